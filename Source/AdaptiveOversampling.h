@@ -0,0 +1,86 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+
+//==============================================================================
+// Adaptive oversampling policy
+// Estimates per block how much aliasing the fuzz can produce from the input
+// level, the output gain and how far the PINCH gate is open, and picks the
+// number of 2x stages (0..maxStages) for the next block. Steps up at once,
+// steps down one factor at a time after the lower factor has been safe for a
+// hold period with a hysteresis margin.
+//==============================================================================
+
+class AdaptiveOversamplingPolicy
+{
+public:
+    void prepare(double sampleRate, int newMaxStages)
+    {
+        maxStages = std::max(0, newMaxStages);
+        holdSamples = static_cast<int>(sampleRate * 0.25);
+        reset();
+    }
+
+    void reset()
+    {
+        // Start at full quality and relax from there
+        stages = maxStages;
+        samplesBelow = 0;
+    }
+
+    int update(float inputPeak, double outputGain, double gateActivity, int numSamples)
+    {
+        // Level that reaches the output through the open part of the gate
+        const double risk = static_cast<double>(inputPeak) * outputGain * gateActivity;
+        const double riskDb = 20.0 * std::log10(std::max(risk, 1.0e-9));
+
+        const int target = stagesForRisk(riskDb);
+
+        if (target > stages)
+        {
+            stages = target;
+            samplesBelow = 0;
+        }
+        else if (target < stages && stagesForRisk(riskDb + hysteresisDb) < stages)
+        {
+            samplesBelow += numSamples;
+
+            if (samplesBelow >= holdSamples)
+            {
+                --stages;
+                samplesBelow = 0;
+            }
+        }
+        else
+        {
+            samplesBelow = 0;
+        }
+
+        return stages;
+    }
+
+    int getStages() const { return stages; }
+
+private:
+    static constexpr double hysteresisDb = 6.0;
+
+    int maxStages = 3;
+    int stages = 3;
+    int holdSamples = 11025;
+    int samplesBelow = 0;
+
+    int stagesForRisk(double riskDb) const
+    {
+        // With ~70 dB of gain ahead of Q2, anything much above -70 dBFS is driven
+        // into hard saturation; only near-silence and a shut gate stay linear
+        int target = 3;
+        if (riskDb < -84.0)
+            target = 0;
+        else if (riskDb < -66.0)
+            target = 1;
+        else if (riskDb < -48.0)
+            target = 2;
+
+        return std::min(target, maxStages);
+    }
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <algorithm>
+
+//==============================================================================
+// CPU load governor
+// Tracks how much of each block's real-time budget processing takes and picks
+// a quality tier for the next block: 0 is full quality, each higher tier is
+// cheaper. Steps down one tier after the smoothed load has stayed above
+// pressureLoad for a short hold, or at once after a block that overran its
+// budget. Steps back up one tier after the load has stayed below
+// headroomLoad for a longer hold, which doubles each time a step up has to be
+// taken back soon after, so a load sitting near a tier boundary can't make
+// the quality flap. What each tier means is up to the caller.
+//==============================================================================
+
+class CpuGovernor
+{
+public:
+    void prepare(double newSampleRate, int newNumTiers)
+    {
+        sampleRate = newSampleRate;
+        pressureHoldSamples = static_cast<long long>(sampleRate * 0.2);
+        minHeadroomHoldSamples = static_cast<long long>(sampleRate * 3.0);
+        maxHeadroomHoldSamples = static_cast<long long>(sampleRate * 60.0);
+        relapseSamples = static_cast<long long>(sampleRate * 10.0);
+        settleSamples = static_cast<long long>(sampleRate * 0.05);
+        setNumTiers(newNumTiers);
+        reset();
+    }
+
+    void setNumTiers(int newNumTiers)
+    {
+        numTiers = std::max(1, newNumTiers);
+        tier = std::min(tier, numTiers - 1);
+    }
+
+    void reset()
+    {
+        tier = 0;
+        load = 0.0;
+        samplesAbove = samplesBelow = 0;
+        samplesSinceChange = samplesSinceStepUp = 0;
+        steppedUp = false;
+        headroomHoldSamples = minHeadroomHoldSamples;
+    }
+
+    // Switching either way starts again from tier 0 with no load history
+    void setEnabled(bool shouldBeEnabled)
+    {
+        if (shouldBeEnabled != enabled)
+            reset();
+
+        enabled = shouldBeEnabled;
+    }
+
+    int update(double processSeconds, int numSamples)
+    {
+        if (numSamples <= 0 || sampleRate <= 0.0)
+            return tier;
+
+        // Fraction of the block's duration spent processing it, smoothed over ~0.1 s
+        const double blockLoad = processSeconds * sampleRate / numSamples;
+        const double coefficient = std::min(1.0, numSamples / (sampleRate * 0.1));
+        load += (blockLoad - load) * coefficient;
+
+        samplesSinceChange += numSamples;
+        samplesSinceStepUp += numSamples;
+
+        if (! enabled)
+            return tier;
+
+        // The load measured right after a change still reflects the old tier
+        if (samplesSinceChange < settleSamples)
+            return tier;
+
+        samplesAbove = load > pressureLoad ? samplesAbove + numSamples : 0;
+        samplesBelow = load < headroomLoad ? samplesBelow + numSamples : 0;
+
+        if (tier < numTiers - 1 && (blockLoad > 1.0 || samplesAbove >= pressureHoldSamples))
+        {
+            // A step up taken back this soon was premature: wait longer next time
+            if (steppedUp && samplesSinceStepUp < relapseSamples)
+                headroomHoldSamples = std::min(headroomHoldSamples * 2, maxHeadroomHoldSamples);
+
+            ++tier;
+            steppedUp = false;
+            changed();
+        }
+        else if (tier > 0 && samplesBelow >= headroomHoldSamples)
+        {
+            // A step up that held for a while resets the back-off
+            if (steppedUp && samplesSinceStepUp >= relapseSamples)
+                headroomHoldSamples = minHeadroomHoldSamples;
+
+            --tier;
+            steppedUp = true;
+            samplesSinceStepUp = 0;
+            changed();
+        }
+
+        return tier;
+    }
+
+    int getTier() const { return tier; }
+    int getNumTiers() const { return numTiers; }
+    double getLoad() const { return load; }
+
+private:
+    static constexpr double pressureLoad = 0.5;
+    static constexpr double headroomLoad = 0.2;
+
+    bool enabled = true;
+    double sampleRate = 44100.0;
+    int numTiers = 1;
+    int tier = 0;
+    double load = 0.0;
+
+    long long pressureHoldSamples = 8820;
+    long long minHeadroomHoldSamples = 132300;
+    long long maxHeadroomHoldSamples = 2646000;
+    long long headroomHoldSamples = 132300;
+    long long relapseSamples = 441000;
+    long long settleSamples = 2205;
+
+    long long samplesAbove = 0, samplesBelow = 0;
+    long long samplesSinceChange = 0, samplesSinceStepUp = 0;
+    bool steppedUp = false;
+
+    void changed()
+    {
+        samplesAbove = samplesBelow = 0;
+        samplesSinceChange = 0;
+    }
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include "MammothChannel.h"
+#include "RationalResampler.h"
+
+//==============================================================================
+// One audio channel of the fuzz running at a fixed internal rate
+// Resamples the host signal to internalRate, runs a MammothChannel there and
+// resamples back, so the voicing and the CPU cost no longer follow the host
+// rate. The resampler delays are chosen so the whole chain, oversampler
+// included, lands on an exact whole number of host samples.
+//==============================================================================
+
+class FixedRateChannel
+{
+public:
+    static constexpr double internalRate = 96000.0;
+
+    // Host rates this can run at; anything else stays at the host rate
+    static bool isSupported(double hostRate)
+    {
+        return (hostRate < internalRate || hostRate > internalRate)
+            && RationalResampler::isSupported(hostRate, internalRate)
+            && RationalResampler::isSupported(internalRate, hostRate);
+    }
+
+    void prepare(double hostRate, int maxBlockSize)
+    {
+        active = isSupported(hostRate);
+        if (! active)
+            return;
+
+        // Filters reach 12 samples of the lower rate either side, enough for
+        // ~70 dB of image and alias rejection from 0.6 x the lower Nyquist
+        const double lowerRate = std::min(hostRate, internalRate);
+        const double halfLength = 12.0 / lowerRate;
+
+        upsampler.prepare(hostRate, internalRate, halfLength, std::ceil(halfLength * hostRate) / hostRate, maxBlockSize);
+        upsamplerDelay = static_cast<int>(std::ceil(halfLength * hostRate));
+
+        const int maxInternal = upsampler.getMaxOutputSamples(maxBlockSize);
+        channel.setLatencyAlignment(MammothChannel::maxStages);
+        channel.prepare(internalRate, maxInternal);
+
+        // The oversampler's latency is taken out of the downsampler's delay so
+        // the total rounds up to whole host samples instead of being rounded off
+        const double channelDelay = channel.getLatencyInSamples(0) / internalRate;
+        downsamplerDelay = static_cast<int>(std::ceil((halfLength + channelDelay) * hostRate));
+        downsampler.prepare(internalRate, hostRate, halfLength, downsamplerDelay / hostRate - channelDelay, maxInternal);
+
+        internalBuffer.assign(static_cast<size_t>(maxInternal), 0.0f);
+        outputFifo.assign(static_cast<size_t>(downsampler.getMaxOutputSamples(maxInternal) + maxBlockSize), 0.0f);
+        reset();
+    }
+
+    void reset()
+    {
+        upsampler.reset();
+        channel.reset();
+        downsampler.reset();
+
+        std::fill(outputFifo.begin(), outputFifo.end(), 0.0f);
+        fifoSize = 0;
+    }
+
+    bool isActive() const { return active; }
+
+    void setParameters(double wool, double pinch, double eq, double output, unsigned features)
+    {
+        channel.setParameters(wool, pinch, eq, output, features);
+    }
+
+    void setSecondCircuit(bool enabled, double wool, double pinch, double eq, double output, double blendA, double blendB)
+    {
+        channel.setSecondCircuit(enabled, wool, pinch, eq, output, blendA, blendB);
+    }
+
+    // Host samples from input to output, exact
+    int getLatencyInSamples() const { return upsamplerDelay + downsamplerDelay; }
+
+    void process(float* samples, int numSamples, int stages)
+    {
+        const int numInternal = upsampler.process(samples, numSamples, internalBuffer.data());
+        channel.process(internalBuffer.data(), numInternal, stages);
+
+        // A block can come back one sample long or short, but host output j
+        // only ever depends on host input up to j, so the FIFO never runs dry
+        fifoSize += downsampler.process(internalBuffer.data(), numInternal, outputFifo.data() + fifoSize);
+
+        std::copy_n(outputFifo.begin(), numSamples, samples);
+        std::copy(outputFifo.begin() + numSamples, outputFifo.begin() + fifoSize, outputFifo.begin());
+        fifoSize -= numSamples;
+    }
+
+    void copyStateFrom(const FixedRateChannel& other)
+    {
+        upsampler.copyStateFrom(other.upsampler);
+        channel.copyStateFrom(other.channel);
+        downsampler.copyStateFrom(other.downsampler);
+        std::copy_n(other.outputFifo.begin(), other.fifoSize, outputFifo.begin());
+        fifoSize = other.fifoSize;
+    }
+
+    int getActiveStages() const { return channel.getActiveStages(); }
+    double getGateActivity() const { return channel.getGateActivity(); }
+    double getSupplyVoltage() const { return channel.getSupplyVoltage(); }
+
+private:
+    bool active = false;
+    RationalResampler upsampler, downsampler;
+    MammothChannel channel;
+    int upsamplerDelay = 0, downsamplerDelay = 0;
+
+    std::vector<float> internalBuffer;
+    std::vector<float> outputFifo;
+    int fifoSize = 0;
+};
@@ -0,0 +1,539 @@
+#include "FlightRecorder.h"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+    constexpr int recordingVersion = 1;
+
+    // Smallest block the block ring is sized for; smaller host buffers still
+    // record, with a correspondingly shorter history
+    constexpr int smallestExpectedBlock = 16;
+
+    void writeRing (juce::AudioBuffer<float>& ring, const juce::AudioBuffer<float>& source,
+                    juce::int64 position, int numSamples)
+    {
+        const int ringSize = ring.getNumSamples();
+        const int start = static_cast<int> (position % ringSize);
+        const int first = juce::jmin (numSamples, ringSize - start);
+        const int numChannels = juce::jmin (ring.getNumChannels(), source.getNumChannels());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            ring.copyFrom (channel, start, source, channel, 0, first);
+
+            if (first < numSamples)
+                ring.copyFrom (channel, 0, source, channel, first, numSamples - first);
+        }
+    }
+
+    void readRing (const juce::AudioBuffer<float>& ring, juce::AudioBuffer<float>& destination,
+                   juce::int64 position, int numSamples)
+    {
+        destination.setSize (ring.getNumChannels(), numSamples);
+
+        const int ringSize = ring.getNumSamples();
+        const int start = static_cast<int> (position % ringSize);
+        const int first = juce::jmin (numSamples, ringSize - start);
+
+        for (int channel = 0; channel < ring.getNumChannels(); ++channel)
+        {
+            destination.copyFrom (channel, 0, ring, channel, start, first);
+
+            if (first < numSamples)
+                destination.copyFrom (channel, first, ring, channel, 0, numSamples - first);
+        }
+    }
+
+    bool writeWav (const juce::File& file, const juce::AudioBuffer<float>& audio, double sampleRate)
+    {
+        file.deleteFile();
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+
+        if (auto stream = file.createOutputStream())
+            writer.reset (juce::WavAudioFormat().createWriterFor (stream.release(), sampleRate,
+                                                                  static_cast<unsigned> (audio.getNumChannels()), 32, {}, 0));
+
+        return writer != nullptr && writer->writeFromAudioSampleBuffer (audio, 0, audio.getNumSamples());
+    }
+
+    bool readWav (const juce::File& file, juce::AudioBuffer<float>& audio)
+    {
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (file));
+        if (reader == nullptr)
+            return false;
+
+        audio.setSize (static_cast<int> (reader->numChannels), static_cast<int> (reader->lengthInSamples));
+        return reader->read (&audio, 0, audio.getNumSamples(), 0, true, true);
+    }
+}
+
+//==============================================================================
+juce::String FlightRecorder::describeTriggers (juce::uint32 reasons)
+{
+    juce::StringArray names;
+
+    if ((reasons & userRequest) != 0)    names.add ("request");
+    if ((reasons & nonFinite) != 0)      names.add ("non-finite");
+    if ((reasons & clippingBurst) != 0)  names.add ("clipping");
+    if ((reasons & deadlineMiss) != 0)   names.add ("deadline");
+
+    return names.joinIntoString (" ");
+}
+
+//==============================================================================
+bool FlightRecorder::Recording::save (const juce::File& xmlFile) const
+{
+    const auto name = xmlFile.getFileNameWithoutExtension();
+    const auto inputFile = xmlFile.getSiblingFile (name + " input.wav");
+    const auto outputFile = xmlFile.getSiblingFile (name + " output.wav");
+
+    if (! writeWav (inputFile, input, sampleRate) || ! writeWav (outputFile, output, sampleRate))
+        return false;
+
+    juce::XmlElement root ("FlightRecording");
+    root.setAttribute ("version", recordingVersion);
+    root.setAttribute ("sampleRate", sampleRate);
+    root.setAttribute ("maxBlockSize", maxBlockSize);
+    root.setAttribute ("inputChannels", numInputChannels);
+    root.setAttribute ("outputChannels", numOutputChannels);
+    root.setAttribute ("triggers", static_cast<int> (triggers));
+    root.setAttribute ("reason", describeTriggers (triggers));
+    root.setAttribute ("triggerSample", juce::String (triggerSample));
+    root.setAttribute ("cabinetIR", cabinetFile.getFullPathName());
+    root.setAttribute ("input", inputFile.getFileName());
+    root.setAttribute ("output", outputFile.getFileName());
+    root.setAttribute ("parameters", parameterIds.joinIntoString (" "));
+
+    for (const auto& block : blocks)
+    {
+        // Nine significant digits bring every float back bit for bit
+        juce::StringArray values;
+        for (int i = 0; i < parameterIds.size() && i < maxParameters; ++i)
+            values.add (juce::String::formatted ("%.9g", static_cast<double> (block.parameters[i])));
+
+        auto* element = root.createNewChildElement ("Block");
+        element->setAttribute ("n", block.numSamples);
+        element->setAttribute ("us", static_cast<double> (block.processMicros));
+        element->setAttribute ("supply", static_cast<double> (block.supplyVoltage));
+        element->setAttribute ("gate", static_cast<double> (block.gateActivity));
+        element->setAttribute ("factor", block.oversamplingFactor);
+        element->setAttribute ("tier", block.qualityTier);
+        element->setAttribute ("values", values.joinIntoString (" "));
+
+        if (block.triggers != 0)
+            element->setAttribute ("triggers", static_cast<int> (block.triggers));
+    }
+
+    return root.writeTo (xmlFile);
+}
+
+bool FlightRecorder::Recording::load (const juce::File& xmlFile, Recording& result, juce::String& error)
+{
+    const auto root = juce::XmlDocument::parse (xmlFile);
+
+    if (root == nullptr || ! root->hasTagName ("FlightRecording"))
+    {
+        error = xmlFile.getFullPathName() + " is not a flight recording";
+        return false;
+    }
+
+    if (root->getIntAttribute ("version") > recordingVersion)
+    {
+        error = "The recording was made by a newer version";
+        return false;
+    }
+
+    result.sampleRate = root->getDoubleAttribute ("sampleRate");
+    result.maxBlockSize = root->getIntAttribute ("maxBlockSize");
+    result.numInputChannels = root->getIntAttribute ("inputChannels");
+    result.numOutputChannels = root->getIntAttribute ("outputChannels");
+    result.triggers = static_cast<juce::uint32> (root->getIntAttribute ("triggers"));
+    result.triggerSample = root->getStringAttribute ("triggerSample", "-1").getLargeIntValue();
+    result.parameterIds = juce::StringArray::fromTokens (root->getStringAttribute ("parameters"), " ", {});
+    result.parameterIds.removeEmptyStrings();
+
+    const auto cabinetPath = root->getStringAttribute ("cabinetIR");
+    result.cabinetFile = juce::File::isAbsolutePath (cabinetPath) ? juce::File (cabinetPath) : juce::File();
+
+    result.blocks.clear();
+    juce::int64 totalSamples = 0;
+
+    for (auto* element : root->getChildWithTagNameIterator ("Block"))
+    {
+        BlockRecord block;
+        block.numSamples = element->getIntAttribute ("n");
+        block.processMicros = static_cast<float> (element->getDoubleAttribute ("us"));
+        block.supplyVoltage = static_cast<float> (element->getDoubleAttribute ("supply"));
+        block.gateActivity = static_cast<float> (element->getDoubleAttribute ("gate"));
+        block.oversamplingFactor = element->getIntAttribute ("factor", 1);
+        block.qualityTier = element->getIntAttribute ("tier", 0);
+        block.triggers = static_cast<juce::uint32> (element->getIntAttribute ("triggers"));
+
+        const auto values = juce::StringArray::fromTokens (element->getStringAttribute ("values"), " ", {});
+        for (int i = 0; i < values.size() && i < maxParameters; ++i)
+            block.parameters[i] = std::strtof (values[i].toRawUTF8(), nullptr);
+
+        totalSamples += block.numSamples;
+        result.blocks.push_back (block);
+    }
+
+    if (! readWav (xmlFile.getSiblingFile (root->getStringAttribute ("input")), result.input)
+        || ! readWav (xmlFile.getSiblingFile (root->getStringAttribute ("output")), result.output))
+    {
+        error = "Cannot read the recorded audio next to " + xmlFile.getFileName();
+        return false;
+    }
+
+    if (result.input.getNumSamples() != totalSamples || result.output.getNumSamples() != totalSamples)
+    {
+        error = "The recorded audio and block list disagree";
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+FlightRecorder::FlightRecorder()
+    : juce::Thread ("Harmonster flight recorder"),
+      dumpDirectory (juce::File::getSpecialLocation (juce::File::userDocumentsDirectory)
+                         .getChildFile ("Harmonster Flight Recorder"))
+{
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    stopThread (2000);
+}
+
+void FlightRecorder::setEnabled (bool shouldBeEnabled)
+{
+    // The audio thread only looks at the rings once storageReady is set
+    if (shouldBeEnabled && ! storageReady.load())
+    {
+        const juce::ScopedLock sl (storageLock);
+
+        if (sampleRate > 0.0 && ! storageReady.load())
+            allocate();
+    }
+
+    enabled.store (shouldBeEnabled);
+
+    // The dump thread only exists once the recorder has been switched on
+    if (shouldBeEnabled && ! isThreadRunning())
+        startThread (juce::Thread::Priority::low);
+
+    notify();
+}
+
+void FlightRecorder::setDumpDirectory (const juce::File& directory)
+{
+    const juce::ScopedLock sl (fileLock);
+    dumpDirectory = directory;
+}
+
+juce::File FlightRecorder::getDumpDirectory() const
+{
+    const juce::ScopedLock sl (fileLock);
+    return dumpDirectory;
+}
+
+void FlightRecorder::setCabinetFile (const juce::File& file)
+{
+    const juce::ScopedLock sl (fileLock);
+    cabinetFile = file;
+}
+
+juce::File FlightRecorder::getLastDump() const
+{
+    const juce::ScopedLock sl (fileLock);
+    return lastDump;
+}
+
+void FlightRecorder::requestDump()
+{
+    dumpRequested.store (true);
+    notify();
+}
+
+void FlightRecorder::prepare (double newSampleRate, int newMaxBlockSize, int newNumInputChannels,
+                              int newNumOutputChannels, const juce::StringArray& newParameterIds)
+{
+    const juce::ScopedLock sl (storageLock);
+
+    storageReady.store (false);
+    sampleRate = newSampleRate;
+    maxBlockSize = newMaxBlockSize;
+    numInputChannels = juce::jlimit (0, maxChannels, newNumInputChannels);
+    numOutputChannels = juce::jlimit (0, maxChannels, newNumOutputChannels);
+    parameterIds = newParameterIds;
+    wasEnabled = false;
+    phase.store (armed);
+
+    if (enabled.load())
+    {
+        allocate();
+    }
+    else
+    {
+        inputRing.setSize (0, 0);
+        outputRing.setSize (0, 0);
+        blockRing = {};
+    }
+}
+
+void FlightRecorder::allocate()
+{
+    ringSamples = juce::jmax (maxBlockSize, static_cast<int> (historySeconds * sampleRate));
+    inputRing.setSize (numInputChannels, ringSamples);
+    outputRing.setSize (numOutputChannels, ringSamples);
+    inputRing.clear();
+    outputRing.clear();
+    blockRing.assign (static_cast<size_t> (ringSamples / smallestExpectedBlock + 1), BlockRecord {});
+
+    resetWindow();
+    storageReady.store (true);
+}
+
+void FlightRecorder::resetWindow()
+{
+    samplesWritten = 0;
+    blocksWritten = 0;
+    triggerSample = -1;
+    triggers = 0;
+}
+
+//==============================================================================
+bool FlightRecorder::beginBlock (const juce::AudioBuffer<float>& buffer, const juce::Array<juce::AudioProcessorParameter*>& parameters)
+{
+    if (! enabled.load() || ! storageReady.load())
+    {
+        wasEnabled = false;
+        return false;
+    }
+
+    // Announce the write before looking at the phase, so a requested freeze
+    // either sees us busy or we see it frozen
+    busy.store (true);
+
+    const int numSamples = buffer.getNumSamples();
+
+    if (phase.load() == frozen || numSamples > ringSamples)
+    {
+        busy.store (false);
+        return false;
+    }
+
+    if (! wasEnabled)
+    {
+        // Switched on, or back on after a gap: start a fresh window
+        wasEnabled = true;
+        resetWindow();
+
+        for (auto& run : clippedRun)
+            run = 0;
+
+        int expected = draining;
+        phase.compare_exchange_strong (expected, armed);
+    }
+
+    auto& block = blockRing[static_cast<size_t> (blocksWritten % static_cast<juce::int64> (blockRing.size()))];
+    block = BlockRecord {};
+    block.numSamples = numSamples;
+
+    for (int i = 0; i < juce::jmin (parameters.size(), maxParameters); ++i)
+        block.parameters[i] = parameters.getUnchecked (i)->getValue();
+
+    writeRing (inputRing, buffer, samplesWritten, numSamples);
+    return true;
+}
+
+void FlightRecorder::endBlock (const juce::AudioBuffer<float>& buffer, const BlockState& state)
+{
+    auto& block = blockRing[static_cast<size_t> (blocksWritten % static_cast<juce::int64> (blockRing.size()))];
+    const int numSamples = block.numSamples;
+
+    block.processMicros = static_cast<float> (state.processSeconds * 1.0e6);
+    block.supplyVoltage = static_cast<float> (state.supplyVoltage);
+    block.gateActivity = static_cast<float> (state.gateActivity);
+    block.oversamplingFactor = state.oversamplingFactor;
+    block.qualityTier = state.qualityTier;
+
+    writeRing (outputRing, buffer, samplesWritten, numSamples);
+
+    // Anomalies: the plugin alone overran the block's real-time budget, or
+    // the output went non-finite or sat at full scale
+    juce::uint32 detected = 0;
+
+    if (state.processSeconds * sampleRate > numSamples)
+        detected |= deadlineMiss;
+
+    for (int channel = 0; channel < juce::jmin (numOutputChannels, buffer.getNumChannels()); ++channel)
+    {
+        const float* samples = buffer.getReadPointer (channel);
+        int run = clippedRun[channel];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            if (! std::isfinite (samples[i]))
+                detected |= nonFinite;
+
+            run = std::abs (samples[i]) >= 1.0f ? run + 1 : 0;
+
+            if (run >= clippingBurstSamples)
+                detected |= clippingBurst;
+        }
+
+        clippedRun[channel] = run;
+    }
+
+    block.triggers = detected;
+
+    if (detected != 0)
+        trigger (detected);
+
+    samplesWritten += numSamples;
+    ++blocksWritten;
+
+    if (phase.load() == draining && samplesWritten >= freezeAtSample)
+        phase.store (frozen);
+
+    busy.store (false);
+}
+
+void FlightRecorder::trigger (juce::uint32 reasons)
+{
+    if (phase.load() == draining)
+    {
+        triggers |= reasons;
+        return;
+    }
+
+    if (automaticDumps >= maxAutomaticDumps)
+        return;
+
+    // Fails if the dump thread has just frozen the rings for a request
+    int expected = armed;
+    if (! phase.compare_exchange_strong (expected, draining))
+        return;
+
+    ++automaticDumps;
+    triggers = reasons;
+    triggerSample = samplesWritten;
+    freezeAtSample = samplesWritten + static_cast<juce::int64> (postTriggerSeconds * sampleRate);
+}
+
+//==============================================================================
+void FlightRecorder::freezeForRequest()
+{
+    int expected = armed;
+
+    // Already draining towards an anomaly dump, which will cover the request
+    if (! phase.compare_exchange_strong (expected, frozen))
+        return;
+
+    while (busy.load())
+        juce::Thread::yield();
+
+    triggers = userRequest;
+    triggerSample = samplesWritten;
+}
+
+void FlightRecorder::copyWindow (Recording& destination)
+{
+    destination.sampleRate = sampleRate;
+    destination.numInputChannels = numInputChannels;
+    destination.numOutputChannels = numOutputChannels;
+    destination.parameterIds = parameterIds;
+    destination.triggers = triggers;
+
+    {
+        const juce::ScopedLock sl (fileLock);
+        destination.cabinetFile = cabinetFile;
+    }
+
+    // The newest run of blocks still held by both the block and audio rings
+    const auto numSlots = static_cast<juce::int64> (blockRing.size());
+    const auto oldest = juce::jmax (static_cast<juce::int64> (0), blocksWritten - numSlots);
+    auto first = blocksWritten;
+    juce::int64 windowSamples = 0;
+
+    while (first > oldest)
+    {
+        const int numSamples = blockRing[static_cast<size_t> ((first - 1) % numSlots)].numSamples;
+        if (windowSamples + numSamples > ringSamples)
+            break;
+
+        windowSamples += numSamples;
+        --first;
+    }
+
+    const auto windowStart = samplesWritten - windowSamples;
+    destination.triggerSample = triggerSample >= windowStart ? triggerSample - windowStart : -1;
+    destination.maxBlockSize = maxBlockSize;
+
+    destination.blocks.clear();
+    for (auto index = first; index < blocksWritten; ++index)
+    {
+        destination.blocks.push_back (blockRing[static_cast<size_t> (index % numSlots)]);
+        destination.maxBlockSize = juce::jmax (destination.maxBlockSize, destination.blocks.back().numSamples);
+    }
+
+    readRing (inputRing, destination.input, windowStart, static_cast<int> (windowSamples));
+    readRing (outputRing, destination.output, windowStart, static_cast<int> (windowSamples));
+}
+
+void FlightRecorder::writeDump (const Recording& recording)
+{
+    const auto directory = getDumpDirectory();
+    if (directory.createDirectory().failed())
+        return;
+
+    const auto name = "Harmonster " + juce::Time::getCurrentTime().formatted ("%Y-%m-%d %H-%M-%S")
+                    + " " + describeTriggers (recording.triggers);
+    const auto xmlFile = directory.getNonexistentChildFile (name, ".xml", false);
+
+    if (recording.save (xmlFile))
+    {
+        const juce::ScopedLock sl (fileLock);
+        lastDump = xmlFile;
+        ++numDumps;
+    }
+}
+
+void FlightRecorder::run()
+{
+    while (! threadShouldExit())
+    {
+        // Polls for the audio thread freezing the rings while armed
+        wait (enabled.load() ? 100 : -1);
+
+        Recording dump;
+        bool hasDump = false;
+
+        {
+            const juce::ScopedLock sl (storageLock);
+
+            if (dumpRequested.exchange (false) && enabled.load() && storageReady.load())
+                freezeForRequest();
+
+            // The audio thread has let go of the rings: copy the window out
+            // and hand them straight back
+            if (storageReady.load() && phase.load() == frozen)
+            {
+                copyWindow (dump);
+                resetWindow();
+                phase.store (armed);
+                hasDump = ! dump.blocks.empty();
+            }
+        }
+
+        if (hasDump)
+            writeDump (dump);
+    }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <atomic>
+#include <vector>
+
+//==============================================================================
+// Opt-in flight recorder for reproducing glitches offline
+// The audio thread copies every block's input, output, parameter values,
+// timing and key circuit state into preallocated rings holding the last
+// historySeconds. It never locks or allocates: the rings belong to it until
+// a trigger freezes them, then a background thread copies the window out,
+// hands the rings back and writes the dump to disk. Triggers are a request
+// from any thread, or an anomaly on the audio thread (non-finite output, a
+// burst of full-scale samples, a block that took longer than it lasts),
+// after which recording carries on for postTriggerSeconds so the dump shows
+// the aftermath too.
+//
+// A dump is an XML file describing the session and every block, plus the
+// input and output audio as 32-bit float WAVs next to it.
+// HarmonsterOfflineRender --replay feeds it back through the processor with
+// the same block sizes and parameter values.
+//==============================================================================
+class FlightRecorder : private juce::Thread
+{
+public:
+    static constexpr double historySeconds = 10.0;
+    static constexpr double postTriggerSeconds = 1.0;
+    static constexpr int maxChannels = 2;
+    static constexpr int maxParameters = 32;
+    static constexpr int maxAutomaticDumps = 20;     // per session, so a clipping mix can't fill the disk
+    static constexpr int clippingBurstSamples = 16;  // consecutive samples at full scale
+
+    enum Trigger : juce::uint32
+    {
+        userRequest   = 1u << 0,
+        nonFinite     = 1u << 1,
+        clippingBurst = 1u << 2,
+        deadlineMiss  = 1u << 3
+    };
+
+    static juce::String describeTriggers (juce::uint32 reasons);
+
+    // One processBlock() call
+    struct BlockRecord
+    {
+        int numSamples = 0;
+        float parameters[maxParameters] {};  // normalised, in Recording::parameterIds order
+        float processMicros = 0.0f;          // time spent in processBlock()
+        float supplyVoltage = 0.0f;          // left circuit at the end of the block
+        float gateActivity = 0.0f;           // gating_smoother, ditto
+        int oversamplingFactor = 1;
+        int qualityTier = 0;                 // CPU governor tier the block ran at
+        juce::uint32 triggers = 0;           // anomalies detected in this block
+    };
+
+    // Circuit state reported by the processor after each block
+    struct BlockState
+    {
+        double processSeconds = 0.0;
+        double supplyVoltage = 0.0;
+        double gateActivity = 0.0;
+        int oversamplingFactor = 1;
+        int qualityTier = 0;
+    };
+
+    // A dump, as written to disk and read back by the replay
+    struct Recording
+    {
+        double sampleRate = 0.0;
+        int maxBlockSize = 0;
+        int numInputChannels = 0, numOutputChannels = 0;
+        juce::StringArray parameterIds;
+        juce::File cabinetFile;
+        juce::uint32 triggers = 0;
+        juce::int64 triggerSample = -1;  // first trigger, relative to the start of the window
+        std::vector<BlockRecord> blocks;
+        juce::AudioBuffer<float> input, output;
+
+        bool save (const juce::File& xmlFile) const;
+        static bool load (const juce::File& xmlFile, Recording& result, juce::String& error);
+    };
+
+    FlightRecorder();
+    ~FlightRecorder() override;
+
+    // Message thread. The rings only exist while the recorder is enabled.
+    void setEnabled (bool shouldBeEnabled);
+    bool isEnabled() const { return enabled.load(); }
+
+    void setDumpDirectory (const juce::File& directory);
+    juce::File getDumpDirectory() const;
+    void setCabinetFile (const juce::File& file);
+
+    // Any thread: dump the last historySeconds as soon as possible
+    void requestDump();
+
+    // Any thread: the most recent dump and how many were written
+    juce::File getLastDump() const;
+    int getNumDumps() const { return numDumps.load(); }
+
+    // Never concurrently with beginBlock()/endBlock(), i.e. from prepareToPlay()
+    void prepare (double sampleRate, int maxBlockSize, int numInputChannels, int numOutputChannels,
+                  const juce::StringArray& parameterIds);
+
+    // Audio thread, around processBlock(). beginBlock() records the input and
+    // parameters and returns false if the block is not being recorded, in
+    // which case endBlock() must not be called.
+    bool beginBlock (const juce::AudioBuffer<float>& buffer, const juce::Array<juce::AudioProcessorParameter*>& parameters);
+    void endBlock (const juce::AudioBuffer<float>& buffer, const BlockState& state);
+
+private:
+    // armed -> draining (audio thread, on an anomaly) -> frozen (audio
+    // thread, once the post-trigger audio is in) -> armed (dump thread, once
+    // it has copied the window). A requested dump goes straight from armed
+    // to frozen on the dump thread; busy tells it when the audio thread is
+    // out of the rings.
+    enum Phase { armed, draining, frozen };
+
+    std::atomic<bool> enabled { false };
+    std::atomic<bool> storageReady { false };
+    std::atomic<int> phase { armed };
+    std::atomic<bool> busy { false };
+    std::atomic<bool> dumpRequested { false };
+    std::atomic<int> numDumps { 0 };
+
+    // Configuration and rings; reallocated only under storageLock while the
+    // audio thread cannot be using them
+    juce::CriticalSection storageLock;
+    double sampleRate = 0.0;
+    int maxBlockSize = 0;
+    int numInputChannels = 0, numOutputChannels = 0;
+    juce::StringArray parameterIds;
+    juce::AudioBuffer<float> inputRing, outputRing;
+    std::vector<BlockRecord> blockRing;
+    int ringSamples = 0;
+
+    // Owned by the audio thread while armed or draining, by the dump thread
+    // while frozen
+    juce::int64 samplesWritten = 0;
+    juce::int64 blocksWritten = 0;
+    juce::int64 freezeAtSample = 0;
+    juce::int64 triggerSample = -1;
+    juce::uint32 triggers = 0;
+
+    // Audio thread only
+    bool wasEnabled = false;
+    int clippedRun[maxChannels] {};
+    int automaticDumps = 0;
+
+    // Message and dump threads
+    juce::CriticalSection fileLock;
+    juce::File dumpDirectory, cabinetFile, lastDump;
+
+    void allocate();
+    void resetWindow();
+    void trigger (juce::uint32 reasons);
+    void freezeForRequest();
+    void copyWindow (Recording& destination);
+    void writeDump (const Recording& recording);
+
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FlightRecorder)
+};
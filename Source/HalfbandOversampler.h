@@ -0,0 +1,267 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include "SharedDspTables.h"
+
+//==============================================================================
+// Linear-phase FIR halfband stage (2x up / 2x down)
+// Kaiser-windowed halfband: every other tap is zero apart from the centre, so
+// interpolation costs one short dot product per input sample and the odd
+// output phase is a plain delay.
+//==============================================================================
+
+class HalfbandStage
+{
+public:
+    void design(int numTaps)
+    {
+        // Halfband lengths are 4k + 3 so the centre tap sits on an odd index
+        taps = numTaps;
+        centre = (taps - 1) / 2;
+
+        // The kernel depends on the length only, so one copy serves the whole process
+        kernel = SharedTableCache<int, Kernel>::get(numTaps, [numTaps] { return designKernel(numTaps); });
+    }
+
+    void prepare(int maxInputSamples)
+    {
+        upBuffer.assign(static_cast<size_t>(getUpHistory() + maxInputSamples), 0.0f);
+        downBuffer.assign(static_cast<size_t>(getDownHistory() + maxInputSamples * 2), 0.0f);
+    }
+
+    void reset()
+    {
+        std::fill(upBuffer.begin(), upBuffer.end(), 0.0f);
+        std::fill(downBuffer.begin(), downBuffer.end(), 0.0f);
+    }
+
+    void copyStateFrom(const HalfbandStage& other)
+    {
+        // Only the filter history is state; the rest of the buffers is scratch
+        std::copy_n(other.upBuffer.begin(), getUpHistory(), upBuffer.begin());
+        std::copy_n(other.downBuffer.begin(), getDownHistory(), downBuffer.begin());
+    }
+
+    // numInputSamples in, 2 * numInputSamples out
+    void upsample(const float* input, float* output, int numInputSamples)
+    {
+        const int history = getUpHistory();
+        const int numEven = static_cast<int>(kernel->evenTaps.size());
+        const float* evenTaps = kernel->evenTaps.data();
+        const int oddDelay = (centre - 1) / 2;
+        float* x = upBuffer.data() + history;
+
+        std::copy(input, input + numInputSamples, x);
+
+        for (int m = 0; m < numInputSamples; ++m)
+        {
+            float even = 0.0f;
+            for (int j = 0; j < numEven; ++j)
+                even += evenTaps[j] * x[m - j];
+
+            output[2 * m] = 2.0f * even;
+            output[2 * m + 1] = x[m - oddDelay];
+        }
+
+        std::copy(x + numInputSamples - history, x + numInputSamples, upBuffer.data());
+    }
+
+    // 2 * numOutputSamples in, numOutputSamples out
+    void downsample(const float* input, float* output, int numOutputSamples)
+    {
+        const int history = getDownHistory();
+        const int numEven = static_cast<int>(kernel->evenTaps.size());
+        const float* evenTaps = kernel->evenTaps.data();
+        const int numInputSamples = numOutputSamples * 2;
+        float* v = downBuffer.data() + history;
+
+        std::copy(input, input + numInputSamples, v);
+
+        for (int m = 0; m < numOutputSamples; ++m)
+        {
+            const float* newest = v + 2 * m;
+            float sum = 0.5f * newest[-centre];
+            for (int j = 0; j < numEven; ++j)
+                sum += evenTaps[j] * newest[-2 * j];
+
+            output[m] = sum;
+        }
+
+        std::copy(v + numInputSamples - history, v + numInputSamples, downBuffer.data());
+    }
+
+    // Up + down group delay, in samples at the stage's high rate
+    int getRoundTripLatency() const { return 2 * centre; }
+
+private:
+    struct Kernel
+    {
+        std::vector<float> evenTaps;
+    };
+
+    int taps = 3;
+    int centre = 1;
+    std::shared_ptr<const Kernel> kernel;     // shared, read-only
+    std::vector<float> upBuffer, downBuffer;  // history prefix + current block
+
+    int getUpHistory() const { return static_cast<int>(kernel->evenTaps.size()) - 1; }
+    int getDownHistory() const { return taps - 1; }
+
+    static Kernel designKernel(int numTaps)
+    {
+        const int kernelCentre = (numTaps - 1) / 2;
+        const double beta = 7.86;  // ~80 dB stopband
+        const double besselBeta = besselI0(beta);
+
+        Kernel designed;
+        designed.evenTaps.assign(static_cast<size_t>((numTaps + 1) / 2), 0.0f);
+        double sum = 0.0;
+
+        for (int n = 0; n < numTaps; n += 2)
+        {
+            double offset = n - kernelCentre;
+            double ratio = offset / kernelCentre;
+            double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / besselBeta;
+            double sinc = std::sin(M_PI * offset * 0.5) / (M_PI * offset);
+            designed.evenTaps[static_cast<size_t>(n / 2)] = static_cast<float>(sinc * window);
+            sum += sinc * window;
+        }
+
+        // Even taps sum to exactly 0.5 so the DC gain is unity
+        for (auto& tap : designed.evenTaps)
+            tap = static_cast<float>(tap * 0.5 / sum);
+
+        return designed;
+    }
+
+    static double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x * 0.5 / k) * (x * 0.5 / k);
+            sum += term;
+        }
+        return sum;
+    }
+};
+
+//==============================================================================
+// Cascade of up to three halfband stages (2x, 4x, 8x)
+// The first stage carries the audible transition band and gets the longest
+// filter; later stages only have to reject images far above the audio band.
+// A halfband's centre tap is always odd, so the later stages leave the
+// latency a fraction of a base-rate sample off whole; a delay of a few
+// samples at the oversampled rate tops it up exactly, and the latency is a
+// whole number of base-rate samples at every factor.
+//==============================================================================
+
+class HalfbandOversampler
+{
+public:
+    static constexpr int maxStages = 3;
+
+    void prepare(int newNumStages, int maxBlockSize)
+    {
+        static constexpr std::array<int, maxStages> stageTaps { 47, 23, 15 };
+
+        numStages = std::clamp(newNumStages, 0, maxStages);
+        maxInputSamples = maxBlockSize;
+
+        for (int s = 0; s < numStages; ++s)
+        {
+            stages[static_cast<size_t>(s)].design(stageTaps[static_cast<size_t>(s)]);
+            stages[static_cast<size_t>(s)].prepare(maxBlockSize << s);
+        }
+
+        int latency = 0;
+        for (int s = 0; s < numStages; ++s)
+            latency += stages[static_cast<size_t>(s)].getRoundTripLatency() << (numStages - 1 - s);
+
+        trimDelay = (getFactor() - latency % getFactor()) % getFactor();
+        baseLatency = (latency + trimDelay) / getFactor();
+        trimHistory.fill(0.0f);
+
+        for (auto& buffer : buffers)
+            buffer.assign(static_cast<size_t>(std::max(1, maxBlockSize << numStages)), 0.0f);
+    }
+
+    void reset()
+    {
+        for (int s = 0; s < numStages; ++s)
+            stages[static_cast<size_t>(s)].reset();
+
+        trimHistory.fill(0.0f);
+    }
+
+    void copyStateFrom(const HalfbandOversampler& other)
+    {
+        for (int s = 0; s < numStages; ++s)
+            stages[static_cast<size_t>(s)].copyStateFrom(other.stages[static_cast<size_t>(s)]);
+
+        trimHistory = other.trimHistory;
+    }
+
+    int getFactor() const { return 1 << numStages; }
+    int getMaxBlockSize() const { return maxInputSamples; }
+
+    // Returns the oversampled block (numSamples * getFactor() long); numSamples <= maxBlockSize
+    float* upsample(const float* input, int numSamples)
+    {
+        const float* source = input;
+        float* destination = nullptr;
+
+        for (int s = 0; s < numStages; ++s)
+        {
+            destination = buffers[static_cast<size_t>(s & 1)].data();
+            stages[static_cast<size_t>(s)].upsample(source, destination, numSamples << s);
+            source = destination;
+        }
+
+        return destination;
+    }
+
+    // Decimates the block returned by upsample() back into output
+    void downsample(float* output, int numSamples)
+    {
+        float* source = buffers[static_cast<size_t>((numStages - 1) & 1)].data();
+        trim(source, numSamples << numStages);
+
+        for (int s = numStages - 1; s >= 0; --s)
+        {
+            float* destination = s == 0 ? output : buffers[static_cast<size_t>(s & 1) ^ 1u].data();
+            stages[static_cast<size_t>(s)].downsample(source, destination, numSamples << s);
+            source = destination;
+        }
+    }
+
+    // Total up + down latency in samples at the base rate, trim included
+    int getLatencyInSamples() const { return baseLatency; }
+
+private:
+    static constexpr int maxFactor = 1 << maxStages;
+
+    int numStages = 0;
+    int maxInputSamples = 0;
+    std::array<HalfbandStage, maxStages> stages;
+    std::array<std::vector<float>, 2> buffers;  // ping-pong between stages
+
+    int trimDelay = 0;                            // samples at the oversampled rate, < the factor
+    int baseLatency = 0;
+    std::array<float, maxFactor> trimHistory {};  // the last trimDelay samples, oldest first
+
+    void trim(float* samples, int numSamples)
+    {
+        if (trimDelay == 0)
+            return;
+
+        // numSamples is a multiple of the factor, so never shorter than the delay
+        std::array<float, maxFactor> newest {};
+        std::copy(samples + numSamples - trimDelay, samples + numSamples, newest.begin());
+        std::copy_backward(samples, samples + numSamples - trimDelay, samples + numSamples);
+        std::copy_n(trimHistory.begin(), trimDelay, samples);
+        trimHistory = newest;
+    }
+};
@@ -0,0 +1,664 @@
+#pragma once
+#include <juce_dsp/juce_dsp.h>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "SharedDspTables.h"
+
+//==============================================================================
+// Low-latency pitch shifter, time domain
+// Two read taps sweep through a delay line at the pitch ratio, each under a
+// sin^2 grain window, half a grain apart so the windows sum to one. When a tap
+// starts a new grain it is moved by up to searchSeconds either way to where
+// the audio best matches what the other tap is playing, so the grains overlap
+// in phase (WSOLA). Nothing tracks the pitch, so chords shift too, though
+// one whose combined period is longer than the search comes out rougher. The
+// latency is the taps' mean delay.
+//==============================================================================
+
+class GrainPitchShifter
+{
+public:
+    void prepare(double sampleRate)
+    {
+        grainLength = static_cast<int>(std::lround(sampleRate * grainSeconds));
+        searchRange = static_cast<int>(std::lround(sampleRate * searchSeconds));
+        // A whole number of four-sample passes through the search
+        correlationLength = std::max(4, static_cast<int>(std::lround(sampleRate * correlationSeconds)) / 4 * 4);
+
+        // Cubic interpolation reads two samples past the read position
+        minimumDelay = searchRange + 2;
+
+        int size = 1;
+        while (size < minimumDelay + grainLength + searchRange + correlationLength + 4)
+            size *= 2;
+
+        buffer.assign(static_cast<size_t>(size), 0.0f);
+        mask = size - 1;
+
+        reference.assign(static_cast<size_t>(correlationLength), 0.0f);
+        span.assign(static_cast<size_t>(correlationLength + 2 * searchRange), 0.0f);
+        scores.assign(static_cast<size_t>(2 * searchRange + 1), 0.0f);
+
+        window.resize(windowSize + 1);
+        for (int i = 0; i <= windowSize; ++i)
+        {
+            const double s = std::sin(M_PI * i / windowSize);
+            window[static_cast<size_t>(i)] = static_cast<float>(s * s);
+        }
+
+        setRatio(ratio);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(buffer.begin(), buffer.end(), 0.0f);
+        writeIndex = 0;
+        phase = 0.0;
+
+        for (int tap = 0; tap < 2; ++tap)
+        {
+            tapPhase[tap] = 0.5 * tap;
+            offset[tap] = 0;
+            delay[tap] = getLatencyInSamples();
+        }
+    }
+
+    void copyStateFrom(const GrainPitchShifter& other)
+    {
+        std::copy(other.buffer.begin(), other.buffer.end(), buffer.begin());
+        writeIndex = other.writeIndex;
+        phase = other.phase;
+
+        for (int tap = 0; tap < 2; ++tap)
+        {
+            tapPhase[tap] = other.tapPhase[tap];
+            offset[tap] = other.offset[tap];
+            delay[tap] = other.delay[tap];
+        }
+    }
+
+    // Output pitch over input pitch
+    void setRatio(double newRatio)
+    {
+        ratio = newRatio;
+        unison = grainLength == 0 || ! (ratio < 1.0 || ratio > 1.0);
+        phaseIncrement = unison ? 0.0 : std::abs(1.0 - ratio) / grainLength;
+    }
+
+    int getLatencyInSamples() const { return minimumDelay + grainLength / 2; }
+
+    static int getLatencyInSamples(double sampleRate)
+    {
+        return static_cast<int>(std::lround(sampleRate * searchSeconds)) + 2 + static_cast<int>(std::lround(sampleRate * grainSeconds)) / 2;
+    }
+
+    float processSample(float input)
+    {
+        buffer[static_cast<size_t>(writeIndex & mask)] = input;
+
+        // At unison the taps would stand still at different delays and comb
+        if (unison)
+        {
+            const float delayed = buffer[static_cast<size_t>((writeIndex - getLatencyInSamples()) & mask)];
+            writeIndex = (writeIndex + 1) & mask;
+            return delayed;
+        }
+
+        phase += phaseIncrement;
+        if (phase >= 1.0)
+            phase -= 1.0;
+
+        float output = 0.0f;
+
+        for (int tap = 0; tap < 2; ++tap)
+        {
+            double position = phase + 0.5 * tap;
+            if (position >= 1.0)
+                position -= 1.0;
+
+            // Wrapped round: the tap is silent and jumps to the start of a new grain
+            if (position < tapPhase[tap])
+                startGrain(tap);
+
+            tapPhase[tap] = position;
+
+            // Reading slower than writing, the delay grows through the grain; faster, it shrinks
+            const double sweep = ratio < 1.0 ? position : 1.0 - position;
+            delay[tap] = minimumDelay + sweep * grainLength + offset[tap];
+
+            const double scaled = position * windowSize;
+            const int index = static_cast<int>(scaled);
+            const float fraction = static_cast<float>(scaled - index);
+            const float gain = window[static_cast<size_t>(index)]
+                             + fraction * (window[static_cast<size_t>(index + 1)] - window[static_cast<size_t>(index)]);
+
+            output += gain * read(delay[tap]);
+        }
+
+        writeIndex = (writeIndex + 1) & mask;
+        return output;
+    }
+
+private:
+    // Just under 10 ms of latency at 44.1 and 48 kHz: the search reaches half
+    // a period of a low E either way, so every guitar note can be lined up,
+    // and the grains are as long as what is left allows
+    static constexpr double grainSeconds = 0.007;
+    static constexpr double searchSeconds = 0.0062;
+    static constexpr double correlationSeconds = 0.004;
+    static constexpr int windowSize = 1024;
+
+    std::vector<float> buffer;
+    int mask = 0;
+    int writeIndex = 0;
+
+    int grainLength = 0, searchRange = 0, correlationLength = 0, minimumDelay = 2;
+    double ratio = 1.0, phaseIncrement = 0.0, phase = 0.0;
+    bool unison = true;
+
+    double tapPhase[2] {};
+    int offset[2] {};
+    double delay[2] {};
+
+    std::vector<float> window;                   // sin^2 over one grain
+    std::vector<float> reference, span, scores;  // correlation scratch
+
+    float read(double delaySamples) const
+    {
+        // 4-point Hermite between the samples either side of the read position
+        const double position = writeIndex - delaySamples;
+        const int index = static_cast<int>(std::floor(position));
+        const float t = static_cast<float>(position - index);
+
+        const float xm1 = buffer[static_cast<size_t>((index - 1) & mask)];
+        const float x0 = buffer[static_cast<size_t>(index & mask)];
+        const float x1 = buffer[static_cast<size_t>((index + 1) & mask)];
+        const float x2 = buffer[static_cast<size_t>((index + 2) & mask)];
+
+        const float c1 = 0.5f * (x1 - xm1);
+        const float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+        const float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+        return ((c3 * t + c2) * t + c1) * t + x0;
+    }
+
+    void startGrain(int tap)
+    {
+        // Compares the audio leading up to where the other tap is reading with
+        // the audio leading up to each candidate start of the new grain
+        const int referenceEnd = writeIndex - static_cast<int>(std::lround(delay[1 - tap]));
+        const int nominalDelay = minimumDelay + (ratio < 1.0 ? 0 : grainLength);
+        const int spanStart = writeIndex - nominalDelay - searchRange - correlationLength + 1;
+
+        for (int i = 0; i < correlationLength; ++i)
+            reference[static_cast<size_t>(i)] = buffer[static_cast<size_t>((referenceEnd - correlationLength + 1 + i) & mask)];
+
+        for (int i = 0; i < static_cast<int>(span.size()); ++i)
+            span[static_cast<size_t>(i)] = buffer[static_cast<size_t>((spanStart + i) & mask)];
+
+        // Candidates are the inner loop, so the compiler vectorises across them
+        // without having to reorder any sum; four reference samples per pass
+        // keep the running scores in registers for most of the work
+        const int numCandidates = static_cast<int>(scores.size());
+        float* score = scores.data();
+        std::fill(scores.begin(), scores.end(), 0.0f);
+
+        for (int i = 0; i < correlationLength; i += 4)
+        {
+            const float r0 = reference[static_cast<size_t>(i)];
+            const float r1 = reference[static_cast<size_t>(i + 1)];
+            const float r2 = reference[static_cast<size_t>(i + 2)];
+            const float r3 = reference[static_cast<size_t>(i + 3)];
+            const float* s = span.data() + i;
+
+            for (int j = 0; j < numCandidates; ++j)
+                score[j] += r0 * s[j] + r1 * s[j + 1] + r2 * s[j + 2] + r3 * s[j + 3];
+        }
+
+        // Normalised by each candidate's energy, kept as a running sum
+        float energy = 0.0f;
+        for (int i = 0; i < correlationLength; ++i)
+            energy += span[static_cast<size_t>(i)] * span[static_cast<size_t>(i)];
+
+        int best = searchRange;
+        float bestScore = 0.0f;
+
+        for (int j = 0; j < numCandidates; ++j)
+        {
+            if (j > 0)
+            {
+                const float leaving = span[static_cast<size_t>(j - 1)];
+                const float entering = span[static_cast<size_t>(j + correlationLength - 1)];
+                energy = std::max(0.0f, energy + entering * entering - leaving * leaving);
+            }
+
+            const float normalised = score[j] / std::sqrt(energy + 1.0e-12f);
+            if (normalised > bestScore)
+            {
+                bestScore = normalised;
+                best = j;
+            }
+        }
+
+        // Candidate j ends searchRange - j samples later than the nominal start
+        offset[tap] = searchRange - best;
+    }
+};
+
+//==============================================================================
+// Phase vocoder pitch shifter
+// Hann frames at 75% overlap, long enough to resolve the notes of a chord
+// down on the low strings. Each spectral peak is moved to its new bin together
+// with the bins around it, keeping their phases relative to the peak
+// (Laroche-Dolson phase locking), and only the peak's phase is advanced at the
+// shifted frequency. Clean on chords, but its latency is a whole frame, so it
+// is for mixing rather than playing live.
+//==============================================================================
+
+class VocoderPitchShifter
+{
+public:
+    void prepare(double sampleRate)
+    {
+        const int order = getOrder(sampleRate);
+        tables = SharedTableCache<int, Tables>::get(order, [order] { return Tables(order); });
+
+        fftSize = 1 << order;
+        hop = fftSize / 4;
+        numBins = fftSize / 2 + 1;
+
+        input.assign(static_cast<size_t>(fftSize), 0.0f);
+        output.assign(static_cast<size_t>(fftSize), 0.0f);
+        frame.assign(static_cast<size_t>(2 * fftSize), 0.0f);
+
+        for (auto* bins : { &magnitude, &analysisPhase, &advance, &previousPhase, &synthesisPhase, &nextPhase })
+            bins->assign(static_cast<size_t>(numBins), 0.0f);
+
+        peaks.assign(static_cast<size_t>(numBins), 0);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(input.begin(), input.end(), 0.0f);
+        std::fill(output.begin(), output.end(), 0.0f);
+        std::fill(previousPhase.begin(), previousPhase.end(), 0.0f);
+        std::fill(synthesisPhase.begin(), synthesisPhase.end(), 0.0f);
+        filled = 0;
+    }
+
+    void copyStateFrom(const VocoderPitchShifter& other)
+    {
+        std::copy(other.input.begin(), other.input.end(), input.begin());
+        std::copy(other.output.begin(), other.output.end(), output.begin());
+        std::copy(other.previousPhase.begin(), other.previousPhase.end(), previousPhase.begin());
+        std::copy(other.synthesisPhase.begin(), other.synthesisPhase.end(), synthesisPhase.begin());
+        filled = other.filled;
+    }
+
+    void setRatio(double newRatio) { ratio = static_cast<float>(newRatio); }
+
+    int getLatencyInSamples() const { return fftSize; }
+    static int getLatencyInSamples(double sampleRate) { return 1 << getOrder(sampleRate); }
+
+    float processSample(float x)
+    {
+        // The newest hop of the frame fills up while the oldest hop of the output drains
+        input[static_cast<size_t>(fftSize - hop + filled)] = x;
+        const float y = output[static_cast<size_t>(filled)];
+
+        if (++filled == hop)
+        {
+            processFrame();
+            filled = 0;
+        }
+
+        return y;
+    }
+
+private:
+    static constexpr double frameSeconds = 0.0853;
+
+    // 4096 samples at 44.1/48 kHz, 8192 at 88.2/96 kHz
+    static int getOrder(double sampleRate)
+    {
+        return std::clamp(static_cast<int>(std::lround(std::log2(sampleRate * frameSeconds))), 8, 14);
+    }
+
+    struct Tables
+    {
+        explicit Tables(int order) : fft(order), window(static_cast<size_t>(1 << order))
+        {
+            // Periodic Hann, so analysis times synthesis window overlap-adds flat
+            const int size = 1 << order;
+            for (int i = 0; i < size; ++i)
+                window[static_cast<size_t>(i)] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * i / size));
+        }
+
+        juce::dsp::FFT fft;
+        std::vector<float> window;
+    };
+
+    std::shared_ptr<const Tables> tables;  // shared, read-only
+    int fftSize = 512, hop = 128, numBins = 257;
+    float ratio = 1.0f;
+
+    std::vector<float> input, output, frame;
+    std::vector<float> magnitude, analysisPhase, advance, previousPhase, synthesisPhase, nextPhase;
+    std::vector<int> peaks;
+    int filled = 0;
+
+    static float wrapPhase(float phase)
+    {
+        return phase - 2.0f * juce::MathConstants<float>::pi * std::round(phase * (0.5f / juce::MathConstants<float>::pi));
+    }
+
+    void processFrame()
+    {
+        const float* window = tables->window.data();
+
+        for (int i = 0; i < fftSize; ++i)
+            frame[static_cast<size_t>(i)] = input[static_cast<size_t>(i)] * window[i];
+
+        std::fill(frame.begin() + fftSize, frame.end(), 0.0f);
+        tables->fft.performRealOnlyForwardTransform(frame.data(), true);
+
+        // Phase advance of every bin over one hop, from its deviation from the bin centre
+        const float binAdvance = 2.0f * juce::MathConstants<float>::pi * static_cast<float>(hop) / static_cast<float>(fftSize);
+        float loudest = 0.0f;
+
+        for (int k = 0; k < numBins; ++k)
+        {
+            const auto bin = static_cast<size_t>(k);
+            const float re = frame[2 * bin], im = frame[2 * bin + 1];
+            magnitude[bin] = std::sqrt(re * re + im * im);
+            analysisPhase[bin] = std::atan2(im, re);
+            advance[bin] = k * binAdvance + wrapPhase(analysisPhase[bin] - previousPhase[bin] - k * binAdvance);
+            previousPhase[bin] = analysisPhase[bin];
+            loudest = std::max(loudest, magnitude[bin]);
+        }
+
+        // Local maxima over five bins, down to 80 dB below the loudest
+        int numPeaks = 0;
+        for (int k = 2; k < numBins - 2; ++k)
+        {
+            const float m = magnitude[static_cast<size_t>(k)];
+            if (m > loudest * 1.0e-4f && m > magnitude[static_cast<size_t>(k - 1)] && m >= magnitude[static_cast<size_t>(k + 1)]
+                && m >= magnitude[static_cast<size_t>(k - 2)] && m >= magnitude[static_cast<size_t>(k + 2)])
+                peaks[static_cast<size_t>(numPeaks++)] = k;
+        }
+
+        std::fill(frame.begin(), frame.end(), 0.0f);
+        std::copy(synthesisPhase.begin(), synthesisPhase.end(), nextPhase.begin());
+
+        for (int p = 0; p < numPeaks; ++p)
+        {
+            // Each peak takes the bins up to halfway to its neighbours
+            const int peak = peaks[static_cast<size_t>(p)];
+            const int low = p == 0 ? 0 : (peaks[static_cast<size_t>(p - 1)] + peak) / 2 + 1;
+            const int high = p == numPeaks - 1 ? numBins - 1 : (peak + peaks[static_cast<size_t>(p + 1)]) / 2;
+            const int shifted = static_cast<int>(std::lround(peak * ratio));
+
+            if (shifted < 1 || shifted >= numBins - 1)
+                continue;
+
+            const float peakPhase = wrapPhase(synthesisPhase[static_cast<size_t>(shifted)] + advance[static_cast<size_t>(peak)] * ratio);
+
+            for (int k = low; k <= high; ++k)
+            {
+                const int target = shifted + k - peak;
+                if (target < 0 || target >= numBins)
+                    continue;
+
+                const auto bin = static_cast<size_t>(k);
+                const auto out = static_cast<size_t>(target);
+                const float phase = peakPhase + analysisPhase[bin] - analysisPhase[static_cast<size_t>(peak)];
+
+                frame[2 * out] += magnitude[bin] * std::cos(phase);
+                frame[2 * out + 1] += magnitude[bin] * std::sin(phase);
+                nextPhase[out] = wrapPhase(phase);
+            }
+        }
+
+        std::swap(synthesisPhase, nextPhase);
+        tables->fft.performRealOnlyInverseTransform(frame.data());
+
+        // Hann squared at 75% overlap sums to 1.5
+        std::copy(output.begin() + hop, output.end(), output.begin());
+        std::fill(output.end() - hop, output.end(), 0.0f);
+
+        for (int i = 0; i < fftSize; ++i)
+            output[static_cast<size_t>(i)] += frame[static_cast<size_t>(i)] * window[i] * (1.0f / 1.5f);
+
+        std::copy(input.begin() + hop, input.end(), input.begin());
+    }
+};
+
+//==============================================================================
+// Harmonizer stage for one channel
+// Up to two shifted voices blended with the dry signal, which is delayed by
+// the shifters' latency so the voices stay in time with it. Runs at the host
+// rate, before or after the fuzz as the processor chooses. Switching it on or
+// off, or changing engine, moves the dry delay, so the output crossfades from
+// the old setting to the new one over 10 ms; the dry line keeps running while
+// the stage is off so there is a delayed dry signal to fade to.
+//==============================================================================
+
+class Harmonizer
+{
+public:
+    enum Voicing { off, octaveDown, octaveUp, octaves, interval };
+    enum class Engine { grains, vocoder };
+
+    void prepare(double sampleRate, int maxBlockSize)
+    {
+        juce::ignoreUnused(maxBlockSize);
+
+        for (int voice = 0; voice < maxVoices; ++voice)
+        {
+            grainShifters[voice].prepare(sampleRate);
+            vocoderShifters[voice].prepare(sampleRate);
+        }
+
+        int size = 1;
+        while (size <= std::max(grainShifters[0].getLatencyInSamples(), vocoderShifters[0].getLatencyInSamples()))
+            size *= 2;
+
+        dryLine.assign(static_cast<size_t>(size), 0.0f);
+        dryMask = size - 1;
+        fadeLength = std::max(1, static_cast<int>(std::lround(sampleRate * 0.01)));
+
+        mix.reset(sampleRate, 0.02);
+        mix.setCurrentAndTargetValue(mix.getTargetValue());
+        reset();
+    }
+
+    void reset()
+    {
+        for (int voice = 0; voice < maxVoices; ++voice)
+        {
+            grainShifters[voice].reset();
+            vocoderShifters[voice].reset();
+        }
+
+        std::fill(dryLine.begin(), dryLine.end(), 0.0f);
+        dryIndex = 0;
+        fadeRemaining = 0;
+    }
+
+    void copyStateFrom(const Harmonizer& other)
+    {
+        for (int voice = 0; voice < maxVoices; ++voice)
+        {
+            grainShifters[voice].copyStateFrom(other.grainShifters[voice]);
+            vocoderShifters[voice].copyStateFrom(other.vocoderShifters[voice]);
+        }
+
+        std::copy(other.dryLine.begin(), other.dryLine.end(), dryLine.begin());
+        dryIndex = other.dryIndex;
+        fadingFrom = other.fadingFrom;
+        fadeRemaining = other.fadeRemaining;
+        mix.setCurrentAndTargetValue(other.mix.getCurrentValue());
+        mix.setTargetValue(other.mix.getTargetValue());
+    }
+
+    void setParameters(int newVoicing, int intervalSemitones, float newMix, Engine newEngine)
+    {
+        newVoicing = std::clamp(newVoicing, static_cast<int>(off), static_cast<int>(interval));
+
+        const bool nowActive = newVoicing != off;
+
+        if (newEngine != engine || nowActive != isActive())
+        {
+            // Changing engine while off is silent and needs no fade
+            if (nowActive || isActive())
+            {
+                fadingFrom = current();
+                fadeRemaining = fadeLength;
+            }
+
+            // The engine switched to starts from silence rather than stale audio
+            engine = newEngine;
+            if (nowActive)
+                resetShifters(engine);
+        }
+
+        voicing = newVoicing;
+        mix.setTargetValue(std::clamp(newMix, 0.0f, 1.0f));
+
+        double ratios[maxVoices] { 1.0, 1.0 };
+        numVoices = 1;
+
+        switch (voicing)
+        {
+            case octaveDown: ratios[0] = 0.5; break;
+            case octaveUp: ratios[0] = 2.0; break;
+            case octaves: ratios[0] = 0.5; ratios[1] = 2.0; numVoices = 2; break;
+            case interval: ratios[0] = std::exp2(intervalSemitones / 12.0); break;
+            default: numVoices = 0; break;
+        }
+
+        // Switched off, the voices keep their ratios while they fade out
+        if (! nowActive)
+            return;
+
+        for (int voice = 0; voice < maxVoices; ++voice)
+        {
+            grainShifters[voice].setRatio(ratios[voice]);
+            vocoderShifters[voice].setRatio(ratios[voice]);
+        }
+    }
+
+    bool isActive() const { return voicing != off; }
+
+    // Input to output, 0 while off
+    int getLatencyInSamples() const
+    {
+        if (! isActive())
+            return 0;
+
+        return engine == Engine::vocoder ? vocoderShifters[0].getLatencyInSamples() : grainShifters[0].getLatencyInSamples();
+    }
+
+    // What an engine would add at a given rate, for display before it runs
+    static int getLatencyInSamples(double sampleRate, Engine engine)
+    {
+        return engine == Engine::vocoder ? VocoderPitchShifter::getLatencyInSamples(sampleRate)
+                                         : GrainPitchShifter::getLatencyInSamples(sampleRate);
+    }
+
+    void process(float* samples, int numSamples)
+    {
+        if (! isActive() && fadeRemaining == 0)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                dryLine[static_cast<size_t>(dryIndex)] = samples[i];
+                dryIndex = (dryIndex + 1) & dryMask;
+            }
+
+            return;
+        }
+
+        const Setting setting = current();
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float x = samples[i];
+            dryLine[static_cast<size_t>(dryIndex)] = x;
+
+            const float amount = mix.getNextValue();
+            float y = play(setting, x, amount);
+
+            // The old setting is a different engine, or the stage switched
+            // off, so no shifter runs twice
+            if (fadeRemaining > 0)
+            {
+                const float oldGain = static_cast<float>(fadeRemaining) / static_cast<float>(fadeLength);
+                y += oldGain * (play(fadingFrom, x, amount) - y);
+                --fadeRemaining;
+            }
+
+            dryIndex = (dryIndex + 1) & dryMask;
+            samples[i] = y;
+        }
+    }
+
+private:
+    static constexpr int maxVoices = 2;
+
+    struct Setting
+    {
+        bool active = false;
+        Engine engine = Engine::grains;
+        int numVoices = 0;
+    };
+
+    GrainPitchShifter grainShifters[maxVoices];
+    VocoderPitchShifter vocoderShifters[maxVoices];
+
+    int voicing = off;
+    int numVoices = 0;
+    Engine engine = Engine::grains;
+    juce::SmoothedValue<float> mix { 0.5f };
+
+    std::vector<float> dryLine;
+    int dryMask = 0;
+    int dryIndex = 0;
+
+    Setting fadingFrom;
+    int fadeLength = 1;
+    int fadeRemaining = 0;
+
+    Setting current() const { return { isActive(), engine, numVoices }; }
+
+    void resetShifters(Engine toReset)
+    {
+        for (int voice = 0; voice < maxVoices; ++voice)
+        {
+            if (toReset == Engine::vocoder)
+                vocoderShifters[voice].reset();
+            else
+                grainShifters[voice].reset();
+        }
+    }
+
+    // One sample of the stage's output under a setting, with the dry line
+    // already holding x at dryIndex
+    float play(const Setting& setting, float x, float amount)
+    {
+        if (! setting.active)
+            return x;
+
+        const int latency = setting.engine == Engine::vocoder ? vocoderShifters[0].getLatencyInSamples()
+                                                              : grainShifters[0].getLatencyInSamples();
+        const float dry = dryLine[static_cast<size_t>((dryIndex - latency) & dryMask)];
+
+        float wet = 0.0f;
+        for (int voice = 0; voice < setting.numVoices; ++voice)
+            wet += setting.engine == Engine::vocoder ? vocoderShifters[voice].processSample(x) : grainShifters[voice].processSample(x);
+
+        return dry + amount * (wet / static_cast<float>(setting.numVoices) - dry);
+    }
+};
@@ -0,0 +1,53 @@
+#include "HarmonsterAssets.h"
+#include "BinaryData.h"
+
+namespace
+{
+    struct EmbeddedImage
+    {
+        const char* data;
+        int size;
+    };
+
+    EmbeddedImage getEmbeddedImage (HarmonsterAssets::Asset asset, bool hiDpi)
+    {
+        switch (asset)
+        {
+            case HarmonsterAssets::Asset::background:
+                return hiDpi ? EmbeddedImage { BinaryData::background_2x_png, BinaryData::background_2x_pngSize }
+                             : EmbeddedImage { BinaryData::background_1x_png, BinaryData::background_1x_pngSize };
+
+            case HarmonsterAssets::Asset::knob:
+                return hiDpi ? EmbeddedImage { BinaryData::knob_2x_png, BinaryData::knob_2x_pngSize }
+                             : EmbeddedImage { BinaryData::knob_1x_png, BinaryData::knob_1x_pngSize };
+
+            case HarmonsterAssets::Asset::powerOn:
+                return hiDpi ? EmbeddedImage { BinaryData::poweron_2x_png, BinaryData::poweron_2x_pngSize }
+                             : EmbeddedImage { BinaryData::poweron_1x_png, BinaryData::poweron_1x_pngSize };
+
+            case HarmonsterAssets::Asset::powerOff:
+                return hiDpi ? EmbeddedImage { BinaryData::poweroff_2x_png, BinaryData::poweroff_2x_pngSize }
+                             : EmbeddedImage { BinaryData::poweroff_1x_png, BinaryData::poweroff_1x_pngSize };
+        }
+
+        return { nullptr, 0 };
+    }
+}
+
+const juce::Image& HarmonsterAssets::get (Asset asset, float physicalPixelScale)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    const bool hiDpi = physicalPixelScale > 1.0f;
+    auto& image = images[static_cast<size_t> (static_cast<int> (asset) * 2 + (hiDpi ? 1 : 0))];
+
+    if (image.isNull())
+    {
+        auto embedded = getEmbeddedImage (asset, hiDpi);
+
+        if (embedded.data != nullptr)
+            image = juce::ImageFileFormat::loadFrom (embedded.data, static_cast<size_t> (embedded.size));
+    }
+
+    return image;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include <array>
+
+//==============================================================================
+// Shared UI image atlas
+// The build bakes every image at 1x and 2x layout size; each variant is
+// decoded on first use and shared by all open editors in the process via
+// juce::SharedResourcePointer<HarmonsterAssets>.
+//==============================================================================
+class HarmonsterAssets
+{
+public:
+    enum class Asset
+    {
+        background,
+        knob,
+        powerOn,
+        powerOff
+    };
+
+    static constexpr int numAssets = 4;
+
+    // Returns the variant matching the physical pixel scale, decoding it on first
+    // request. Message thread only.
+    const juce::Image& get (Asset asset, float physicalPixelScale);
+
+private:
+    std::array<juce::Image, numAssets * 2> images;
+};
@@ -0,0 +1,256 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+
+//==============================================================================
+// Linear segment compiler
+// A run of linear stages between two nonlinearities is a single transfer
+// function. compile() takes the stages in signal order, folds plain gains
+// into a numerator, multiplies first-order stages together in pairs and
+// returns the minimal cascade of transposed direct form II sections: one
+// state variable per pole, five multiplies per biquad and three per
+// first-order section. It is cheap enough to rerun on every knob change.
+//==============================================================================
+
+// One stage as a ratio of polynomials in z^-1 with a0 = 1. A first-order
+// stage has b2 = a2 = 0; a plain gain only has b0. The order is set by the
+// constructor that made the stage, not read back from the coefficients.
+struct LinearStage
+{
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0;
+    double a1 = 0.0, a2 = 0.0;
+    int order = 2;
+
+    bool isGain() const { return order == 0; }
+    bool isFirstOrder() const { return order <= 1; }
+
+    static LinearStage gain(double g) { return { g, 0.0, 0.0, 0.0, 0.0, 0 }; }
+
+    static LinearStage biquad(double b0, double b1, double b2, double a1, double a2)
+    {
+        return { b0, b1, b2, a1, a2 };
+    }
+
+    // v = pole v + (1 - pole) x, y = x - v: a coupling capacitor or RC high-pass
+    static LinearStage capacitorHighPass(double pole) { return { pole, -pole, 0.0, -pole, 0.0, 1 }; }
+
+    // y[n] = x[n] - x[n-1] + pole y[n-1]
+    static LinearStage dcBlocker(double pole) { return { 1.0, -1.0, 0.0, -pole, 0.0, 1 }; }
+
+    // Product of two first-order stages
+    static LinearStage multiply(const LinearStage& x, const LinearStage& y)
+    {
+        return { x.b0 * y.b0, x.b0 * y.b1 + x.b1 * y.b0, x.b1 * y.b1,
+                 x.a1 + y.a1, x.a1 * y.a1 };
+    }
+};
+
+template <std::size_t MaxSections>
+class LinearCascade
+{
+public:
+    // Plain data, so it can live in the circuit's State
+    struct State
+    {
+        double z1[MaxSections] {};
+        double z2[MaxSections] {};
+
+        // Largest difference in any state variable
+        double distanceTo(const State& other) const
+        {
+            double distance = 0.0;
+            for (std::size_t s = 0; s < MaxSections; ++s)
+                distance = std::max({ distance, std::abs(z1[s] - other.z1[s]), std::abs(z2[s] - other.z2[s]) });
+
+            return distance;
+        }
+    };
+
+    static LinearCascade compile(std::initializer_list<LinearStage> stages)
+    {
+        LinearCascade cascade;
+        double gain = 1.0;
+        LinearStage unpaired;
+        bool hasUnpaired = false;
+
+        for (const auto& stage : stages)
+        {
+            if (stage.isGain())
+            {
+                gain *= stage.b0;
+            }
+            else if (! stage.isFirstOrder())
+            {
+                cascade.add(stage);
+            }
+            else if (hasUnpaired)
+            {
+                cascade.add(LinearStage::multiply(unpaired, stage));
+                hasUnpaired = false;
+            }
+            else
+            {
+                unpaired = stage;
+                hasUnpaired = true;
+            }
+        }
+
+        if (hasUnpaired || cascade.numSections == 0)
+            cascade.add(hasUnpaired ? unpaired : LinearStage::gain(1.0));
+
+        auto& first = cascade.sections[0];
+        first.b0 *= gain;
+        first.b1 *= gain;
+        first.b2 *= gain;
+        return cascade;
+    }
+
+    int getNumSections() const { return static_cast<int>(numSections); }
+    const LinearStage& getSection(std::size_t index) const { return sections[index]; }
+
+    double processSample(double input, State& state) const
+    {
+        // Unused sections are pass-throughs, so the loop can be unrolled
+        for (std::size_t s = 0; s < MaxSections; ++s)
+        {
+            const auto& c = sections[s];
+            const double output = c.b0 * input + state.z1[s];
+            state.z1[s] = c.b1 * input - c.a1 * output + state.z2[s];
+            state.z2[s] = c.b2 * input - c.a2 * output;
+            input = output;
+        }
+
+        return input;
+    }
+
+    // Sample by sample rather than section by section: each section's
+    // recurrence is a chain of dependent multiply-adds, and interleaving the
+    // sections lets their chains overlap. input may equal output
+    void process(const double* input, double* output, int numSamples, State& state) const
+    {
+        for (int i = 0; i < numSamples; ++i)
+            output[i] = processSample(input[i], state);
+    }
+
+private:
+    LinearStage sections[MaxSections];
+    std::size_t numSections = 0;
+
+    void add(const LinearStage& stage)
+    {
+        // More stages than MaxSections is a programming error; the extra ones are dropped
+        if (numSections < MaxSections)
+            sections[numSections++] = stage;
+    }
+};
+
+//==============================================================================
+// Cascades of the same size run in lockstep, one per lane: the dual circuit's
+// two circuits fed from the same point, or a batch of HarmonsterConstantFit's
+// candidates. Every multiply-add is done for all lanes together, so the
+// compiler can issue it as SIMD instructions, and each lane computes exactly
+// what its own cascade would. The lanes' states are interleaved while a block
+// runs; load() and store() convert to and from the plain per-cascade states.
+//==============================================================================
+
+template <std::size_t MaxSections, std::size_t Lanes>
+class LinearCascadeLanes
+{
+public:
+    using Cascade = LinearCascade<MaxSections>;
+    using CascadeState = typename Cascade::State;
+
+    struct State
+    {
+        double z1[MaxSections][Lanes] {};
+        double z2[MaxSections][Lanes] {};
+    };
+
+    static LinearCascadeLanes pack(const std::array<const Cascade*, Lanes>& cascades)
+    {
+        LinearCascadeLanes lanes;
+        for (std::size_t s = 0; s < MaxSections; ++s)
+        {
+            for (std::size_t lane = 0; lane < Lanes; ++lane)
+            {
+                const auto& c = cascades[lane]->getSection(s);
+                auto& section = lanes.sections[s];
+                section.b0[lane] = c.b0;
+                section.b1[lane] = c.b1;
+                section.b2[lane] = c.b2;
+                section.a1[lane] = c.a1;
+                section.a2[lane] = c.a2;
+            }
+        }
+
+        return lanes;
+    }
+
+    static State load(const std::array<const CascadeState*, Lanes>& states)
+    {
+        State state;
+        for (std::size_t s = 0; s < MaxSections; ++s)
+        {
+            for (std::size_t lane = 0; lane < Lanes; ++lane)
+            {
+                state.z1[s][lane] = states[lane]->z1[s];
+                state.z2[s][lane] = states[lane]->z2[s];
+            }
+        }
+
+        return state;
+    }
+
+    static void store(const State& state, const std::array<CascadeState*, Lanes>& states)
+    {
+        for (std::size_t s = 0; s < MaxSections; ++s)
+        {
+            for (std::size_t lane = 0; lane < Lanes; ++lane)
+            {
+                states[lane]->z1[s] = state.z1[s][lane];
+                states[lane]->z2[s] = state.z2[s][lane];
+            }
+        }
+    }
+
+    // input may equal output
+    void processSample(const double (&input)[Lanes], double (&output)[Lanes], State& state) const
+    {
+        double x[Lanes];
+        std::copy_n(input, Lanes, x);
+
+        for (std::size_t s = 0; s < MaxSections; ++s)
+        {
+            const auto& c = sections[s];
+            double y[Lanes];
+
+            for (std::size_t lane = 0; lane < Lanes; ++lane)
+            {
+                y[lane] = c.b0[lane] * x[lane] + state.z1[s][lane];
+                state.z1[s][lane] = c.b1[lane] * x[lane] - c.a1[lane] * y[lane] + state.z2[s][lane];
+                state.z2[s][lane] = c.b2[lane] * x[lane] - c.a2[lane] * y[lane];
+                x[lane] = y[lane];
+            }
+        }
+
+        std::copy_n(x, Lanes, output);
+    }
+
+private:
+    // Pass-throughs until packed
+    struct Section
+    {
+        Section() { std::fill_n(b0, Lanes, 1.0); }
+
+        double b0[Lanes], b1[Lanes] {}, b2[Lanes] {};
+        double a1[Lanes] {}, a2[Lanes] {};
+    };
+
+    Section sections[MaxSections];
+};
+
+template <std::size_t MaxSections>
+using LinearCascadePair = LinearCascadeLanes<MaxSections, 2>;
@@ -0,0 +1,247 @@
+#pragma once
+#include "WoolyMammothDSP.h"
+#include "HalfbandOversampler.h"
+
+//==============================================================================
+// One audio channel of the fuzz at a selectable oversampling factor
+// Keeps a circuit per factor (1x/2x/4x/8x). Changing factor hands the circuit
+// state over to the new circuit and crossfades the two outputs, so the factor
+// can change at any block boundary without a click.
+//==============================================================================
+
+class MammothChannel
+{
+public:
+    static constexpr int maxStages = HalfbandOversampler::maxStages;
+    static constexpr int numFactors = maxStages + 1;
+
+    void prepare(double sampleRate, int maxBlockSize)
+    {
+        maxBlock = std::max(1, maxBlockSize);
+
+        for (int stages = 0; stages < numFactors; ++stages)
+        {
+            auto& circuit = circuits[static_cast<size_t>(stages)];
+            circuit.oversampler.prepare(stages, maxBlock);
+            circuit.dsp.setSampleRate(sampleRate * (1 << stages), 1 << stages);
+            circuit.latency = circuit.oversampler.getLatencyInSamples();
+        }
+
+        const int maxPad = circuits[maxStages].latency;
+        for (auto& circuit : circuits)
+            circuit.pad.buffer.assign(static_cast<size_t>(maxPad + 1), 0.0f);
+
+        fadeBuffer.assign(static_cast<size_t>(maxBlock), 0.0f);
+        fadeLength = std::max(1, static_cast<int>(sampleRate * 0.01));  // 10 ms crossfade
+
+        setLatencyAlignment(alignStages);
+        reset();
+    }
+
+    void reset()
+    {
+        for (auto& circuit : circuits)
+        {
+            circuit.dsp.reset();
+            circuit.oversampler.reset();
+            circuit.pad.clear();
+        }
+
+        fadeRemaining = 0;
+    }
+
+    void setParameters(double wool, double pinch, double eq, double output, unsigned features)
+    {
+        // Only the circuits that run are updated, often enough to follow
+        // automation; an idle circuit takes the knobs over with the state when
+        // it is switched to (see beginTransition())
+        for (auto* circuit : runningCircuits())
+        {
+            if (circuit == nullptr)
+                continue;
+
+            circuit->dsp.setKnobs(wool, pinch, eq, output);
+            circuit->dsp.setFeatures(features);
+        }
+    }
+
+    void setSecondCircuit(bool enabled, double wool, double pinch, double eq, double output, double blendA, double blendB)
+    {
+        // Dual circuit mode (see WoolyMammothDSP::setSecondCircuit()); the
+        // blend runs at the oversampled rate, ahead of the one downsampler
+        for (auto* circuit : runningCircuits())
+        {
+            if (circuit == nullptr)
+                continue;
+
+            circuit->dsp.setSecondCircuit(enabled, wool, pinch, eq, output);
+            circuit->dsp.setBlend(blendA, blendB);
+        }
+    }
+
+    void setLatencyAlignment(int stages)
+    {
+        // Every factor up to stages is padded to that factor's latency, so
+        // switching between them never shifts the signal in time. maxStages
+        // aligns all of them to the 8x latency; 0 pads nothing.
+        alignStages = std::clamp(stages, 0, maxStages);
+        const int alignedLatency = circuits[static_cast<size_t>(alignStages)].latency;
+
+        for (int i = 0; i < numFactors; ++i)
+        {
+            auto& circuit = circuits[static_cast<size_t>(i)];
+            circuit.pad.delay = i < alignStages ? alignedLatency - circuit.latency : 0;
+            circuit.pad.clear();
+        }
+    }
+
+    int getLatencyInSamples(int stages) const
+    {
+        stages = std::clamp(stages, 0, maxStages);
+        return circuits[static_cast<size_t>(std::max(stages, alignStages))].latency;
+    }
+
+    void process(float* samples, int numSamples, int stages)
+    {
+        // A new factor is taken on only once the previous crossfade has finished
+        stages = std::clamp(stages, 0, maxStages);
+        if (stages != activeStages && fadeRemaining == 0)
+            beginTransition(stages);
+
+        for (int offset = 0; offset < numSamples; offset += maxBlock)
+            processChunk(samples + offset, std::min(maxBlock, numSamples - offset));
+    }
+
+    void copyStateFrom(const MammothChannel& other)
+    {
+        // Makes this channel continue exactly where other is, without touching
+        // scratch buffers. Both channels must have been prepared identically.
+        for (size_t i = 0; i < circuits.size(); ++i)
+        {
+            auto& circuit = circuits[i];
+            const auto& source = other.circuits[i];
+
+            circuit.dsp = source.dsp;
+            circuit.oversampler.copyStateFrom(source.oversampler);
+            std::copy(source.pad.buffer.begin(), source.pad.buffer.end(), circuit.pad.buffer.begin());
+            circuit.pad.writeIndex = source.pad.writeIndex;
+            circuit.pad.delay = source.pad.delay;
+        }
+
+        alignStages = other.alignStages;
+        activeStages = other.activeStages;
+        fadingStages = other.fadingStages;
+        fadeRemaining = other.fadeRemaining;
+    }
+
+    int getActiveStages() const { return activeStages; }
+    bool isTransitioning() const { return fadeRemaining > 0; }
+    double getGateActivity() const { return circuits[static_cast<size_t>(activeStages)].dsp.getGateActivity(); }
+    double getSupplyVoltage() const { return circuits[static_cast<size_t>(activeStages)].dsp.getSupplyVoltage(); }
+
+private:
+    struct LatencyPad
+    {
+        std::vector<float> buffer;
+        int writeIndex = 0;
+        int delay = 0;
+
+        void clear()
+        {
+            std::fill(buffer.begin(), buffer.end(), 0.0f);
+            writeIndex = 0;
+        }
+
+        void process(float* samples, int numSamples)
+        {
+            if (delay == 0)
+                return;
+
+            const int size = static_cast<int>(buffer.size());
+            for (int i = 0; i < numSamples; ++i)
+            {
+                buffer[static_cast<size_t>(writeIndex)] = samples[i];
+                int readIndex = writeIndex - delay;
+                if (readIndex < 0)
+                    readIndex += size;
+                samples[i] = buffer[static_cast<size_t>(readIndex)];
+                writeIndex = writeIndex + 1 < size ? writeIndex + 1 : 0;
+            }
+        }
+    };
+
+    struct Circuit
+    {
+        WoolyMammothDSP dsp;
+        HalfbandOversampler oversampler;
+        LatencyPad pad;
+        int latency = 0;  // whole samples, so the pads line every factor up exactly
+    };
+
+    std::array<Circuit, numFactors> circuits;
+    int maxBlock = 1;
+    int alignStages = 0;
+
+    int activeStages = 0;
+    int fadingStages = 0;
+    int fadeLength = 1;
+    int fadeRemaining = 0;
+    std::vector<float> fadeBuffer;
+
+    std::array<Circuit*, 2> runningCircuits()
+    {
+        // The active circuit, and the one it is fading from while a crossfade runs
+        return { &circuits[static_cast<size_t>(activeStages)],
+                 fadeRemaining > 0 ? &circuits[static_cast<size_t>(fadingStages)] : nullptr };
+    }
+
+    void beginTransition(int stages)
+    {
+        auto& from = circuits[static_cast<size_t>(activeStages)];
+        auto& to = circuits[static_cast<size_t>(stages)];
+
+        // The idle circuit starts from the running circuit's state; its filters
+        // ramp in from silence while the crossfade still favours the old output
+        to.dsp.adoptStateFrom(from.dsp);
+        to.oversampler.reset();
+        to.pad.clear();
+
+        fadingStages = activeStages;
+        activeStages = stages;
+        fadeRemaining = fadeLength;
+    }
+
+    void processChunk(float* samples, int numSamples)
+    {
+        if (fadeRemaining > 0)
+        {
+            std::copy(samples, samples + numSamples, fadeBuffer.data());
+            runCircuit(circuits[static_cast<size_t>(fadingStages)], fadeBuffer.data(), numSamples);
+        }
+
+        runCircuit(circuits[static_cast<size_t>(activeStages)], samples, numSamples);
+
+        for (int i = 0; i < numSamples && fadeRemaining > 0; ++i, --fadeRemaining)
+        {
+            // Linear crossfade: both outputs are the same signal, nearly in phase
+            float newGain = 1.0f - static_cast<float>(fadeRemaining) / static_cast<float>(fadeLength);
+            samples[i] = fadeBuffer[static_cast<size_t>(i)] + newGain * (samples[i] - fadeBuffer[static_cast<size_t>(i)]);
+        }
+    }
+
+    static void runCircuit(Circuit& circuit, float* samples, int numSamples)
+    {
+        if (circuit.oversampler.getFactor() == 1)
+        {
+            circuit.dsp.processBlock(samples, numSamples);
+        }
+        else
+        {
+            float* oversampled = circuit.oversampler.upsample(samples, numSamples);
+            circuit.dsp.processBlock(oversampled, numSamples * circuit.oversampler.getFactor());
+            circuit.oversampler.downsample(samples, numSamples);
+        }
+
+        circuit.pad.process(samples, numSamples);
+    }
+};
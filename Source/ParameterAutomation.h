@@ -0,0 +1,185 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <cstddef>
+
+//==============================================================================
+// Sub-block parameter automation
+// Collects the automation points of a block, each a value a parameter
+// reaches at a sample offset, moving there in a straight line from the point
+// before it (the convention of VST3 parameter queues), and walks the block in
+// sub-blocks. A sub-block ends at the next point, or after step samples while
+// any parameter is ramping, and is never shorter than step samples unless the
+// block ends first: dense automation costs one parameter update per step
+// instead of one per sample, and a block without automation stays whole.
+// Every sub-block hands out each parameter's value at its midpoint.
+//==============================================================================
+
+template <std::size_t NumParameters>
+class ParameterAutomation
+{
+public:
+    static constexpr std::size_t maxPointsPerBlock = 64;  // per parameter
+
+    void setStep(int samples) { step = std::max(1, samples); }
+    int getStep() const { return step; }
+
+    void reset(const std::array<float, NumParameters>& values)
+    {
+        for (std::size_t p = 0; p < NumParameters; ++p)
+        {
+            lanes[p].numPoints = 0;
+            lanes[p].value = values[p];
+            lanes[p].origin = values[p];
+            lanes[p].moving = false;
+        }
+    }
+
+    // offset counts from the start of the block; offsets at or past its end
+    // land at the end. Points of one parameter must come in offset order. A
+    // point within step samples of the last but one replaces the last, since
+    // sub-blocks couldn't follow it anyway: a lane with a point on every
+    // sample is kept as one point per step, always ending on the latest.
+    void addPoint(std::size_t parameter, int offset, float value)
+    {
+        auto& lane = lanes[parameter];
+        std::size_t index = lane.numPoints;
+
+        if (index == maxPointsPerBlock || (index >= 2 && offset - lane.points[index - 2].offset < step))
+            --index;
+
+        lane.points[index] = { offset, value };
+        lane.numPoints = index + 1;
+    }
+
+    // For hosts that only report where a parameter is at the end of each
+    // block. A lane that also moved in the block before is taken to be in a
+    // sweep and ramps across the whole block; a change out of the blue is a
+    // jump, reached within one step instead of smeared over a long block.
+    void addBlockEndValue(std::size_t parameter, int numSamples, float value)
+    {
+        auto& lane = lanes[parameter];
+        const bool moving = differs(value, lane.value);
+
+        addPoint(parameter, moving && ! lane.moving ? std::min(step, numSamples) : numSamples, value);
+        lane.moving = moving;
+    }
+
+    void beginBlock(int numSamples)
+    {
+        blockLength = numSamples;
+        position = 0;
+
+        for (auto& lane : lanes)
+        {
+            lane.origin = lane.value;
+            lane.cursor = 0;
+
+            for (std::size_t i = 0; i < lane.numPoints; ++i)
+                lane.points[i].offset = std::clamp(lane.points[i].offset, 0, numSamples);
+        }
+    }
+
+    // Next sub-block of the block, false once it has all been handed out;
+    // getValue() then gives the values for it
+    bool nextSegment(int& start, int& length)
+    {
+        if (position >= blockLength)
+        {
+            finishBlock();
+            return false;
+        }
+
+        int end = blockLength;
+        for (auto& lane : lanes)
+        {
+            while (lane.cursor < lane.numPoints && lane.points[lane.cursor].offset <= position)
+                ++lane.cursor;
+
+            if (lane.cursor == lane.numPoints)
+                continue;
+
+            // A lane ramps while its next point differs from the one before it
+            const auto& next = lane.points[lane.cursor];
+            const float from = lane.cursor == 0 ? lane.origin : lane.points[lane.cursor - 1].value;
+            end = std::min(end, differs(next.value, from) ? position + step : next.offset);
+        }
+
+        end = std::clamp(end, std::min(position + step, blockLength), blockLength);
+
+        start = position;
+        length = end - position;
+        position = end;
+
+        const double midpoint = 0.5 * (start + end);
+        for (auto& lane : lanes)
+            lane.value = valueAt(lane, midpoint);
+
+        return true;
+    }
+
+    float getValue(std::size_t parameter) const { return lanes[parameter].value; }
+
+private:
+    struct Point
+    {
+        int offset = 0;
+        float value = 0.0f;
+    };
+
+    struct Lane
+    {
+        std::array<Point, maxPointsPerBlock> points;
+        std::size_t numPoints = 0;
+        std::size_t cursor = 0;  // first point after the start of the current sub-block
+        float origin = 0.0f;     // value at the start of the block
+        float value = 0.0f;
+        bool moving = false;     // addBlockEndValue() moved it last block
+    };
+
+    std::array<Lane, NumParameters> lanes;
+    int step = 32;
+    int blockLength = 0;
+    int position = 0;
+
+    static bool differs(float a, float b) { return a < b || a > b; }
+
+    static float valueAt(const Lane& lane, double time)
+    {
+        // Straight line between the points either side of time, which are at
+        // or after the cursor since sub-blocks never run backwards
+        int previousOffset = 0;
+        float previousValue = lane.cursor == 0 ? lane.origin : lane.points[lane.cursor - 1].value;
+
+        if (lane.cursor > 0)
+            previousOffset = lane.points[lane.cursor - 1].offset;
+
+        for (std::size_t i = lane.cursor; i < lane.numPoints; ++i)
+        {
+            const auto& point = lane.points[i];
+            if (point.offset >= time)
+            {
+                const double span = point.offset - previousOffset;
+                const double t = span > 0.0 ? (time - previousOffset) / span : 1.0;
+                return static_cast<float>(previousValue + t * (point.value - previousValue));
+            }
+
+            previousOffset = point.offset;
+            previousValue = point.value;
+        }
+
+        return previousValue;
+    }
+
+    void finishBlock()
+    {
+        // The last point holds until the next block's points
+        for (auto& lane : lanes)
+        {
+            if (lane.numPoints > 0)
+                lane.value = lane.points[lane.numPoints - 1].value;
+
+            lane.numPoints = 0;
+        }
+    }
+};
@@ -0,0 +1,147 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include "SharedDspTables.h"
+
+//==============================================================================
+// Passive RC tone network of the EQ control
+// A low-pass branch (R1, C1) and a high-pass branch (C2, R2) feed the two ends
+// of the 10k EQ pot; the wiper drives the 10k output pot. Solved as a circuit
+// this is one second-order transfer function whose coefficients depend on the
+// knob, discretised with the bilinear transform prewarped at the centre of the
+// sweep. The digital biquads are designed once per sample rate on a dense grid
+// over the knob and shared process-wide, so a knob change is a lookup and a
+// linear interpolation.
+//==============================================================================
+
+class PassiveToneStack
+{
+public:
+    static constexpr int gridPoints = 129;
+
+    // Transposed direct form II biquad, a0 normalised to 1
+    struct Coefficients
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0;
+        double a1 = 0.0, a2 = 0.0;
+    };
+
+    struct Table
+    {
+        std::array<Coefficients, gridPoints> grid;
+    };
+
+    static std::shared_ptr<const Table> getTable(double sampleRate)
+    {
+        return SharedTableCache<double, Table>::get(sampleRate, [sampleRate] { return designTable(sampleRate); });
+    }
+
+    // eq 0 = fully bass (wiper at the low-pass end), 1 = fully treble
+    static Coefficients lookup(const Table& table, double eq)
+    {
+        const double position = std::clamp(eq, 0.0, 1.0) * (gridPoints - 1);
+        const int index = std::min(static_cast<int>(position), gridPoints - 2);
+        const double fraction = position - index;
+
+        const auto& lo = table.grid[static_cast<size_t>(index)];
+        const auto& hi = table.grid[static_cast<size_t>(index + 1)];
+        auto mix = [fraction](double a, double b) { return a + (b - a) * fraction; };
+
+        return { mix(lo.b0, hi.b0), mix(lo.b1, hi.b1), mix(lo.b2, hi.b2), mix(lo.a1, hi.a1), mix(lo.a2, hi.a2) };
+    }
+
+    // Exact design at any knob position; the reference the grid is built from
+    static Coefficients design(double eq, double sampleRate)
+    {
+        const auto h = solve(eq);
+
+        // Bilinear transform prewarped to match exactly at the centre frequency
+        const double w = 2.0 * M_PI * prewarpFrequency;
+        const double k = w / std::tan(w / (2.0 * sampleRate));
+        const double kk = k * k;
+        const double a0 = h.d2 * kk + h.d1 * k + h.d0;
+
+        Coefficients c;
+        c.b0 = (h.n2 * kk + h.n1 * k + h.n0) / a0;
+        c.b1 = 2.0 * (h.n0 - h.n2 * kk) / a0;
+        c.b2 = (h.n2 * kk - h.n1 * k + h.n0) / a0;
+        c.a1 = 2.0 * (h.d0 - h.d2 * kk) / a0;
+        c.a2 = (h.d2 * kk - h.d1 * k + h.d0) / a0;
+        return c;
+    }
+
+    // Magnitude of the analogue circuit itself, for checking the digital model
+    static double analogMagnitude(double eq, double frequency)
+    {
+        const auto h = solve(eq);
+        const double w = 2.0 * M_PI * frequency;
+        const double numRe = h.n0 - h.n2 * w * w, numIm = h.n1 * w;
+        const double denRe = h.d0 - h.d2 * w * w, denIm = h.d1 * w;
+        return std::sqrt((numRe * numRe + numIm * numIm) / (denRe * denRe + denIm * denIm));
+    }
+
+    // Per-sample filter; z1 and z2 live in the caller's state
+    static double process(const Coefficients& c, double input, double& z1, double& z2)
+    {
+        const double out = c.b0 * input + z1;
+        z1 = c.b1 * input - c.a1 * out + z2;
+        z2 = c.b2 * input - c.a2 * out;
+        return out;
+    }
+
+private:
+    // Branch components
+    static constexpr double r1 = 10.0e3, c1 = 22.0e-9;   // low-pass, ~720 Hz
+    static constexpr double r2 = 22.0e3, c2 = 4.7e-9;    // high-pass, ~1.5 kHz
+
+    // EQ pot, and the output pot hanging off its wiper
+    static constexpr double potResistance = 10.0e3;
+    static constexpr double potEndResistance = 10.0;
+    static constexpr double loadResistance = 10.0e3;
+
+    static constexpr double prewarpFrequency = 1000.0;
+
+    // Recovers most of the network's insertion loss, as the stage after it would
+    static constexpr double makeupGain = 2.0;
+
+    // H(s) = (n2 s^2 + n1 s + n0) / (d2 s^2 + d1 s + d0), make-up gain included
+    struct Analog
+    {
+        double n2, n1, n0;
+        double d2, d1, d0;
+    };
+
+    static Analog solve(double eq)
+    {
+        // Pot end resistance keeps both halves of the track finite at the stops
+        const double t = std::clamp(eq, 0.0, 1.0);
+        const double gA = 1.0 / std::max(t * potResistance, potEndResistance);          // low-pass end to wiper
+        const double gB = 1.0 / std::max((1.0 - t) * potResistance, potEndResistance);  // wiper to high-pass end
+        const double gL = 1.0 / loadResistance;
+        const double g1 = 1.0 / r1, g2 = 1.0 / r2;
+
+        // The wiper node as its equivalent delta between the two branch nodes and ground
+        const double sum = gA + gB + gL;
+        const double gAB = gA * gB / sum;
+        const double pA = g1 + gAB + gA * gL / sum;
+        const double pB = g2 + gAB + gB * gL / sum;
+        const double gain = makeupGain / sum;
+
+        return { gain * gB * c1 * c2,
+                 gain * (gA * c2 * (g1 + gAB) + gB * c2 * pA),
+                 gain * (gA * g1 * pB + gB * gAB * g1),
+                 c1 * c2,
+                 c1 * pB + c2 * pA,
+                 pA * pB - gAB * gAB };
+    }
+
+    static Table designTable(double sampleRate)
+    {
+        Table table;
+        for (int i = 0; i < gridPoints; ++i)
+            table.grid[static_cast<size_t>(i)] = design(static_cast<double>(i) / (gridPoints - 1), sampleRate);
+        return table;
+    }
+};
@@ -27,8 +27,8 @@ void WoolyLookAndFeel::drawRotarySlider(juce::Graphics& g, int x, int y, int wid
     // Fix the angle calculation - this was backwards before
     auto angle = rotaryStartAngle + sliderPos * (rotaryEndAngle - rotaryStartAngle);
     
-    // Load the custom knob image from BinaryData
-    auto knobImage = juce::ImageCache::getFromMemory(BinaryData::harmonster_custom_knob_png, BinaryData::harmonster_custom_knob_pngSize);
+    // Custom knob image from the shared atlas (baked at knob size, decoded once)
+    const auto& knobImage = assets->get(HarmonsterAssets::Asset::knob, g.getInternalContext().getPhysicalPixelScaleFactor());
     
     if (knobImage.isValid())
     {
@@ -162,10 +162,9 @@ void WoolyLookAndFeel::drawToggleButton(juce::Graphics& g, juce::ToggleButton& b
     auto bounds = button.getLocalBounds().toFloat();
     bool isOn = button.getToggleState();
     
-    // Load the appropriate power button image based on state
-    auto buttonImage = isOn ? 
-        juce::ImageCache::getFromMemory(BinaryData::poweron_png, BinaryData::poweron_pngSize) :
-        juce::ImageCache::getFromMemory(BinaryData::poweroff_png, BinaryData::poweroff_pngSize);
+    // Pick the appropriate power button image based on state
+    const auto& buttonImage = assets->get(isOn ? HarmonsterAssets::Asset::powerOn : HarmonsterAssets::Asset::powerOff,
+                                          g.getInternalContext().getPhysicalPixelScaleFactor());
     
     if (buttonImage.isValid())
     {
@@ -189,6 +188,291 @@ void WoolyLookAndFeel::drawToggleButton(juce::Graphics& g, juce::ToggleButton& b
     }
 }
 
+//==============================================================================
+// ToneDisplay Implementation
+//==============================================================================
+
+void ToneDisplay::setResult(const ToneAnalyser::Result& newResult)
+{
+    result = newResult;
+    hasResult = true;
+    repaint();
+}
+
+void ToneDisplay::paint(juce::Graphics& g)
+{
+    auto bounds = getLocalBounds().toFloat();
+    
+    // Recessed screen
+    g.setColour(juce::Colour(0xC0101010));
+    g.fillRoundedRectangle(bounds, 4.0f);
+    g.setColour(juce::Colour(0xFF505050));
+    g.drawRoundedRectangle(bounds.reduced(0.5f), 4.0f, 1.0f);
+    
+    auto plot = bounds.reduced(5.0f);
+    g.setColour(juce::Colour(0x30F5DEB3));
+    g.drawHorizontalLine(juce::roundToInt(plot.getCentreY()), plot.getX(), plot.getRight());
+    
+    if (! hasResult)
+        return;
+    
+    g.setColour(juce::Colour(0xFFD4A574));
+    
+    if (mode == Mode::transferCurve)
+    {
+        // Output against input over one period of the test sine
+        g.drawVerticalLine(juce::roundToInt(plot.getCentreX()), plot.getY(), plot.getBottom());
+        
+        juce::Path curve;
+        for (int i = 0; i < ToneAnalyser::curvePoints; ++i)
+        {
+            const float x = juce::jmap(result.input[static_cast<size_t>(i)], -1.0f, 1.0f, plot.getX(), plot.getRight());
+            const float y = juce::jmap(result.output[static_cast<size_t>(i)], -1.0f, 1.0f, plot.getBottom(), plot.getY());
+            
+            if (i == 0)
+                curve.startNewSubPath(x, y);
+            else
+                curve.lineTo(x, y);
+        }
+        
+        curve.closeSubPath();
+        g.strokePath(curve, juce::PathStrokeType(1.5f));
+    }
+    else
+    {
+        // One bar per harmonic, 0 to -72 dBFS
+        const float barWidth = plot.getWidth() / ToneAnalyser::numHarmonics;
+        
+        for (int i = 0; i < ToneAnalyser::numHarmonics; ++i)
+        {
+            const float level = juce::jlimit(0.0f, 1.0f, 1.0f + result.harmonicsDb[static_cast<size_t>(i)] / 72.0f);
+            const float height = level * plot.getHeight();
+            g.fillRect(plot.getX() + i * barWidth + 1.0f, plot.getBottom() - height, barWidth - 2.0f, height);
+        }
+    }
+}
+
+//==============================================================================
+// TunerDisplay Implementation
+//==============================================================================
+
+void TunerDisplay::setReading(const Tuner::Reading& newReading)
+{
+    reading = newReading;
+    repaint();
+}
+
+void TunerDisplay::setMode(int newMode)
+{
+    if (newMode == mode)
+        return;
+    
+    mode = newMode;
+    repaint();
+}
+
+void TunerDisplay::paint(juce::Graphics& g)
+{
+    auto bounds = getLocalBounds().toFloat();
+    
+    // Recessed screen, as the tone displays
+    g.setColour(juce::Colour(0xC0101010));
+    g.fillRoundedRectangle(bounds, 4.0f);
+    g.setColour(juce::Colour(0xFF505050));
+    g.drawRoundedRectangle(bounds.reduced(0.5f), 4.0f, 1.0f);
+    
+    auto area = bounds.reduced(6.0f);
+    
+    if (mode == Tuner::off)
+    {
+        g.setColour(juce::Colour(0x80F5DEB3));
+        g.setFont(juce::Font(juce::FontOptions(12.0f)));
+        g.drawText("Tuner off", area, juce::Justification::centred);
+        return;
+    }
+    
+    // Cents scale, -50 to +50, ticks every 10 cents
+    auto scale = area.removeFromBottom(16.0f);
+    g.setColour(juce::Colour(0x30F5DEB3));
+    for (int cents = -50; cents <= 50; cents += 10)
+    {
+        const float x = juce::jmap(static_cast<float>(cents), -50.0f, 50.0f, scale.getX(), scale.getRight());
+        const float inset = cents == 0 ? 0.0f : 5.0f;
+        g.drawVerticalLine(juce::roundToInt(x), scale.getY() + inset, scale.getBottom());
+    }
+    
+    const bool hasPitch = reading.midiNote >= 0;
+    const bool inTune = hasPitch && std::abs(reading.cents) <= 2.0f;
+    g.setColour(inTune ? juce::Colour(0xFF8FD48F) : juce::Colour(0xFFD4A574));
+    
+    if (hasPitch)
+    {
+        const float x = juce::jmap(reading.cents, -50.0f, 50.0f, scale.getX(), scale.getRight());
+        g.fillRect(x - 1.5f, scale.getY(), 3.0f, scale.getHeight());
+    }
+    
+    // Note name with its octave, so a drop-tuned B0 isn't taken for B1
+    const auto name = hasPitch ? Tuner::getNoteName(reading.midiNote) : juce::String("-");
+    const auto octave = hasPitch ? juce::String(reading.midiNote / 12 - 1) : juce::String();
+    
+    g.setFont(juce::Font(juce::FontOptions(28.0f, juce::Font::bold)));
+    g.drawText(name, area.withTrimmedRight(area.getWidth() * 0.5f - 14.0f), juce::Justification::centredRight);
+    
+    g.setFont(juce::Font(juce::FontOptions(13.0f)));
+    g.drawText(octave, area.withTrimmedLeft(area.getWidth() * 0.5f + 16.0f).withTrimmedTop(area.getHeight() * 0.4f),
+               juce::Justification::centredLeft);
+    
+    if (hasPitch)
+    {
+        const auto cents = (reading.cents >= 0.0f ? "+" : "") + juce::String(reading.cents, 0) + " c";
+        g.drawText(cents, area, juce::Justification::topRight);
+    }
+}
+
+void TunerDisplay::mouseUp(const juce::MouseEvent& event)
+{
+    if (onClick != nullptr && getLocalBounds().contains(event.getPosition()))
+        onClick();
+}
+
+//==============================================================================
+// PresetBrowser Implementation
+//==============================================================================
+
+PresetBrowser::PresetBrowser(WoolyMammothAudioProcessor& processor)
+    : audioProcessor(processor)
+{
+    searchBox.setTextToShowWhenEmpty("Search names and tags", juce::Colours::grey);
+    searchBox.onTextChange = [this] { updateResults(); };
+    searchBox.onReturnKey = [this] { loadRow(0); };
+    addAndMakeVisible(&searchBox);
+    
+    resultList.setRowHeight(20);
+    addAndMakeVisible(&resultList);
+    
+    statusLabel.setFont(juce::Font(juce::FontOptions(12.0f)));
+    addAndMakeVisible(&statusLabel);
+    
+    nameBox.setTextToShowWhenEmpty("Preset name", juce::Colours::grey);
+    nameBox.onReturnKey = [this] { savePreset(); };
+    addAndMakeVisible(&nameBox);
+    
+    tagsBox.setTextToShowWhenEmpty("Tags, separated by commas", juce::Colours::grey);
+    tagsBox.onReturnKey = [this] { savePreset(); };
+    addAndMakeVisible(&tagsBox);
+    
+    saveButton.setTooltip("Save the current settings to the user bank; an existing preset of the same name is replaced");
+    saveButton.onClick = [this] { savePreset(); };
+    addAndMakeVisible(&saveButton);
+    
+    setSize(HarmonsterLayout::PRESET_BROWSER_WIDTH, HarmonsterLayout::PRESET_BROWSER_HEIGHT);
+    updateResults();
+}
+
+void PresetBrowser::resized()
+{
+    auto area = getLocalBounds().reduced(4);
+    
+    searchBox.setBounds(area.removeFromTop(24));
+    area.removeFromTop(4);
+    
+    auto saveRow = area.removeFromBottom(24);
+    saveButton.setBounds(saveRow.removeFromRight(50));
+    saveRow.removeFromRight(4);
+    nameBox.setBounds(saveRow);
+    area.removeFromBottom(4);
+    tagsBox.setBounds(area.removeFromBottom(24));
+    area.removeFromBottom(4);
+    
+    statusLabel.setBounds(area.removeFromBottom(18));
+    resultList.setBounds(area);
+}
+
+int PresetBrowser::getNumRows()
+{
+    return static_cast<int>(results.size());
+}
+
+void PresetBrowser::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
+{
+    if (! juce::isPositiveAndBelow(rowNumber, getNumRows()))
+        return;
+    
+    if (rowIsSelected)
+        g.fillAll(juce::Colour(0xFF00BFFF).withAlpha(0.3f));
+    
+    g.setColour(juce::Colour(0xFFF5DEB3));
+    g.setFont(juce::Font(juce::FontOptions(14.0f)));
+    g.drawText(audioProcessor.getUserPresets().getName(results[static_cast<size_t>(rowNumber)]),
+               4, 0, width - 8, height, juce::Justification::centredLeft, true);
+}
+
+void PresetBrowser::listBoxItemDoubleClicked(int row, const juce::MouseEvent&)
+{
+    loadRow(row);
+}
+
+void PresetBrowser::returnKeyPressed(int lastRowSelected)
+{
+    loadRow(lastRowSelected);
+}
+
+void PresetBrowser::selectedRowsChanged(int lastRowSelected)
+{
+    // Saving over the selected preset is the usual way to update it
+    if (! juce::isPositiveAndBelow(lastRowSelected, getNumRows()))
+        return;
+    
+    UserPresetBank::Preset preset;
+    if (audioProcessor.getUserPresets().getPreset(results[static_cast<size_t>(lastRowSelected)], preset))
+    {
+        nameBox.setText(preset.name, false);
+        tagsBox.setText(preset.tags.joinIntoString(", "), false);
+    }
+}
+
+void PresetBrowser::updateResults()
+{
+    auto& bank = audioProcessor.getUserPresets();
+    results = bank.search(searchBox.getText());
+    resultList.updateContent();
+    resultList.repaint();
+    
+    if (bank.getNumPresets() == 0)
+        statusLabel.setText("No user presets yet - name and save one below", juce::dontSendNotification);
+    else
+        statusLabel.setText(juce::String(static_cast<int>(results.size())) + " of " + juce::String(bank.getNumPresets()) + " presets",
+                            juce::dontSendNotification);
+}
+
+void PresetBrowser::loadRow(int row)
+{
+    if (juce::isPositiveAndBelow(row, getNumRows()))
+        audioProcessor.loadUserPreset(results[static_cast<size_t>(row)]);
+}
+
+void PresetBrowser::savePreset()
+{
+    const auto name = nameBox.getText().trim();
+    if (name.isEmpty())
+    {
+        nameBox.grabKeyboardFocus();
+        return;
+    }
+    
+    juce::StringArray tags;
+    tags.addTokens(tagsBox.getText(), ",", {});
+    
+    if (! audioProcessor.saveUserPreset(name, tags))
+    {
+        statusLabel.setText("Couldn't write to " + audioProcessor.getUserPresets().getBankFile().getParentDirectory().getFullPathName(),
+                            juce::dontSendNotification);
+        return;
+    }
+    
+    updateResults();
+}
+
 //==============================================================================
 // WoolyMammothAudioProcessorEditor Implementation
 //==============================================================================
@@ -238,27 +522,309 @@ WoolyMammothAudioProcessorEditor::WoolyMammothAudioProcessorEditor (WoolyMammoth
 
     // Setup footswitch button
     footswitchButton.setButtonText("");
-    footswitchButton.setTooltip("Click to bypass/enable the effect");
+    footswitchButton.setTooltip("Click to bypass/enable the effect; the tuner shows while bypassed");
     footswitchButton.setToggleState(false, juce::dontSendNotification); // Default to ON (not bypassed)
     addAndMakeVisible(&footswitchButton);
 
+    // Setup cabinet IR loader
+    cabinetButton.onClick = [this] { chooseCabinetImpulseResponse(); };
+    updateCabinetTooltip();
+    addAndMakeVisible(&cabinetButton);
+
+    // Setup flight recorder menu
+    recorderButton.onClick = [this] { showRecorderMenu(); };
+    updateRecorderButton();
+    addAndMakeVisible(&recorderButton);
+
+    // Setup CPU governor switch
+    governorButton.setClickingTogglesState(true);
+    addAndMakeVisible(&governorButton);
+
+    // Setup harmonizer menu
+    harmonyButton.onClick = [this] { showHarmonyMenu(); };
+    updateHarmonyButton();
+    addAndMakeVisible(&harmonyButton);
+
+    // Setup user preset browser
+    presetButton.setTooltip("Search, load and save user presets");
+    presetButton.onClick = [this] { showPresetBrowser(); };
+    addAndMakeVisible(&presetButton);
+
+    // Setup dual circuit menu
+    dualButton.onClick = [this] { showDualMenu(); };
+    updateDualButton();
+    addAndMakeVisible(&dualButton);
+
+    // Setup tone displays; the analyser picks up knob changes from the timer
+    transferDisplay.setTooltip("Transfer curve of the current settings (output against input)");
+    harmonicsDisplay.setTooltip("Harmonic levels of the current settings for a 120 Hz test tone");
+    addAndMakeVisible(&transferDisplay);
+    addAndMakeVisible(&harmonicsDisplay);
+
+    // Setup tuner; the timer shows it while the effect is bypassed
+    tunerDisplay.setTooltip("Tuner - click to choose whether it listens while bypassed and mutes the output");
+    tunerDisplay.onClick = [this] { showTunerMenu(); };
+    addChildComponent(&tunerDisplay);
+
     // Create parameter attachments for the 4 knobs
-    eqAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment> (audioProcessor.parameters, "eq", eqSlider);
-    snarlAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment> (audioProcessor.parameters, "wool", snarlSlider);
-    pinchAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment> (audioProcessor.parameters, "pinch", pinchSlider);
-    outputAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment> (audioProcessor.parameters, "output", outputSlider);
+    attachKnobs();
     
     // Create parameter attachment for footswitch
     footswitchAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment> (audioProcessor.parameters, "bypass", footswitchButton);
+    governorAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment> (audioProcessor.parameters, "governor", governorButton);
 
     // Size already set at beginning of constructor
+    
+    timerCallback();
+    startTimerHz(20);
 }
 
 WoolyMammothAudioProcessorEditor::~WoolyMammothAudioProcessorEditor()
 {
+    stopTimer();
     setLookAndFeel(nullptr);
 }
 
+void WoolyMammothAudioProcessorEditor::chooseCabinetImpulseResponse()
+{
+    cabinetChooser = std::make_unique<juce::FileChooser>("Load cabinet impulse response",
+                                                         audioProcessor.getCabinetImpulseResponseFile(),
+                                                         "*.wav;*.aif;*.aiff;*.flac");
+    
+    auto flags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+    
+    cabinetChooser->launchAsync(flags, [this](const juce::FileChooser& chooser)
+    {
+        auto file = chooser.getResult();
+        
+        if (file.existsAsFile())
+        {
+            audioProcessor.loadCabinetImpulseResponse(file);
+            updateCabinetTooltip();
+        }
+    });
+}
+
+void WoolyMammothAudioProcessorEditor::updateCabinetTooltip()
+{
+    auto file = audioProcessor.getCabinetImpulseResponseFile();
+    cabinetButton.setTooltip(file == juce::File() ? "Load a cabinet impulse response"
+                                                  : "Cabinet IR: " + file.getFileName());
+}
+
+void WoolyMammothAudioProcessorEditor::showRecorderMenu()
+{
+    auto& recorder = audioProcessor.getFlightRecorder();
+    const auto lastDump = recorder.getLastDump();
+    
+    juce::PopupMenu menu;
+    menu.addItem("Record the last " + juce::String(static_cast<int>(FlightRecorder::historySeconds)) + " seconds", true, recorder.isEnabled(), [this]
+    {
+        auto& flightRecorder = audioProcessor.getFlightRecorder();
+        flightRecorder.setEnabled(! flightRecorder.isEnabled());
+        updateRecorderButton();
+    });
+    menu.addItem("Save recording now", recorder.isEnabled(), false, [this] { audioProcessor.getFlightRecorder().requestDump(); });
+    menu.addSeparator();
+    menu.addItem("Show recordings", true, false, [this, lastDump]
+    {
+        auto directory = audioProcessor.getFlightRecorder().getDumpDirectory();
+        
+        if (lastDump.existsAsFile())
+            lastDump.revealToUser();
+        else
+            (directory.isDirectory() ? directory : directory.getParentDirectory()).revealToUser();
+    });
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&recorderButton));
+}
+
+void WoolyMammothAudioProcessorEditor::updateRecorderButton()
+{
+    auto& recorder = audioProcessor.getFlightRecorder();
+    lastRecorderDumps = recorder.getNumDumps();
+    recorderButton.setToggleState(recorder.isEnabled(), juce::dontSendNotification);
+    
+    if (! recorder.isEnabled())
+        recorderButton.setTooltip("Flight recorder off - switch it on to capture glitches for a bug report");
+    else if (lastRecorderDumps == 0)
+        recorderButton.setTooltip("Flight recorder on - saves the last seconds on request or when the output glitches");
+    else
+        recorderButton.setTooltip("Flight recorder on - last recording: " + recorder.getLastDump().getFileName());
+}
+
+void WoolyMammothAudioProcessorEditor::showHarmonyMenu()
+{
+    auto& state = audioProcessor.parameters;
+    const int voicing = static_cast<int>(state.getRawParameterValue("harmony")->load());
+    const int interval = static_cast<int>(state.getRawParameterValue("interval")->load());
+    const float mix = state.getRawParameterValue("harmonymix")->load();
+    const int placement = static_cast<int>(state.getRawParameterValue("harmonyplace")->load());
+    const int engine = static_cast<int>(state.getRawParameterValue("harmonyengine")->load());
+    
+    auto setParameter = [this](const juce::String& id, float value)
+    {
+        if (auto* parameter = audioProcessor.parameters.getParameter(id))
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        
+        updateHarmonyButton();
+    };
+    
+    juce::PopupMenu menu;
+    const juce::StringArray voicings { "Off", "Octave down", "Octave up", "Octaves down and up" };
+    for (int i = 0; i < voicings.size(); ++i)
+        menu.addItem(voicings[i], true, voicing == i, [setParameter, i] { setParameter("harmony", static_cast<float>(i)); });
+    
+    juce::PopupMenu intervals;
+    for (int semitones = -12; semitones <= 12; ++semitones)
+    {
+        if (semitones == 0)
+            continue;
+        
+        const auto name = (semitones > 0 ? "+" : "") + juce::String(semitones) + " semitones";
+        intervals.addItem(name, true, voicing == Harmonizer::interval && interval == semitones, [setParameter, semitones]
+        {
+            setParameter("interval", static_cast<float>(semitones));
+            setParameter("harmony", static_cast<float>(Harmonizer::interval));
+        });
+    }
+    menu.addSubMenu("Interval", intervals, true, nullptr, voicing == Harmonizer::interval);
+    
+    juce::PopupMenu mixes;
+    for (int percent = 25; percent <= 100; percent += 25)
+        mixes.addItem(juce::String(percent) + "% wet", true, juce::roundToInt(mix * 100.0f) == percent,
+                      [setParameter, percent] { setParameter("harmonymix", static_cast<float>(percent) / 100.0f); });
+    menu.addSubMenu("Mix", mixes);
+    
+    menu.addSeparator();
+    menu.addItem("After the fuzz", true, placement == 0, [setParameter] { setParameter("harmonyplace", 0.0f); });
+    menu.addItem("Before the fuzz", true, placement == 1, [setParameter] { setParameter("harmonyplace", 1.0f); });
+    
+    // Latency is what decides the engine for live playing, so it is shown up front
+    menu.addSeparator();
+    const juce::StringArray engines { "Low latency", "Phase vocoder (chords)" };
+    for (int i = 0; i < engines.size(); ++i)
+    {
+        const auto name = engines[i] + ", " + juce::String(audioProcessor.getHarmonizerLatencyMs(i), 1) + " ms";
+        menu.addItem(name, true, engine == i, [setParameter, i] { setParameter("harmonyengine", static_cast<float>(i)); });
+    }
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&harmonyButton));
+}
+
+void WoolyMammothAudioProcessorEditor::updateHarmonyButton()
+{
+    auto& state = audioProcessor.parameters;
+    const int voicing = static_cast<int>(state.getRawParameterValue("harmony")->load());
+    harmonyButton.setToggleState(voicing != Harmonizer::off, juce::dontSendNotification);
+    
+    if (voicing == Harmonizer::off)
+        harmonyButton.setTooltip("Harmonizer off - add octave or interval voices");
+    else if (voicing == Harmonizer::interval)
+        harmonyButton.setTooltip("Harmonizer: " + state.getParameter("interval")->getCurrentValueAsText() + " semitones");
+    else
+        harmonyButton.setTooltip("Harmonizer: " + state.getParameter("harmony")->getCurrentValueAsText());
+}
+
+void WoolyMammothAudioProcessorEditor::showPresetBrowser()
+{
+    juce::CallOutBox::launchAsynchronously(std::make_unique<PresetBrowser>(audioProcessor),
+                                           presetButton.getBounds(), this);
+}
+
+void WoolyMammothAudioProcessorEditor::attachKnobs()
+{
+    // The old attachments go first, so they stop writing to the circuit being left
+    eqAttachment.reset();
+    snarlAttachment.reset();
+    pinchAttachment.reset();
+    outputAttachment.reset();
+    
+    const juce::String suffix = editingSecondCircuit ? "b" : "";
+    eqAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment> (audioProcessor.parameters, "eq" + suffix, eqSlider);
+    snarlAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment> (audioProcessor.parameters, "wool" + suffix, snarlSlider);
+    pinchAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment> (audioProcessor.parameters, "pinch" + suffix, pinchSlider);
+    outputAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment> (audioProcessor.parameters, "output" + suffix, outputSlider);
+}
+
+void WoolyMammothAudioProcessorEditor::showDualMenu()
+{
+    auto& state = audioProcessor.parameters;
+    const bool dual = state.getRawParameterValue("dual")->load() > 0.5f;
+    const float blend = state.getRawParameterValue("blend")->load();
+    const float spread = state.getRawParameterValue("spread")->load();
+    
+    auto setParameter = [this](const juce::String& id, float value)
+    {
+        if (auto* parameter = audioProcessor.parameters.getParameter(id))
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        
+        updateDualButton();
+    };
+    
+    auto editCircuit = [this](bool second)
+    {
+        editingSecondCircuit = second;
+        attachKnobs();
+        updateDualButton();
+    };
+    
+    juce::PopupMenu menu;
+    menu.addItem("Dual circuit", true, dual, [setParameter, dual] { setParameter("dual", dual ? 0.0f : 1.0f); });
+    
+    menu.addSeparator();
+    menu.addItem("Knobs set circuit A", true, ! editingSecondCircuit, [editCircuit] { editCircuit(false); });
+    menu.addItem("Knobs set circuit B", true, editingSecondCircuit, [editCircuit] { editCircuit(true); });
+    
+    juce::PopupMenu blends;
+    for (int percent = 0; percent <= 100; percent += 25)
+        blends.addItem(juce::String(100 - percent) + "% A, " + juce::String(percent) + "% B", true, juce::roundToInt(blend * 100.0f) == percent,
+                       [setParameter, percent] { setParameter("blend", static_cast<float>(percent) / 100.0f); });
+    menu.addSubMenu("Blend", blends, dual);
+    
+    juce::PopupMenu spreads;
+    for (int percent = 0; percent <= 100; percent += 25)
+        spreads.addItem(percent == 0 ? juce::String("Centred") : juce::String(percent) + "% A left, B right", true, juce::roundToInt(spread * 100.0f) == percent,
+                        [setParameter, percent] { setParameter("spread", static_cast<float>(percent) / 100.0f); });
+    menu.addSubMenu("Spread", spreads, dual);
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&dualButton));
+}
+
+void WoolyMammothAudioProcessorEditor::updateDualButton()
+{
+    auto& state = audioProcessor.parameters;
+    const bool dual = state.getRawParameterValue("dual")->load() > 0.5f;
+    dualButton.setToggleState(dual, juce::dontSendNotification);
+    dualButton.setButtonText(editingSecondCircuit ? "DUAL B" : "DUAL");
+    
+    const juce::String knobs = editingSecondCircuit ? " - knobs set circuit B" : " - knobs set circuit A";
+    if (! dual)
+        dualButton.setTooltip("Dual circuit off - blend a second, differently voiced circuit" + knobs);
+    else
+        dualButton.setTooltip("Dual circuit: " + state.getParameter("blend")->getCurrentValueAsText() + " blend to B, spread "
+                              + state.getParameter("spread")->getCurrentValueAsText() + knobs);
+}
+
+void WoolyMammothAudioProcessorEditor::updateGovernorButton()
+{
+    const auto stats = audioProcessor.getProcessingStats();
+    const auto load = "CPU load " + juce::String(juce::roundToInt(stats.cpuLoad * 100.0f)) + "%";
+    
+    if (stats.qualityTier != lastQualityTier)
+    {
+        lastQualityTier = stats.qualityTier;
+        governorButton.setButtonText(lastQualityTier > 0 ? "ECO" : "CPU");
+    }
+    
+    if (! governorButton.getToggleState())
+        governorButton.setTooltip(load + " - governor off, quality never reduced");
+    else if (lastQualityTier == 0)
+        governorButton.setTooltip(load + " - governor on, reduces quality if processing falls behind");
+    else
+        governorButton.setTooltip(load + " - reduced to " + audioProcessor.describeQualityTier(lastQualityTier));
+}
+
 void WoolyMammothAudioProcessorEditor::sliderValueChanged (juce::Slider* slider)
 {
     (void)slider; // Suppress unused parameter warning
@@ -266,24 +832,73 @@ void WoolyMammothAudioProcessorEditor::sliderValueChanged (juce::Slider* slider)
     // This method can be left empty or used for additional UI updates
 }
 
+void WoolyMammothAudioProcessorEditor::showTunerMenu()
+{
+    auto* parameter = audioProcessor.parameters.getParameter("tuner");
+    const int mode = static_cast<int>(audioProcessor.parameters.getRawParameterValue("tuner")->load());
+    
+    auto setMode = [parameter](int newMode)
+    {
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(static_cast<float>(newMode)));
+    };
+    
+    juce::PopupMenu menu;
+    menu.addItem("Tuner off", true, mode == Tuner::off, [setMode] { setMode(Tuner::off); });
+    menu.addItem("Tune on bypass, signal passes", true, mode == Tuner::onBypass, [setMode] { setMode(Tuner::onBypass); });
+    menu.addItem("Tune on bypass, output muted", true, mode == Tuner::mutedOnBypass, [setMode] { setMode(Tuner::mutedOnBypass); });
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&tunerDisplay));
+}
+
 void WoolyMammothAudioProcessorEditor::comboBoxChanged (juce::ComboBox* comboBoxThatHasChanged)
 {
     (void)comboBoxThatHasChanged; // Suppress unused parameter warning
     // No combo boxes in HARMONSTER design
 }
 
+void WoolyMammothAudioProcessorEditor::timerCallback()
+{
+    // Only the parameter values leave the processor; the analyser runs its own circuit
+    ToneAnalyser::Settings settings;
+    settings.wool = audioProcessor.parameters.getRawParameterValue("wool")->load();
+    settings.pinch = audioProcessor.parameters.getRawParameterValue("pinch")->load();
+    settings.eq = audioProcessor.parameters.getRawParameterValue("eq")->load();
+    settings.output = audioProcessor.parameters.getRawParameterValue("output")->load();
+    settings.features = audioProcessor.getCircuitFeatures();
+    toneAnalyser.setSettings(settings);
+    
+    if (toneAnalyser.getLatestResult(toneResult))
+    {
+        transferDisplay.setResult(toneResult);
+        harmonicsDisplay.setResult(toneResult);
+    }
+    
+    if (audioProcessor.getFlightRecorder().getNumDumps() != lastRecorderDumps)
+        updateRecorderButton();
+    
+    updateGovernorButton();
+    updateHarmonyButton();
+    updateDualButton();
+    
+    // The tuner's readings arrive from its own thread, a few per timer tick
+    tunerDisplay.setVisible(audioProcessor.parameters.getRawParameterValue("bypass")->load() > 0.5f);
+    tunerDisplay.setMode(static_cast<int>(audioProcessor.parameters.getRawParameterValue("tuner")->load()));
+    
+    if (audioProcessor.getTuner().getLatestReading(tunerReading))
+        tunerDisplay.setReading(tunerReading);
+}
+
 void WoolyMammothAudioProcessorEditor::paint (juce::Graphics& g)
 {
     auto bounds = getLocalBounds();
     
-    // Load the HARMONSTER custom background image from BinaryData
-    auto backgroundImage = juce::ImageCache::getFromMemory(BinaryData::harmonster_custom_ui_png, 
-                                                          BinaryData::harmonster_custom_ui_pngSize);
+    // HARMONSTER background, pre-scaled at build time to the 360x540 layout (2x on HiDPI)
+    const auto& backgroundImage = assets->get(HarmonsterAssets::Asset::background,
+                                              g.getInternalContext().getPhysicalPixelScaleFactor());
     
     if (backgroundImage.isValid())
     {
-        // Draw the HARMONSTER background image scaled to fit the plugin window
-        // Scale from original to current window size (360x540)
+        // Draw the HARMONSTER background image to fit the plugin window
         g.drawImage(backgroundImage, bounds.toFloat(), 
                    juce::RectanglePlacement::centred | juce::RectanglePlacement::fillDestination);
     }
@@ -326,4 +941,29 @@ void WoolyMammothAudioProcessorEditor::resized()
     
     // Footswitch button (bottom center)
     footswitchButton.setBounds(FOOTSWITCH_X, FOOTSWITCH_Y, FOOTSWITCH_WIDTH, FOOTSWITCH_HEIGHT);
+    
+    // Cabinet IR loader (bottom right)
+    cabinetButton.setBounds(CAB_BUTTON_X, CAB_BUTTON_Y, CAB_BUTTON_WIDTH, CAB_BUTTON_HEIGHT);
+    
+    // Flight recorder menu (left of the cabinet loader)
+    recorderButton.setBounds(RECORDER_BUTTON_X, CAB_BUTTON_Y, CAB_BUTTON_WIDTH, CAB_BUTTON_HEIGHT);
+    
+    // CPU governor (left of the flight recorder)
+    governorButton.setBounds(GOVERNOR_BUTTON_X, CAB_BUTTON_Y, CAB_BUTTON_WIDTH, CAB_BUTTON_HEIGHT);
+    
+    // Harmonizer (left of the CPU governor)
+    harmonyButton.setBounds(HARMONY_BUTTON_X, CAB_BUTTON_Y, CAB_BUTTON_WIDTH, CAB_BUTTON_HEIGHT);
+    
+    // User presets (left of the harmonizer)
+    presetButton.setBounds(PRESET_BUTTON_X, CAB_BUTTON_Y, CAB_BUTTON_WIDTH, CAB_BUTTON_HEIGHT);
+    
+    // Dual circuit (left of the user presets)
+    dualButton.setBounds(DUAL_BUTTON_X, CAB_BUTTON_Y, CAB_BUTTON_WIDTH, CAB_BUTTON_HEIGHT);
+    
+    // Tone displays (bottom left and right)
+    transferDisplay.setBounds(TRANSFER_DISPLAY_X, TONE_DISPLAY_Y, TONE_DISPLAY_WIDTH, TONE_DISPLAY_HEIGHT);
+    harmonicsDisplay.setBounds(HARMONICS_DISPLAY_X, TONE_DISPLAY_Y, TONE_DISPLAY_WIDTH, TONE_DISPLAY_HEIGHT);
+    
+    // Tuner (between the knobs and the footswitch)
+    tunerDisplay.setBounds(TUNER_DISPLAY_X, TUNER_DISPLAY_Y, TUNER_DISPLAY_WIDTH, TUNER_DISPLAY_HEIGHT);
 }
\ No newline at end of file
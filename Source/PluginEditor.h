@@ -3,7 +3,8 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_gui_basics/juce_gui_basics.h>
 #include "PluginProcessor.h"
-#include "BinaryData.h"
+#include "HarmonsterAssets.h"
+#include "ToneAnalyser.h"
 
 //==============================================================================
 // Layout Constants for HARMONSTER Stomp Box Design
@@ -34,6 +35,42 @@ namespace HarmonsterLayout
     static constexpr int FOOTSWITCH_HEIGHT = 70;
     static constexpr int FOOTSWITCH_X = (PLUGIN_WIDTH - FOOTSWITCH_WIDTH) / 2;  // Center horizontally
     static constexpr int FOOTSWITCH_Y = PLUGIN_HEIGHT - 155;  // Aligned with background power button
+    
+    // Cabinet IR loader (bottom right corner of the enclosure)
+    static constexpr int CAB_BUTTON_WIDTH = 44;
+    static constexpr int CAB_BUTTON_HEIGHT = 20;
+    static constexpr int CAB_BUTTON_X = 270;
+    static constexpr int CAB_BUTTON_Y = 470;
+    
+    // Flight recorder menu, left of the cabinet loader
+    static constexpr int RECORDER_BUTTON_X = 220;
+    
+    // CPU governor switch and quality indicator, left of the flight recorder
+    static constexpr int GOVERNOR_BUTTON_X = 170;
+    
+    // Harmonizer menu, left of the CPU governor
+    static constexpr int HARMONY_BUTTON_X = 120;
+    
+    // User preset browser, left of the harmonizer
+    static constexpr int PRESET_BUTTON_X = 70;
+    static constexpr int PRESET_BROWSER_WIDTH = 240;
+    static constexpr int PRESET_BROWSER_HEIGHT = 300;
+    
+    // Dual circuit menu, left of the preset browser
+    static constexpr int DUAL_BUTTON_X = 20;
+    
+    // Tone displays either side of the footswitch
+    static constexpr int TONE_DISPLAY_WIDTH = 90;
+    static constexpr int TONE_DISPLAY_HEIGHT = 60;
+    static constexpr int TONE_DISPLAY_Y = 400;
+    static constexpr int TRANSFER_DISPLAY_X = 40;
+    static constexpr int HARMONICS_DISPLAY_X = 230;
+    
+    // Tuner, between the knobs and the footswitch while the effect is bypassed
+    static constexpr int TUNER_DISPLAY_WIDTH = 160;
+    static constexpr int TUNER_DISPLAY_HEIGHT = 70;
+    static constexpr int TUNER_DISPLAY_X = (PLUGIN_WIDTH - TUNER_DISPLAY_WIDTH) / 2;
+    static constexpr int TUNER_DISPLAY_Y = 220;
 }
 
 //==============================================================================
@@ -51,6 +88,82 @@ public:
                      int buttonX, int buttonY, int buttonW, int buttonH, juce::ComboBox& box) override;
                      
     void drawToggleButton(juce::Graphics& g, juce::ToggleButton& button, bool shouldDrawButtonAsHighlighted, bool shouldDrawButtonAsDown) override;
+
+private:
+    juce::SharedResourcePointer<HarmonsterAssets> assets;
+};
+
+//==============================================================================
+// Transfer curve or harmonic spectrum published by the ToneAnalyser
+//==============================================================================
+class ToneDisplay : public juce::Component
+{
+public:
+    enum class Mode { transferCurve, harmonics };
+
+    explicit ToneDisplay(Mode displayMode) : mode(displayMode) {}
+
+    void setResult(const ToneAnalyser::Result& newResult);
+    void paint(juce::Graphics& g) override;
+
+private:
+    Mode mode;
+    ToneAnalyser::Result result;
+    bool hasResult = false;
+};
+
+//==============================================================================
+// Note and cents needle of the built-in tuner; a click opens the tuner menu
+//==============================================================================
+class TunerDisplay : public juce::Component
+{
+public:
+    void setReading(const Tuner::Reading& newReading);
+    void setMode(int newMode);
+    void paint(juce::Graphics& g) override;
+    void mouseUp(const juce::MouseEvent& event) override;
+    
+    std::function<void()> onClick;
+
+private:
+    Tuner::Reading reading;
+    int mode = Tuner::onBypass;
+};
+
+//==============================================================================
+// Search, load and save for the user preset bank, shown in a call-out box.
+// Only the rows on screen are read from the bank.
+//==============================================================================
+class PresetBrowser : public juce::Component,
+                      private juce::ListBoxModel
+{
+public:
+    explicit PresetBrowser(WoolyMammothAudioProcessor& processor);
+
+    void resized() override;
+
+private:
+    int getNumRows() override;
+    void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
+    void listBoxItemDoubleClicked(int row, const juce::MouseEvent&) override;
+    void returnKeyPressed(int lastRowSelected) override;
+    void selectedRowsChanged(int lastRowSelected) override;
+
+    void updateResults();
+    void loadRow(int row);
+    void savePreset();
+
+    WoolyMammothAudioProcessor& audioProcessor;
+    std::vector<int> results;  // bank indices matching the search, in name order
+
+    juce::TextEditor searchBox;
+    juce::ListBox resultList { {}, this };
+    juce::Label statusLabel;
+    juce::TextEditor nameBox;
+    juce::TextEditor tagsBox;
+    juce::TextButton saveButton { "Save" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PresetBrowser)
 };
 
 //==============================================================================
@@ -58,7 +171,8 @@ public:
 //==============================================================================
 class WoolyMammothAudioProcessorEditor : public juce::AudioProcessorEditor,
                                         private juce::Slider::Listener,
-                                        private juce::ComboBox::Listener
+                                        private juce::ComboBox::Listener,
+                                        private juce::Timer
 {
 public:
     WoolyMammothAudioProcessorEditor (WoolyMammothAudioProcessor&);
@@ -70,6 +184,7 @@ public:
 private:
     void sliderValueChanged (juce::Slider* slider) override;
     void comboBoxChanged (juce::ComboBox* comboBoxThatHasChanged) override;
+    void timerCallback() override;
     
     // UI Components
     // Title label removed - included in new background image
@@ -81,15 +196,66 @@ private:
     
     juce::ToggleButton footswitchButton;
     
+    juce::TextButton cabinetButton { "CAB" };
+    std::unique_ptr<juce::FileChooser> cabinetChooser;
+    
+    void chooseCabinetImpulseResponse();
+    void updateCabinetTooltip();
+    
+    juce::TextButton recorderButton { "REC" };
+    int lastRecorderDumps = -1;
+    
+    void showRecorderMenu();
+    void updateRecorderButton();
+    
+    // Reads "ECO" while the CPU governor has reduced quality
+    juce::TextButton governorButton { "CPU" };
+    int lastQualityTier = -1;
+    
+    void updateGovernorButton();
+    
+    // Harmonizer voicing, interval, mix, placement and engine
+    juce::TextButton harmonyButton { "HARM" };
+    
+    void showHarmonyMenu();
+    void updateHarmonyButton();
+    
+    // User preset bank; the browser is only built when opened
+    juce::TextButton presetButton { "BANK" };
+    
+    void showPresetBrowser();
+    
+    // Dual circuit switch, blend and spread; the knobs edit one circuit at a time
+    juce::TextButton dualButton { "DUAL" };
+    bool editingSecondCircuit = false;
+    
+    void showDualMenu();
+    void updateDualButton();
+    void attachKnobs();
+    
+    // Knob-driven tone preview, analysed off the audio path
+    ToneAnalyser toneAnalyser;
+    ToneAnalyser::Result toneResult;
+    ToneDisplay transferDisplay { ToneDisplay::Mode::transferCurve };
+    ToneDisplay harmonicsDisplay { ToneDisplay::Mode::harmonics };
+    
+    // Built-in tuner, shown while the footswitch has the effect bypassed
+    TunerDisplay tunerDisplay;
+    Tuner::Reading tunerReading;
+    
+    void showTunerMenu();
+    
     // Parameter attachments
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> eqAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> snarlAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> pinchAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> outputAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> footswitchAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> governorAttachment;
 
     WoolyMammothAudioProcessor& audioProcessor;
     WoolyLookAndFeel woolyLF;
+    juce::SharedResourcePointer<HarmonsterAssets> assets;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WoolyMammothAudioProcessorEditor)
 };
\ No newline at end of file
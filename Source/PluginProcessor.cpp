@@ -15,35 +15,157 @@ WoolyMammothAudioProcessor::WoolyMammothAudioProcessor()
 #endif
     parameters (*this, nullptr, juce::Identifier ("WoolyMammoth"),
     {
-        std::make_unique<juce::AudioParameterFloat> ("wool", "Wool", 0.0f, 1.0f, 0.5f),
-        std::make_unique<juce::AudioParameterFloat> ("pinch", "Pinch", 0.0f, 1.0f, 0.3f),
-        std::make_unique<juce::AudioParameterFloat> ("eq", "EQ", 0.0f, 1.0f, 0.5f),
-        std::make_unique<juce::AudioParameterFloat> ("output", "Output", 0.0f, 1.0f, 0.5f),
-        std::make_unique<juce::AudioParameterBool> ("bypass", "Bypass", false)
-    })
+        // Knob defaults are the first factory preset, so a new instance starts
+        // there without pushing parameter changes to the host from the constructor
+        std::make_unique<juce::AudioParameterFloat> ("wool", "Wool", 0.0f, 1.0f, static_cast<float> (WoolyMammothPresets::defaultPreset.wool)),
+        std::make_unique<juce::AudioParameterFloat> ("pinch", "Pinch", 0.0f, 1.0f, static_cast<float> (WoolyMammothPresets::defaultPreset.pinch)),
+        std::make_unique<juce::AudioParameterFloat> ("eq", "EQ", 0.0f, 1.0f, static_cast<float> (WoolyMammothPresets::defaultPreset.eq)),
+        std::make_unique<juce::AudioParameterFloat> ("output", "Output", 0.0f, 1.0f, static_cast<float> (WoolyMammothPresets::defaultPreset.output)),
+        std::make_unique<juce::AudioParameterBool> ("bypass", "Bypass", false),
+        std::make_unique<juce::AudioParameterBool> ("sag", "Battery Sag", true),
+        std::make_unique<juce::AudioParameterBool> ("texture", "Fuzz Texture", true),
+        std::make_unique<juce::AudioParameterChoice> ("eqmodel", "EQ Model",
+                                                      juce::StringArray { "Classic", "Passive RC" }, 0),
+        std::make_unique<juce::AudioParameterBool> ("cab", "Cabinet", false),
+        std::make_unique<juce::AudioParameterChoice> ("oversampling", "Oversampling",
+                                                      juce::StringArray { "1x", "2x", "4x", "8x", "Adaptive" }, 0),
+        std::make_unique<juce::AudioParameterChoice> ("rate", "Processing Rate",
+                                                      juce::StringArray { "Host", "96 kHz" }, 0),
+        std::make_unique<juce::AudioParameterBool> ("governor", "CPU Governor", true),
+        std::make_unique<juce::AudioParameterChoice> ("harmony", "Harmony",
+                                                      juce::StringArray { "Off", "Octave Down", "Octave Up", "Octaves", "Interval" }, 0),
+        std::make_unique<juce::AudioParameterInt> ("interval", "Harmony Interval", -12, 12, 7),
+        std::make_unique<juce::AudioParameterFloat> ("harmonymix", "Harmony Mix", 0.0f, 1.0f, 0.5f),
+        std::make_unique<juce::AudioParameterChoice> ("harmonyplace", "Harmony Placement",
+                                                      juce::StringArray { "After Fuzz", "Before Fuzz" }, 0),
+        std::make_unique<juce::AudioParameterChoice> ("harmonyengine", "Harmony Engine",
+                                                      juce::StringArray { "Low Latency", "Phase Vocoder" }, 0),
+        // Circuit B of the dual mode starts on the Smooth Fuzz preset, the usual partner for a gated circuit A
+        std::make_unique<juce::AudioParameterBool> ("dual", "Dual Circuit", false),
+        std::make_unique<juce::AudioParameterFloat> ("woolb", "Wool B", 0.0f, 1.0f, static_cast<float> (WoolyMammothPresets::factoryPresets[4].wool)),
+        std::make_unique<juce::AudioParameterFloat> ("pinchb", "Pinch B", 0.0f, 1.0f, static_cast<float> (WoolyMammothPresets::factoryPresets[4].pinch)),
+        std::make_unique<juce::AudioParameterFloat> ("eqb", "EQ B", 0.0f, 1.0f, static_cast<float> (WoolyMammothPresets::factoryPresets[4].eq)),
+        std::make_unique<juce::AudioParameterFloat> ("outputb", "Output B", 0.0f, 1.0f, static_cast<float> (WoolyMammothPresets::factoryPresets[4].output)),
+        std::make_unique<juce::AudioParameterFloat> ("blend", "Circuit Blend", 0.0f, 1.0f, 0.5f),
+        std::make_unique<juce::AudioParameterFloat> ("spread", "Dual Spread", 0.0f, 1.0f, 0.0f),
+        std::make_unique<juce::AudioParameterChoice> ("tuner", "Tuner",
+                                                      juce::StringArray { "Off", "On Bypass", "Muted On Bypass" }, Tuner::onBypass)
+    }),
+    cabinet (juce::dsp::Convolution::NonUniform { cabinetHeadSize }, *convolutionQueue)
 {
     woolParam = parameters.getRawParameterValue ("wool");
     pinchParam = parameters.getRawParameterValue ("pinch");
     eqParam = parameters.getRawParameterValue ("eq");
     outputParam = parameters.getRawParameterValue ("output");
     bypassParam = parameters.getRawParameterValue ("bypass");
-    
-    // Initialize factory presets
-    initializeFactoryPresets();
+    sagParam = parameters.getRawParameterValue ("sag");
+    textureParam = parameters.getRawParameterValue ("texture");
+    eqModelParam = parameters.getRawParameterValue ("eqmodel");
+    cabParam = parameters.getRawParameterValue ("cab");
+    oversamplingParam = parameters.getRawParameterValue ("oversampling");
+    rateParam = parameters.getRawParameterValue ("rate");
+    governorParam = parameters.getRawParameterValue ("governor");
+    harmonyParam = parameters.getRawParameterValue ("harmony");
+    intervalParam = parameters.getRawParameterValue ("interval");
+    harmonyMixParam = parameters.getRawParameterValue ("harmonymix");
+    harmonyPlaceParam = parameters.getRawParameterValue ("harmonyplace");
+    harmonyEngineParam = parameters.getRawParameterValue ("harmonyengine");
+    dualParam = parameters.getRawParameterValue ("dual");
+    woolBParam = parameters.getRawParameterValue ("woolb");
+    pinchBParam = parameters.getRawParameterValue ("pinchb");
+    eqBParam = parameters.getRawParameterValue ("eqb");
+    outputBParam = parameters.getRawParameterValue ("outputb");
+    blendParam = parameters.getRawParameterValue ("blend");
+    spreadParam = parameters.getRawParameterValue ("spread");
+    tunerParam = parameters.getRawParameterValue ("tuner");
+
+    automatedParameters = { woolParam, pinchParam, eqParam, outputParam, woolBParam, pinchBParam, eqBParam, outputBParam,
+                            blendParam, spreadParam };
+
+    for (size_t i = 0; i < presetParameters.size(); ++i)
+    {
+        const auto id = UserPresetBank::parameterIds[i];
+        presetParameters[i] = parameters.getRawParameterValue (juce::String (id.data(), id.size()));
+        jassert (presetParameters[i] != nullptr);
+    }
+
+    startTimerHz (10);
 }
 
 WoolyMammothAudioProcessor::~WoolyMammothAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
 void WoolyMammothAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    for (auto& dsp : mammothDSP)
+    for (auto& channel : mammothChannels)
+        channel.prepare (sampleRate, samplesPerBlock);
+
+    for (auto& channel : fixedRateChannels)
+        channel.prepare (sampleRate, samplesPerBlock);
+
+    fixedRateActive = rateParam->load() > 0.5f && fixedRateChannels[0].isActive();
+
+    for (auto& harmonizer : harmonizers)
     {
-        dsp.setSampleRate (sampleRate);
-        dsp.reset();
+        harmonizer.setParameters (static_cast<int> (harmonyParam->load()), static_cast<int> (intervalParam->load()),
+                                  harmonyMixParam->load(), static_cast<Harmonizer::Engine> (static_cast<int> (harmonyEngineParam->load())));
+        harmonizer.prepare (sampleRate, samplesPerBlock);
     }
+
+    harmonizerLatency = harmonizers[0].getLatencyInSamples();
+
+    juce::StringArray parameterIds;
+    for (auto* parameter : getParameters())
+        if (auto* withId = dynamic_cast<juce::AudioProcessorParameterWithID*> (parameter))
+            parameterIds.add (withId->paramID);
+
+    flightRecorder.prepare (sampleRate, samplesPerBlock, getTotalNumInputChannels(), getTotalNumOutputChannels(), parameterIds);
+    tuner.prepare (sampleRate);
+
+    automation.setStep (automationStepOverride > 0 ? automationStepOverride
+                                                   : juce::jmax (1, juce::roundToInt (sampleRate * automationStepSeconds)));
+
+    std::array<float, numAutomatedParameters> automatedValues;
+    for (size_t i = 0; i < automatedParameters.size(); ++i)
+        automatedValues[i] = automatedParameters[i]->load();
+
+    automation.reset (automatedValues);
+
+    // Freshly reset channels are in step, so a mono input can collapse at once
+    channelsInStep = true;
+    monoCollapsed = false;
+
+    oversamplingPolicy.prepare (sampleRate, MammothChannel::maxStages);
+    governor.prepare (sampleRate, 1);
+    applyOversamplingMode (static_cast<int> (oversamplingParam->load()));
+    applyQualityTier (0);
+
+    oversampledSampleCount = processedSampleCount = 0.0;
+    averageOversampling = 1.0f;
+    peakOversampling = 1.0f;
+    cpuLoad = 0.0f;
+
+    // Re-preparing keeps the loaded IR and resamples it to the new rate in the background
+    cabinet.prepare ({ sampleRate, static_cast<juce::uint32> (samplesPerBlock),
+                       static_cast<juce::uint32> (juce::jmax (1, getTotalNumOutputChannels())) });
+    cabinetWasActive = false;
+
+    // Hosts read the latency once prepareToPlay() returns, so it is set here directly
+    setLatencySamples (pendingLatency.load());
+}
+
+double WoolyMammothAudioProcessor::getTailLengthSeconds() const
+{
+    // The cabinet rings out for the length of its impulse response
+    const int irSize = cabinetIRSize.load();
+
+    if (cabParam->load() > 0.5f && irSize > 0 && getSampleRate() > 0.0)
+        return static_cast<double> (irSize) / getSampleRate();
+
+    return 0.0;
 }
 
 void WoolyMammothAudioProcessor::releaseResources()
@@ -55,6 +177,49 @@ void WoolyMammothAudioProcessor::releaseResources()
 void WoolyMammothAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+
+    // Flight recorder: input and parameters before the block, output, timing
+    // and circuit state after it
+    const bool recording = flightRecorder.beginBlock (buffer, getParameters());
+
+    // Offline the governor is off, and full quality applies from the first block
+    governor.setEnabled (governorParam->load() > 0.5f && ! isNonRealtime());
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    processAudio (buffer);
+
+    const double processSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+
+    // The tier chosen from this block's load applies from the next block on
+    governor.update (processSeconds, buffer.getNumSamples());
+    cpuLoad.store (static_cast<float> (governor.getLoad()), std::memory_order_relaxed);
+
+    if (recording)
+    {
+        FlightRecorder::BlockState state;
+        state.processSeconds = processSeconds;
+        state.qualityTier = qualityTier;
+
+        if (fixedRateActive)
+        {
+            state.supplyVoltage = fixedRateChannels[0].getSupplyVoltage();
+            state.gateActivity = fixedRateChannels[0].getGateActivity();
+            state.oversamplingFactor = 1 << fixedRateChannels[0].getActiveStages();
+        }
+        else
+        {
+            state.supplyVoltage = mammothChannels[0].getSupplyVoltage();
+            state.gateActivity = mammothChannels[0].getGateActivity();
+            state.oversamplingFactor = 1 << mammothChannels[0].getActiveStages();
+        }
+
+        flightRecorder.endBlock (buffer, state);
+    }
+}
+
+void WoolyMammothAudioProcessor::processAudio (juce::AudioBuffer<float>& buffer)
+{
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -62,35 +227,352 @@ void WoolyMammothAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
+    latchPresetValues();
+
     // Check if bypassed
     bool isBypassed = bypassParam->load() > 0.5f;
     
     if (isBypassed)
     {
-        // Bypass - pass audio through unchanged
+        // Bypass - pass audio through unchanged, or muted while tuning. The
+        // tuner only gets a copy of the left input here; the pitch detection
+        // runs on its own thread.
+        const int tunerMode = static_cast<int> (tunerParam->load());
+
+        if (tunerMode != Tuner::off && totalNumInputChannels > 0)
+        {
+            tuner.push (buffer.getReadPointer (0), buffer.getNumSamples());
+
+            if (tunerMode == Tuner::mutedOnBypass)
+                buffer.clear();
+        }
+
         return;
     }
 
-    // Update DSP parameters
-    for (auto& dsp : mammothDSP)
-    {
-        dsp.setWool (woolParam->load());
-        dsp.setPinch (pinchParam->load());
-        dsp.setEQ (eqParam->load());
-        dsp.setOutput (outputParam->load());
-    }
+    // A mode change comes first: the quality tiers are counted from the selected factor
+    const int mode = static_cast<int> (oversamplingParam->load());
+
+    if (mode != lastOversamplingMode)
+        applyOversamplingMode (mode);
+
+    applyQualityTier (pinnedQualityTier >= 0 ? pinnedQualityTier : governor.getTier());
+
+    // Switched-off circuit features are compiled out of the kernel the DSP dispatches to
+    const unsigned features = circuitFeatures (blockValue (sagParam), blockValue (textureParam), blockValue (eqModelParam));
+
+    // Knob automation: JUCE's wrappers hand over only the value a parameter
+    // has by the end of the block, so that is its one point. It is ramped to
+    // across the block while the knob keeps moving block after block, and
+    // reached within one step when it jumps after holding still. The knobs
+    // reach the circuit per sub-block, in processChannel(). A parameter that
+    // holds still gets a point at the value it already has, which doesn't ramp.
+    const int numSamples = buffer.getNumSamples();
+
+    for (size_t i = 0; i < automatedParameters.size(); ++i)
+        automation.addBlockEndValue (i, numSamples, blockValue (automatedParameters[i]));
+
+    // Dual circuit: B runs beside A in the same DSP; spread pans A left and B right
+    const bool dual = blockValue (dualParam) > 0.5f;
+    const bool spreadActive = dual && (automation.getValue (automatedSpread) > 0.0f || blockValue (spreadParam) > 0.0f);
 
-    // Process audio
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+    // Host rate or fixed internal rate; the path switched to starts from a clean circuit
+    const bool useFixedRate = rateParam->load() > 0.5f && fixedRateChannels[0].isActive();
+
+    if (useFixedRate != fixedRateActive)
     {
-        auto* channelData = buffer.getWritePointer (channel);
-        auto& channelDSP = mammothDSP[channel];
+        fixedRateActive = useFixedRate;
 
-        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+        for (int channel = 0; channel < 2; ++channel)
         {
-            channelData[sample] = static_cast<float>(channelDSP.process(channelData[sample]));
+            if (fixedRateActive)
+                fixedRateChannels[channel].reset();
+            else
+                mammothChannels[channel].reset();
         }
+
+        // The harmonizers carry on, so the two sides have to show they agree again
+        channelsInStep = false;
+        monoCollapsed = false;
+        updateLatency();
+    }
+
+    // Harmonizer voices; switching it on or off, or changing engine, moves the reported latency
+    const auto harmonyEngine = static_cast<Harmonizer::Engine> (static_cast<int> (blockValue (harmonyEngineParam)));
+
+    for (auto& harmonizer : harmonizers)
+        harmonizer.setParameters (static_cast<int> (blockValue (harmonyParam)), static_cast<int> (blockValue (intervalParam)),
+                                  blockValue (harmonyMixParam), harmonyEngine);
+
+    harmonizerBeforeFuzz = blockValue (harmonyPlaceParam) > 0.5f;
+
+    if (harmonizers[0].getLatencyInSamples() != harmonizerLatency)
+    {
+        harmonizerLatency = harmonizers[0].getLatencyInSamples();
+        updateLatency();
+    }
+
+    // Mono input on a stereo output is fed to both sides and runs as a mono
+    // DI on a stereo track, so a spread dual circuit can still tell them apart
+    if (totalNumInputChannels == 1 && totalNumOutputChannels > 1)
+        buffer.copyFrom (1, 0, buffer, 0, 0, numSamples);
+
+    const int numChannels = juce::jmin (juce::jmax (totalNumInputChannels, totalNumOutputChannels), 2);
+    const int stages = chooseOversamplingStages (buffer, numChannels);
+
+    // Mono DI on a stereo track: identical inputs give identical outputs, so run the circuit once
+    // (unless the dual circuit is spread, which gives the two sides different mixes)
+    const bool channelsIdentical = numChannels == 2 && ! spreadActive
+        && std::memcmp (buffer.getReadPointer (0), buffer.getReadPointer (1), sizeof (float) * static_cast<size_t> (numSamples)) == 0;
+
+    if (channelsIdentical && channelsInStep)
+        monoCollapsed = true;
+
+    const bool runCollapsed = monoCollapsed && channelsIdentical;
+
+    if (! runCollapsed && monoCollapsed)
+    {
+        // Inputs diverged: the right channel resumes from the shared state
+        if (fixedRateActive)
+            fixedRateChannels[1].copyStateFrom (fixedRateChannels[0]);
+        else
+            mammothChannels[1].copyStateFrom (mammothChannels[0]);
+
+        harmonizers[1].copyStateFrom (harmonizers[0]);
+
+        monoCollapsed = false;
     }
+
+    // Sub-blocks end where the automation needs them to; a block whose knobs
+    // hold still runs whole
+    automation.beginBlock (numSamples);
+    int start = 0, length = 0;
+
+    while (automation.nextSegment (start, length))
+        for (int channel = 0; channel < (runCollapsed ? 1 : numChannels); ++channel)
+            processChannel (channel, buffer.getWritePointer (channel) + start, length, stages, features, dual);
+
+    if (runCollapsed)
+        buffer.copyFrom (1, 0, buffer, 0, 0, numSamples);
+    else
+        channelsInStep = channelsIdentical
+            && std::memcmp (buffer.getReadPointer (0), buffer.getReadPointer (1), sizeof (float) * static_cast<size_t> (numSamples)) == 0;
+
+    // Instrumentation: average and peak oversampling factor actually used
+    const int factor = 1 << (fixedRateActive ? fixedRateChannels[0].getActiveStages() : mammothChannels[0].getActiveStages());
+    oversampledSampleCount += static_cast<double> (factor) * numSamples;
+    processedSampleCount += numSamples;
+    averageOversampling.store (static_cast<float> (oversampledSampleCount / processedSampleCount), std::memory_order_relaxed);
+    peakOversampling.store (juce::jmax (peakOversampling.load (std::memory_order_relaxed), static_cast<float> (factor)), std::memory_order_relaxed);
+
+    // Cabinet simulation after the fuzz. A queued IR keeps the convolution
+    // running until it has an IR installed, since it swaps one in from inside
+    // process(); a reload over an existing IR has one installed already.
+    if (cabinetLoadQueued.exchange (false))
+        cabinetInstalling = true;
+
+    const bool cabinetActive = cabParam->load() > 0.5f && (cabinetInstalling || cabinetIRSize.load (std::memory_order_relaxed) > 0);
+
+    if (cabinetActive)
+    {
+        // Don't let stale tail from the last time the cab was on bleed back in
+        if (! cabinetWasActive)
+            cabinet.reset();
+
+        auto block = juce::dsp::AudioBlock<float> (buffer).getSubsetChannelBlock (0, static_cast<size_t> (numChannels));
+        cabinet.process (juce::dsp::ProcessContextReplacing<float> (block));
+
+        // Also follows the IR being swapped or resampled after a sample rate change
+        const int irSize = cabinet.getCurrentIRSize();
+        cabinetIRSize.store (irSize, std::memory_order_relaxed);
+
+        if (irSize > 0)
+            cabinetInstalling = false;
+    }
+
+    cabinetWasActive = cabinetActive;
+}
+
+void WoolyMammothAudioProcessor::processChannel (int channel, float* samples, int numSamples, int stages, unsigned features, bool dual)
+{
+    // Knobs at this sub-block's point on the automation. Circuit B is mixed
+    // in against A by blend; spread takes A out of the right channel and B
+    // out of the left.
+    const double blend = automation.getValue (automatedBlend);
+    const double spread = dual ? automation.getValue (automatedSpread) : 0.0;
+    const double mixA = (1.0 - blend) * (channel == 1 ? 1.0 - spread : 1.0);
+    const double mixB = blend * (channel == 0 ? 1.0 - spread : 1.0);
+
+    auto setKnobs = [&] (auto& circuit)
+    {
+        circuit.setParameters (automation.getValue (automatedWool), automation.getValue (automatedPinch),
+                               automation.getValue (automatedEq), automation.getValue (automatedOutput), features);
+        circuit.setSecondCircuit (dual, automation.getValue (automatedWoolB), automation.getValue (automatedPinchB),
+                                  automation.getValue (automatedEqB), automation.getValue (automatedOutputB), mixA, mixB);
+    };
+
+    if (fixedRateActive)
+        setKnobs (fixedRateChannels[channel]);
+    else
+        setKnobs (mammothChannels[channel]);
+
+    // Before the fuzz the voices are distorted together with the dry note
+    if (harmonizerBeforeFuzz)
+        harmonizers[channel].process (samples, numSamples);
+
+    if (fixedRateActive)
+        fixedRateChannels[channel].process (samples, numSamples, stages);
+    else
+        mammothChannels[channel].process (samples, numSamples, stages);
+
+    if (! harmonizerBeforeFuzz)
+        harmonizers[channel].process (samples, numSamples);
+}
+
+unsigned WoolyMammothAudioProcessor::getCircuitFeatures() const
+{
+    return circuitFeatures (sagParam->load(), textureParam->load(), eqModelParam->load());
+}
+
+unsigned WoolyMammothAudioProcessor::circuitFeatures (float sag, float texture, float eqModel)
+{
+    unsigned features = WoolyMammothDSP::allFeatures;
+    if (sag < 0.5f)
+        features &= ~static_cast<unsigned> (WoolyMammothDSP::supplySag);
+    if (texture < 0.5f)
+        features &= ~WoolyMammothDSP::textureFeatures;
+    if (eqModel < 0.5f)
+        features &= ~static_cast<unsigned> (WoolyMammothDSP::passiveEq);
+
+    return features;
+}
+
+void WoolyMammothAudioProcessor::applyOversamplingMode (int mode)
+{
+    // Every factor the governor or the adaptive policy may drop to is padded to
+    // the selected one's latency (8x for adaptive), so switching never shifts timing
+    lastOversamplingMode = mode;
+    const int userStages = getUserOversamplingStages();
+
+    for (auto& channel : mammothChannels)
+        channel.setLatencyAlignment (userStages);
+
+    // One tier per factor below the selected one
+    governor.setNumTiers (userStages + 1);
+    numQualityTiers.store (governor.getNumTiers(), std::memory_order_relaxed);
+
+    oversamplingPolicy.reset();
+    updateLatency();
+}
+
+int WoolyMammothAudioProcessor::getUserOversamplingStages() const
+{
+    if (lastOversamplingMode == adaptiveOversamplingMode)
+        return MammothChannel::maxStages;
+
+    return juce::jlimit (0, MammothChannel::maxStages, lastOversamplingMode);
+}
+
+void WoolyMammothAudioProcessor::applyQualityTier (int tier)
+{
+    qualityTier = juce::jlimit (0, governor.getNumTiers() - 1, tier);
+    reportedQualityTier.store (qualityTier, std::memory_order_relaxed);
+}
+
+void WoolyMammothAudioProcessor::updateLatency()
+{
+    // The fixed-rate path always pads to the 8x latency, so its figure never changes
+    const int circuitLatency = fixedRateActive ? fixedRateChannels[0].getLatencyInSamples()
+                                               : mammothChannels[0].getLatencyInSamples (getUserOversamplingStages());
+
+    // Called from the audio thread too; timerCallback() passes it on to the host
+    pendingLatency.store (circuitLatency + harmonizerLatency);
+}
+
+void WoolyMammothAudioProcessor::timerCallback()
+{
+    // No-op while the latency is unchanged
+    setLatencySamples (pendingLatency.load());
+
+    // The tuner's detector thread only runs while the footswitch has it listening
+    tuner.setEnabled (bypassParam->load() > 0.5f && static_cast<int> (tunerParam->load()) != Tuner::off);
+}
+
+double WoolyMammothAudioProcessor::getHarmonizerLatencyMs (int engine) const
+{
+    const double sampleRate = getSampleRate() > 0.0 ? getSampleRate() : 48000.0;
+    return 1000.0 * Harmonizer::getLatencyInSamples (sampleRate, static_cast<Harmonizer::Engine> (engine)) / sampleRate;
+}
+
+int WoolyMammothAudioProcessor::chooseOversamplingStages (const juce::AudioBuffer<float>& buffer, int numChannels)
+{
+    // Each governor tier up to the selected factor takes one 2x stage away
+    const int userStages = getUserOversamplingStages();
+    const int stageLimit = userStages - juce::jmin (qualityTier, userStages);
+
+    if (lastOversamplingMode != adaptiveOversamplingMode)
+        return stageLimit;
+
+    float inputPeak = 0.0f;
+    for (int channel = 0; channel < numChannels; ++channel)
+        inputPeak = juce::jmax (inputPeak, buffer.getMagnitude (channel, 0, buffer.getNumSamples()));
+
+    // Same mapping as WoolyMammothDSP::setOutput()
+    const double outputGain = 0.2 + blockValue (outputParam) * 3.0;
+
+    const double gateActivity = fixedRateActive ? fixedRateChannels[0].getGateActivity() : mammothChannels[0].getGateActivity();
+    return juce::jmin (stageLimit, oversamplingPolicy.update (inputPeak, outputGain, gateActivity, buffer.getNumSamples()));
+}
+
+WoolyMammothAudioProcessor::ProcessingStats WoolyMammothAudioProcessor::getProcessingStats() const
+{
+    ProcessingStats stats;
+    stats.averageOversampling = averageOversampling.load (std::memory_order_relaxed);
+    stats.peakOversampling = peakOversampling.load (std::memory_order_relaxed);
+    stats.cpuLoad = cpuLoad.load (std::memory_order_relaxed);
+    stats.qualityTier = reportedQualityTier.load (std::memory_order_relaxed);
+    stats.numQualityTiers = numQualityTiers.load (std::memory_order_relaxed);
+    return stats;
+}
+
+juce::String WoolyMammothAudioProcessor::describeQualityTier (int tier) const
+{
+    const int userStages = juce::jmin (numQualityTiers.load (std::memory_order_relaxed) - 1, MammothChannel::maxStages);
+
+    if (tier <= 0)
+        return "Full quality";
+
+    return juce::String (1 << (userStages - juce::jmin (tier, userStages))) + "x oversampling";
+}
+
+//==============================================================================
+// Cabinet impulse response loading
+void WoolyMammothAudioProcessor::loadCabinetImpulseResponse (const juce::File& file)
+{
+    if (! file.existsAsFile())
+        return;
+
+    {
+        const juce::ScopedLock sl (cabinetFileLock);
+        cabinetFile = file;
+    }
+
+    flightRecorder.setCabinetFile (file);
+
+    // Queued to the shared loader thread; the audio thread picks the new IR up when it's ready
+    cabinet.loadImpulseResponse (file, juce::dsp::Convolution::Stereo::no,
+                                 juce::dsp::Convolution::Trim::yes, 0,
+                                 juce::dsp::Convolution::Normalise::yes);
+    cabinetLoadQueued = true;
+
+    if (auto* cabParamObj = parameters.getParameter ("cab"))
+        cabParamObj->setValueNotifyingHost (1.0f);
+}
+
+juce::File WoolyMammothAudioProcessor::getCabinetImpulseResponseFile() const
+{
+    const juce::ScopedLock sl (cabinetFileLock);
+    return cabinetFile;
 }
 
 //==============================================================================
@@ -103,7 +585,7 @@ juce::AudioProcessorEditor* WoolyMammothAudioProcessor::createEditor()
 // Preset/Program management implementation
 int WoolyMammothAudioProcessor::getNumPrograms()
 {
-    return static_cast<int>(factoryPresets.size());
+    return WoolyMammothPresets::numFactoryPresets;
 }
 
 int WoolyMammothAudioProcessor::getCurrentProgram()
@@ -113,7 +595,7 @@ int WoolyMammothAudioProcessor::getCurrentProgram()
 
 void WoolyMammothAudioProcessor::setCurrentProgram(int index)
 {
-    if (index >= 0 && index < static_cast<int>(factoryPresets.size()))
+    if (index >= 0 && index < WoolyMammothPresets::numFactoryPresets)
     {
         currentPresetIndex = index;
         loadPreset(index);
@@ -122,15 +604,18 @@ void WoolyMammothAudioProcessor::setCurrentProgram(int index)
 
 const juce::String WoolyMammothAudioProcessor::getProgramName(int index)
 {
-    if (index >= 0 && index < static_cast<int>(factoryPresets.size()))
-        return factoryPresets[index].name;
+    if (index >= 0 && index < WoolyMammothPresets::numFactoryPresets)
+    {
+        const auto name = WoolyMammothPresets::factoryPresets[static_cast<size_t>(index)].name;
+        return juce::String(name.data(), name.size());
+    }
     return "Unknown";
 }
 
 void WoolyMammothAudioProcessor::changeProgramName(int index, const juce::String& newName)
 {
-    // For factory presets, we don't allow name changes
-    // This could be extended to support user presets in the future
+    // Host programs are the factory presets, which keep their names; user
+    // presets are named when saved to the user bank (saveUserPreset)
     (void)index;
     (void)newName;
 }
@@ -143,6 +628,12 @@ void WoolyMammothAudioProcessor::getStateInformation (juce::MemoryBlock& destDat
     // Add current preset index to the state
     state.setProperty("currentPreset", currentPresetIndex, nullptr);
     
+    // Remember which cabinet IR is loaded
+    state.setProperty("cabinetIR", getCabinetImpulseResponseFile().getFullPathName(), nullptr);
+    
+    // The flight recorder stays armed across sessions once switched on
+    state.setProperty("flightRecorder", flightRecorder.isEnabled(), nullptr);
+    
     std::unique_ptr<juce::XmlElement> xml (state.createXml());
     copyXmlToBinary (*xml, destData);
 }
@@ -161,7 +652,20 @@ void WoolyMammothAudioProcessor::setStateInformation (const void* data, int size
             if (newState.hasProperty("currentPreset"))
             {
                 currentPresetIndex = newState.getProperty("currentPreset", 0);
-                currentPresetIndex = juce::jlimit(0, static_cast<int>(factoryPresets.size()) - 1, currentPresetIndex);
+                currentPresetIndex = juce::jlimit(0, WoolyMammothPresets::numFactoryPresets - 1, currentPresetIndex);
+            }
+            
+            flightRecorder.setEnabled(newState.getProperty("flightRecorder", false));
+            
+            // Reload the cabinet IR; the cab switch itself is restored with the parameters
+            auto cabinetPath = newState.getProperty("cabinetIR").toString();
+            if (juce::File::isAbsolutePath(cabinetPath))
+            {
+                auto cabinetEnabled = newState.getChildWithProperty("id", "cab").getProperty("value", 0.0);
+                loadCabinetImpulseResponse(juce::File(cabinetPath));
+                
+                if (auto* cabParamObj = parameters.getParameter("cab"))
+                    cabParamObj->setValueNotifyingHost(static_cast<float>(cabinetEnabled));
             }
         }
     }
@@ -169,36 +673,95 @@ void WoolyMammothAudioProcessor::setStateInformation (const void* data, int size
 
 //==============================================================================
 // Preset management helper methods
-void WoolyMammothAudioProcessor::initializeFactoryPresets()
+void WoolyMammothAudioProcessor::loadPreset(int index)
 {
-    factoryPresets = WoolyMammothPresets::getFactoryPresets();
-    
-    // Load the first preset by default
-    if (!factoryPresets.empty())
+    if (index >= 0 && index < WoolyMammothPresets::numFactoryPresets)
     {
-        loadPreset(0);
+        const auto& preset = WoolyMammothPresets::factoryPresets[static_cast<size_t>(index)];
+        
+        // Factory presets only set the four knobs
+        UserPresetBank::Values values;
+        values.fill(std::numeric_limits<float>::quiet_NaN());
+        values[0] = static_cast<float>(preset.wool);
+        values[1] = static_cast<float>(preset.pinch);
+        values[2] = static_cast<float>(preset.eq);
+        values[3] = static_cast<float>(preset.output);
+        applyPresetValues(values);
     }
 }
 
-void WoolyMammothAudioProcessor::loadPreset(int index)
+bool WoolyMammothAudioProcessor::loadUserPreset(int index)
+{
+    UserPresetBank::Preset preset;
+    if (! userPresets->getPreset(index, preset))
+        return false;
+    
+    applyPresetValues(preset.values);
+    return true;
+}
+
+bool WoolyMammothAudioProcessor::saveUserPreset(const juce::String& name, const juce::StringArray& tags)
 {
-    if (index >= 0 && index < static_cast<int>(factoryPresets.size()))
+    UserPresetBank::Preset preset;
+    preset.name = name;
+    preset.tags = tags;
+    
+    for (size_t i = 0; i < presetParameters.size(); ++i)
+        preset.values[i] = presetParameters[i]->load();
+    
+    return userPresets->addPreset(preset);
+}
+
+void WoolyMammothAudioProcessor::applyPresetValues(const UserPresetBank::Values& values)
+{
+    PresetSnapshot snapshot;
+    snapshot.values = values;
+    
     {
-        const auto& preset = factoryPresets[index];
+        // The handoff takes one writer at a time, and a host may switch programs from another thread
+        const juce::SpinLock::ScopedLockType sl(presetPublishLock);
+        snapshot.sequence = ++presetSequence;
+        presetHandoff.publish(snapshot);
+    }
+    
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        if (std::isnan(values[i]))
+            continue;
         
-        // Update parameter values
-        if (auto* woolParamObj = parameters.getParameter("wool"))
-            woolParamObj->setValueNotifyingHost(static_cast<float>(preset.wool));
-            
-        if (auto* pinchParamObj = parameters.getParameter("pinch"))
-            pinchParamObj->setValueNotifyingHost(static_cast<float>(preset.pinch));
-            
-        if (auto* eqParamObj = parameters.getParameter("eq"))
-            eqParamObj->setValueNotifyingHost(static_cast<float>(preset.eq));
-            
-        if (auto* outputParamObj = parameters.getParameter("output"))
-            outputParamObj->setValueNotifyingHost(static_cast<float>(preset.output));
+        const auto id = UserPresetBank::parameterIds[i];
+        if (auto* param = parameters.getParameter(juce::String(id.data(), id.size())))
+            param->setValueNotifyingHost(param->convertTo0to1(values[i]));
     }
+    
+    // Never moves back, should an older load finish after a newer one
+    auto applied = presetsApplied.load(std::memory_order_relaxed);
+    while (applied < snapshot.sequence
+           && ! presetsApplied.compare_exchange_weak(applied, snapshot.sequence, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+}
+
+//==============================================================================
+// Audio thread side of the preset handoff
+void WoolyMammothAudioProcessor::latchPresetValues()
+{
+    if (auto* snapshot = presetHandoff.acquire())
+        heldPreset = snapshot;
+
+    // Once every parameter of the preset is set, they are at least as new as the snapshot
+    if (heldPreset != nullptr && presetsApplied.load (std::memory_order_acquire) >= heldPreset->sequence)
+        heldPreset = nullptr;
+}
+
+float WoolyMammothAudioProcessor::blockValue (const std::atomic<float>* param) const
+{
+    if (heldPreset != nullptr)
+        for (size_t i = 0; i < presetParameters.size(); ++i)
+            if (presetParameters[i] == param && ! std::isnan (heldPreset->values[i]))
+                return heldPreset->values[i];
+
+    return param->load();
 }
 
 //==============================================================================
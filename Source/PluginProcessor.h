@@ -2,10 +2,22 @@
 
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_audio_utils/juce_audio_utils.h>
+#include <juce_dsp/juce_dsp.h>
 #include "WoolyMammothDSP.h"
+#include "MammothChannel.h"
+#include "FixedRateChannel.h"
+#include "AdaptiveOversampling.h"
+#include "CpuGovernor.h"
+#include "FlightRecorder.h"
+#include "Harmonizer.h"
+#include "UserPresetBank.h"
+#include "SnapshotHandoff.h"
+#include "ParameterAutomation.h"
+#include "Tuner.h"
 
 //==============================================================================
-class WoolyMammothAudioProcessor : public juce::AudioProcessor
+class WoolyMammothAudioProcessor : public juce::AudioProcessor,
+                                   private juce::Timer
 {
 public:
     WoolyMammothAudioProcessor();
@@ -22,7 +34,7 @@ public:
     bool acceptsMidi() const override { return false; }
     bool producesMidi() const override { return false; }
     bool isMidiEffect() const override { return false; }
-    double getTailLengthSeconds() const override { return 0.0; }
+    double getTailLengthSeconds() const override;
 
     // Preset/Program management - Updated to support factory presets
     int getNumPrograms() override;
@@ -37,8 +49,129 @@ public:
     // Parameter management
     juce::AudioProcessorValueTreeState parameters;
 
+    // Cabinet impulse response (message thread). Reading, resampling and the
+    // swap into the running convolution all happen off the audio thread.
+    void loadCabinetImpulseResponse (const juce::File& file);
+    juce::File getCabinetImpulseResponseFile() const;
+
+    // WoolyMammothDSP::Feature mask selected by the sag/texture switches (any thread)
+    unsigned getCircuitFeatures() const;
+
+    // Audio-thread instrumentation, safe to read from any thread
+    struct ProcessingStats
+    {
+        float averageOversampling = 1.0f;  // Sample-weighted mean factor since prepareToPlay
+        float peakOversampling = 1.0f;     // Highest factor used since prepareToPlay
+        float cpuLoad = 0.0f;              // Smoothed fraction of the real-time budget in use
+        int qualityTier = 0;               // CPU governor tier, 0 = full quality
+        int numQualityTiers = 1;
+    };
+
+    ProcessingStats getProcessingStats() const;
+
+    // What a CPU governor tier gives up, e.g. "4x oversampling"
+    juce::String describeQualityTier (int tier) const;
+
+    // Offline replay: run every block at the given governor tier instead of
+    // letting the governor choose from the wall-clock load; -1 hands it back
+    void pinQualityTier (int tier) { pinnedQualityTier = tier; }
+
+    // Benchmarks: follow knob automation in sub-blocks of this many samples
+    // from the next prepareToPlay() on; 0 goes back to the default 0.5 ms
+    void setAutomationStep (int samples) { automationStepOverride = samples; }
+
+    // Opt-in recorder of the last few seconds of processBlock(), dumped to disk
+    // on request or on an audio anomaly and replayed by HarmonsterOfflineRender
+    FlightRecorder& getFlightRecorder() { return flightRecorder; }
+
+    // Latency the harmonizer adds with the given "harmonyengine" choice (any thread)
+    double getHarmonizerLatencyMs (int engine) const;
+
+    // User presets (message thread). Host programs stay the factory presets;
+    // the user bank is shared by every instance and browsed from the editor.
+    UserPresetBank& getUserPresets() { return *userPresets; }
+    bool loadUserPreset (int index);
+    bool saveUserPreset (const juce::String& name, const juce::StringArray& tags);
+
+    // Built-in tuner, listening to the left input while the footswitch has the
+    // effect bypassed and the "tuner" choice isn't Off
+    Tuner& getTuner() { return tuner; }
+
 private:
-    WoolyMammothDSP mammothDSP[2]; // Stereo processing
+    MammothChannel mammothChannels[2]; // Stereo processing
+    
+    // Same circuit behind a resampler to a fixed internal rate, selected by "rate"
+    FixedRateChannel fixedRateChannels[2];
+    bool fixedRateActive = false;
+    
+    // Octave/interval voices at the host rate, before or after the circuit
+    Harmonizer harmonizers[2];
+    int harmonizerLatency = 0;
+    bool harmonizerBeforeFuzz = false;
+    
+    void processAudio (juce::AudioBuffer<float>& buffer);
+    void processChannel (int channel, float* samples, int numSamples, int stages, unsigned features, bool dual);
+    
+    // Knob automation: the continuous parameters move in a straight line to
+    // each new value, over the block while they keep moving and within one
+    // step when they jump, and are followed in sub-blocks of about
+    // automationStepSeconds; switches and choices still change per block
+    enum AutomatedParameter
+    {
+        automatedWool, automatedPinch, automatedEq, automatedOutput,
+        automatedWoolB, automatedPinchB, automatedEqB, automatedOutputB,
+        automatedBlend, automatedSpread, numAutomatedParameters
+    };
+    
+    static constexpr double automationStepSeconds = 0.0005;
+    ParameterAutomation<numAutomatedParameters> automation;
+    std::array<std::atomic<float>*, numAutomatedParameters> automatedParameters {};
+    int automationStepOverride = 0;
+    
+    // Mono collapse: while both inputs are bit-identical only the left channel
+    // runs; the right one takes over its state when the inputs diverge. After a
+    // stereo passage both run until a block of identical inputs has given
+    // bit-identical outputs, so collapsing never changes what the right side plays.
+    bool monoCollapsed = false;
+    bool channelsInStep = false;
+    
+    // Oversampling: fixed 1x/2x/4x/8x, or adaptive per block
+    static constexpr int adaptiveOversamplingMode = MammothChannel::numFactors;
+    AdaptiveOversamplingPolicy oversamplingPolicy;
+    int lastOversamplingMode = -1;
+    
+    void applyOversamplingMode (int mode);
+    void updateLatency();
+    int chooseOversamplingStages (const juce::AudioBuffer<float>& buffer, int numChannels);
+    
+    // Message-thread housekeeping. Latency changes found on the audio thread
+    // are reported to the host from here, since setLatencySamples() calls the
+    // host's listeners under the processor's listener lock; the tuner's thread
+    // is started and stopped from here too.
+    std::atomic<int> pendingLatency { 0 };
+    void timerCallback() override;
+
+    // CPU governor: under deadline pressure drops the oversampling factor one
+    // step at a time. Off while rendering offline, where the wall-clock load
+    // says nothing about a deadline and a bounce must come out the same each time.
+    CpuGovernor governor;
+    int qualityTier = 0;
+    int pinnedQualityTier = -1;
+
+    int getUserOversamplingStages() const;
+    void applyQualityTier (int tier);
+    
+    // Instrumentation (written on the audio thread only)
+    double oversampledSampleCount = 0.0;
+    double processedSampleCount = 0.0;
+    std::atomic<float> averageOversampling { 1.0f };
+    std::atomic<float> peakOversampling { 1.0f };
+    std::atomic<float> cpuLoad { 0.0f };
+    std::atomic<int> reportedQualityTier { 0 };
+    std::atomic<int> numQualityTiers { 1 };
+    
+    FlightRecorder flightRecorder;
+    Tuner tuner;
     
     // Parameter pointers
     std::atomic<float>* woolParam = nullptr;
@@ -46,14 +179,73 @@ private:
     std::atomic<float>* eqParam = nullptr;
     std::atomic<float>* outputParam = nullptr;
     std::atomic<float>* bypassParam = nullptr;
+    std::atomic<float>* sagParam = nullptr;
+    std::atomic<float>* textureParam = nullptr;
+    std::atomic<float>* eqModelParam = nullptr;
+    std::atomic<float>* cabParam = nullptr;
+    std::atomic<float>* oversamplingParam = nullptr;
+    std::atomic<float>* rateParam = nullptr;
+    std::atomic<float>* governorParam = nullptr;
+    std::atomic<float>* harmonyParam = nullptr;
+    std::atomic<float>* intervalParam = nullptr;
+    std::atomic<float>* harmonyMixParam = nullptr;
+    std::atomic<float>* harmonyPlaceParam = nullptr;
+    std::atomic<float>* harmonyEngineParam = nullptr;
+    std::atomic<float>* dualParam = nullptr;
+    std::atomic<float>* woolBParam = nullptr;
+    std::atomic<float>* pinchBParam = nullptr;
+    std::atomic<float>* eqBParam = nullptr;
+    std::atomic<float>* outputBParam = nullptr;
+    std::atomic<float>* blendParam = nullptr;
+    std::atomic<float>* spreadParam = nullptr;
+    std::atomic<float>* tunerParam = nullptr;
+
+    // Cabinet simulation after the fuzz: zero-latency uniform head partition
+    // followed by a non-uniform FFT-partitioned tail. One background loader
+    // thread is shared by every instance in the process.
+    static constexpr int cabinetHeadSize = 128;
+    juce::SharedResourcePointer<juce::dsp::ConvolutionMessageQueue> convolutionQueue;
+    juce::dsp::Convolution cabinet;
+    bool cabinetWasActive = false;
+
+    // The convolution swaps a queued IR in from inside process(), so the audio
+    // thread is the one to see it arrive: the IR length in samples once one is
+    // installed, 0 before
+    std::atomic<bool> cabinetLoadQueued { false };
+    std::atomic<int> cabinetIRSize { 0 };
+    bool cabinetInstalling = false;                 // audio thread, until the first IR is in
+
+    juce::File cabinetFile;
+    juce::CriticalSection cabinetFileLock;
 
     // Preset management
     int currentPresetIndex = 0;
-    std::vector<WoolyMammothPresets::Preset> factoryPresets;
+    juce::SharedResourcePointer<UserPresetBank> userPresets;
     
     // Helper methods for preset management
     void loadPreset(int index);
-    void initializeFactoryPresets();
+    
+    // Preset loads reach the audio thread as one snapshot, published before the
+    // parameters are set one by one, so no block runs with half a preset. A
+    // block that picks up a snapshot uses its values until every parameter has
+    // been set, then goes back to the parameters themselves.
+    struct PresetSnapshot
+    {
+        UserPresetBank::Values values;
+        juce::uint32 sequence = 0;
+    };
+    
+    SnapshotHandoff<PresetSnapshot> presetHandoff;
+    juce::uint32 presetSequence = 0;                   // under presetPublishLock
+    juce::SpinLock presetPublishLock;
+    std::atomic<juce::uint32> presetsApplied { 0 };
+    const PresetSnapshot* heldPreset = nullptr;        // audio thread
+    std::array<std::atomic<float>*, UserPresetBank::numParameters> presetParameters {};
+    
+    void applyPresetValues (const UserPresetBank::Values& values);
+    void latchPresetValues();
+    float blockValue (const std::atomic<float>* param) const;
+    static unsigned circuitFeatures (float sag, float texture, float eqModel);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WoolyMammothAudioProcessor)
 };
\ No newline at end of file
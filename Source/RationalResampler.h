@@ -0,0 +1,215 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+#include "SharedDspTables.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+ #include <xmmintrin.h>
+ #define HARMONSTER_RESAMPLER_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+ #define HARMONSTER_RESAMPLER_NEON 1
+#endif
+
+//==============================================================================
+// Streaming polyphase resampler for a fixed rational ratio L/M
+// Output sample k is the windowed-sinc interpolation of the input at input
+// time (k * M - centre) / L, so the delay is set exactly by the centre of the
+// prototype filter and can be any real number of prototype samples. Each
+// output costs one dot product over a phase of the filter; phases are padded
+// to a multiple of four taps for the SIMD inner loop.
+//==============================================================================
+
+class RationalResampler
+{
+public:
+    // Largest interpolation factor accepted; covers every ratio between the
+    // common 44.1k and 48k families
+    static constexpr int maxPhases = 1024;
+
+    static bool isSupported(double inputRate, double outputRate)
+    {
+        int up = 0, down = 0;
+        return getRatio(inputRate, outputRate, up, down);
+    }
+
+    // halfLengthSeconds sets the filter's reach either side of its centre;
+    // delaySeconds (>= halfLengthSeconds) is the resulting group delay
+    void prepare(double inputRate, double outputRate, double halfLengthSeconds, double delaySeconds, int maxInputSamples)
+    {
+        // The filter bank is shared by every instance using the same design
+        const TableKey key { inputRate, outputRate, halfLengthSeconds, delaySeconds };
+        table = SharedTableCache<TableKey, Table>::get(key, [&] { return design(inputRate, outputRate, halfLengthSeconds, delaySeconds); });
+
+        up = table->up;
+        down = table->down;
+        tapsPerPhase = table->tapsPerPhase;
+
+        history.assign(static_cast<size_t>(tapsPerPhase - 1 + maxInputSamples), 0.0f);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(history.begin(), history.end(), 0.0f);
+        nextOutputTime = 0;
+    }
+
+    void copyStateFrom(const RationalResampler& other)
+    {
+        std::copy_n(other.history.begin(), tapsPerPhase - 1, history.begin());
+        nextOutputTime = other.nextOutputTime;
+    }
+
+    // Upper bound on the outputs produced from numInputSamples
+    int getMaxOutputSamples(int numInputSamples) const
+    {
+        return static_cast<int>((static_cast<int64_t>(numInputSamples) * up) / down) + 1;
+    }
+
+    // Returns the number of samples written to output
+    int process(const float* input, int numInputSamples, float* output)
+    {
+        const int historyLength = tapsPerPhase - 1;
+        float* x = history.data() + historyLength;
+        std::copy(input, input + numInputSamples, x);
+
+        // nextOutputTime is in 1/up input samples, relative to input[0]
+        const int64_t end = static_cast<int64_t>(numInputSamples) * up;
+        const float* coefficients = table->coefficients.data();
+        int produced = 0;
+
+        for (; nextOutputTime < end; nextOutputTime += down)
+        {
+            const auto newest = static_cast<int>(nextOutputTime / up);
+            const auto phase = static_cast<int>(nextOutputTime - static_cast<int64_t>(newest) * up);
+            output[produced++] = dotProduct(coefficients + phase * tapsPerPhase, x + newest - historyLength, tapsPerPhase);
+        }
+
+        nextOutputTime -= end;
+        std::copy(x + numInputSamples - historyLength, x + numInputSamples, history.data());
+        return produced;
+    }
+
+private:
+    using TableKey = std::array<double, 4>;
+
+    struct Table
+    {
+        int up = 1, down = 1;
+        int tapsPerPhase = 4;
+        std::vector<float> coefficients;  // per phase, time-reversed to run forward over the history
+    };
+
+    std::shared_ptr<const Table> table;
+    int up = 1, down = 1;
+    int tapsPerPhase = 4;
+    std::vector<float> history;  // tapsPerPhase - 1 samples of history + current block
+    int64_t nextOutputTime = 0;
+
+    static Table design(double inputRate, double outputRate, double halfLengthSeconds, double delaySeconds)
+    {
+        Table designed;
+        getRatio(inputRate, outputRate, designed.up, designed.down);
+
+        const int phases = designed.up;
+        const double prototypeRate = inputRate * phases;
+        const double cutoff = 0.5 * std::min(inputRate, outputRate) / prototypeRate;  // cycles per prototype sample
+        const double halfLength = halfLengthSeconds * prototypeRate;
+        const double centre = delaySeconds * prototypeRate;
+        const int length = static_cast<int>(std::floor(centre + halfLength)) + 1;
+
+        designed.tapsPerPhase = ((length + phases - 1) / phases + 3) & ~3;
+        designed.coefficients.assign(static_cast<size_t>(phases * designed.tapsPerPhase), 0.0f);
+
+        // Kaiser window lowered to reach exactly zero at the edges, so the
+        // truncated ends of an off-grid centre cost nothing
+        const double beta = 8.0;
+        const double windowFloor = besselI0(0.0);
+        const double windowScale = besselI0(beta) - windowFloor;
+        std::vector<double> prototype(static_cast<size_t>(length), 0.0);
+        double sum = 0.0;
+
+        for (int j = 0; j < length; ++j)
+        {
+            const double offset = j - centre;
+            const double ratio = offset / halfLength;
+            if (std::abs(ratio) >= 1.0)
+                continue;
+
+            const double x = 2.0 * cutoff * offset;
+            const double sinc = std::abs(x) < 1.0e-12 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+            const double window = (besselI0(beta * std::sqrt(1.0 - ratio * ratio)) - windowFloor) / windowScale;
+            prototype[static_cast<size_t>(j)] = sinc * window;
+            sum += sinc * window;
+        }
+
+        // Unity gain through every phase on average
+        for (int j = 0; j < length; ++j)
+        {
+            const int phase = j % phases;
+            const int tap = j / phases;
+            designed.coefficients[static_cast<size_t>(phase * designed.tapsPerPhase + designed.tapsPerPhase - 1 - tap)]
+                = static_cast<float>(prototype[static_cast<size_t>(j)] * phases / sum);
+        }
+
+        return designed;
+    }
+
+    static bool getRatio(double inputRate, double outputRate, int& newUp, int& newDown)
+    {
+        const auto in = static_cast<int64_t>(std::llround(inputRate));
+        const auto out = static_cast<int64_t>(std::llround(outputRate));
+        newUp = newDown = 1;
+
+        if (in <= 0 || out <= 0 || std::abs(inputRate - static_cast<double>(in)) > 1.0e-6 || std::abs(outputRate - static_cast<double>(out)) > 1.0e-6)
+            return false;
+
+        const auto divisor = std::gcd(in, out);
+        if (out / divisor > maxPhases || in / divisor > maxPhases)
+            return false;
+
+        newUp = static_cast<int>(out / divisor);
+        newDown = static_cast<int>(in / divisor);
+        return true;
+    }
+
+    static float dotProduct(const float* a, const float* b, int numTaps)
+    {
+       #if HARMONSTER_RESAMPLER_SSE
+        __m128 acc = _mm_setzero_ps();
+        for (int i = 0; i < numTaps; i += 4)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+        return _mm_cvtss_f32(acc);
+       #elif HARMONSTER_RESAMPLER_NEON
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for (int i = 0; i < numTaps; i += 4)
+            acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+        float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+        return vget_lane_f32(vpadd_f32(pair, pair), 0);
+       #else
+        float acc[4] = {};
+        for (int i = 0; i < numTaps; i += 4)
+            for (int j = 0; j < 4; ++j)
+                acc[j] += a[i + j] * b[i + j];
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+       #endif
+    }
+
+    static double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x * 0.5 / k) * (x * 0.5 / k);
+            sum += term;
+        }
+        return sum;
+    }
+};
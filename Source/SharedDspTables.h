@@ -0,0 +1,62 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+
+//==============================================================================
+// Process-wide cache of immutable DSP tables
+// Filter kernels and coefficient grids depend only on a few design inputs
+// (sample rate, quality, length), so every plugin instance in the host can
+// share one copy. Tables are built on first request under the cache lock, so
+// instances preparing at the same time build each table only once, and are
+// freed when the last instance holding them lets go. Call from prepare code,
+// never from the audio thread.
+//
+// Each Table type gets its own cache; Key needs operator<.
+//==============================================================================
+
+template <typename Key, typename Table>
+class SharedTableCache
+{
+public:
+    template <typename Builder>
+    static std::shared_ptr<const Table> get(const Key& key, Builder&& build)
+    {
+        auto& cache = instance();
+        const std::lock_guard<std::mutex> lock(cache.mutex);
+
+        auto& slot = cache.tables[key];
+        if (auto table = slot.lock())
+            return table;
+
+        // Drop entries nobody holds any more before adding a new one
+        for (auto it = cache.tables.begin(); it != cache.tables.end();)
+            it = it->second.expired() && &it->second != &slot ? cache.tables.erase(it) : std::next(it);
+
+        std::shared_ptr<const Table> table = std::make_shared<Table>(build());
+        slot = table;
+        return table;
+    }
+
+    // Number of distinct tables currently alive in the process
+    static size_t getNumLiveTables()
+    {
+        auto& cache = instance();
+        const std::lock_guard<std::mutex> lock(cache.mutex);
+
+        size_t live = 0;
+        for (const auto& entry : cache.tables)
+            live += entry.second.expired() ? 0 : 1;
+        return live;
+    }
+
+private:
+    std::mutex mutex;
+    std::map<Key, std::weak_ptr<const Table>> tables;
+
+    static SharedTableCache& instance()
+    {
+        static SharedTableCache cache;
+        return cache;
+    }
+};
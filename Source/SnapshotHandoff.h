@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+
+//==============================================================================
+// Wait-free handoff of a value from one writer thread to one reader thread
+// Triple buffer: the writer fills its back slot and swaps it with the middle
+// one; the reader swaps its front slot with the middle one when that holds
+// something newer. Neither side waits for or copies under the other, and the
+// reader's snapshot stays untouched until it next acquires. T is copied on
+// the writer's side only, so it should be trivially copyable.
+//==============================================================================
+
+template <typename T>
+class SnapshotHandoff
+{
+public:
+    // Writer thread
+    void publish(const T& value)
+    {
+        slots[back] = value;
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Reader thread: the newest value published since the last call, or nullptr.
+    // The pointer stays valid, and the value unchanged, until the next call.
+    const T* acquire()
+    {
+        if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+            return nullptr;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return &slots[front];
+    }
+
+private:
+    static constexpr int freshBit = 4;
+    static constexpr int indexMask = 3;
+
+    T slots[3] {};
+    int back = 0;                   // writer's
+    std::atomic<int> middle { 1 };  // slot index, plus freshBit while unread
+    int front = 2;                  // reader's
+
+    static_assert(std::atomic<int>::is_always_lock_free, "the audio thread must not lock");
+};
@@ -0,0 +1,128 @@
+#include "ToneAnalyser.h"
+
+namespace
+{
+    // 120 Hz test sine at 48 kHz: exactly 400 samples per period, so the
+    // harmonics fall on exact DFT bins without any windowing
+    constexpr double analysisRate = 48000.0;
+    constexpr int periodSamples = 400;
+    constexpr int settleSamples = 24000;    // lets the coupling caps and gate smoother settle
+    constexpr int analysedPeriods = 8;
+    constexpr double testLevel = 0.5;       // a hard-picked single-coil DI
+}
+
+ToneAnalyser::ToneAnalyser()
+    : juce::Thread ("Harmonster tone analyser")
+{
+    startThread (juce::Thread::Priority::low);
+}
+
+ToneAnalyser::~ToneAnalyser()
+{
+    stopThread (2000);
+}
+
+void ToneAnalyser::setSettings (const Settings& newSettings)
+{
+    if (hasRequested && newSettings == lastRequested)
+        return;
+
+    lastRequested = newSettings;
+    hasRequested = true;
+
+    {
+        const juce::ScopedLock sl (settingsLock);
+        pendingSettings = newSettings;
+        hasPendingSettings = true;
+        lastChangeMs = juce::Time::getMillisecondCounter();
+    }
+
+    notify();
+}
+
+void ToneAnalyser::run()
+{
+    while (! threadShouldExit())
+    {
+        Settings settings;
+        int waitMs = -1;
+
+        {
+            const juce::ScopedLock sl (settingsLock);
+
+            if (hasPendingSettings)
+            {
+                // Debounce: only analyse once the knobs have been still for a moment
+                const auto sinceChange = static_cast<int> (juce::Time::getMillisecondCounter() - lastChangeMs);
+                waitMs = juce::jmax (0, debounceMs - sinceChange);
+
+                if (waitMs == 0)
+                {
+                    settings = pendingSettings;
+                    hasPendingSettings = false;
+                }
+            }
+        }
+
+        if (waitMs != 0)
+        {
+            wait (waitMs);
+            continue;
+        }
+
+        analyse (settings, results.beginWrite());
+        results.publish();
+    }
+}
+
+void ToneAnalyser::analyse (const Settings& settings, Result& result)
+{
+    WoolyMammothDSP dsp;
+    dsp.setSampleRate (analysisRate);
+    dsp.setWool (settings.wool);
+    dsp.setPinch (settings.pinch);
+    dsp.setEQ (settings.eq);
+    dsp.setOutput (settings.output);
+    dsp.setFeatures (settings.features);
+
+    const int analysedSamples = periodSamples * analysedPeriods;
+    const int totalSamples = settleSamples + analysedSamples;
+    std::vector<float> input (static_cast<size_t> (totalSamples)), output;
+
+    for (int i = 0; i < totalSamples; ++i)
+        input[static_cast<size_t> (i)] = static_cast<float> (testLevel * std::sin (juce::MathConstants<double>::twoPi * i / periodSamples));
+
+    output = input;
+    dsp.processBlock (output.data(), totalSamples);
+
+    // Transfer curve: the last period, output against input (the loop opens
+    // up where the coupling caps and filters add phase shift)
+    const int lastPeriod = totalSamples - periodSamples;
+    float peak = 1.0e-6f;
+    for (int i = lastPeriod; i < totalSamples; ++i)
+        peak = juce::jmax (peak, std::abs (output[static_cast<size_t> (i)]));
+
+    for (int point = 0; point < curvePoints; ++point)
+    {
+        const auto index = static_cast<size_t> (lastPeriod + point * periodSamples / curvePoints);
+        result.input[static_cast<size_t> (point)] = static_cast<float> (input[index] / testLevel);
+        result.output[static_cast<size_t> (point)] = output[index] / peak;
+    }
+
+    // Harmonic levels: DFT bins at exact multiples of the fundamental
+    const float* analysed = output.data() + settleSamples;
+    for (int harmonic = 1; harmonic <= numHarmonics; ++harmonic)
+    {
+        const double step = juce::MathConstants<double>::twoPi * harmonic / periodSamples;
+        double re = 0.0, im = 0.0;
+
+        for (int i = 0; i < analysedSamples; ++i)
+        {
+            re += analysed[i] * std::cos (step * i);
+            im -= analysed[i] * std::sin (step * i);
+        }
+
+        const double amplitude = 2.0 * std::sqrt (re * re + im * im) / analysedSamples;
+        result.harmonicsDb[static_cast<size_t> (harmonic - 1)] = juce::Decibels::gainToDecibels (static_cast<float> (amplitude), -120.0f);
+    }
+}
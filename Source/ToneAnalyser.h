@@ -0,0 +1,133 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include "WoolyMammothDSP.h"
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+//==============================================================================
+// Single-writer, single-reader double buffer
+// The reader never blocks: it copies the front slot and retries if the writer
+// published over it meanwhile. The writer only ever waits for a reader that is
+// still copying the slot it wants to reuse.
+//==============================================================================
+template <typename Value>
+class LockFreeDoubleBuffer
+{
+public:
+    // Writer: fill the returned slot, then call publish()
+    Value& beginWrite()
+    {
+        back = 1 - front.load();
+
+        while (reading[back].load())
+            std::this_thread::yield();
+
+        return slots[static_cast<size_t> (back)];
+    }
+
+    void publish()
+    {
+        front.store (back);
+        ++version;
+    }
+
+    // Reader: copies the latest value if it is newer than lastVersion
+    bool readIfNewer (Value& destination, uint32_t& lastVersion)
+    {
+        const auto latest = version.load();
+        if (latest == lastVersion)
+            return false;
+
+        for (;;)
+        {
+            const int slot = front.load();
+            reading[slot].store (true);
+
+            if (front.load() == slot)
+            {
+                destination = slots[static_cast<size_t> (slot)];
+                reading[slot].store (false);
+                lastVersion = latest;
+                return true;
+            }
+
+            reading[slot].store (false);
+        }
+    }
+
+private:
+    std::array<Value, 2> slots {};
+    std::atomic<int> front { 0 };
+    std::atomic<bool> reading[2] { { false }, { false } };
+    std::atomic<uint32_t> version { 0 };
+    int back = 1;
+};
+
+//==============================================================================
+// Background tone analysis for the editor
+// Drives a private WoolyMammothDSP with a test sine whenever the knobs change
+// (debounced) and publishes the transfer curve and harmonic levels. Never
+// touches the processor's circuits; the only input is a copy of the settings.
+//==============================================================================
+class ToneAnalyser : private juce::Thread
+{
+public:
+    static constexpr int curvePoints = 100;
+    static constexpr int numHarmonics = 12;
+
+    struct Settings
+    {
+        float wool = 0.5f, pinch = 0.5f, eq = 0.5f, output = 0.5f;
+        unsigned features = WoolyMammothDSP::allFeatures;
+
+        bool operator== (const Settings& other) const
+        {
+            return ! (differs (wool, other.wool) || differs (pinch, other.pinch) || differs (eq, other.eq)
+                      || differs (output, other.output)) && features == other.features;
+        }
+
+    private:
+        static bool differs (float a, float b) { return a < b || a > b; }
+    };
+
+    struct Result
+    {
+        // One period of the test sine: output against input, both scaled to -1..1
+        std::array<float, curvePoints> input {}, output {};
+
+        // Harmonic levels in dBFS, fundamental first
+        std::array<float, numHarmonics> harmonicsDb {};
+    };
+
+    ToneAnalyser();
+    ~ToneAnalyser() override;
+
+    // Message thread: schedules a new analysis once the settings stop changing
+    void setSettings (const Settings& newSettings);
+
+    // Message thread: copies the latest result if one arrived since the last call
+    bool getLatestResult (Result& result) { return results.readIfNewer (result, lastReadVersion); }
+
+private:
+    static constexpr int debounceMs = 80;
+
+    juce::CriticalSection settingsLock;
+    Settings pendingSettings;
+    bool hasPendingSettings = false;
+    juce::uint32 lastChangeMs = 0;
+
+    Settings lastRequested;
+    bool hasRequested = false;
+
+    LockFreeDoubleBuffer<Result> results;
+    uint32_t lastReadVersion = 0;
+
+    void run() override;
+    static void analyse (const Settings& settings, Result& result);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ToneAnalyser)
+};
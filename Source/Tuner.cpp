@@ -0,0 +1,331 @@
+#include "Tuner.h"
+
+namespace
+{
+    constexpr float keyMaximumThreshold = 0.93f;  // of the highest NSDF peak; McLeod's k
+    constexpr int maxKeyMaxima = 64;
+    constexpr float newNoteCents = 80.0f;         // further than this from the median is a new note
+
+    float centsBetween (float a, float b)
+    {
+        return 1200.0f * std::log2 (a / b);
+    }
+
+    float median (const float* values, int count)
+    {
+        float sorted[16];
+        std::copy_n (values, count, sorted);
+        std::nth_element (sorted, sorted + count / 2, sorted + count);
+        return sorted[count / 2];
+    }
+}
+
+Tuner::Tuner()
+    : juce::Thread ("Harmonster tuner")
+{
+}
+
+Tuner::~Tuner()
+{
+    stopThread (2000);
+}
+
+void Tuner::prepare (double sampleRate)
+{
+    const juce::ScopedLock sl (storageLock);
+
+    decimation = juce::jmax (1, static_cast<int> (sampleRate / detectorRate));
+    rate = sampleRate / decimation;
+    windowLength = static_cast<int> (std::ceil (windowSeconds * rate));
+
+    // Zero padded to twice the window, so the FFT's circular autocorrelation
+    // doesn't wrap around into the lags we read
+    int order = 1;
+    while ((1 << order) < 2 * windowLength)
+        ++order;
+
+    fft = std::make_unique<juce::dsp::FFT> (order);
+    spectrum.assign (static_cast<size_t> (2 * fft->getSize()), 0.0f);
+    window.assign (static_cast<size_t> (windowLength), 0.0f);
+    nsdf.assign (static_cast<size_t> (windowLength), 0.0f);
+
+    // Room for a few windows, so the detector can copy one out while the
+    // audio thread carries on writing
+    ring.assign (static_cast<size_t> (juce::nextPowerOfTwo (4 * windowLength)), 0.0f);
+    ringMask = static_cast<juce::uint32> (ring.size() - 1);
+
+    accumulated = 0;
+    accumulator = 0.0f;
+    written.store (0);
+    lastAnalysed = 0;
+    numRecentPitches = 0;
+    candidatePitch = 0.0f;
+    secondsUnclear = 0.0;
+}
+
+void Tuner::setEnabled (bool shouldBeEnabled)
+{
+    if (shouldBeEnabled == isThreadRunning())
+        return;
+
+    if (shouldBeEnabled)
+    {
+        startThread (juce::Thread::Priority::low);
+        return;
+    }
+
+    // wait() returns as soon as stopThread() signals, so this doesn't stall
+    stopThread (2000);
+
+    // With the detector stopped this thread is the only writer, so the
+    // display clears rather than holding the last note
+    const juce::ScopedLock sl (storageLock);
+    numRecentPitches = 0;
+    candidatePitch = 0.0f;
+    publish (0.0f, 0.0f);
+}
+
+void Tuner::push (const float* samples, int numSamples)
+{
+    if (ring.empty())
+        return;
+
+    // Averaging decimation: a boxcar is a poor anti-alias filter, but what it
+    // folds down is upper harmonics, which only ever add to the periodicity
+    auto position = written.load (std::memory_order_relaxed);
+    const float gain = 1.0f / static_cast<float> (decimation);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        accumulator += samples[i];
+
+        if (++accumulated == decimation)
+        {
+            ring[position & ringMask] = accumulator * gain;
+            ++position;
+            accumulator = 0.0f;
+            accumulated = 0;
+        }
+    }
+
+    written.store (position, std::memory_order_release);
+}
+
+juce::String Tuner::getNoteName (int midiNote)
+{
+    static const char* const names[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+    return midiNote < 0 ? juce::String ("-") : juce::String (names[midiNote % 12]);
+}
+
+void Tuner::run()
+{
+    // Polls rather than being woken: notify() takes a lock, which the audio
+    // thread mustn't. While nothing is pushed it looks in less often.
+    while (! threadShouldExit())
+        wait (analyseLatest() ? hopMs : idleMs);
+}
+
+bool Tuner::analyseLatest()
+{
+    const juce::ScopedLock sl (storageLock);
+
+    if (ring.empty())
+        return false;
+
+    const auto end = written.load (std::memory_order_acquire);
+
+    if (end == lastAnalysed)
+    {
+        // Not tuning: forget the last note, so the next time starts afresh
+        if (numRecentPitches > 0)
+        {
+            numRecentPitches = 0;
+            publish (0.0f, 0.0f);
+        }
+
+        return false;
+    }
+
+    const double elapsed = static_cast<juce::uint32> (end - lastAnalysed) / rate;
+    lastAnalysed = end;
+
+    if (end < static_cast<juce::uint32> (windowLength))
+        return true;
+
+    const auto start = end - static_cast<juce::uint32> (windowLength);
+    for (int i = 0; i < windowLength; ++i)
+        window[static_cast<size_t> (i)] = ring[(start + static_cast<juce::uint32> (i)) & ringMask];
+
+    // The audio thread may have lapped the copy while it was taken
+    if (written.load (std::memory_order_acquire) - start > static_cast<juce::uint32> (ring.size()))
+        return true;
+
+    float clarity = 0.0f;
+    const float pitch = detectPitch (clarity);
+
+    if (pitch <= 0.0f)
+    {
+        // Held through short gaps such as a string being re-picked
+        secondsUnclear += elapsed;
+        if (secondsUnclear < holdSeconds)
+            return true;
+
+        numRecentPitches = 0;
+        publish (0.0f, clarity);
+        return true;
+    }
+
+    secondsUnclear = 0.0;
+
+    if (numRecentPitches > 0 && std::abs (centsBetween (pitch, median (recentPitches.data(), numRecentPitches))) > newNoteCents)
+    {
+        // One stray reading, such as an octave jump on the attack, is left
+        // out; two that agree are a new note, which the median of the old
+        // one would otherwise hold back for half the history
+        const bool confirmed = candidatePitch > 0.0f && std::abs (centsBetween (pitch, candidatePitch)) < newNoteCents;
+        candidatePitch = pitch;
+
+        if (! confirmed)
+            return true;
+
+        numRecentPitches = 0;
+    }
+
+    candidatePitch = 0.0f;
+
+    if (numRecentPitches == medianLength)
+    {
+        std::copy (recentPitches.begin() + 1, recentPitches.end(), recentPitches.begin());
+        --numRecentPitches;
+    }
+
+    recentPitches[static_cast<size_t> (numRecentPitches++)] = pitch;
+    publish (median (recentPitches.data(), numRecentPitches), clarity);
+    return true;
+}
+
+float Tuner::detectPitch (float& clarity)
+{
+    // McLeod pitch method: the normalised square difference function
+    // n(t) = 2 r(t) / m(t), r the autocorrelation and m the energy of the
+    // two overlapping parts, peaks near 1 at every multiple of the period.
+    // Its first peak close to the highest one is the period.
+    const int length = windowLength;
+    auto* x = window.data();
+
+    float mean = 0.0f;
+    for (int i = 0; i < length; ++i)
+        mean += x[i];
+    juce::FloatVectorOperations::add (x, -mean / static_cast<float> (length), length);
+
+    double energy = 0.0;
+    for (int i = 0; i < length; ++i)
+        energy += static_cast<double> (x[i]) * x[i];
+
+    clarity = 0.0f;
+    if (energy < static_cast<double> (silenceRms) * silenceRms * length)
+        return 0.0f;
+
+    // Autocorrelation as the inverse FFT of the power spectrum
+    auto* data = spectrum.data();
+    std::fill (spectrum.begin(), spectrum.end(), 0.0f);
+    juce::FloatVectorOperations::copy (data, x, length);
+    fft->performRealOnlyForwardTransform (data, true);
+
+    const int numBins = fft->getSize() / 2 + 1;
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        const float re = data[2 * bin];
+        const float im = data[2 * bin + 1];
+        data[2 * bin] = re * re + im * im;
+        data[2 * bin + 1] = 0.0f;
+    }
+
+    fft->performRealOnlyInverseTransform (data);
+
+    if (data[0] <= 0.0f)
+        return 0.0f;
+
+    // r(0) is the energy; scaling by that leaves the FFT's own scaling out of it
+    const int minLag = juce::jmax (2, static_cast<int> (rate / maxFrequency));
+    const int maxLag = juce::jmin (length - 2, static_cast<int> (std::ceil (rate / minFrequency)) + 1);
+    const float scale = static_cast<float> (energy) / data[0];
+
+    double m = 2.0 * energy;
+    for (int lag = 0; lag <= maxLag; ++lag)
+    {
+        nsdf[static_cast<size_t> (lag)] = m > 0.0 ? static_cast<float> (2.0 * scale * data[lag] / m) : 0.0f;
+        m -= static_cast<double> (x[lag]) * x[lag] + static_cast<double> (x[length - 1 - lag]) * x[length - 1 - lag];
+    }
+
+    // Key maxima: the highest point of each positive lobe after the first
+    // negative stretch (the lobe around lag 0 is no period)
+    std::array<int, maxKeyMaxima> keyMaxima {};
+    int numKeyMaxima = 0;
+    float highest = 0.0f;
+
+    int lag = 1;
+    while (lag < maxLag && nsdf[static_cast<size_t> (lag)] > 0.0f)
+        ++lag;
+
+    int best = -1;
+    for (; lag < maxLag && numKeyMaxima < maxKeyMaxima; ++lag)
+    {
+        const float value = nsdf[static_cast<size_t> (lag)];
+
+        if (value > 0.0f && (best < 0 || value > nsdf[static_cast<size_t> (best)]))
+            best = lag;
+
+        if (value <= 0.0f && best >= 0)
+        {
+            keyMaxima[static_cast<size_t> (numKeyMaxima++)] = best;
+            highest = juce::jmax (highest, nsdf[static_cast<size_t> (best)]);
+            best = -1;
+        }
+    }
+
+    // A lobe still open at maxLag counts if its peak is inside it
+    if (best >= 0 && best < maxLag - 1 && numKeyMaxima < maxKeyMaxima)
+    {
+        keyMaxima[static_cast<size_t> (numKeyMaxima++)] = best;
+        highest = juce::jmax (highest, nsdf[static_cast<size_t> (best)]);
+    }
+
+    for (int i = 0; i < numKeyMaxima; ++i)
+    {
+        const int peak = keyMaxima[static_cast<size_t> (i)];
+        if (peak < minLag || nsdf[static_cast<size_t> (peak)] < keyMaximumThreshold * highest)
+            continue;
+
+        // Parabola through the peak and its neighbours for the fractional lag
+        const float a = nsdf[static_cast<size_t> (peak - 1)];
+        const float b = nsdf[static_cast<size_t> (peak)];
+        const float c = nsdf[static_cast<size_t> (peak + 1)];
+        const float curvature = a - 2.0f * b + c;
+        const float offset = curvature < 0.0f ? 0.5f * (a - c) / curvature : 0.0f;
+
+        clarity = b - 0.25f * (a - c) * offset;
+        if (clarity < minClarity)
+            return 0.0f;
+
+        return static_cast<float> (rate / (peak + offset));
+    }
+
+    return 0.0f;
+}
+
+void Tuner::publish (float frequency, float clarity)
+{
+    Reading reading;
+    reading.clarity = clarity;
+
+    if (frequency > 0.0f)
+    {
+        const double note = 69.0 + 12.0 * std::log2 (frequency / referencePitch);
+        reading.frequency = frequency;
+        reading.midiNote = juce::roundToInt (note);
+        reading.cents = static_cast<float> (100.0 * (note - reading.midiNote));
+    }
+
+    readings.publish (reading);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_dsp/juce_dsp.h>
+#include "SnapshotHandoff.h"
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+//==============================================================================
+// Built-in tuner
+// The audio thread averages the input down to about 16 kHz and writes it into
+// a ring: a few adds per sample and one atomic store per block, no locks and
+// no wake-ups. A background thread, running only while the tuner is in use,
+// polls the ring, runs the McLeod pitch
+// method over the last windowSeconds (the normalised square difference
+// function, its autocorrelation taken with an FFT) and publishes the note
+// and cents. A reading is the median of the last few clear pitches, so the
+// slow, wide vibration of a low drop-tuned string doesn't make it flicker.
+//==============================================================================
+class Tuner : private juce::Thread
+{
+public:
+    static constexpr double minFrequency = 25.0;       // below A0, for drop-tuned basses
+    static constexpr double maxFrequency = 1400.0;
+    static constexpr double windowSeconds = 0.12;      // three periods of the lowest note
+    static constexpr double referencePitch = 440.0;
+
+    // "tuner" parameter choices
+    enum Mode { off, onBypass, mutedOnBypass };
+
+    struct Reading
+    {
+        float frequency = 0.0f;  // Hz, 0 while there is no clear pitch
+        int midiNote = -1;
+        float cents = 0.0f;      // -50..50 from midiNote
+        float clarity = 0.0f;    // NSDF peak, 1 = perfectly periodic
+    };
+
+    Tuner();
+    ~Tuner() override;
+
+    // Never concurrently with push(), i.e. from prepareToPlay()
+    void prepare (double sampleRate);
+
+    // Message thread: starts the detector thread while the tuner is in use and
+    // stops it when it isn't, so an instance that never tunes has no thread
+    void setEnabled (bool shouldBeEnabled);
+
+    // Audio thread: one channel of dry input
+    void push (const float* samples, int numSamples);
+
+    // Message thread: copies the latest reading if one arrived since the last call
+    bool getLatestReading (Reading& reading)
+    {
+        const auto* latest = readings.acquire();
+        if (latest != nullptr)
+            reading = *latest;
+
+        return latest != nullptr;
+    }
+
+    // "E", "F#" and so on; octave numbers are left to the caller
+    static juce::String getNoteName (int midiNote);
+
+private:
+    static constexpr double detectorRate = 16000.0;  // at least; the decimation is a whole number
+    static constexpr int hopMs = 20;
+    static constexpr int idleMs = 200;
+    static constexpr int medianLength = 5;           // at most 16
+    static constexpr double holdSeconds = 0.3;       // keeps the last note through short gaps
+    static constexpr float minClarity = 0.9f;        // below this a dying note reads off by cents
+    static constexpr float silenceRms = 0.0005f;     // about -66 dBFS
+
+    // Ring and detector; replaced only under storageLock, which the audio
+    // thread never takes
+    juce::CriticalSection storageLock;
+    std::vector<float> ring;
+    juce::uint32 ringMask = 0;
+    double rate = detectorRate;
+    int windowLength = 0;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> window, spectrum, nsdf;
+
+    // Audio thread: decimation by averaging, and the count of samples written
+    int decimation = 1;
+    int accumulated = 0;
+    float accumulator = 0.0f;
+    std::atomic<juce::uint32> written { 0 };
+
+    // Detector thread
+    juce::uint32 lastAnalysed = 0;
+    std::array<float, medianLength> recentPitches {};
+    int numRecentPitches = 0;
+    float candidatePitch = 0.0f;    // a reading far from the median, waiting for a second
+    double secondsUnclear = 0.0;
+
+    SnapshotHandoff<Reading> readings;  // detector thread to message thread
+
+    void run() override;
+    bool analyseLatest();
+    float detectPitch (float& clarity);
+    void publish (float frequency, float clarity);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Tuner)
+};
@@ -0,0 +1,855 @@
+#include "UserPresetBank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <string>
+
+//==============================================================================
+// Bank file, all integers little-endian:
+//
+//   header     64 bytes, see below
+//   records    numPresets x (nameOffset, nameLength, tagsOffset, tagsLength,
+//              numValues floats), sorted by lowercased name
+//   tokens     numTokens x (textOffset, textLength, firstPosting, numPostings),
+//              sorted by the UTF-8 bytes of the text
+//   postings   record numbers, ascending within each token
+//   strings    UTF-8 names, comma-joined tags and token texts
+//
+// Log file, one entry per save:
+//
+//   magic, payload size, sequence (64 bits), payload, FNV-1a of sequence and payload
+//   payload: name length, name, tags length, tags, numValues, values
+//==============================================================================
+namespace
+{
+    constexpr juce::uint32 bankMagic = 0x4b425048;  // "HPBK"
+    constexpr juce::uint32 bankVersion = 1;
+    constexpr juce::uint32 logMagic = 0x454c5048;   // "HPLE"
+
+    constexpr size_t headerSize = 64;
+    constexpr size_t recordFixedSize = 16;
+    constexpr size_t tokenSize = 16;
+    constexpr size_t logEntryOverhead = 20;
+
+    // Header fields, by byte offset
+    enum HeaderField : size_t
+    {
+        magicField = 0, versionField = 4, numPresetsField = 8, numValuesField = 12,
+        numTokensField = 16, numPostingsField = 20, recordsField = 24, tokensField = 28,
+        postingsField = 32, stringsField = 36, stringsSizeField = 40, fileSizeField = 44,
+        sequenceField = 48
+    };
+
+    juce::uint32 read32 (const char* data)
+    {
+        return juce::ByteOrder::littleEndianInt (data);
+    }
+
+    juce::uint64 read64 (const char* data)
+    {
+        return juce::ByteOrder::littleEndianInt64 (data);
+    }
+
+    float readFloat (const char* data)
+    {
+        const auto bits = read32 (data);
+        float value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return value;
+    }
+
+    juce::uint32 fnv1a (const void* data, size_t size, juce::uint32 hash = 2166136261u)
+    {
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ static_cast<const juce::uint8*> (data)[i]) * 16777619u;
+
+        return hash;
+    }
+
+    // What the index stores and a query matches: lowercased runs of letters and digits
+    juce::StringArray splitWords (const juce::String& text)
+    {
+        juce::StringArray words;
+        const auto lower = text.toLowerCase();
+
+        auto position = lower.getCharPointer();
+        auto wordStart = position;
+        bool inWord = false;
+
+        for (;;)
+        {
+            const auto current = position;
+            const auto c = position.getAndAdvance();
+            const bool letter = c != 0 && juce::CharacterFunctions::isLetterOrDigit (c);
+
+            if (letter && ! inWord)
+                wordStart = current;
+            else if (! letter && inWord)
+                words.addIfNotAlreadyThere (juce::String (wordStart, current));
+
+            inWord = letter;
+
+            if (c == 0)
+                return words;
+        }
+    }
+
+    juce::StringArray splitTags (const juce::String& joined)
+    {
+        juce::StringArray tags;
+        tags.addTokens (joined, ",", {});
+        tags.trim();
+        tags.removeEmptyStrings();
+        return tags;
+    }
+
+    juce::String joinTags (const juce::StringArray& tags)
+    {
+        // Commas separate tags, so a tag can't contain one
+        juce::StringArray cleaned;
+        for (auto tag : tags)
+        {
+            tag = tag.removeCharacters (",").trim();
+            if (tag.isNotEmpty())
+                cleaned.addIfNotAlreadyThere (tag);
+        }
+
+        return cleaned.joinIntoString (",");
+    }
+
+    juce::StringArray wordsOf (const UserPresetBank::Preset& preset)
+    {
+        auto words = splitWords (preset.name);
+        words.mergeArray (splitWords (preset.tags.joinIntoString (" ")));
+        return words;
+    }
+
+    bool startsWith (std::string_view text, std::string_view prefix)
+    {
+        return text.size() >= prefix.size() && text.compare (0, prefix.size(), prefix) == 0;
+    }
+
+    void writeString (juce::MemoryOutputStream& out, const juce::String& text)
+    {
+        const auto utf8 = text.toUTF8();
+        const auto numBytes = utf8.sizeInBytes() - 1;
+        out.writeInt (static_cast<int> (numBytes));
+        out.write (utf8.getAddress(), numBytes);
+    }
+}
+
+//==============================================================================
+struct UserPresetBank::MappedBank
+{
+    std::unique_ptr<juce::MemoryMappedFile> file;
+    const char* data = nullptr;
+    size_t size = 0;
+
+    juce::uint32 numPresets = 0, numValues = 0, numTokens = 0, numPostings = 0;
+    size_t records = 0, tokens = 0, postings = 0, strings = 0, stringsSize = 0, recordSize = 0;
+    juce::uint64 mergedSequence = 0;
+
+    // Checks the header and that every section lies inside the file; what
+    // the sections point at is bounds-checked as it's read
+    bool open (const juce::File& bankFile)
+    {
+        file = std::make_unique<juce::MemoryMappedFile> (bankFile, juce::MemoryMappedFile::readOnly);
+        data = static_cast<const char*> (file->getData());
+        size = file->getSize();
+
+        if (data == nullptr || size < headerSize
+             || read32 (data + magicField) != bankMagic || read32 (data + versionField) != bankVersion
+             || read32 (data + fileSizeField) != size)
+            return false;
+
+        numPresets = read32 (data + numPresetsField);
+        numValues = read32 (data + numValuesField);
+        numTokens = read32 (data + numTokensField);
+        numPostings = read32 (data + numPostingsField);
+        records = read32 (data + recordsField);
+        tokens = read32 (data + tokensField);
+        postings = read32 (data + postingsField);
+        strings = read32 (data + stringsField);
+        stringsSize = read32 (data + stringsSizeField);
+        mergedSequence = read64 (data + sequenceField);
+        recordSize = recordFixedSize + 4 * static_cast<size_t> (numValues);
+
+        auto fits = [this] (size_t offset, juce::uint64 bytes) { return offset >= headerSize && offset + bytes <= size; };
+
+        return numValues <= 1024
+            && fits (records, static_cast<juce::uint64> (numPresets) * recordSize)
+            && fits (tokens, static_cast<juce::uint64> (numTokens) * tokenSize)
+            && fits (postings, static_cast<juce::uint64> (numPostings) * 4)
+            && fits (strings, stringsSize);
+    }
+
+    std::string_view getString (const char* reference) const
+    {
+        const auto offset = read32 (reference);
+        const auto length = read32 (reference + 4);
+
+        if (offset > stringsSize || length > stringsSize - offset)
+            return {};
+
+        return { data + strings + offset, length };
+    }
+
+    const char* getRecord (int record) const { return data + records + static_cast<size_t> (record) * recordSize; }
+    const char* getToken (juce::uint32 token) const { return data + tokens + static_cast<size_t> (token) * tokenSize; }
+
+    juce::String getName (int record) const
+    {
+        const auto name = getString (getRecord (record));
+        return juce::String::fromUTF8 (name.data(), static_cast<int> (name.size()));
+    }
+
+    void getPreset (int record, Preset& result) const
+    {
+        const auto* entry = getRecord (record);
+        const auto tags = getString (entry + 8);
+
+        result.name = getName (record);
+        result.tags = splitTags (juce::String::fromUTF8 (tags.data(), static_cast<int> (tags.size())));
+        result.values.fill (std::numeric_limits<float>::quiet_NaN());
+
+        for (juce::uint32 i = 0; i < juce::jmin (numValues, static_cast<juce::uint32> (numParameters)); ++i)
+            result.values[i] = readFloat (entry + recordFixedSize + 4 * i);
+    }
+
+    // Marks the records containing a word that starts with the prefix and
+    // already matched every earlier query word
+    void markPrefix (std::string_view prefix, juce::uint16 wordIndex, std::vector<juce::uint16>& hits) const
+    {
+        juce::uint32 low = 0, high = numTokens;
+        while (low < high)
+        {
+            const auto middle = low + (high - low) / 2;
+            if (getString (getToken (middle)) < prefix)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        for (auto token = low; token < numTokens; ++token)
+        {
+            const auto* entry = getToken (token);
+            if (! startsWith (getString (entry), prefix))
+                break;
+
+            const auto first = read32 (entry + 8);
+            const auto count = read32 (entry + 12);
+            if (first > numPostings || count > numPostings - first)
+                continue;
+
+            for (auto posting = first; posting < first + count; ++posting)
+            {
+                const auto record = read32 (data + postings + 4 * static_cast<size_t> (posting));
+                if (record < numPresets && hits[record] == wordIndex)
+                    hits[record] = static_cast<juce::uint16> (wordIndex + 1);
+            }
+        }
+    }
+};
+
+//==============================================================================
+int UserPresetBank::getParameterIndex (const juce::String& parameterId)
+{
+    for (int i = 0; i < numParameters; ++i)
+        if (parameterId == juce::String (parameterIds[static_cast<size_t> (i)].data(), parameterIds[static_cast<size_t> (i)].size()))
+            return i;
+
+    return -1;
+}
+
+juce::File UserPresetBank::getDefaultBankFile()
+{
+    return juce::File::getSpecialLocation (juce::File::userDocumentsDirectory)
+               .getChildFile ("Harmonster Presets")
+               .getChildFile ("User Presets.harmonsterbank");
+}
+
+UserPresetBank::UserPresetBank() : UserPresetBank (getDefaultBankFile())
+{
+}
+
+UserPresetBank::UserPresetBank (const juce::File& file)
+    : juce::Thread ("Harmonster preset merge")
+{
+    open (file);
+}
+
+UserPresetBank::~UserPresetBank()
+{
+    // Anything not merged yet stays in the log for the next session
+    stopThread (10000);
+}
+
+void UserPresetBank::open (const juce::File& file)
+{
+    const juce::ScopedLock ml (mergeLock);
+    const juce::ScopedLock sl (lock);
+
+    bankFile = file;
+    mapped.reset();
+    pending.clear();
+    nextSequence = 1;
+
+    auto bank = std::make_unique<MappedBank>();
+    canMerge = ! file.exists() || bank->open (file);
+
+    if (canMerge && file.existsAsFile())
+    {
+        nextSequence = bank->mergedSequence + 1;
+        mapped = std::move (bank);
+    }
+
+    loadLog();
+    rebuildOrder();
+
+    if (! pending.empty() && canMerge)
+    {
+        if (! isThreadRunning())
+            startThread (juce::Thread::Priority::low);
+
+        notify();
+    }
+}
+
+juce::File UserPresetBank::getBankFile() const
+{
+    const juce::ScopedLock sl (lock);
+    return bankFile;
+}
+
+juce::File UserPresetBank::getLogFile() const
+{
+    return bankFile.getSiblingFile (bankFile.getFileName() + ".log");
+}
+
+//==============================================================================
+int UserPresetBank::getNumPresets() const
+{
+    const juce::ScopedLock sl (lock);
+
+    if (pending.empty())
+        return mapped != nullptr ? static_cast<int> (mapped->numPresets) : 0;
+
+    return static_cast<int> (order.size());
+}
+
+int UserPresetBank::getEntry (int index) const
+{
+    return pending.empty() ? index : order[static_cast<size_t> (index)];
+}
+
+juce::String UserPresetBank::readName (int entry) const
+{
+    return entry >= 0 ? mapped->getName (entry) : pending[static_cast<size_t> (-1 - entry)].preset.name;
+}
+
+bool UserPresetBank::readEntry (int entry, Preset& result) const
+{
+    if (entry >= 0)
+        mapped->getPreset (entry, result);
+    else
+        result = pending[static_cast<size_t> (-1 - entry)].preset;
+
+    return true;
+}
+
+juce::String UserPresetBank::getName (int index) const
+{
+    const juce::ScopedLock sl (lock);
+
+    if (! juce::isPositiveAndBelow (index, getNumPresets()))
+        return {};
+
+    return readName (getEntry (index));
+}
+
+bool UserPresetBank::getPreset (int index, Preset& result) const
+{
+    const juce::ScopedLock sl (lock);
+
+    if (! juce::isPositiveAndBelow (index, getNumPresets()))
+        return false;
+
+    return readEntry (getEntry (index), result);
+}
+
+std::vector<int> UserPresetBank::search (const juce::String& query, int maxResults) const
+{
+    const juce::ScopedLock sl (lock);
+
+    const auto words = splitWords (query);
+    const int numPresets = getNumPresets();
+    const int numMapped = mapped != nullptr ? static_cast<int> (mapped->numPresets) : 0;
+
+    // Number of query words each mapped record has matched so far
+    std::vector<juce::uint16> hits (static_cast<size_t> (numMapped), 0);
+    const auto numWords = static_cast<juce::uint16> (juce::jmin (words.size(), 65535));
+
+    if (numMapped > 0)
+        for (juce::uint16 w = 0; w < numWords; ++w)
+            mapped->markPrefix (words[w].toStdString(), w, hits);
+
+    auto pendingMatches = [&words] (const Pending& entry)
+    {
+        for (auto& word : words)
+        {
+            bool found = false;
+            for (auto& candidate : entry.words)
+                found = found || candidate.startsWith (word);
+
+            if (! found)
+                return false;
+        }
+
+        return true;
+    };
+
+    std::vector<int> results;
+
+    for (int index = 0; index < numPresets && static_cast<int> (results.size()) < maxResults; ++index)
+    {
+        const int entry = getEntry (index);
+        const bool matches = entry >= 0 ? hits[static_cast<size_t> (entry)] == numWords
+                                        : pendingMatches (pending[static_cast<size_t> (-1 - entry)]);
+        if (matches)
+            results.push_back (index);
+    }
+
+    return results;
+}
+
+//==============================================================================
+bool UserPresetBank::addPreset (const Preset& preset)
+{
+    if (preset.name.trim().isEmpty())
+        return false;
+
+    const juce::ScopedLock sl (lock);
+
+    Pending entry;
+    entry.preset = preset;
+    entry.preset.name = preset.name.trim();
+    entry.preset.tags = splitTags (joinTags (preset.tags));
+    entry.key = entry.preset.name.toLowerCase();
+    entry.words = wordsOf (entry.preset);
+    entry.sequence = nextSequence;
+
+    juce::MemoryOutputStream payload;
+    writeString (payload, entry.preset.name);
+    writeString (payload, joinTags (entry.preset.tags));
+    payload.writeInt (numParameters);
+    for (auto value : entry.preset.values)
+        payload.writeFloat (value);
+
+    juce::MemoryOutputStream sequenceBytes;
+    sequenceBytes.writeInt64 (static_cast<juce::int64> (entry.sequence));
+
+    juce::MemoryOutputStream record;
+    record.writeInt (static_cast<int> (logMagic));
+    record.writeInt (static_cast<int> (payload.getDataSize()));
+    record << sequenceBytes.getMemoryBlock();
+    record << payload.getMemoryBlock();
+    record.writeInt (static_cast<int> (fnv1a (payload.getData(), payload.getDataSize(),
+                                              fnv1a (sequenceBytes.getData(), sequenceBytes.getDataSize()))));
+
+    const auto logFile = getLogFile();
+    if (logFile.getParentDirectory().createDirectory().failed())
+        return false;
+
+    {
+        juce::FileOutputStream out (logFile);
+        if (! out.openedOk() || ! out.write (record.getData(), record.getDataSize()))
+            return false;
+
+        out.flush();
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    ++nextSequence;
+
+    // Replaces an unmerged preset of the same name; a merged one is hidden by rebuildOrder()
+    auto position = std::lower_bound (pending.begin(), pending.end(), entry.key,
+                                      [] (const Pending& p, const juce::String& key) { return p.key < key; });
+
+    if (position != pending.end() && position->key == entry.key)
+        *position = std::move (entry);
+    else
+        pending.insert (position, std::move (entry));
+
+    rebuildOrder();
+
+    if (canMerge)
+    {
+        if (! isThreadRunning())
+            startThread (juce::Thread::Priority::low);
+
+        notify();
+    }
+
+    return true;
+}
+
+void UserPresetBank::rebuildOrder()
+{
+    order.clear();
+
+    if (pending.empty())
+        return;
+
+    const int numMapped = mapped != nullptr ? static_cast<int> (mapped->numPresets) : 0;
+    order.reserve (static_cast<size_t> (numMapped) + pending.size());
+
+    // Only the records around each pending name are read, so a save into a big
+    // bank doesn't decode every name in it
+    int record = 0;
+
+    for (size_t next = 0; next < pending.size(); ++next)
+    {
+        const auto& key = pending[next].key;
+        int low = record, high = numMapped;
+
+        while (low < high)
+        {
+            const int middle = low + (high - low) / 2;
+            if (mapped->getName (middle).toLowerCase() < key)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        for (; record < low; ++record)
+            order.push_back (record);
+
+        order.push_back (-1 - static_cast<int> (next));
+
+        // A merged preset of the same name is replaced
+        if (record < numMapped && mapped->getName (record).toLowerCase() == key)
+            ++record;
+    }
+
+    for (; record < numMapped; ++record)
+        order.push_back (record);
+}
+
+//==============================================================================
+void UserPresetBank::loadLog()
+{
+    const auto logFile = getLogFile();
+    juce::MemoryBlock log;
+
+    if (! logFile.existsAsFile() || ! logFile.loadFileAsData (log))
+        return;
+
+    const auto* data = static_cast<const char*> (log.getData());
+    const size_t size = log.getSize();
+    const juce::uint64 mergedSequence = mapped != nullptr ? mapped->mergedSequence : 0;
+    size_t position = 0;
+
+    while (size - position >= logEntryOverhead)
+    {
+        const auto* entry = data + position;
+        const size_t payloadSize = read32 (entry + 4);
+
+        if (read32 (entry) != logMagic || payloadSize > size - position - logEntryOverhead)
+            break;
+
+        const auto* payload = entry + 16;
+        const auto checksum = fnv1a (payload, payloadSize, fnv1a (entry + 8, 8));
+        if (read32 (payload + payloadSize) != checksum)
+            break;
+
+        position += logEntryOverhead + payloadSize;
+
+        const auto sequence = read64 (entry + 8);
+        nextSequence = juce::jmax (nextSequence, sequence + 1);
+
+        if (sequence <= mergedSequence)
+            continue;
+
+        // The checksum passed, but the lengths inside still get checked
+        Pending item;
+        size_t offset = 0;
+
+        auto readText = [&] (juce::String& text)
+        {
+            if (payloadSize - offset < 4)
+                return false;
+
+            const size_t length = read32 (payload + offset);
+            offset += 4;
+
+            if (length > payloadSize - offset)
+                return false;
+
+            text = juce::String::fromUTF8 (payload + offset, static_cast<int> (length));
+            offset += length;
+            return true;
+        };
+
+        juce::String tags;
+        if (! readText (item.preset.name) || ! readText (tags) || payloadSize - offset < 4)
+            continue;
+
+        const auto numValues = read32 (payload + offset);
+        offset += 4;
+
+        if (numValues > (payloadSize - offset) / 4)
+            continue;
+
+        for (juce::uint32 i = 0; i < juce::jmin (numValues, static_cast<juce::uint32> (numParameters)); ++i)
+            item.preset.values[i] = readFloat (payload + offset + 4 * i);
+
+        item.preset.tags = splitTags (tags);
+        item.key = item.preset.name.toLowerCase();
+        item.words = wordsOf (item.preset);
+        item.sequence = sequence;
+
+        auto existing = std::lower_bound (pending.begin(), pending.end(), item.key,
+                                          [] (const Pending& p, const juce::String& key) { return p.key < key; });
+
+        if (existing != pending.end() && existing->key == item.key)
+            *existing = std::move (item);
+        else
+            pending.insert (existing, std::move (item));
+    }
+
+    // A save cut short by a crash: drop the torn tail so new entries follow the last good one
+    if (position < size)
+    {
+        juce::FileOutputStream out (logFile);
+
+        if (out.openedOk() && out.setPosition (static_cast<juce::int64> (position)))
+            out.truncate();
+    }
+}
+
+bool UserPresetBank::rewriteLog()
+{
+    const auto logFile = getLogFile();
+
+    if (pending.empty())
+        return logFile.deleteFile();
+
+    // Entries saved while the merge was running; they keep their sequence numbers
+    juce::TemporaryFile temporary (logFile);
+    {
+        juce::FileOutputStream out (temporary.getFile());
+        juce::MemoryBlock log;
+
+        if (! out.openedOk() || ! logFile.loadFileAsData (log))
+            return false;
+
+        const auto* data = static_cast<const char*> (log.getData());
+        const juce::uint64 mergedSequence = mapped->mergedSequence;
+        size_t position = 0;
+
+        while (log.getSize() - position >= logEntryOverhead)
+        {
+            const size_t entrySize = logEntryOverhead + read32 (data + position + 4);
+            if (entrySize > log.getSize() - position)
+                break;
+
+            if (read64 (data + position + 8) > mergedSequence)
+                out.write (data + position, entrySize);
+
+            position += entrySize;
+        }
+
+        out.flush();
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    return temporary.overwriteTargetFileWithTemporary();
+}
+
+bool UserPresetBank::mergeNow()
+{
+    const juce::ScopedLock ml (mergeLock);
+
+    std::vector<Preset> presets;
+    juce::uint64 mergedSequence = 0;
+    juce::File file;
+
+    {
+        const juce::ScopedLock sl (lock);
+
+        if (pending.empty())
+            return true;
+
+        if (! canMerge)
+            return false;
+
+        file = bankFile;
+        const int numMapped = mapped != nullptr ? static_cast<int> (mapped->numPresets) : 0;
+        presets.resize (static_cast<size_t> (numMapped));
+
+        for (int record = 0; record < numMapped; ++record)
+            mapped->getPreset (record, presets[static_cast<size_t> (record)]);
+
+        // Last, so they replace merged presets of the same name
+        for (auto& entry : pending)
+        {
+            presets.push_back (entry.preset);
+            mergedSequence = juce::jmax (mergedSequence, entry.sequence);
+        }
+    }
+
+    // The slow part runs without the lock, so searches carry on meanwhile
+    juce::TemporaryFile temporary (file);
+    if (! writeBankContents (temporary.getFile(), presets, mergedSequence))
+        return false;
+
+    const juce::ScopedLock sl (lock);
+
+    // A mapped file can't be replaced on Windows, so the bank is unmapped for
+    // the rename and mapped again after it, the old one if the rename failed
+    mapped.reset();
+    const bool replaced = temporary.overwriteTargetFileWithTemporary();
+
+    auto bank = std::make_unique<MappedBank>();
+    if (! bank->open (file))
+    {
+        // Never merge over a bank that is there but can't be read
+        canMerge = ! file.exists();
+        rebuildOrder();
+        return false;
+    }
+
+    mapped = std::move (bank);
+
+    if (! replaced)
+        return false;
+
+    pending.erase (std::remove_if (pending.begin(), pending.end(),
+                                   [mergedSequence] (const Pending& entry) { return entry.sequence <= mergedSequence; }),
+                   pending.end());
+
+    rebuildOrder();
+    return rewriteLog();
+}
+
+void UserPresetBank::run()
+{
+    while (! threadShouldExit())
+    {
+        wait (-1);
+
+        // Every save notifies again and restarts the delay, so a burst merges once
+        while (! threadShouldExit() && wait (mergeDelayMs))
+        {
+        }
+
+        if (! threadShouldExit())
+            mergeNow();
+    }
+}
+
+//==============================================================================
+bool UserPresetBank::writeBank (const juce::File& file, const std::vector<Preset>& presets, juce::uint64 mergedSequence)
+{
+    // Written next to the bank and renamed over it, so a reader never sees half a bank
+    juce::TemporaryFile temporary (file);
+
+    return writeBankContents (temporary.getFile(), presets, mergedSequence)
+        && temporary.overwriteTargetFileWithTemporary();
+}
+
+bool UserPresetBank::writeBankContents (const juce::File& file, const std::vector<Preset>& presets, juce::uint64 mergedSequence)
+{
+    // One preset per name, the last one given, in name order
+    std::map<juce::String, const Preset*> byKey;
+    for (auto& preset : presets)
+        if (preset.name.trim().isNotEmpty())
+            byKey[preset.name.trim().toLowerCase()] = &preset;
+
+    std::string strings;
+    auto addString = [&strings] (const juce::String& text)
+    {
+        const auto offset = static_cast<juce::uint32> (strings.size());
+        strings += text.toStdString();
+        return std::make_pair (offset, static_cast<juce::uint32> (strings.size()) - offset);
+    };
+
+    juce::MemoryOutputStream records;
+    std::map<std::string, std::vector<juce::uint32>> postingLists;
+    juce::uint32 record = 0;
+
+    for (auto& [key, preset] : byKey)
+    {
+        const auto name = addString (preset->name.trim());
+        const auto tags = addString (joinTags (preset->tags));
+
+        records.writeInt (static_cast<int> (name.first));
+        records.writeInt (static_cast<int> (name.second));
+        records.writeInt (static_cast<int> (tags.first));
+        records.writeInt (static_cast<int> (tags.second));
+
+        for (auto value : preset->values)
+            records.writeFloat (value);
+
+        for (auto& word : wordsOf (*preset))
+            postingLists[word.toStdString()].push_back (record);
+
+        ++record;
+    }
+
+    juce::MemoryOutputStream tokens, postings;
+    juce::uint32 numPostings = 0;
+
+    // std::map orders by the UTF-8 bytes, as the prefix search expects
+    for (auto& [word, list] : postingLists)
+    {
+        const auto text = addString (juce::String::fromUTF8 (word.data(), static_cast<int> (word.size())));
+        tokens.writeInt (static_cast<int> (text.first));
+        tokens.writeInt (static_cast<int> (text.second));
+        tokens.writeInt (static_cast<int> (numPostings));
+        tokens.writeInt (static_cast<int> (list.size()));
+
+        for (auto posting : list)
+            postings.writeInt (static_cast<int> (posting));
+
+        numPostings += static_cast<juce::uint32> (list.size());
+    }
+
+    const auto recordsOffset = headerSize;
+    const auto tokensOffset = recordsOffset + records.getDataSize();
+    const auto postingsOffset = tokensOffset + tokens.getDataSize();
+    const auto stringsOffset = postingsOffset + postings.getDataSize();
+    const auto fileSize = stringsOffset + strings.size();
+
+    if (fileSize > std::numeric_limits<juce::uint32>::max())
+        return false;
+
+    juce::MemoryOutputStream header;
+    for (auto field : { bankMagic, bankVersion, record, static_cast<juce::uint32> (numParameters),
+                        static_cast<juce::uint32> (postingLists.size()), numPostings,
+                        static_cast<juce::uint32> (recordsOffset), static_cast<juce::uint32> (tokensOffset),
+                        static_cast<juce::uint32> (postingsOffset), static_cast<juce::uint32> (stringsOffset),
+                        static_cast<juce::uint32> (strings.size()), static_cast<juce::uint32> (fileSize) })
+        header.writeInt (static_cast<int> (field));
+
+    header.writeInt64 (static_cast<juce::int64> (mergedSequence));
+    header.writeRepeatedByte (0, headerSize - header.getDataSize());
+
+    if (file.getParentDirectory().createDirectory().failed())
+        return false;
+
+    juce::FileOutputStream out (file);
+
+    if (! out.openedOk())
+        return false;
+
+    out << header.getMemoryBlock() << records.getMemoryBlock() << tokens.getMemoryBlock() << postings.getMemoryBlock();
+    out.write (strings.data(), strings.size());
+    out.flush();
+
+    return ! out.getStatus().failed();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+//==============================================================================
+// User preset bank, one per process (juce::SharedResourcePointer)
+// The bank is a single binary file, memory-mapped read-only: a header,
+// fixed-size preset records, a string pool and a prebuilt search index of
+// every lowercased word in the names and tags, sorted, each with the list of
+// presets it appears in. Opening maps the file and checks the header and
+// nothing else, so a bank of ten thousand presets opens as fast as an empty
+// one. A search is a binary search per query word (matching word prefixes)
+// plus one pass over the presets in name order.
+//
+// Saving appends the preset to a write-ahead log next to the bank, written
+// out before it returns, and makes it searchable straight away. A background
+// thread merges the log into a new bank file a couple of seconds after the
+// last save, renames it over the old one and remaps. The bank header records
+// the last log entry merged, so a crash between the rename and clearing the
+// log can't duplicate presets, and a torn entry at the end of the log is cut
+// off when it is next opened. A preset saved under an existing name (case
+// ignored) replaces it.
+//
+// All public functions are for the message thread or other non-audio
+// threads; the audio thread only ever sees the values of a loaded preset,
+// through the processor's snapshot handoff.
+//==============================================================================
+class UserPresetBank : private juce::Thread
+{
+public:
+    // The parameters a preset stores, in record order. New ones are only
+    // ever appended: an older bank has fewer values per record, and those it
+    // lacks load as "not stored" and leave the parameter alone.
+    static constexpr std::array<std::string_view, 19> parameterIds {{
+        "wool", "pinch", "eq", "output", "sag", "texture", "eqmodel",
+        "harmony", "interval", "harmonymix", "harmonyplace", "harmonyengine",
+        "dual", "woolb", "pinchb", "eqb", "outputb", "blend", "spread"
+    }};
+
+    static constexpr int numParameters = static_cast<int> (parameterIds.size());
+
+    // Plain (not normalised) parameter values; NaN where a preset doesn't store one
+    using Values = std::array<float, numParameters>;
+
+    static int getParameterIndex (const juce::String& parameterId);
+
+    struct Preset
+    {
+        juce::String name;
+        juce::StringArray tags;
+        Values values;
+
+        Preset() { values.fill (std::numeric_limits<float>::quiet_NaN()); }
+    };
+
+    // Documents/Harmonster Presets/User Presets.harmonsterbank
+    static juce::File getDefaultBankFile();
+
+    UserPresetBank();
+    explicit UserPresetBank (const juce::File& bankFile);
+    ~UserPresetBank() override;
+
+    // Maps the bank and replays its log; a missing bank is an empty one.
+    // Not concurrently with a merge: finishes any pending one first.
+    void open (const juce::File& bankFile);
+    juce::File getBankFile() const;
+
+    // Presets are numbered in name order, merged and unmerged alike
+    int getNumPresets() const;
+    juce::String getName (int index) const;
+    bool getPreset (int index, Preset& result) const;
+
+    // Presets whose names or tags contain a word starting with each word of
+    // the query, in name order; an empty query matches everything
+    std::vector<int> search (const juce::String& query, int maxResults = std::numeric_limits<int>::max()) const;
+
+    // Appends to the log and returns once it is written; false if it couldn't be
+    bool addPreset (const Preset& preset);
+
+    // Merges the log into the bank on the calling thread
+    bool mergeNow();
+
+    // Writes a complete bank, index included, replacing the file atomically.
+    // Later presets replace earlier ones with the same name.
+    static bool writeBank (const juce::File& bankFile, const std::vector<Preset>& presets, juce::uint64 mergedSequence = 0);
+
+private:
+    struct MappedBank;
+    struct Pending
+    {
+        Preset preset;
+        juce::String key;  // lowercased name
+        juce::StringArray words;  // what search() matches against
+        juce::uint64 sequence = 0;
+    };
+
+    juce::CriticalSection lock;
+    juce::File bankFile;
+    std::unique_ptr<MappedBank> mapped;  // records are stored in name order
+    std::vector<Pending> pending;        // saved since the last merge, sorted by key
+    juce::uint64 nextSequence = 1;
+
+    // A bank file that exists but can't be read is never merged over
+    bool canMerge = true;
+
+    // Only while there are pending presets: the mapped records minus those
+    // a pending one replaces, merged with the pending ones in name order.
+    // >= 0 is a mapped record, < 0 pending entry -1 - entry.
+    std::vector<int> order;
+
+    juce::CriticalSection mergeLock;  // one merge at a time, and no open() during one
+
+    static constexpr int mergeDelayMs = 2000;
+
+    int getEntry (int index) const;
+    bool readEntry (int entry, Preset& result) const;
+    juce::String readName (int entry) const;
+    void rebuildOrder();
+    void loadLog();
+    bool rewriteLog();
+
+    // writeBank() without the rename: the whole bank, written to file
+    static bool writeBankContents (const juce::File& file, const std::vector<Preset>& presets, juce::uint64 mergedSequence);
+    juce::File getLogFile() const;
+
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (UserPresetBank)
+};
@@ -2,6 +2,19 @@
 #include <cmath>
 #include <algorithm>
 #include <array>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "MemorylessKernels.h"
+#include "PassiveToneStack.h"
+#include "LinearCascade.h"
+
+// Build with HARMONSTER_PRECISE_MATH=1 to run the memoryless stages through the
+// C library (bit-exact with the original per-sample code, but not vectorised)
+#ifndef HARMONSTER_PRECISE_MATH
+ #define HARMONSTER_PRECISE_MATH 0
+#endif
 
 //==============================================================================
 // Clean ZVEX Woolly Mammoth Circuit Emulation
@@ -11,52 +24,236 @@
 class WoolyMammothDSP
 {
 public:
+    // Optional circuit features. The combinations the plugin's switches select
+    // have kernels of their own with the features compiled in or out, so a
+    // disabled feature costs nothing there; any other combination runs a
+    // generic kernel that tests them as it goes.
+    enum Feature : unsigned
+    {
+        supplySag     = 1u << 0,  // 9V battery sag modelling
+        q2Instability = 1u << 1,  // starved-bias sputter in Q2
+        hfTexture     = 1u << 2,  // sin() fuzz texture in the Q2 harmonics
+        bitReduction  = 1u << 3,  // round() quantisation in the Q2 harmonics
+        crossover     = 1u << 4,  // crossover distortion around zero
+        passiveEq     = 1u << 5   // passive RC tone network instead of the classic EQ blend
+    };
+    
+    static constexpr int numFeatures = 6;
+    static constexpr unsigned allFeatures = (1u << numFeatures) - 1u;
+    static constexpr unsigned textureFeatures = q2Instability | hfTexture | bitReduction | crossover;
+    
+    // Cheaper math: FastMath for the memoryless stages and the Q2 tanh, sqrt
+    // instead of pow in the Q2 gate. The dual circuit's paired lanes always
+    // use it. Not a circuit feature, so allFeatures leaves it out.
+    static constexpr unsigned economyMath = 1u << numFeatures;
+    static constexpr unsigned kernelMask = allFeatures | economyMath;
+    
+    // The hand-voiced constants of the transistor stages and the fuzz
+    // harmonics after Q2, so they can be refitted to recordings of a real
+    // pedal (see HarmonsterConstantFit). The defaults are the voicing by ear.
+    // The Q1 saturation curve stays in the vectorised kernel.
+    struct CircuitConstants
+    {
+        // Q1 (first amplification)
+        double q1_bias_voltage = 0.7;
+        double q1_sag_bias_shift = 0.3;
+        double q1_gain = 18.0;
+        double q1_thermal = 0.2;
+        
+        // Q2 (main fuzz, PINCH bias)
+        double q2_bias_voltage = 0.8;
+        double q2_sag_bias_shift = 0.4;
+        double q2_gate_threshold = 0.6;
+        double q2_gain = 50.0;
+        double q2_bias_gain_floor = 0.3;
+        double q2_bias_gain = 2.0;
+        double q2_thermal = 0.5;
+        double q2_saturation = 0.4;
+        double q2_compression = 0.25;
+        double q2_sag_compression = 0.2;
+        double q2_negative_level = 0.6;
+        double q2_positive_squash = 2.0;
+        double q2_negative_squash = 1.5;
+        double q2_vce_threshold = 0.3;
+        double q2_vce_slope = 3.0;
+        double q2_vce_sat = 0.2;
+        
+        // Fuzz harmonics after Q2
+        double fuzz_drive = 1.8;
+        double fuzz_gated_drive = 1.0;
+        double fuzz_harmonics = 0.12;
+        double fuzz_gated_harmonics = 0.08;
+        double fuzz_second = 1.5;
+        double fuzz_third = 1.0;
+        double fuzz_intermodulation = 0.04;
+        double crossover_threshold = 0.12;
+        double crossover_gain = 0.7;
+        double hf_texture_frequency = 30.0;
+        double hf_texture_active_frequency = 15.0;
+        double hf_texture_amount = 0.06;
+        double bit_depth = 32.0;
+        double active_bit_depth = 16.0;
+    };
+    
+    // Everything the circuit remembers from one sample to the next. Knob
+    // settings and rate-dependent coefficients are not part of it, so a state
+    // can be restored into any instance prepared at the same sample rate.
+    struct State
+    {
+        // Transistor nodes and bias points
+        double q1_collector = 0.0, q1_base = 0.0, q1_emitter = 0.0;
+        double q2_collector = 0.0, q2_base = 0.0, q2_emitter = 0.0;
+        double q1_bias = 0.5, q2_bias = 0.5;
+        
+        // Linear segments: input DC blocker, C1 (220nF), WOOL high-pass with
+        // C2 (10nF), and C6 (10nF) with the EQ and anti-aliasing filter
+        LinearCascade<1>::State dc_block_z;
+        LinearCascade<1>::State c1_z;
+        LinearCascade<1>::State inter_stage_z;
+        LinearCascade<3>::State post_q2_z;
+        
+        // Supply sag modeling
+        double current_supply_voltage = 9.0;  // Fresh 9V battery
+        double supply_sag_filter = 0.0;       // For supply voltage smoothing
+        double average_current_draw = 0.0;    // Running average of current consumption
+        
+        // Q2 gating smoother and intermodulation memory
+        double gating_smoother = 1.0;
+        double im_delay = 0.0;
+        
+        // Q2 transistor activity of the last sample
+        double transistor_activity = 1.0;
+        
+        // Dual circuit mode: circuit B's own copy of everything after Q1, and
+        // the blend of the two outputs reached at the end of the last block
+        struct SecondCircuit
+        {
+            double q2_collector = 0.0;
+            LinearCascade<1>::State inter_stage_z;
+            LinearCascade<3>::State post_q2_z;
+            double gating_smoother = 1.0;
+            double im_delay = 0.0;
+            double transistor_activity = 1.0;
+        };
+        
+        SecondCircuit second;
+        double blend_a = 1.0, blend_b = 0.0;
+        bool dual_running = false;
+        
+        // Largest difference in any variable, or infinity if the dual modes
+        // differ; two renders of the same input
+        // whose states are this close carry on this close
+        double distanceTo(const State& other) const
+        {
+            if (dual_running != other.dual_running)
+                return std::numeric_limits<double>::infinity();
+            
+            const double variables[][2] = {
+                { q1_collector, other.q1_collector }, { q1_base, other.q1_base }, { q1_emitter, other.q1_emitter },
+                { q2_collector, other.q2_collector }, { q2_base, other.q2_base }, { q2_emitter, other.q2_emitter },
+                { q1_bias, other.q1_bias }, { q2_bias, other.q2_bias },
+                { current_supply_voltage, other.current_supply_voltage }, { supply_sag_filter, other.supply_sag_filter },
+                { average_current_draw, other.average_current_draw },
+                { gating_smoother, other.gating_smoother }, { im_delay, other.im_delay },
+                { transistor_activity, other.transistor_activity },
+                { second.q2_collector, other.second.q2_collector }, { second.gating_smoother, other.second.gating_smoother },
+                { second.im_delay, other.second.im_delay }, { second.transistor_activity, other.second.transistor_activity },
+                { blend_a, other.blend_a }, { blend_b, other.blend_b } };
+            
+            double distance = std::max({ dc_block_z.distanceTo(other.dc_block_z), c1_z.distanceTo(other.c1_z),
+                                         inter_stage_z.distanceTo(other.inter_stage_z), post_q2_z.distanceTo(other.post_q2_z),
+                                         second.inter_stage_z.distanceTo(other.second.inter_stage_z),
+                                         second.post_q2_z.distanceTo(other.second.post_q2_z) });
+            
+            for (const auto& variable : variables)
+                distance = std::max(distance, std::abs(variable[0] - variable[1]));
+            
+            return distance;
+        }
+    };
+    
+    static_assert(std::is_trivially_copyable_v<State>, "State must stay a plain block of memory");
+    
     WoolyMammothDSP() = default;
     
-    void setSampleRate(double newSampleRate)
+    State snapshot() const { return state; }
+    void restore(const State& newState)
+    {
+        // A state from a running dual circuit needs circuit B's filters here too
+        const bool wasActive = isDualActive();
+        state = newState;
+        
+        if (isDualActive() && ! wasActive)
+            updateSecondCircuitCoefficients();
+    }
+    
+    void setSampleRate(double newSampleRate, int newOversamplingFactor = 1)
     {
+        // newSampleRate is the rate process() runs at; when that is an oversampled
+        // rate the per-sample smoothing constants are rescaled to keep the
+        // time constants of the base-rate circuit
         sampleRate = newSampleRate;
+        oversamplingFactor = std::max(1, newOversamplingFactor);
         
-        // Initialize simple anti-aliasing filter
-        initializeAntiAliasingFilter();
+        // Tone stack coefficient grid for this rate, shared with every other instance
+        toneStackTable = PassiveToneStack::getTable(sampleRate);
         
         updateFilterCoefficients();
+        updateSmoothingCoefficients();
         reset();
     }
     
-    void reset()
+    void adoptStateFrom(const WoolyMammothDSP& other)
     {
-        // Reset all circuit state
-        q1_collector = q1_base = q1_emitter = 0.0;
-        q2_collector = q2_base = q2_emitter = 0.0;
-        
-        // Reset coupling capacitors (AC coupling between stages)
-        c1_voltage = c2_voltage = c6_voltage = 0.0;
+        // Takes over circuit state and knob settings from an instance running at
+        // another oversampling factor, keeping this one's rate-dependent coefficients
+        const double ownSampleRate = sampleRate;
+        const int ownOversamplingFactor = oversamplingFactor;
+        auto ownToneStackTable = std::move(toneStackTable);
         
-        // Reset DC bias points
-        q1_bias = 0.5;  // Quiescent bias point
-        q2_bias = 0.5;  // This will be modulated by PINCH
+        *this = other;
         
-        // Reset filters
-        wool_filter_z1 = 0.0;
-        eq_filter_z1 = eq_filter_z2 = 0.0;
-        
-        // Reset DC blocking
-        dc_block_in = dc_block_out = 0.0;
-        
-        // Reset anti-aliasing filter
-        antiAlias_x1 = antiAlias_x2 = 0.0;
-        antiAlias_y1 = antiAlias_y2 = 0.0;
-        
-        // Reset supply sag modeling
-        current_supply_voltage = nominal_supply_voltage;
-        supply_sag_filter = 0.0;
-        average_current_draw = 0.0;
-        
-        // Reset smooth gating (only addition to prevent cutouts)
-        gating_smoother = 1.0;
+        sampleRate = ownSampleRate;
+        oversamplingFactor = ownOversamplingFactor;
+        toneStackTable = std::move(ownToneStackTable);
+        updateFilterCoefficients();
+        updateSmoothingCoefficients();
+    }
+    
+    // Current Q2 transistor activity: 1 = gate fully open, ~0.05 = starved shut
+    double getGateActivity() const { return state.gating_smoother; }
+    
+    // Battery voltage under the current load; nominal while sag is switched off
+    double getSupplyVoltage() const
+    {
+        if ((features & supplySag) == 0)
+            return nominal_supply_voltage;
+        return std::max(nominal_supply_voltage - state.supply_sag_filter, minimum_supply_voltage);
+    }
+    
+    void reset()
+    {
+        // Back to the quiescent circuit: caps discharged, fresh battery, gate open
+        state = State{};
+    }
+    
+    void setFeatures(unsigned newFeatures)
+    {
+        // Selects which kernel processBlock() dispatches to; the EQ model is
+        // part of the compiled output segment
+        const bool eqModelChanged = ((newFeatures ^ features) & passiveEq) != 0;
+        features = newFeatures & kernelMask;
+        kernel = kernelFor(features);
+        
+        if (eqModelChanged)
+            updateLinearSegments();
     }
     
+    unsigned getFeatures() const { return features; }
+    
+    void setCircuitConstants(const CircuitConstants& newConstants) { constants = newConstants; }
+    const CircuitConstants& getCircuitConstants() const { return constants; }
+    
     void setWool(double value)
     {
         // WOOL (2k linear) - bass roll-off before fuzz stages
@@ -68,9 +265,7 @@ public:
     {
         // PINCH (500k linear) - controls Q2 bias, creates gated/starved effect
         pinch = std::clamp(value, 0.0, 1.0);
-        // Higher pinch = more bias starvation = more gating
-        // SMALL CHANGE: Slightly less extreme range to prevent total cutouts
-        q2_bias_level = 0.15 + (1.0 - pinch) * 0.65;  // 0.15 to 0.8 bias range (was 0.1 to 0.8)
+        q2_bias_level = biasLevelForPinch(pinch);
     }
     
     void setEQ(double value)
@@ -84,62 +279,438 @@ public:
     {
         // OUTPUT (10k linear) - final volume control with good range
         output = std::clamp(value, 0.0, 1.0);
-        output_gain = 0.2 + (output * 3.0);  // More reasonable range: 0.2 to 3.2 gain
+        output_gain = gainForOutput(output);
+    }
+    
+    void setKnobs(double woolValue, double pinchValue, double eqValue, double outputValue)
+    {
+        // All four knobs with at most one redesign of the filters, and none
+        // while WOOL and EQ hold still, so automation can move the knobs every
+        // few dozen samples without redesigning filters that haven't changed
+        setPinch(pinchValue);
+        setOutput(outputValue);
+        
+        const double newWool = std::clamp(woolValue, 0.0, 1.0);
+        const double newEq = std::clamp(eqValue, 0.0, 1.0);
+        
+        if (knobMoved(wool, newWool) || knobMoved(eq, newEq))
+        {
+            wool = newWool;
+            eq = newEq;
+            updateFilterCoefficients();
+        }
     }
     
+    // Dual circuit mode: a second set of knobs, circuit B, runs on the same
+    // input, and processBlock() returns blendA x circuit A + blendB x circuit B.
+    // Everything up to and including Q1 is independent of the knobs, so the
+    // two circuits share it; from the WOOL filter on they run side by side in
+    // the two lanes of one SIMD register. Circuit B starts from circuit A's
+    // state when switched on, and the blend gains move in a linear ramp over
+    // each block, so switching, blending and panning don't click.
+    void setSecondCircuit(bool enabled, double woolValue, double pinchValue, double eqValue, double outputValue)
+    {
+        // Like setKnobs(), circuit B's filters are only redesigned when they change
+        const bool wasActive = isDualActive();
+        const double newWool = std::clamp(woolValue, 0.0, 1.0);
+        const double newEq = std::clamp(eqValue, 0.0, 1.0);
+        const bool filtersMoved = knobMoved(second.wool, newWool) || knobMoved(second.eq, newEq);
+        
+        dualEnabled = enabled;
+        second.wool = newWool;
+        second.pinch = std::clamp(pinchValue, 0.0, 1.0);
+        second.eq = newEq;
+        second.output = std::clamp(outputValue, 0.0, 1.0);
+        second.q2_bias_level = biasLevelForPinch(second.pinch);
+        second.output_gain = gainForOutput(second.output);
+        
+        if (isDualActive() && (filtersMoved || ! wasActive))
+            updateSecondCircuitCoefficients();
+    }
+    
+    void setBlend(double gainA, double gainB)
+    {
+        blendA = gainA;
+        blendB = gainB;
+    }
+    
+    bool isDualEnabled() const { return dualEnabled; }
+    
     double process(double input)
     {
-        // MASSIVE INPUT OVERDRIVE STAGE - Built-in aggressive pre-saturation
-        double overdriven_input = aggressiveInputOverdrive(input);
-        
-        // Input DC blocking
-        double dc_blocked = dcBlockingFilter(overdriven_input);
+        // Reference path: always runs the full circuit A, with the EQ model
+        // selected by setFeatures()
+        return processSample<allFeatures>(input);
+    }
+    
+    // Processes a block in place using the kernel specialised for the enabled features
+    void processBlock(float* samples, int numSamples);
+    
+    // Renders one input with Lanes sets of circuit constants in a single
+    // pass, for HarmonsterConstantFit's candidates: lane k is circuit A with
+    // candidates[k], starting from start, and writes outputs[k]. Everything
+    // before Q1 is shared, and from Q1 on the lanes run in lockstep like the
+    // dual circuit's, economy math in Q2 included. This instance's own state
+    // is left as it was.
+    template <std::size_t Lanes>
+    void processCandidates(const State& start, const CircuitConstants (&candidates)[Lanes],
+                           const float* input, float* const (&outputs)[Lanes], int numSamples);
+    
+    // Designs of the linear stages after Q2, public for the equivalence check
+    // in HarmonsterKernelBench
+    static LinearStage classicEqStage(double eq, double sampleRate)
+    {
+        // EQ control - passive tone shaping after fuzz, the classic model:
+        // two one-pole low-passes L = (1 - alpha) / (1 - alpha z^-1) in series,
+        // bass L^2 blended against treble 1 - L. CCW = more bass, CW = more treble.
+        //   (1 - eq) L^2 + 0.7 eq (1 - L)
+        const double eq_cutoff = 800.0 + (eq * 2200.0);  // 800Hz to 3000Hz
+        const double alpha = 1.0 / (1.0 + (2.0 * M_PI * eq_cutoff / sampleRate));
+        const double beta = 1.0 - alpha;
+        const double treble = 0.7 * eq * alpha;
+        
+        return LinearStage::biquad((1.0 - eq) * beta * beta + treble, -treble * (1.0 + alpha), treble * alpha,
+                                   -2.0 * alpha, alpha * alpha);
+    }
+    
+    static LinearStage antiAliasingStage(double sampleRate)
+    {
+        // Design a simple 2nd-order Butterworth low-pass filter
+        // Cutoff at about 80% of Nyquist to prevent aliasing
+        double cutoff = sampleRate * 0.4;  // 40% of sample rate
+        double omega = 2.0 * M_PI * cutoff / sampleRate;
+        double cos_omega = std::cos(omega);
+        double sin_omega = std::sin(omega);
+        double alpha = sin_omega / (2.0 * 0.707);  // Q = 0.707 for Butterworth
         
-        // Estimate current consumption from input signal level
-        double instantaneous_current = std::abs(dc_blocked) * 0.02;
+        // Low-pass biquad coefficients, normalised
+        double a0 = 1.0 + alpha;
+        return LinearStage::biquad((1.0 - cos_omega) / 2.0 / a0, (1.0 - cos_omega) / a0, (1.0 - cos_omega) / 2.0 / a0,
+                                   -2.0 * cos_omega / a0, (1.0 - alpha) / a0);
+    }
+
+private:
+    using Math = std::conditional_t<HARMONSTER_PRECISE_MATH != 0, PreciseMath, FastMath>;
+    
+    // Any change at all, however small, counts: the filters are redesigned
+    // exactly when the clamped knob value differs from the one they were made for
+    static bool knobMoved(double from, double to) { return from < to || from > to; }
+    
+    template <unsigned Features>
+    using Kernels = MemorylessKernels<std::conditional_t<(Features & economyMath) != 0, FastMath, Math>>;
+    
+    // Samples per pass of the block kernels; the scratch lives on the stack
+    static constexpr int subBlockSize = 64;
+    
+    using BlockKernel = void (WoolyMammothDSP::*)(float*, int);
+    
+    // The feature masks the sag, texture and EQ model switches select, the
+    // only ones the plugin runs. Each has a kernel without and with economy
+    // math; every other mask shares the generic pair of kernels, which read
+    // the circuit features from the features member.
+    static constexpr std::array<unsigned, 8> switchFeatureMasks {{
+        0u,
+        supplySag,
+        textureFeatures,
+        supplySag | textureFeatures,
+        passiveEq,
+        passiveEq | supplySag,
+        passiveEq | textureFeatures,
+        allFeatures
+    }};
+    
+    static constexpr unsigned genericFeatures = economyMath << 1;
+    static constexpr std::size_t numKernels = 2 * (switchFeatureMasks.size() + 1);
+    
+    static constexpr unsigned kernelFeatures(std::size_t index)
+    {
+        const std::size_t pair = index / 2;
+        const unsigned circuit = pair < switchFeatureMasks.size() ? switchFeatureMasks[pair] : genericFeatures;
+        return circuit | (index % 2 != 0 ? economyMath : 0u);
+    }
+    
+    static constexpr std::size_t kernelFor(unsigned mask)
+    {
+        std::size_t pair = 0;
+        while (pair < switchFeatureMasks.size() && switchFeatureMasks[pair] != (mask & allFeatures))
+            ++pair;
         
-        // Update average current draw with smoothing
-        average_current_draw = average_current_draw * 0.999 + instantaneous_current * 0.001;
+        return 2 * pair + ((mask & economyMath) != 0 ? 1 : 0);
+    }
+    
+    // Whether a kernel runs a circuit feature: a constant in the specialised
+    // kernels, so the test compiles away, and a test of features in the generic ones
+    template <unsigned Features>
+    bool runs(unsigned feature) const
+    {
+        if constexpr ((Features & genericFeatures) != 0)
+            return (features & feature) != 0;
+        else
+            return (Features & feature) != 0;
+    }
+    
+    template <std::size_t... Indices>
+    static constexpr std::array<BlockKernel, sizeof...(Indices)> makeBlockKernels(std::index_sequence<Indices...>)
+    {
+        return {{ &WoolyMammothDSP::processBlockWith<kernelFeatures(Indices)>... }};
+    }
+    
+    template <std::size_t... Indices>
+    static constexpr std::array<BlockKernel, sizeof...(Indices)> makeDualBlockKernels(std::index_sequence<Indices...>)
+    {
+        return {{ &WoolyMammothDSP::processDualBlockWith<kernelFeatures(Indices)>... }};
+    }
+    
+    template <std::size_t Lanes>
+    using CandidateKernel = void (WoolyMammothDSP::*)(const CircuitConstants (&)[Lanes], const float*, float* const (&)[Lanes], int);
+    
+    template <std::size_t Lanes, std::size_t... Indices>
+    static constexpr std::array<CandidateKernel<Lanes>, sizeof...(Indices)> makeCandidateKernels(std::index_sequence<Indices...>)
+    {
+        return {{ &WoolyMammothDSP::processCandidatesWith<kernelFeatures(Indices), Lanes>... }};
+    }
+    
+    template <unsigned Features>
+    void processBlockWith(float* samples, int numSamples)
+    {
+        // The memoryless input and output stages run over each sub-block in
+        // vectorisable loops and the linear segments on either side of the
+        // transistors in loops of their own; only Q1, Q2 and what lies
+        // between them run inside the per-sample circuit loop
+        double stage[subBlockSize];
+        double coupled[subBlockSize];
+        double supplyGain[subBlockSize];
+        const bool hasSag = runs<Features>(supplySag);
+        
+        for (int start = 0; start < numSamples; start += subBlockSize)
+        {
+            const int count = std::min(subBlockSize, numSamples - start);
+            float* block = samples + start;
+            
+            Kernels<Features>::inputOverdrive(block, stage, count);
+            
+            // The sag model reads the signal between the DC blocker and C1
+            dcBlockSegment.process(stage, stage, count, state.dc_block_z);
+            c1Segment.process(stage, coupled, count, state.c1_z);
+            
+            for (int i = 0; i < count; ++i)
+                stage[i] = processTransistors<Features>(stage[i], coupled[i], supplyGain[i]);
+            
+            outputSegment.process(stage, stage, count, state.post_q2_z);
+            
+            // Without sag the supply gain is exactly 1
+            Kernels<Features>::outputStage(stage, hasSag ? supplyGain : nullptr, output_gain, block, count);
+        }
+    }
+    
+    template <unsigned Features>
+    void processDualBlockWith(float* samples, int numSamples)
+    {
+        // As processBlockWith() up to Q1. From the WOOL filter to C6 the two
+        // circuits go through each sample together, circuit A in lane 0 and
+        // circuit B in lane 1, with their memory held in locals for the block;
+        // the output stages and the blend then run over the sub-block
+        double stage[subBlockSize];
+        double coupled[subBlockSize];
+        double supplyGain[subBlockSize];
+        double stageB[subBlockSize];
+        const bool hasSag = runs<Features>(supplySag);
+        
+        auto interStageState = LinearCascadePair<1>::load({ &state.inter_stage_z, &state.second.inter_stage_z });
+        auto postQ2State = LinearCascadePair<3>::load({ &state.post_q2_z, &state.second.post_q2_z });
+        
+        Q2Lanes<2> q2 {};
+        q2.bias_level[0] = q2_bias_level;
+        q2.bias_level[1] = second.q2_bias_level;
+        q2.transistor_activity[0] = state.transistor_activity;
+        q2.transistor_activity[1] = state.second.transistor_activity;
+        q2.gating_smoother[0] = state.gating_smoother;
+        q2.gating_smoother[1] = state.second.gating_smoother;
+        q2.im_delay[0] = state.im_delay;
+        q2.im_delay[1] = state.second.im_delay;
+        
+        // Switching the mode off ramps circuit B out over this block
+        const double targetA = dualEnabled ? blendA : 1.0;
+        const double targetB = dualEnabled ? blendB : 0.0;
+        const double stepA = (targetA - state.blend_a) / numSamples;
+        const double stepB = (targetB - state.blend_b) / numSamples;
+        
+        double q2_out[2] = { state.q2_collector, state.second.q2_collector };
+        
+        for (int start = 0; start < numSamples; start += subBlockSize)
+        {
+            const int count = std::min(subBlockSize, numSamples - start);
+            float* block = samples + start;
+            
+            Kernels<Features>::inputOverdrive(block, stage, count);
+            dcBlockSegment.process(stage, stage, count, state.dc_block_z);
+            c1Segment.process(stage, coupled, count, state.c1_z);
+            
+            for (int i = 0; i < count; ++i)
+            {
+                double supply_voltage = nominal_supply_voltage;
+                const double q1_out = supplyAndQ1<Features>(stage[i], coupled[i], supply_voltage);
+                supplyGain[i] = supply_voltage / nominal_supply_voltage;
+                
+                const double shared[2] = { q1_out, q1_out };
+                dualInterStageSegment.processSample(shared, q2.input, interStageState);
+                transistorQ2Lanes<Features>(q2, SharedConstants { constants }, supply_voltage, q2_out);
+                
+                double post[2];
+                dualOutputSegment.processSample(q2_out, post, postQ2State);
+                stage[i] = post[0];
+                stageB[i] = post[1];
+            }
+            
+            Kernels<Features>::blendedOutputStage(stage, stageB, hasSag ? supplyGain : nullptr, output_gain, second.output_gain,
+                                                  state.blend_a + stepA * start, stepA,
+                                                  state.blend_b + stepB * start, stepB, block, count);
+        }
         
-        // Calculate supply voltage with sag
-        double supply_voltage = calculateSupplySag(average_current_draw + instantaneous_current * 0.1);
+        state.blend_a = targetA;
+        state.blend_b = targetB;
+        
+        LinearCascadePair<1>::store(interStageState, { &state.inter_stage_z, &state.second.inter_stage_z });
+        LinearCascadePair<3>::store(postQ2State, { &state.post_q2_z, &state.second.post_q2_z });
+        state.transistor_activity = q2.transistor_activity[0];
+        state.second.transistor_activity = q2.transistor_activity[1];
+        state.gating_smoother = q2.gating_smoother[0];
+        state.second.gating_smoother = q2.gating_smoother[1];
+        state.im_delay = q2.im_delay[0];
+        state.second.im_delay = q2.im_delay[1];
+        state.q2_collector = q2_out[0];
+        state.second.q2_collector = q2_out[1];
+    }
+    
+    template <unsigned Features, std::size_t Lanes>
+    void processCandidatesWith(const CircuitConstants (&candidates)[Lanes], const float* input, float* const (&outputs)[Lanes], int numSamples)
+    {
+        // As processDualBlockWith(), with the same knobs in every lane and
+        // the constants differing from Q1 on
+        double stage[subBlockSize];
+        double coupled[subBlockSize];
+        double supplyGain[subBlockSize];
+        double laneStage[Lanes][subBlockSize];
+        const bool hasSag = runs<Features>(supplySag);
+        
+        std::array<const LinearCascade<1>*, Lanes> interStageSegments;
+        std::array<const LinearCascade<3>*, Lanes> outputSegments;
+        std::array<const LinearCascade<1>::State*, Lanes> interStageStates;
+        std::array<const LinearCascade<3>::State*, Lanes> postQ2States;
+        interStageSegments.fill(&interStageSegment);
+        outputSegments.fill(&outputSegment);
+        interStageStates.fill(&state.inter_stage_z);
+        postQ2States.fill(&state.post_q2_z);
+        
+        const auto laneInterStageSegment = LinearCascadeLanes<1, Lanes>::pack(interStageSegments);
+        const auto laneOutputSegment = LinearCascadeLanes<3, Lanes>::pack(outputSegments);
+        auto interStageState = LinearCascadeLanes<1, Lanes>::load(interStageStates);
+        auto postQ2State = LinearCascadeLanes<3, Lanes>::load(postQ2States);
+        
+        Q2Lanes<Lanes> q2 {};
+        std::fill_n(q2.bias_level, Lanes, q2_bias_level);
+        std::fill_n(q2.transistor_activity, Lanes, state.transistor_activity);
+        std::fill_n(q2.gating_smoother, Lanes, state.gating_smoother);
+        std::fill_n(q2.im_delay, Lanes, state.im_delay);
+        
+        for (int start = 0; start < numSamples; start += subBlockSize)
+        {
+            const int count = std::min(subBlockSize, numSamples - start);
+            
+            Kernels<Features>::inputOverdrive(input + start, stage, count);
+            dcBlockSegment.process(stage, stage, count, state.dc_block_z);
+            c1Segment.process(stage, coupled, count, state.c1_z);
+            
+            for (int i = 0; i < count; ++i)
+            {
+                const double supply_voltage = supplyVoltage<Features>(stage[i]);
+                supplyGain[i] = supply_voltage / nominal_supply_voltage;
+                
+                double q1_out[Lanes];
+                for (std::size_t lane = 0; lane < Lanes; ++lane)
+                    q1_out[lane] = transistorQ1<Features>(coupled[i], supply_voltage, candidates[lane]);
+                
+                double q2_out[Lanes];
+                laneInterStageSegment.processSample(q1_out, q2.input, interStageState);
+                transistorQ2Lanes<Features>(q2, candidates, supply_voltage, q2_out);
+                
+                double post[Lanes];
+                laneOutputSegment.processSample(q2_out, post, postQ2State);
+                for (std::size_t lane = 0; lane < Lanes; ++lane)
+                    laneStage[lane][i] = post[lane];
+            }
+            
+            for (std::size_t lane = 0; lane < Lanes; ++lane)
+                Kernels<Features>::outputStage(laneStage[lane], hasSag ? supplyGain : nullptr, output_gain, outputs[lane] + start, count);
+        }
+    }
+    
+    template <unsigned Features>
+    double processSample(double input)
+    {
+        // MASSIVE INPUT OVERDRIVE STAGE - Built-in aggressive pre-saturation
+        double overdriven_input = Kernels<Features>::inputOverdrive(input);
         
-        // C1 coupling capacitor (220nF) - AC coupling to Q1
-        double c1_coupled = acCouplingFilter(dc_blocked, c1_voltage, 0.999);
+        // Input DC blocking, then the C1 coupling capacitor (220nF) into Q1
+        double dc_blocked = dcBlockSegment.processSample(overdriven_input, state.dc_block_z);
+        double c1_coupled = c1Segment.processSample(dc_blocked, state.c1_z);
         
-        // Q1 transistor stage (2N3904) - first amplification with supply-dependent bias
-        double q1_out = transistorQ1(c1_coupled, supply_voltage);
+        double supply_gain_factor = 1.0;
+        double q2_out = processTransistors<Features>(dc_blocked, c1_coupled, supply_gain_factor);
         
-        // Apply WOOL bass roll-off before Q2 (this is where it affects the circuit)
-        double wool_filtered = woolBassFilter(q1_out);
+        // C6 coupling capacitor, EQ and anti-aliasing filter
+        double anti_aliased = outputSegment.processSample(q2_out, state.post_q2_z);
         
-        // ADDITIONAL OVERDRIVE between Q1 and Q2 for maximum aggression
-        double inter_stage_overdrive = interStageOverdrive(wool_filtered);
+        // Final output gain (also affected by supply voltage), then enhanced
+        // soft limiting with more aggressive character
+        return Kernels<Features>::softLimit(anti_aliased * output_gain * supply_gain_factor);
+    }
+    
+    // Supply sag, Q1, the inter-stage segment and Q2: everything between C1
+    // and C6. Returns the Q2 output and the supply gain factor for the output stage.
+    template <unsigned Features>
+    double processTransistors(double dc_blocked, double c1_coupled, double& supply_gain_factor)
+    {
+        // Supply voltage is a constant 9V unless sag modelling is enabled
+        double supply_voltage = nominal_supply_voltage;
+        double q1_out = supplyAndQ1<Features>(dc_blocked, c1_coupled, supply_voltage);
         
-        // C2 coupling capacitor (10nF) - AC coupling to Q2
-        double c2_coupled = acCouplingFilter(inter_stage_overdrive, c2_voltage, 0.995);
+        // WOOL bass roll-off, inter-stage boost and C2 coupling capacitor (10nF) into Q2
+        double c2_coupled = interStageSegment.processSample(q1_out, state.inter_stage_z);
         
         // Q2 transistor stage (2N3904) - main fuzz with bias control (PINCH) and supply effects
-        double q2_out = transistorQ2Improved(c2_coupled, supply_voltage);
-        
-        // C6 coupling capacitor (10nF) - AC coupling to output
-        double c6_coupled = acCouplingFilter(q2_out, c6_voltage, 0.995);
+        supply_gain_factor = supply_voltage / nominal_supply_voltage;
+        return transistorQ2Improved<Features>(c2_coupled, supply_voltage);
+    }
+    
+    // Supply sag and Q1, the part of the circuit no knob reaches, so the dual
+    // mode runs it once for both circuits
+    template <unsigned Features>
+    double supplyAndQ1(double dc_blocked, double c1_coupled, double& supply_voltage)
+    {
+        supply_voltage = supplyVoltage<Features>(dc_blocked);
         
-        // EQ passive tone control (post-fuzz)
-        double eq_shaped = eqToneControl(c6_coupled);
+        // Q1 transistor stage (2N3904) - first amplification with supply-dependent bias
+        return transistorQ1<Features>(c1_coupled, supply_voltage, constants);
+    }
+    
+    // The battery voltage under the load the signal draws, nominal without sag
+    template <unsigned Features>
+    double supplyVoltage(double dc_blocked)
+    {
+        if (! runs<Features>(supplySag))
+            return nominal_supply_voltage;
         
-        // Anti-aliasing filter to reduce high-frequency artifacts from nonlinear processing
-        double anti_aliased = antiAliasingFilter(eq_shaped);
+        // Estimate current consumption from input signal level
+        double instantaneous_current = std::abs(dc_blocked) * 0.02;
         
-        // Final output gain (also affected by supply voltage)
-        double supply_gain_factor = supply_voltage / nominal_supply_voltage;
-        double final_out = anti_aliased * output_gain * supply_gain_factor;
+        // Update average current draw with smoothing
+        state.average_current_draw = state.average_current_draw * current_draw_pole + instantaneous_current * current_draw_gain;
         
-        // Enhanced soft limiting with more aggressive character
-        return aggressiveSoftLimit(final_out);
+        // Calculate supply voltage with sag
+        return calculateSupplySag(state.average_current_draw + instantaneous_current * 0.1);
     }
-
-private:
+    
     // Parameters
     double sampleRate = 44100.0;
     double wool = 0.5;      // WOOL knob (2k linear)
@@ -147,330 +718,378 @@ private:
     double eq = 0.5;        // EQ knob (10k linear)
     double output = 0.5;    // OUTPUT knob (10k linear)
     
+    // Processing rate relative to the host rate
+    int oversamplingFactor = 1;
+    
+    // Per-sample smoothing coefficients (base-rate values, rescaled when oversampled)
+    double c1_time_constant = 0.999;
+    double c2_time_constant = 0.995;
+    double c6_time_constant = 0.995;
+    double dc_block_pole = 0.995;
+    double current_draw_pole = 0.999, current_draw_gain = 0.001;
+    double sag_pole = 0.99, sag_gain = 0.01;
+    double gating_pole = 0.98, gating_gain = 0.02;
+    double im_pole = 0.95, im_gain = 0.05;
+    
+    // Transistor stage voicing
+    CircuitConstants constants;
+    
     // Derived parameters
     double q2_bias_level = 0.5;
     double output_gain = 1.0;
     double wool_cutoff = 200.0;
-    double eq_cutoff = 2000.0;
+    
+    // Passive tone stack: shared coefficient grid and the current knob's biquad
+    std::shared_ptr<const PassiveToneStack::Table> toneStackTable;
+    PassiveToneStack::Coefficients toneStack;
     
     // Supply sag modeling
     static constexpr double nominal_supply_voltage = 9.0;  // Fresh 9V battery
     static constexpr double minimum_supply_voltage = 6.0;  // Dead battery threshold
     static constexpr double battery_internal_resistance = 2.5;  // Ohms (varies with battery age)
-    double current_supply_voltage = nominal_supply_voltage;
-    double supply_sag_filter = 0.0;  // For supply voltage smoothing
-    double average_current_draw = 0.0;  // Running average of current consumption
     
-    // Circuit state variables
-    double q1_collector = 0.0, q1_base = 0.0, q1_emitter = 0.0;
-    double q2_collector = 0.0, q2_base = 0.0, q2_emitter = 0.0;
-    double q1_bias = 0.5, q2_bias = 0.5;
+    // Circuit memory (see State)
+    State state;
+    
+    // The linear runs between the nonlinear stages, each compiled into a
+    // minimal cascade by updateLinearSegments(). The DC blocker and C1 stay
+    // apart because the sag model reads the signal between them.
+    LinearCascade<1> dcBlockSegment;
+    LinearCascade<1> c1Segment;
+    LinearCascade<1> interStageSegment;
+    LinearCascade<3> outputSegment;
     
-    // Coupling capacitors
-    double c1_voltage = 0.0;   // C1: 220nF
-    double c2_voltage = 0.0;   // C2: 10nF
-    double c6_voltage = 0.0;   // C6: 10nF
+    // Dual circuit mode: circuit B's knobs and what they set, and both
+    // circuits' segments after Q1 packed lane by lane. Only kept up to date
+    // while the mode is in use.
+    struct SecondCircuit
+    {
+        double wool = 0.5, pinch = 0.5, eq = 0.5, output = 0.5;
+        double q2_bias_level = 0.5;
+        double output_gain = 1.0;
+        PassiveToneStack::Coefficients toneStack;
+        LinearCascade<1> interStageSegment;
+        LinearCascade<3> outputSegment;
+    };
     
-    // Filter states
-    double wool_filter_z1 = 0.0;
-    double eq_filter_z1 = 0.0, eq_filter_z2 = 0.0;
+    SecondCircuit second;
+    bool dualEnabled = false;
+    double blendA = 1.0, blendB = 0.0;
+    LinearCascadePair<1> dualInterStageSegment;
+    LinearCascadePair<3> dualOutputSegment;
     
-    // DC blocking
-    double dc_block_in = 0.0, dc_block_out = 0.0;
+    bool isDualActive() const { return dualEnabled || state.dual_running; }
     
-    // Anti-aliasing filter states
-    double antiAlias_x1 = 0.0, antiAlias_x2 = 0.0;
-    double antiAlias_y1 = 0.0, antiAlias_y2 = 0.0;
-    double antiAlias_b0 = 1.0, antiAlias_b1 = 0.0, antiAlias_b2 = 0.0;
-    double antiAlias_a1 = 0.0, antiAlias_a2 = 0.0;
+    // Enabled Feature bits, and the kernel they select
+    unsigned features = allFeatures;
+    std::size_t kernel = kernelFor(allFeatures);
     
-    // ONLY ADDITION: Simple gating smoother to prevent cutouts
-    double gating_smoother = 1.0;
+    // Inter-stage overdrive between Q1 and Q2 was too much; this gentle boost replaces it
+    static constexpr double inter_stage_gain = 1.3;
     
-    // NEW: Moderate input overdrive stage - more musical
-    double aggressiveInputOverdrive(double input)
+    void updateLinearSegments()
     {
-        // Moderate input boost and saturation - musical overdrive
-        
-        // Stage 1: Reasonable input gain boost
-        double boosted = input * 3.5;  // Reduced from 8.0 to 3.5
-        
-        // Stage 2: Softer asymmetric clipping
-        double clipped;
-        if (boosted > 0.0) {
-            clipped = 0.9 * std::tanh(boosted * 1.5);  // Softer positive clipping
-        } else {
-            clipped = 0.8 * std::tanh(boosted * 1.8);  // Moderate negative clipping
-        }
+        dcBlockSegment = LinearCascade<1>::compile({ LinearStage::dcBlocker(dc_block_pole) });
+        c1Segment = LinearCascade<1>::compile({ LinearStage::capacitorHighPass(c1_time_constant) });
+        interStageSegment = compileInterStageSegment(wool_cutoff);
+        outputSegment = compileOutputSegment(eq, toneStack);
         
-        // Stage 3: Moderate harmonic distortion
-        double squared = clipped * clipped;
-        clipped += squared * 0.15;  // Reduced harmonic content
-        
-        // Stage 4: Skip bit crushing - too harsh
-        
-        // Stage 5: Gentle final saturation
-        clipped = std::tanh(clipped * 1.2) * 0.85;  // Gentler final stage
-        
-        return clipped;
+        if (isDualActive())
+            updateSecondCircuitSegments();
     }
     
-    // REMOVED: Inter-stage overdrive - was too much
-    double interStageOverdrive(double input)
+    LinearCascade<1> compileInterStageSegment(double cutoff) const
     {
-        // Just a gentle boost instead of aggressive overdrive
-        return input * 1.3;  // Simple 1.3x boost instead of complex overdrive
+        // WOOL control - bass roll-off before Q2 (high-pass), then C2
+        const double wool_alpha = 1.0 / (1.0 + (2.0 * M_PI * cutoff / sampleRate));
+        return LinearCascade<1>::compile({
+            LinearStage::capacitorHighPass(wool_alpha),
+            LinearStage::gain(inter_stage_gain),
+            LinearStage::capacitorHighPass(c2_time_constant) });
     }
     
-    // NEW: More reasonable soft limiting
-    double aggressiveSoftLimit(double input)
+    LinearCascade<3> compileOutputSegment(double eqValue, const PassiveToneStack::Coefficients& stack) const
     {
-        // Moderate limiting with character but not extreme
-        
-        // Stage 1: Gentle compression
-        double compressed = input / (1.0 + std::abs(input) * 0.5);
-        
-        // Stage 2: Moderate asymmetric saturation
-        double limited;
-        if (compressed > 0.0) {
-            limited = 0.9 * std::tanh(compressed * 1.8);
-        } else {
-            limited = 0.85 * std::tanh(compressed * 2.0);
-        }
-        
-        // Stage 3: Add subtle harmonics
-        limited += limited * limited * 0.04;  // Gentle harmonic enhancement
-        
-        return limited;
+        // C6, the EQ (passive tone network or classic blend), then anti-aliasing
+        const auto eqStage = (features & passiveEq) != 0
+            ? LinearStage::biquad(stack.b0, stack.b1, stack.b2, stack.a1, stack.a2)
+            : classicEqStage(eqValue, sampleRate);
+        
+        return LinearCascade<3>::compile({
+            LinearStage::capacitorHighPass(c6_time_constant),
+            eqStage,
+            antiAliasingStage(sampleRate) });
     }
     
-    void initializeAntiAliasingFilter()
+    void updateSecondCircuitSegments()
     {
-        // Design a simple 2nd-order Butterworth low-pass filter
-        // Cutoff at about 80% of Nyquist to prevent aliasing
-        double cutoff = sampleRate * 0.4;  // 40% of sample rate
-        double omega = 2.0 * M_PI * cutoff / sampleRate;
-        double cos_omega = std::cos(omega);
-        double sin_omega = std::sin(omega);
-        double alpha = sin_omega / (2.0 * 0.707);  // Q = 0.707 for Butterworth
-        
-        // Low-pass biquad coefficients
-        antiAlias_b0 = (1.0 - cos_omega) / 2.0;
-        antiAlias_b1 = 1.0 - cos_omega;
-        antiAlias_b2 = (1.0 - cos_omega) / 2.0;
-        double a0 = 1.0 + alpha;
-        antiAlias_a1 = -2.0 * cos_omega;
-        antiAlias_a2 = 1.0 - alpha;
-        
-        // Normalize coefficients
-        antiAlias_b0 /= a0;
-        antiAlias_b1 /= a0;
-        antiAlias_b2 /= a0;
-        antiAlias_a1 /= a0;
-        antiAlias_a2 /= a0;
+        second.interStageSegment = compileInterStageSegment(woolCutoff(second.wool));
+        second.outputSegment = compileOutputSegment(second.eq, second.toneStack);
+        dualInterStageSegment = LinearCascadePair<1>::pack({ &interStageSegment, &second.interStageSegment });
+        dualOutputSegment = LinearCascadePair<3>::pack({ &outputSegment, &second.outputSegment });
     }
     
-    double antiAliasingFilter(double input)
+    void updateSecondCircuitCoefficients()
     {
-        // Direct Form II biquad filter
-        double result = antiAlias_b0 * input + antiAlias_b1 * antiAlias_x1 + antiAlias_b2 * antiAlias_x2 
-                       - antiAlias_a1 * antiAlias_y1 - antiAlias_a2 * antiAlias_y2;
+        if (toneStackTable)
+            second.toneStack = PassiveToneStack::lookup(*toneStackTable, second.eq);
         
-        // Update history
-        antiAlias_x2 = antiAlias_x1;
-        antiAlias_x1 = input;
-        antiAlias_y2 = antiAlias_y1;
-        antiAlias_y1 = result;
-        
-        return result;
+        updateSecondCircuitSegments();
     }
     
+    // WOOL control - bass roll-off before fuzz (high-pass filter)
+    // More wool = less bass roll-off = more bass into fuzz
+    static double woolCutoff(double woolValue) { return 50.0 + (woolValue * 300.0); }  // 50Hz to 350Hz cutoff
+    
+    // Higher pinch = more bias starvation = more gating
+    // SMALL CHANGE: Slightly less extreme range to prevent total cutouts
+    static double biasLevelForPinch(double pinchValue) { return 0.15 + (1.0 - pinchValue) * 0.65; }  // 0.15 to 0.8 bias range (was 0.1 to 0.8)
+    
+    static double gainForOutput(double outputValue) { return 0.2 + (outputValue * 3.0); }  // More reasonable range: 0.2 to 3.2 gain
+    
     void updateFilterCoefficients()
     {
-        // WOOL control - bass roll-off before fuzz (high-pass filter)
-        // More wool = less bass roll-off = more bass into fuzz
-        wool_cutoff = 50.0 + (wool * 300.0);  // 50Hz to 350Hz cutoff
+        wool_cutoff = woolCutoff(wool);
+        
+        // Passive tone stack: interpolated from the grid, no trig or division
+        if (toneStackTable)
+        {
+            toneStack = PassiveToneStack::lookup(*toneStackTable, eq);
+            
+            if (isDualActive())
+                second.toneStack = PassiveToneStack::lookup(*toneStackTable, second.eq);
+        }
         
-        // EQ control - passive tone shaping after fuzz
-        // CCW = more bass, CW = more treble
-        eq_cutoff = 800.0 + (eq * 2200.0);  // 800Hz to 3000Hz
-    }
-    
-    double dcBlockingFilter(double input)
-    {
-        // High-pass filter for DC blocking
-        double filtered = input - dc_block_in + 0.995 * dc_block_out;
-        dc_block_in = input;
-        dc_block_out = filtered;
-        return filtered;
+        updateLinearSegments();
     }
     
-    double acCouplingFilter(double input, double& capacitor_voltage, double time_constant)
+    void updateSmoothingCoefficients()
     {
-        // Simulate AC coupling capacitor
-        capacitor_voltage = capacitor_voltage * time_constant + input * (1.0 - time_constant);
-        return input - capacitor_voltage;
+        // A one-pole running N times faster needs pole^(1/N) for the same time
+        // constant; its input gain scales with (1 - pole) to keep unity DC gain
+        const double exponent = 1.0 / oversamplingFactor;
+        auto pole = [exponent](double basePole) { return std::pow(basePole, exponent); };
+        auto gain = [](double baseGain, double basePole, double newPole) { return baseGain * ((1.0 - newPole) / (1.0 - basePole)); };
+        
+        c1_time_constant = pole(0.999);
+        c2_time_constant = pole(0.995);
+        c6_time_constant = pole(0.995);
+        dc_block_pole = pole(0.995);
+        
+        current_draw_pole = pole(0.999);
+        current_draw_gain = gain(0.001, 0.999, current_draw_pole);
+        sag_pole = pole(0.99);
+        sag_gain = gain(0.01, 0.99, sag_pole);
+        gating_pole = pole(0.98);
+        gating_gain = gain(0.02, 0.98, gating_pole);
+        im_pole = pole(0.95);
+        im_gain = gain(0.05, 0.95, im_pole);
+        
+        updateLinearSegments();
     }
     
-    double transistorQ1(double input, double supply_voltage)
+    template <unsigned Features>
+    double transistorQ1(double input, double supply_voltage, const CircuitConstants& c)
     {
         // Q1 (2N3904) - First transistor stage with ENHANCED OVERDRIVE
         // Much more aggressive for authentic Woolly Mammoth character
         
         // Supply voltage affects bias point and available headroom
         double supply_factor = supply_voltage / nominal_supply_voltage;
-        double bias_adjustment = (1.0 - supply_factor) * 0.3;
+        double bias_adjustment = (1.0 - supply_factor) * c.q1_sag_bias_shift;
         
         // Base-emitter voltage with input signal and supply-dependent bias
-        double vbe = input + (q1_bias * 0.7 - bias_adjustment);
+        double vbe = input + (state.q1_bias * c.q1_bias_voltage - bias_adjustment);
         
         // MODERATE GAIN for good overdrive character
-        double base_gain = 18.0 * supply_factor;  // Reduced from 25.0 to 18.0 - more reasonable
+        double base_gain = c.q1_gain * supply_factor;  // Reduced from 25.0 to 18.0 - more reasonable
         
         // Enhanced thermal effects for more saturation
-        double thermal_factor = 1.0 + (vbe - 0.7) * 0.2;  // Increased from 0.1
+        double thermal_factor = 1.0 + (vbe - 0.7) * c.q1_thermal;  // Increased from 0.1
         double effective_gain = base_gain * thermal_factor;
         
         // Base collector current before saturation
         double ic_linear = vbe * effective_gain;
         
-        // MORE AGGRESSIVE SATURATION for overdrive character
-        double saturation_level = 0.9 * supply_factor;  // Reduced from 1.2 for earlier saturation
-        double compression_factor = 0.6 + (1.0 - supply_factor) * 0.2;  // More aggressive compression
-        
-        // Enhanced saturation curve for more overdrive
-        double ic_compressed;
-        if (std::abs(ic_linear) > saturation_level * 0.3) {
-            // Multi-stage compression for more character
-            double stage1 = saturation_level * std::tanh(ic_linear / (saturation_level * compression_factor));
-            double stage2 = stage1 / (1.0 + std::abs(stage1) * 0.5);  // Additional compression stage
-            ic_compressed = stage2;
-        } else {
-            ic_compressed = ic_linear;  // Linear region
-        }
+        // MORE AGGRESSIVE SATURATION for overdrive character, then asymmetry,
+        // harmonics and earlier collector-emitter saturation
+        double ic_compressed = Kernels<Features>::q1Saturation(ic_linear, supply_factor);
         
-        // ENHANCED ASYMMETRY for more character
-        double asymmetry_factor = 1.2 + (1.0 - supply_factor) * 0.3;  // Increased asymmetry
-        if (ic_compressed > 0.0) {
-            ic_compressed *= (0.9 + (1.0 - supply_factor) * 0.2);  // More positive compression
-        } else {
-            ic_compressed *= (1.2 * asymmetry_factor);  // Much more negative compression
-            ic_compressed = std::max(ic_compressed, -0.8 * supply_factor);
-        }
-        
-        // INCREASED HARMONIC CONTENT for overdrive character
-        double harmonic_strength = 0.08 * supply_factor;  // Increased from 0.03
-        double harmonic_content = ic_compressed * ic_compressed * harmonic_strength;
-        // Add third harmonic for more overdrive character
-        double third_harmonic = ic_compressed * ic_compressed * ic_compressed * harmonic_strength * 0.3;
-        ic_compressed += harmonic_content + third_harmonic;
-        
-        // Earlier collector-emitter saturation for more overdrive
-        if (std::abs(ic_compressed) > 0.6 * supply_factor) {  // Reduced from 0.8
-            double vce_sat = 0.25 + (1.0 - supply_factor) * 0.2;
-            double sat_factor = 1.0 - (std::abs(ic_compressed) - 0.6 * supply_factor) * 3.0;  // More aggressive
-            ic_compressed *= std::max(sat_factor, vce_sat);
-        }
-        
-        q1_collector = ic_compressed;
+        state.q1_collector = ic_compressed;
         return ic_compressed;
     }
     
-    double woolBassFilter(double input)
+    // IMPROVED VERSION: Enhanced overdrive character with minimal changes to prevent cutouts
+    // The Q2 saturation curve keeps the C library tanh unless economyMath is on
+    template <unsigned Features>
+    static double q2Tanh(double x)
     {
-        // WOOL control - bass roll-off before Q2
-        // This is a high-pass filter that removes bass before the main fuzz stage
-        
-        double alpha = 1.0 / (1.0 + (2.0 * M_PI * wool_cutoff / sampleRate));
-        wool_filter_z1 = wool_filter_z1 * alpha + input * (1.0 - alpha);
-        
-        return input - wool_filter_z1;  // High-pass response
+        if constexpr ((Features & economyMath) != 0)
+            return FastMath::tanh(x);
+        else
+            return std::tanh(x);
     }
     
-    // IMPROVED VERSION: Enhanced overdrive character with minimal changes to prevent cutouts
+    // Q2's knob-dependent bias and per-circuit memory for one or more circuits
+    // run in lockstep, one lane each, around the shared supply and Q1
+    template <std::size_t Lanes>
+    struct Q2Lanes
+    {
+        double input[Lanes];
+        double bias_level[Lanes];
+        double transistor_activity[Lanes];
+        double gating_smoother[Lanes];
+        double im_delay[Lanes];
+    };
+    
+    // The circuit constants of every lane for the plugin's circuits, which
+    // all share the instance's; a plain array gives each lane its own set
+    struct SharedConstants
+    {
+        const CircuitConstants& constants;
+        const CircuitConstants& operator[](std::size_t) const { return constants; }
+    };
+    
+    template <unsigned Features>
     double transistorQ2Improved(double input, double supply_voltage)
     {
+        Q2Lanes<1> q2 {{ input }, { q2_bias_level }, { state.transistor_activity }, { state.gating_smoother }, { state.im_delay }};
+        double laneOut[1];
+        transistorQ2Lanes<Features>(q2, SharedConstants { constants }, supply_voltage, laneOut);
+        
+        state.transistor_activity = q2.transistor_activity[0];
+        state.gating_smoother = q2.gating_smoother[0];
+        state.im_delay = q2.im_delay[0];
+        state.q2_collector = laneOut[0];
+        return laneOut[0];
+    }
+    
+    // The positive and negative saturation and the collector-emitter limit
+    // are selects, and with more than one lane the tanh and the gate curve
+    // always take the economy math (within 1e-6 of the C library), so the
+    // lanes stay together in SIMD registers. One lane computes exactly what
+    // the single-circuit stage always has.
+    template <unsigned Features, std::size_t Lanes, typename LaneConstants>
+    void transistorQ2Lanes(Q2Lanes<Lanes>& q2, const LaneConstants& laneConstants, double supply_voltage, double (&laneOut)[Lanes])
+    {
+        constexpr unsigned laneFeatures = Lanes > 1 ? Features | economyMath : Features;
+        
         // Q2 (2N3904) - Main fuzz transistor with MAXIMUM OVERDRIVE CHARACTER
         // This stage creates the characteristic Woolly Mammoth heavy fuzz
         
         // Supply voltage significantly affects Q2 behavior (fuzz stage more sensitive)
-        double supply_factor = supply_voltage / nominal_supply_voltage;
-        double supply_bias_shift = (1.0 - supply_factor) * 0.4;
-        
-        // Base-emitter voltage with bias control from PINCH and supply effects
-        double bias_voltage = q2_bias_level * 0.8 - supply_bias_shift;
-        double vbe = input + bias_voltage;
+        const double supply_factor = supply_voltage / nominal_supply_voltage;
         
         // Enhanced gating behavior based on bias starvation AND supply voltage
-        double effective_bias_level = q2_bias_level * supply_factor;
-        double bias_threshold = effective_bias_level * 0.6;
-        double input_amplitude = std::abs(input);
+        double effective_bias_level[Lanes];
+        double input_amplitude[Lanes];
+        for (std::size_t lane = 0; lane < Lanes; ++lane)
+        {
+            effective_bias_level[lane] = q2.bias_level[lane] * supply_factor;
+            input_amplitude[lane] = std::abs(q2.input[lane]);
+        }
         
         // Transistor activity based on bias point and supply (creates more complex gating)
-        double transistor_activity = 1.0;
-        if (input_amplitude < bias_threshold) {
-            transistor_activity = std::pow(input_amplitude / bias_threshold, 1.5);
-            transistor_activity = std::clamp(transistor_activity, 0.05, 1.0);  // Prevent complete cutouts
+        for (std::size_t lane = 0; lane < Lanes; ++lane)
+        {
+            const double bias_threshold = effective_bias_level[lane] * laneConstants[lane].q2_gate_threshold;
+            double transistor_activity = 1.0;
+            if (input_amplitude[lane] < bias_threshold) {
+                const double ratio = input_amplitude[lane] / bias_threshold;
+                if constexpr ((laneFeatures & economyMath) != 0)
+                    transistor_activity = ratio * std::sqrt(ratio);
+                else
+                    transistor_activity = std::pow(ratio, 1.5);
+                transistor_activity = std::clamp(transistor_activity, 0.05, 1.0);  // Prevent complete cutouts
+            }
+            
+            // Supply sag makes gating more prominent
+            q2.transistor_activity[lane] = transistor_activity * (0.8 + supply_factor * 0.2);
         }
         
-        // Supply sag makes gating more prominent
-        transistor_activity *= (0.8 + supply_factor * 0.2);
-        
-        // Smooth the gating to prevent abrupt changes
-        gating_smoother = gating_smoother * 0.98 + transistor_activity * 0.02;
-        double smoothed_activity = gating_smoother;
-        
-        // STRONG GAIN for heavy fuzz character but not extreme
-        double base_gain = 50.0 * supply_factor;  // Reduced from 60.0 to 50.0 - still aggressive but more musical
-        double bias_gain_factor = 0.3 + effective_bias_level * 2.0;  // More dramatic bias effects
-        double effective_gain = base_gain * smoothed_activity * bias_gain_factor;
-        
-        // Enhanced temperature effects for more aggressive behavior
-        double thermal_factor = 1.0 + (1.0 - effective_bias_level) * 0.5 * (2.0 - supply_factor);  // More aggressive
-        effective_gain *= thermal_factor;
+        // Each phase is a loop of its own over the lanes, so each one is a
+        // few SIMD instructions for the whole pair
+        double smoothed_activity[Lanes];
+        double ic_saturated[Lanes];
+        double saturation_scale[Lanes];
+        double saturation_input[Lanes];
+        bool positive[Lanes];
+        
+        for (std::size_t lane = 0; lane < Lanes; ++lane)
+        {
+            const auto& c = laneConstants[lane];
+            
+            // Base-emitter voltage with bias control from PINCH and supply effects
+            const double supply_bias_shift = (1.0 - supply_factor) * c.q2_sag_bias_shift;
+            const double bias_voltage = q2.bias_level[lane] * c.q2_bias_voltage - supply_bias_shift;
+            const double vbe = q2.input[lane] + bias_voltage;
+            
+            // Smooth the gating to prevent abrupt changes
+            q2.gating_smoother[lane] = q2.gating_smoother[lane] * gating_pole + q2.transistor_activity[lane] * gating_gain;
+            smoothed_activity[lane] = q2.gating_smoother[lane];
+            
+            // STRONG GAIN for heavy fuzz character but not extreme
+            const double base_gain = c.q2_gain * supply_factor;  // Reduced from 60.0 to 50.0 - still aggressive but more musical
+            const double bias_gain_factor = c.q2_bias_gain_floor + effective_bias_level[lane] * c.q2_bias_gain;  // More dramatic bias effects
+            double effective_gain = base_gain * smoothed_activity[lane] * bias_gain_factor;
+            
+            // Enhanced temperature effects for more aggressive behavior
+            const double thermal_factor = 1.0 + (1.0 - effective_bias_level[lane]) * c.q2_thermal * (2.0 - supply_factor);  // More aggressive
+            effective_gain *= thermal_factor;
+            
+            // Collector current with enhanced modeling
+            const double ic_linear = vbe * effective_gain;
+            
+            // MUCH MORE AGGRESSIVE SATURATION for heavy fuzz
+            const double saturation_level = c.q2_saturation * supply_factor;  // Reduced from 0.6 for earlier, harder saturation
+            const double compression_factor = c.q2_compression + (1.0 - supply_factor) * c.q2_sag_compression;  // Much more aggressive compression
+            const double neg_compression = compression_factor * (0.4 + supply_factor * 0.3);  // More aggressive
+            
+            // Multi-stage fuzz saturation with supply effects: positive saturation
+            // with multiple compression stages, negative clipping much more
+            // affected by supply sag and more aggressive
+            positive[lane] = ic_linear > 0.0;
+            saturation_scale[lane] = positive[lane] ? saturation_level : -saturation_level * c.q2_negative_level;
+            saturation_input[lane] = positive[lane] ? ic_linear / (saturation_level * compression_factor)
+                                                    : -ic_linear / (saturation_level * neg_compression);
+        }
         
-        // Collector current with enhanced modeling
-        double ic_linear = vbe * effective_gain;
+        for (std::size_t lane = 0; lane < Lanes; ++lane)
+            ic_saturated[lane] = saturation_scale[lane] * q2Tanh<laneFeatures>(saturation_input[lane]);
         
-        // MUCH MORE AGGRESSIVE SATURATION for heavy fuzz
-        double saturation_level = 0.4 * supply_factor;  // Reduced from 0.6 for earlier, harder saturation
-        double compression_factor = 0.25 + (1.0 - supply_factor) * 0.2;  // Much more aggressive compression
-        
-        // Multi-stage fuzz saturation with supply effects
-        double ic_saturated;
-        if (ic_linear > 0.0) {
-            // Positive saturation with multiple compression stages
-            double stage1 = saturation_level * std::tanh(ic_linear / (saturation_level * compression_factor));
-            double stage2 = stage1 / (1.0 + stage1 * stage1 * 2.0);  // Additional fuzz compression
-            ic_saturated = stage2;
-        } else {
-            // Negative clipping much more affected by supply sag and more aggressive
-            double neg_compression = compression_factor * (0.4 + supply_factor * 0.3);  // More aggressive
-            double stage1 = -saturation_level * 0.6 * std::tanh(-ic_linear / (saturation_level * neg_compression));
-            double stage2 = stage1 / (1.0 + std::abs(stage1) * 1.5);  // Additional compression
-            ic_saturated = stage2;
+        // Additional fuzz compression
+        for (std::size_t lane = 0; lane < Lanes; ++lane)
+        {
+            const double stage1 = ic_saturated[lane];
+            ic_saturated[lane] = stage1 / (1.0 + (positive[lane] ? stage1 * stage1 * laneConstants[lane].q2_positive_squash
+                                                                 : std::abs(stage1) * laneConstants[lane].q2_negative_squash));
         }
         
         // ENHANCED FUZZ HARMONIC GENERATION for maximum character
-        ic_saturated = addAggressiveFuzzHarmonics(ic_saturated, smoothed_activity, supply_factor);
-        
-        // More subtle instability effects (no rattling)
-        if (smoothed_activity < 0.3) {
-            double supply_instability_factor = 1.0 + (1.0 - supply_factor) * 0.3;
-            double instability = 0.008 * supply_instability_factor *  // Reduced for no rattling
-                                std::sin(input_amplitude * 120.0 + effective_bias_level * 40.0);
-            ic_saturated += instability * (0.3 - smoothed_activity) * 0.3;
+        addAggressiveFuzzHarmonics<Features>(ic_saturated, smoothed_activity, q2.im_delay, laneConstants);
+        
+        for (std::size_t lane = 0; lane < Lanes; ++lane)
+        {
+            // More subtle instability effects (no rattling)
+            if (runs<Features>(q2Instability))
+            {
+                if (smoothed_activity[lane] < 0.3) {
+                    double supply_instability_factor = 1.0 + (1.0 - supply_factor) * 0.3;
+                    double instability = 0.008 * supply_instability_factor *  // Reduced for no rattling
+                                        std::sin(input_amplitude[lane] * 120.0 + effective_bias_level[lane] * 40.0);
+                    ic_saturated[lane] += instability * (0.3 - smoothed_activity[lane]) * 0.3;
+                }
+            }
+            
+            // Earlier collector-emitter saturation for more fuzz
+            const auto& c = laneConstants[lane];
+            const double vce_threshold = c.q2_vce_threshold * supply_factor;  // Much earlier saturation
+            const double vce_sat = c.q2_vce_sat + (1.0 - supply_factor) * 0.25;
+            const double sat_compression = 1.0 - (std::abs(ic_saturated[lane]) - vce_threshold) * c.q2_vce_slope;  // More aggressive
+            ic_saturated[lane] *= std::abs(ic_saturated[lane]) > vce_threshold ? std::max(sat_compression, vce_sat) : 1.0;
+            
+            laneOut[lane] = ic_saturated[lane];
         }
-        
-        // Earlier collector-emitter saturation for more fuzz
-        if (std::abs(ic_saturated) > 0.3 * supply_factor) {  // Much earlier saturation
-            double vce_sat = 0.2 + (1.0 - supply_factor) * 0.25;
-            double sat_compression = 1.0 - (std::abs(ic_saturated) - 0.3 * supply_factor) * 3.0;  // More aggressive
-            ic_saturated *= std::max(sat_compression, vce_sat);
-        }
-        
-        q2_collector = ic_saturated;
-        return ic_saturated;
     }
     
     double addEnhancedFuzzHarmonics(double input, double transistor_activity, double supply_factor)
@@ -512,69 +1131,70 @@ private:
     }
     
     // MODERATE: Fuzz harmonics for Q2 stage - musical but characterful
-    double addAggressiveFuzzHarmonics(double input, double transistor_activity, double supply_factor)
+    template <unsigned Features, std::size_t Lanes, typename LaneConstants>
+    void addAggressiveFuzzHarmonics(double (&signal)[Lanes], const double (&transistor_activity)[Lanes], double (&im_delay)[Lanes],
+                                    const LaneConstants& laneConstants)
     {
         // Strong fuzz character but more musical than extreme
-        
-        double shaped = input;
-        
-        // Moderate waveshaping for fuzz
-        double drive_factor = 1.8 + (1.0 - transistor_activity) * 1.0;  // Reduced drive
-        shaped = shaped / (1.0 + std::abs(shaped) * drive_factor);
-        
-        // Balanced harmonic generation
-        double base_strength = 0.12 + (1.0 - transistor_activity) * 0.08;  // Reduced from 0.2
-        
-        // Strong but musical second harmonic
-        shaped += shaped * shaped * base_strength * 1.5;
-        
-        // Moderate third harmonic for fuzz edge
-        shaped += shaped * shaped * shaped * base_strength * 1.0;
-        
-        // Skip fifth harmonic - was too complex
-        
-        // Simplified intermodulation
-        static double im_delay = 0.0;
-        im_delay = im_delay * 0.95 + shaped * 0.05;
-        shaped += shaped * im_delay * 0.04;  // Reduced from 0.08
-        
-        // Gentler crossover distortion
-        if (std::abs(shaped) < 0.12) {
-            shaped *= 0.7 + 0.3 * transistor_activity;
+        for (std::size_t lane = 0; lane < Lanes; ++lane)
+        {
+            const auto& c = laneConstants[lane];
+            double shaped = signal[lane];
+            const double activity = transistor_activity[lane];
+            
+            // Moderate waveshaping for fuzz
+            double drive_factor = c.fuzz_drive + (1.0 - activity) * c.fuzz_gated_drive;  // Reduced drive
+            shaped = shaped / (1.0 + std::abs(shaped) * drive_factor);
+            
+            // Balanced harmonic generation
+            double base_strength = c.fuzz_harmonics + (1.0 - activity) * c.fuzz_gated_harmonics;  // Reduced from 0.2
+            
+            // Strong but musical second harmonic
+            shaped += shaped * shaped * base_strength * c.fuzz_second;
+            
+            // Moderate third harmonic for fuzz edge
+            shaped += shaped * shaped * shaped * base_strength * c.fuzz_third;
+            
+            // Skip fifth harmonic - was too complex
+            
+            // Simplified intermodulation
+            im_delay[lane] = im_delay[lane] * im_pole + shaped * im_gain;
+            shaped += shaped * im_delay[lane] * c.fuzz_intermodulation;  // Reduced from 0.08
+            
+            // Gentler crossover distortion
+            if (runs<Features>(crossover))
+                shaped *= std::abs(shaped) < c.crossover_threshold ? c.crossover_gain + 0.3 * activity : 1.0;
+            
+            signal[lane] = shaped;
         }
         
-        // Moderate high-frequency saturation
-        double hf_sat_freq = 30.0 + transistor_activity * 15.0;  // Reduced frequency
-        double hf_sat_amount = 0.06 * (1.3 - transistor_activity);  // Reduced amount
-        shaped += shaped * std::sin(shaped * hf_sat_freq) * hf_sat_amount;
-        
-        // Less aggressive bit reduction
-        double bit_depth = 32.0 + transistor_activity * 16.0;  // Higher bit depth
-        bit_depth = std::max(bit_depth, 16.0);  // Higher minimum
-        shaped = std::round(shaped * bit_depth) / bit_depth;
-        
-        return shaped;
+        // The C library calls stay in loops of their own
+        for (std::size_t lane = 0; lane < Lanes; ++lane)
+        {
+            const auto& c = laneConstants[lane];
+            double shaped = signal[lane];
+            const double activity = transistor_activity[lane];
+            
+            // Moderate high-frequency saturation
+            if (runs<Features>(hfTexture))
+            {
+                double hf_sat_freq = c.hf_texture_frequency + activity * c.hf_texture_active_frequency;  // Reduced frequency
+                double hf_sat_amount = c.hf_texture_amount * (1.3 - activity);  // Reduced amount
+                shaped += shaped * std::sin(shaped * hf_sat_freq) * hf_sat_amount;
+            }
+            
+            // Less aggressive bit reduction
+            if (runs<Features>(bitReduction))
+            {
+                double bit_depth = c.bit_depth + activity * c.active_bit_depth;  // Higher bit depth
+                bit_depth = std::max(bit_depth, 16.0);  // Higher minimum
+                shaped = std::round(shaped * bit_depth) / bit_depth;
+            }
+            
+            signal[lane] = shaped;
+        }
     }
     
-    double eqToneControl(double input)
-    {
-        // EQ control - passive tone shaping after fuzz
-        // Simulates the passive RC filter network
-        
-        // Two-pole low-pass filter
-        double alpha = 1.0 / (1.0 + (2.0 * M_PI * eq_cutoff / sampleRate));
-        
-        eq_filter_z1 = eq_filter_z1 * alpha + input * (1.0 - alpha);
-        eq_filter_z2 = eq_filter_z2 * alpha + eq_filter_z1 * (1.0 - alpha);
-        
-        // Blend between full-range and filtered based on EQ setting
-        double bass_response = eq_filter_z2;
-        double treble_response = input - eq_filter_z1;  // High-pass component
-        
-        // EQ blend: CCW = more bass, CW = more treble
-        return bass_response * (1.0 - eq) + treble_response * eq * 0.7;
-    }
-
     double calculateSupplySag(double current_load)
     {
         // Simulate supply voltage sagging due to internal resistance and load
@@ -585,16 +1205,59 @@ private:
         double voltage_drop = current_load * battery_internal_resistance;
         
         // Apply a smoothing filter to the voltage drop to prevent sudden changes
-        supply_sag_filter = supply_sag_filter * 0.99 + voltage_drop * 0.01;
+        state.supply_sag_filter = state.supply_sag_filter * sag_pole + voltage_drop * sag_gain;
         
         // The actual supply voltage is the nominal voltage minus the smoothed voltage drop
-        double supply_voltage = nominal_supply_voltage - supply_sag_filter;
+        double supply_voltage = nominal_supply_voltage - state.supply_sag_filter;
         
         // Ensure the supply voltage doesn't drop below the minimum threshold
         return std::max(supply_voltage, minimum_supply_voltage);
     }
 };
 
+inline void WoolyMammothDSP::processBlock(float* samples, int numSamples)
+{
+    // Dispatch once per block to the kernel setFeatures() picked
+    static constexpr auto kernels = makeBlockKernels(std::make_index_sequence<numKernels>{});
+    static constexpr auto dualKernels = makeDualBlockKernels(std::make_index_sequence<numKernels>{});
+    
+    if (! isDualActive() || numSamples <= 0)
+    {
+        (this->*kernels[kernel])(samples, numSamples);
+        return;
+    }
+    
+    if (! state.dual_running)
+    {
+        // Circuit B takes over circuit A's memory and fades in from there
+        state.second.q2_collector = state.q2_collector;
+        state.second.inter_stage_z = state.inter_stage_z;
+        state.second.post_q2_z = state.post_q2_z;
+        state.second.gating_smoother = state.gating_smoother;
+        state.second.im_delay = state.im_delay;
+        state.second.transistor_activity = state.transistor_activity;
+        state.dual_running = true;
+    }
+    
+    (this->*dualKernels[kernel])(samples, numSamples);
+    
+    // Once switched off, one block fades circuit B out
+    state.dual_running = dualEnabled;
+}
+
+template <std::size_t Lanes>
+void WoolyMammothDSP::processCandidates(const State& start, const CircuitConstants (&candidates)[Lanes],
+                                        const float* input, float* const (&outputs)[Lanes], int numSamples)
+{
+    static constexpr auto kernels = makeCandidateKernels<Lanes>(std::make_index_sequence<numKernels>{});
+    
+    // The shared part runs on this instance's state, which is put back afterwards
+    const State own = state;
+    state = start;
+    (this->*kernels[kernel])(candidates, input, outputs, numSamples);
+    state = own;
+}
+
 //==============================================================================
 // Authentic Wooly Mammoth Presets
 //==============================================================================
@@ -604,26 +1267,29 @@ class WoolyMammothPresets
 public:
     struct Preset
     {
-        std::string name;
+        std::string_view name;
         double wool;
         double pinch;
         double eq;
         double output;
-        std::string description;
+        std::string_view description;
     };
     
-    static std::vector<Preset> getFactoryPresets()
-    {
-        return {
-            {"Classic Wooly", 0.6, 0.4, 0.3, 0.7, "The authentic Wooly Mammoth sound"},
-            {"Velcro Rip", 0.7, 0.8, 0.2, 0.6, "Extreme gated fuzz with velcro texture"},
-            {"Bass Destroyer", 0.8, 0.6, 0.1, 0.8, "Maximum bass fuzz destruction"},
-            {"Gated Synth", 0.4, 0.9, 0.4, 0.5, "Heavily gated synth bass tones"},
-            {"Smooth Fuzz", 0.5, 0.2, 0.6, 0.8, "Less gated, more sustained fuzz"},
-            {"Sputtery Gate", 0.3, 0.7, 0.2, 0.6, "Unstable gated fuzz sputter"},
-            {"Mild Mammoth", 0.4, 0.3, 0.5, 0.7, "Tamed but still fuzzy"},
-            {"Extreme Pinch", 0.5, 1.0, 0.3, 0.4, "Maximum bias starvation"},
-            {"Midnight Mass", 1.0, 0.84, 0.64, 0.5, "Aggressively gated, ripping fuzz"}
-        };
-    }
-};
\ No newline at end of file
+    // Static, read-only data: nothing is built or allocated at runtime
+    static constexpr std::array<Preset, 9> factoryPresets {{
+        {"Classic Wooly", 0.6, 0.4, 0.3, 0.7, "The authentic Wooly Mammoth sound"},
+        {"Velcro Rip", 0.7, 0.8, 0.2, 0.6, "Extreme gated fuzz with velcro texture"},
+        {"Bass Destroyer", 0.8, 0.6, 0.1, 0.8, "Maximum bass fuzz destruction"},
+        {"Gated Synth", 0.4, 0.9, 0.4, 0.5, "Heavily gated synth bass tones"},
+        {"Smooth Fuzz", 0.5, 0.2, 0.6, 0.8, "Less gated, more sustained fuzz"},
+        {"Sputtery Gate", 0.3, 0.7, 0.2, 0.6, "Unstable gated fuzz sputter"},
+        {"Mild Mammoth", 0.4, 0.3, 0.5, 0.7, "Tamed but still fuzzy"},
+        {"Extreme Pinch", 0.5, 1.0, 0.3, 0.4, "Maximum bias starvation"},
+        {"Midnight Mass", 1.0, 0.84, 0.64, 0.5, "Aggressively gated, ripping fuzz"}
+    }};
+    
+    static constexpr int numFactoryPresets = static_cast<int>(factoryPresets.size());
+    
+    // Where a freshly created instance starts; also the parameter defaults
+    static constexpr const Preset& defaultPreset = factoryPresets[0];
+};
@@ -0,0 +1,330 @@
+//==============================================================================
+// HarmonsterAliasingReport - aliasing against CPU for every quality mode
+//
+// Plays a stepped sweep of high sine tones through one channel of the fuzz,
+// for each factory preset, in every quality mode the plugin can run in: each
+// oversampling factor, with the math this build uses and with the economy
+// math the CPU governor falls back to. Each tone sits exactly on an FFT bin
+// with an odd index, so its harmonics land on multiples of that bin while
+// anything folded back from above Nyquist lands between them. Over the sweep
+// it measures
+//   alias - energy off the harmonic bins against the energy on them, full band
+//   snr   - energy on the harmonic bins against the energy off them, up to
+//           20 kHz, which is what a listener gets
+// and the cost in ns per host-rate sample, best of --runs renders.
+//
+// A mode is on the Pareto front when no other mode is both cheaper and less
+// aliased. The table goes to stdout and, for tracking regressions, to
+// --csv and --json. Anti-derivative antialiasing is not listed because the
+// circuit has no such mode.
+//
+// Usage:
+//   HarmonsterAliasingReport [--rate=48000] [--level=-12] [--runs=3]
+//                            [--passive-eq] [--csv=report.csv] [--json=report.json]
+//==============================================================================
+
+#include <juce_core/juce_core.h>
+#include <juce_dsp/juce_dsp.h>
+#include "MammothChannel.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    constexpr int fftOrder = 14;
+    constexpr int fftSize = 1 << fftOrder;
+    constexpr int blockSize = 256;
+    constexpr double warmUpSeconds = 0.25;
+    constexpr double sweepFrequencies[] { 500.0, 1000.0, 2000.0, 3000.0, 5000.0, 8000.0, 12000.0 };
+
+    struct Mode
+    {
+        int stages = 0;
+        bool economy = false;
+
+        juce::String getName() const
+        {
+            return juce::String (1 << stages) + "x" + (economy ? " eco" : "");
+        }
+    };
+
+    struct Measurement
+    {
+        double nanoseconds = 0.0;
+        double harmonicEnergy = 0.0, inharmonicEnergy = 0.0;
+        double audibleHarmonicEnergy = 0.0, audibleInharmonicEnergy = 0.0;
+        bool pareto = false;
+
+        double getAliasDb() const { return ratioDb (inharmonicEnergy, harmonicEnergy); }
+        double getSnrDb() const { return ratioDb (audibleHarmonicEnergy, audibleInharmonicEnergy); }
+
+        static double ratioDb (double numerator, double denominator)
+        {
+            return 10.0 * std::log10 (std::max (numerator, 1.0e-30) / std::max (denominator, 1.0e-30));
+        }
+    };
+
+    //==========================================================================
+    // Splits the spectrum of a bin-exact tone's steady state into harmonic and
+    // inharmonic energy
+    class ToneAnalysis
+    {
+    public:
+        explicit ToneAnalysis (double rate)
+            : sampleRate (rate), fft (fftOrder),
+              window (static_cast<size_t> (fftSize)), spectrum (static_cast<size_t> (2 * fftSize))
+        {
+            for (int i = 0; i < fftSize; ++i)
+                window[static_cast<size_t> (i)] = static_cast<float> (0.5 - 0.5 * std::cos (2.0 * M_PI * i / fftSize));
+        }
+
+        // The odd bin nearest the frequency; an odd bin never divides the FFT
+        // size, so a folded harmonic cannot land exactly on a harmonic bin
+        int getBin (double frequency) const
+        {
+            return static_cast<int> (std::floor (frequency * fftSize / sampleRate / 2.0)) * 2 + 1;
+        }
+
+        double getFrequency (int bin) const { return bin * sampleRate / fftSize; }
+
+        void analyse (const float* samples, int bin, Measurement& result)
+        {
+            std::fill (spectrum.begin(), spectrum.end(), 0.0f);
+            for (int i = 0; i < fftSize; ++i)
+                spectrum[static_cast<size_t> (i)] = samples[i] * window[static_cast<size_t> (i)];
+
+            fft.performFrequencyOnlyForwardTransform (spectrum.data());
+
+            // The Hann window spreads each component over its bin and the two
+            // next to it; the lowest bins are the window's own DC leakage
+            const int audibleLimit = static_cast<int> (std::min (20000.0, 0.5 * sampleRate) * fftSize / sampleRate);
+
+            for (int i = 2; i <= fftSize / 2; ++i)
+            {
+                const double energy = static_cast<double> (spectrum[static_cast<size_t> (i)]) * spectrum[static_cast<size_t> (i)];
+                const int offset = i % bin;
+                const bool harmonic = offset <= 1 || offset >= bin - 1;
+
+                (harmonic ? result.harmonicEnergy : result.inharmonicEnergy) += energy;
+
+                if (i <= audibleLimit)
+                    (harmonic ? result.audibleHarmonicEnergy : result.audibleInharmonicEnergy) += energy;
+            }
+        }
+
+    private:
+        double sampleRate;
+        juce::dsp::FFT fft;
+        std::vector<float> window, spectrum;
+    };
+
+    //==========================================================================
+    struct ReportOptions
+    {
+        double sampleRate = 48000.0;
+        float level = juce::Decibels::decibelsToGain (-12.0f);
+        int runs = 3;
+        unsigned features = WoolyMammothDSP::allFeatures & ~static_cast<unsigned> (WoolyMammothDSP::passiveEq);
+    };
+
+    Measurement measure (const ReportOptions& options, const WoolyMammothPresets::Preset& preset, const Mode& mode)
+    {
+        const int warmUpSamples = static_cast<int> (warmUpSeconds * options.sampleRate);
+        const int toneSamples = warmUpSamples + fftSize;
+
+        MammothChannel channel;
+        channel.prepare (options.sampleRate, blockSize);
+        channel.setParameters (preset.wool, preset.pinch, preset.eq, preset.output,
+                               options.features | (mode.economy ? static_cast<unsigned> (WoolyMammothDSP::economyMath) : 0u));
+
+        ToneAnalysis analysis (options.sampleRate);
+        std::vector<std::vector<float>> tones;
+        std::vector<int> bins;
+
+        for (auto frequency : sweepFrequencies)
+        {
+            if (frequency >= 0.45 * options.sampleRate)
+                continue;
+
+            const int bin = analysis.getBin (frequency);
+            const double increment = 2.0 * M_PI * analysis.getFrequency (bin) / options.sampleRate;
+            std::vector<float> tone (static_cast<size_t> (toneSamples));
+
+            for (int i = 0; i < toneSamples; ++i)
+                tone[static_cast<size_t> (i)] = options.level * static_cast<float> (std::sin (increment * i));
+
+            tones.push_back (std::move (tone));
+            bins.push_back (bin);
+        }
+
+        // Every run renders the same output; the fastest one is the cost
+        Measurement result;
+        result.nanoseconds = 1.0e30;
+        std::vector<std::vector<float>> outputs;
+
+        for (int run = 0; run < options.runs; ++run)
+        {
+            outputs = tones;
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            for (auto& output : outputs)
+            {
+                // The first block of a new factor starts its crossfade, which
+                // the warm-up leaves well behind
+                channel.reset();
+                for (int offset = 0; offset < toneSamples; offset += blockSize)
+                    channel.process (output.data() + offset, std::min (blockSize, toneSamples - offset), mode.stages);
+            }
+
+            const double seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+            result.nanoseconds = std::min (result.nanoseconds, seconds * 1.0e9 / (toneSamples * static_cast<double> (tones.size())));
+        }
+
+        for (size_t i = 0; i < outputs.size(); ++i)
+            analysis.analyse (outputs[i].data() + warmUpSamples, bins[i], result);
+
+        return result;
+    }
+
+    void markParetoFront (std::vector<Measurement>& measurements)
+    {
+        for (auto& candidate : measurements)
+        {
+            candidate.pareto = std::none_of (measurements.begin(), measurements.end(), [&candidate] (const Measurement& other)
+            {
+                return other.nanoseconds <= candidate.nanoseconds && other.getAliasDb() <= candidate.getAliasDb()
+                       && (other.nanoseconds < candidate.nanoseconds || other.getAliasDb() < candidate.getAliasDb());
+            });
+        }
+    }
+
+    //==========================================================================
+    struct Row
+    {
+        juce::String preset;
+        Mode mode;
+        Measurement measurement;
+    };
+
+    void printRow (const Row& row)
+    {
+        std::printf ("%-16s %-8s %9.1f %9.1f %9.1f   %s\n", row.preset.toRawUTF8(), row.mode.getName().toRawUTF8(),
+                     row.measurement.nanoseconds, row.measurement.getAliasDb(), row.measurement.getSnrDb(),
+                     row.measurement.pareto ? "*" : "");
+    }
+
+    bool writeCsv (const juce::String& path, const std::vector<Row>& rows)
+    {
+        auto* file = std::fopen (path.toRawUTF8(), "w");
+        if (file == nullptr)
+            return false;
+
+        std::fprintf (file, "preset,mode,oversampling,economy,ns_per_sample,alias_db,snr_db,pareto\n");
+        for (const auto& row : rows)
+            std::fprintf (file, "\"%s\",%s,%d,%d,%.2f,%.2f,%.2f,%d\n", row.preset.toRawUTF8(), row.mode.getName().toRawUTF8(),
+                          1 << row.mode.stages, row.mode.economy ? 1 : 0, row.measurement.nanoseconds,
+                          row.measurement.getAliasDb(), row.measurement.getSnrDb(), row.measurement.pareto ? 1 : 0);
+
+        return std::fclose (file) == 0;
+    }
+
+    bool writeJson (const juce::String& path, const ReportOptions& options, const std::vector<Row>& rows)
+    {
+        auto* file = std::fopen (path.toRawUTF8(), "w");
+        if (file == nullptr)
+            return false;
+
+        std::fprintf (file, "{\n  \"sampleRate\": %.0f,\n  \"math\": \"%s\",\n  \"rows\": [\n",
+                      options.sampleRate, HARMONSTER_PRECISE_MATH != 0 ? "precise" : "fast");
+
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            const auto& row = rows[i];
+            std::fprintf (file, "    { \"preset\": \"%s\", \"mode\": \"%s\", \"oversampling\": %d, \"economy\": %s, "
+                                "\"nsPerSample\": %.2f, \"aliasDb\": %.2f, \"snrDb\": %.2f, \"pareto\": %s }%s\n",
+                          row.preset.toRawUTF8(), row.mode.getName().toRawUTF8(), 1 << row.mode.stages,
+                          row.mode.economy ? "true" : "false", row.measurement.nanoseconds,
+                          row.measurement.getAliasDb(), row.measurement.getSnrDb(),
+                          row.measurement.pareto ? "true" : "false", i + 1 < rows.size() ? "," : "");
+        }
+
+        std::fprintf (file, "  ]\n}\n");
+        return std::fclose (file) == 0;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ArgumentList args (argc, argv);
+    ReportOptions options;
+
+    if (args.containsOption ("--rate"))
+        options.sampleRate = juce::jlimit (22050.0, 384000.0, args.getValueForOption ("--rate").getDoubleValue());
+    if (args.containsOption ("--level"))
+        options.level = juce::Decibels::decibelsToGain (static_cast<float> (args.getValueForOption ("--level").getDoubleValue()));
+    if (args.containsOption ("--runs"))
+        options.runs = juce::jmax (1, args.getValueForOption ("--runs").getIntValue());
+    if (args.containsOption ("--passive-eq"))
+        options.features |= WoolyMammothDSP::passiveEq;
+
+    std::vector<Mode> modes;
+    for (int stages = 0; stages <= MammothChannel::maxStages; ++stages)
+        for (bool economy : { false, true })
+            modes.push_back ({ stages, economy });
+
+    std::printf ("Sweep %.0f-%.0f Hz at %.0f Hz, %s math; * marks the Pareto front of CPU against aliasing\n",
+                 sweepFrequencies[0], sweepFrequencies[std::size (sweepFrequencies) - 1], options.sampleRate,
+                 HARMONSTER_PRECISE_MATH != 0 ? "precise" : "fast");
+    std::printf ("%-16s %-8s %9s %9s %9s\n", "preset", "mode", "ns/sample", "alias dB", "snr dB");
+
+    std::vector<Row> rows;
+    std::vector<Measurement> overall (modes.size());
+
+    for (const auto& preset : WoolyMammothPresets::factoryPresets)
+    {
+        std::vector<Measurement> measurements;
+        for (const auto& mode : modes)
+            measurements.push_back (measure (options, preset, mode));
+
+        markParetoFront (measurements);
+
+        for (size_t i = 0; i < modes.size(); ++i)
+        {
+            rows.push_back ({ juce::String (preset.name.data(), preset.name.size()), modes[i], measurements[i] });
+            printRow (rows.back());
+
+            // Across presets: mean cost, energies summed
+            auto& total = overall[i];
+            total.nanoseconds += measurements[i].nanoseconds / WoolyMammothPresets::numFactoryPresets;
+            total.harmonicEnergy += measurements[i].harmonicEnergy;
+            total.inharmonicEnergy += measurements[i].inharmonicEnergy;
+            total.audibleHarmonicEnergy += measurements[i].audibleHarmonicEnergy;
+            total.audibleInharmonicEnergy += measurements[i].audibleInharmonicEnergy;
+        }
+    }
+
+    markParetoFront (overall);
+    std::printf ("\n");
+
+    for (size_t i = 0; i < modes.size(); ++i)
+    {
+        rows.push_back ({ "All presets", modes[i], overall[i] });
+        printRow (rows.back());
+    }
+
+    if (args.containsOption ("--csv") && ! writeCsv (args.getValueForOption ("--csv"), rows))
+    {
+        std::printf ("Cannot write %s\n", args.getValueForOption ("--csv").toRawUTF8());
+        return 1;
+    }
+
+    if (args.containsOption ("--json") && ! writeJson (args.getValueForOption ("--json"), options, rows))
+    {
+        std::printf ("Cannot write %s\n", args.getValueForOption ("--json").toRawUTF8());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+//==============================================================================
+// HarmonsterAssetBaker - build-time image pre-scaler
+//
+// Resamples a full-size source image to the exact size the editor draws it
+// at and writes it as PNG, so the plugin embeds and decodes only the pixels
+// it actually shows. A source smaller than that is never upscaled: it is
+// written at its own size (its aspect ratio kept to the requested one), and
+// the editor, which draws every asset into its bounds, does the rest.
+//
+// Usage:
+//   HarmonsterAssetBaker <input image> <output.png> <width> <height>
+//==============================================================================
+
+#include <juce_graphics/juce_graphics.h>
+
+#include <cstdio>
+
+int main (int argc, char* argv[])
+{
+    if (argc != 5)
+    {
+        std::fprintf (stderr, "usage: HarmonsterAssetBaker <input image> <output.png> <width> <height>\n");
+        return 1;
+    }
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const auto input = cwd.getChildFile (argv[1]);
+    const auto output = cwd.getChildFile (argv[2]);
+    const auto width = juce::String (argv[3]).getIntValue();
+    const auto height = juce::String (argv[4]).getIntValue();
+
+    auto image = juce::ImageFileFormat::loadFrom (input);
+
+    if (! image.isValid() || width <= 0 || height <= 0)
+    {
+        std::fprintf (stderr, "HarmonsterAssetBaker: cannot bake %s\n", argv[1]);
+        return 1;
+    }
+
+    // Upscaling would only embed interpolated pixels the editor can make itself
+    const auto fit = juce::jmin (1.0, image.getWidth() / static_cast<double> (width), image.getHeight() / static_cast<double> (height));
+    const auto bakedWidth = juce::jmax (1, juce::roundToInt (width * fit));
+    const auto bakedHeight = juce::jmax (1, juce::roundToInt (height * fit));
+
+    // Halve first so the final resample never skips source pixels
+    while (image.getWidth() >= bakedWidth * 2 && image.getHeight() >= bakedHeight * 2)
+        image = image.rescaled (image.getWidth() / 2, image.getHeight() / 2, juce::Graphics::highResamplingQuality);
+
+    if (image.getWidth() != bakedWidth || image.getHeight() != bakedHeight)
+        image = image.rescaled (bakedWidth, bakedHeight, juce::Graphics::highResamplingQuality);
+
+    output.deleteFile();
+    juce::FileOutputStream stream (output);
+
+    if (! stream.openedOk() || ! juce::PNGImageFormat().writeImageToStream (image, stream))
+    {
+        std::fprintf (stderr, "HarmonsterAssetBaker: cannot write %s\n", argv[2]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,958 @@
+//==============================================================================
+// HarmonsterConstantFit - fits the circuit constants to a real pedal
+//
+// Takes one or more pairs of recordings made at the same knob settings: a dry
+// DI take and the pedal's output for it. Refits WoolyMammothDSP's
+// CircuitConstants so the circuit's render of each DI matches the pedal, and
+// prints the result (and with --save writes it) as lines that paste straight
+// into the struct's defaults.
+//
+// The score is the error-to-signal ratio (ESR) of the render against the
+// pedal. Each candidate renders --segments short segments rather than the
+// recordings, spread over the parts where the DI is playing. A segment starts
+// from the state a render of the whole take at the defaults had reached
+// there, so the slow battery sag and thermal drift come in warm, and runs
+// --preroll-ms of the audio leading up to it to let the fast state settle to
+// the candidate. Candidates are rendered four at a time, one per lane of
+// WoolyMammothDSP::processCandidates(), which shares the circuit up to Q1
+// between them and runs the rest in SIMD lockstep.
+//
+// The pedal take is aligned to the circuit at the lag (and polarity) of the
+// strongest cross-correlation with a render at the defaults. That can land a
+// few samples off once the constants move, so every candidate is scored at
+// the lags within two samples of the best candidate's so far (and no more
+// than a millisecond from the cross-correlation's), each at the recording
+// level that suits it best, which is solved for rather than searched.
+//
+// The optimiser is separable CMA-ES: a diagonal covariance, so it scales to
+// the 30-odd constants, working on log2 of each constant over its default,
+// bounded to a factor of two either way; a sample outside the bounds is
+// drawn again rather than evaluated at the bound, so the search doesn't
+// drift over the flat ground beyond them. Once a run has converged or
+// stopped improving it restarts from the best point so far with twice the
+// population (IPOP-CMA-ES), which gets out of the local basins a gated fuzz
+// is full of. Every generation's candidates are rendered across all cores.
+// Candidates are abandoned once their partial error exceeds the worst
+// candidate selected in the previous generation; the partial error at the
+// best level can only grow, so a finished candidate always ranks ahead of an
+// abandoned one.
+//
+// --self-test runs the whole fit on a synthetic pair instead: a generated DI
+// line and the circuit's own render of it with three constants moved, a few
+// samples late and at a lower level. It fits until the segments are down to
+// -50 dB, or the budget runs out, and exits with 1 unless the fit renders
+// that pedal back to -40 dB ESR on the segments and -30 dB over the whole
+// take, at the right lag and level. The Q2 bit reduction is left out there: its
+// round() has the candidates' error sit at the quantisation noise until the
+// constants are within about a percent of the pedal's, a needle no search
+// finds, where a real pedal has no such quantiser to match.
+//
+// Usage:
+//   HarmonsterConstantFit <di.wav> <pedal.wav> [<di.wav> <pedal.wav> ...]
+//                         [--preset=0] [--wool=] [--pinch=] [--eq=] [--output=]
+//                         [--no-sag] [--no-texture] [--passive-eq]
+//                         [--segments=16] [--segment-ms=60] [--preroll-ms=40]
+//                         [--evaluations=20000] [--minutes=10] [--threads=N]
+//                         [--save=constants.txt]
+//   HarmonsterConstantFit --self-test [--preset=0] [--segments=16] ...
+//==============================================================================
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "WoolyMammothDSP.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <thread>
+
+namespace
+{
+    using Constants = WoolyMammothDSP::CircuitConstants;
+
+    struct FittedConstant
+    {
+        const char* name;
+        double Constants::* member;
+    };
+
+    // Every constant the fit may move
+    constexpr FittedConstant fittedConstants[] {
+        { "q1_bias_voltage", &Constants::q1_bias_voltage },
+        { "q1_sag_bias_shift", &Constants::q1_sag_bias_shift },
+        { "q1_gain", &Constants::q1_gain },
+        { "q1_thermal", &Constants::q1_thermal },
+        { "q2_bias_voltage", &Constants::q2_bias_voltage },
+        { "q2_sag_bias_shift", &Constants::q2_sag_bias_shift },
+        { "q2_gate_threshold", &Constants::q2_gate_threshold },
+        { "q2_gain", &Constants::q2_gain },
+        { "q2_bias_gain_floor", &Constants::q2_bias_gain_floor },
+        { "q2_bias_gain", &Constants::q2_bias_gain },
+        { "q2_thermal", &Constants::q2_thermal },
+        { "q2_saturation", &Constants::q2_saturation },
+        { "q2_compression", &Constants::q2_compression },
+        { "q2_sag_compression", &Constants::q2_sag_compression },
+        { "q2_negative_level", &Constants::q2_negative_level },
+        { "q2_positive_squash", &Constants::q2_positive_squash },
+        { "q2_negative_squash", &Constants::q2_negative_squash },
+        { "q2_vce_threshold", &Constants::q2_vce_threshold },
+        { "q2_vce_slope", &Constants::q2_vce_slope },
+        { "q2_vce_sat", &Constants::q2_vce_sat },
+        { "fuzz_drive", &Constants::fuzz_drive },
+        { "fuzz_gated_drive", &Constants::fuzz_gated_drive },
+        { "fuzz_harmonics", &Constants::fuzz_harmonics },
+        { "fuzz_gated_harmonics", &Constants::fuzz_gated_harmonics },
+        { "fuzz_second", &Constants::fuzz_second },
+        { "fuzz_third", &Constants::fuzz_third },
+        { "fuzz_intermodulation", &Constants::fuzz_intermodulation },
+        { "crossover_threshold", &Constants::crossover_threshold },
+        { "crossover_gain", &Constants::crossover_gain },
+        { "hf_texture_frequency", &Constants::hf_texture_frequency },
+        { "hf_texture_active_frequency", &Constants::hf_texture_active_frequency },
+        { "hf_texture_amount", &Constants::hf_texture_amount },
+        { "bit_depth", &Constants::bit_depth },
+        { "active_bit_depth", &Constants::active_bit_depth }
+    };
+
+    constexpr int numConstants = static_cast<int> (std::size (fittedConstants));
+    constexpr double lagRangeMs = 1.0;  // the fitted lag stays within this of the cross-correlation's
+    constexpr int lagWindow = 2;        // lags scored either side of the best candidate's
+
+    // Candidates per render, one per lane of WoolyMammothDSP::processCandidates()
+    constexpr std::size_t candidateLanes = 4;
+
+    struct FitOptions
+    {
+        juce::Array<juce::File> diFiles, pedalFiles;
+        double wool = 0.5, pinch = 0.5, eq = 0.5, output = 0.5;
+        unsigned features = WoolyMammothDSP::allFeatures & ~static_cast<unsigned> (WoolyMammothDSP::passiveEq);
+        int numSegments = 16;
+        double segmentMs = 60.0, preRollMs = 40.0;
+        int maxEvaluations = 20000;
+        double maxMinutes = 10.0;
+        int numThreads = 1;
+        juce::File saveFile;
+        bool selfTest = false;
+    };
+
+    // A stretch of DI with the audio leading into it, and what the pedal made of it
+    struct Segment
+    {
+        WoolyMammothDSP::State start;
+        std::vector<float> input;   // pre-roll followed by the segment
+        std::vector<float> target;  // the segment with the lag range either side
+        int length = 0;
+    };
+
+    //==========================================================================
+    bool parseOptions (const juce::ArgumentList& args, FitOptions& options)
+    {
+        const auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+        juce::Array<juce::File> files;
+
+        for (const auto& argument : args.arguments)
+            if (! argument.isOption())
+                files.add (workingDirectory.getChildFile (argument.text));
+
+        options.selfTest = args.containsOption ("--self-test");
+        if (options.selfTest != files.isEmpty() || files.size() % 2 != 0)
+            return false;
+
+        for (int i = 0; i < files.size(); i += 2)
+        {
+            options.diFiles.add (files[i]);
+            options.pedalFiles.add (files[i + 1]);
+        }
+
+        const int presetIndex = args.containsOption ("--preset") ? args.getValueForOption ("--preset").getIntValue() : 0;
+        const auto& preset = WoolyMammothPresets::factoryPresets[static_cast<size_t> (juce::jlimit (0, WoolyMammothPresets::numFactoryPresets - 1, presetIndex))];
+
+        options.wool = preset.wool;
+        options.pinch = preset.pinch;
+        options.eq = preset.eq;
+        options.output = preset.output;
+
+        auto readKnob = [&args] (const char* option, double& value)
+        {
+            if (args.containsOption (option))
+                value = juce::jlimit (0.0, 1.0, args.getValueForOption (option).getDoubleValue());
+        };
+
+        readKnob ("--wool", options.wool);
+        readKnob ("--pinch", options.pinch);
+        readKnob ("--eq", options.eq);
+        readKnob ("--output", options.output);
+
+        if (args.containsOption ("--no-sag"))
+            options.features &= ~static_cast<unsigned> (WoolyMammothDSP::supplySag);
+        if (args.containsOption ("--no-texture"))
+            options.features &= ~WoolyMammothDSP::textureFeatures;
+        if (args.containsOption ("--passive-eq"))
+            options.features |= WoolyMammothDSP::passiveEq;
+
+        if (args.containsOption ("--segments"))
+            options.numSegments = juce::jmax (1, args.getValueForOption ("--segments").getIntValue());
+        if (args.containsOption ("--segment-ms"))
+            options.segmentMs = juce::jmax (5.0, args.getValueForOption ("--segment-ms").getDoubleValue());
+        if (args.containsOption ("--preroll-ms"))
+            options.preRollMs = juce::jmax (0.0, args.getValueForOption ("--preroll-ms").getDoubleValue());
+        if (args.containsOption ("--evaluations"))
+            options.maxEvaluations = juce::jmax (1, args.getValueForOption ("--evaluations").getIntValue());
+        if (args.containsOption ("--minutes"))
+            options.maxMinutes = juce::jmax (0.01, args.getValueForOption ("--minutes").getDoubleValue());
+
+        options.numThreads = juce::SystemStats::getNumCpus();
+        if (args.containsOption ("--threads"))
+            options.numThreads = juce::jmax (1, args.getValueForOption ("--threads").getIntValue());
+
+        if (args.containsOption ("--save"))
+            options.saveFile = workingDirectory.getChildFile (args.getValueForOption ("--save"));
+
+        return true;
+    }
+
+    Constants toConstants (const std::vector<double>& coordinates)
+    {
+        Constants constants;
+        for (int i = 0; i < numConstants; ++i)
+        {
+            auto& value = constants.*(fittedConstants[i].member);
+            value *= std::exp2 (juce::jlimit (-1.0, 1.0, coordinates[static_cast<size_t> (i)]));
+        }
+
+        return constants;
+    }
+
+    double toDb (double ratio) { return 10.0 * std::log10 (juce::jmax (ratio, 1.0e-30)); }
+
+    // How one candidate's render matches the pedal at the level and lag that suit it best
+    struct Fit
+    {
+        double esr = 1.0;
+        double level = 0.0;     // gain on the render
+        int lag = 0;            // samples the pedal runs late against the cross-correlation's lag
+        bool finished = false;  // false once abandoned
+    };
+
+    //==========================================================================
+    // Renders the segments with a batch of candidates' constants and scores them
+    class Scorer
+    {
+    public:
+        Scorer (const WoolyMammothDSP& circuit, const std::vector<Segment>& segmentsToScore, int maxLag)
+            : prototype (circuit), segments (segmentsToScore), lagRange (maxLag), numLags (2 * maxLag + 1),
+              segmentEnergies (segmentsToScore.size() * static_cast<size_t> (numLags), 0.0),
+              targetEnergies (static_cast<size_t> (numLags), 0.0)
+        {
+            for (size_t s = 0; s < segments.size(); ++s)
+            {
+                maxInput = juce::jmax (maxInput, segments[s].input.size());
+
+                for (int lag = 0; lag < numLags; ++lag)
+                {
+                    double energy = 0.0;
+                    for (int i = 0; i < segments[s].length; ++i)
+                    {
+                        const double sample = segments[s].target[static_cast<size_t> (lag + i)];
+                        energy += sample * sample;
+                    }
+
+                    segmentEnergies[s * static_cast<size_t> (numLags) + static_cast<size_t> (lag)] = energy;
+                    targetEnergies[static_cast<size_t> (lag)] += energy;
+                }
+            }
+        }
+
+        // Scores count <= candidateLanes candidates at the lags within
+        // lagWindow of centreLag. The error at each lag is the least squares
+        // one over the level, and no more segments are rendered for a
+        // candidate once its error so far passes abandonAbove at every lag.
+        void score (const std::vector<double>* const* candidates, size_t count, int centreLag,
+                    double abandonAbove, std::vector<float>& scratch, Fit* fits) const
+        {
+            auto dsp = prototype;
+            Constants constants[candidateLanes];
+            float* outputs[candidateLanes];
+            scratch.resize (candidateLanes * maxInput);
+
+            // Spare lanes render the first candidate again
+            for (size_t lane = 0; lane < candidateLanes; ++lane)
+            {
+                constants[lane] = toConstants (*candidates[juce::jmin (lane, count - 1)]);
+                outputs[lane] = scratch.data() + lane * maxInput;
+            }
+
+            const int firstLag = juce::jmax (0, lagRange + centreLag - lagWindow);
+            const int lastLag = juce::jmin (numLags - 1, lagRange + centreLag + lagWindow);
+            double renderEnergy[candidateLanes] {};
+            double cross[candidateLanes][2 * lagWindow + 1] {};
+            double segmentTarget[2 * lagWindow + 1] {};
+            size_t running = count;
+
+            for (size_t k = 0; k < count; ++k)
+                fits[k] = { 1.0, 0.0, centreLag, true };
+
+            for (size_t s = 0; s < segments.size() && running > 0; ++s)
+            {
+                const auto& segment = segments[s];
+                dsp.processCandidates (segment.start, constants, segment.input.data(), outputs, static_cast<int> (segment.input.size()));
+
+                for (int lag = firstLag; lag <= lastLag; ++lag)
+                    segmentTarget[lag - firstLag] += segmentEnergies[s * static_cast<size_t> (numLags) + static_cast<size_t> (lag)];
+
+                for (size_t k = 0; k < count; ++k)
+                {
+                    if (! fits[k].finished)
+                        continue;
+
+                    const float* rendered = outputs[k] + (segment.input.size() - static_cast<size_t> (segment.length));
+                    for (int i = 0; i < segment.length; ++i)
+                        renderEnergy[k] += static_cast<double> (rendered[i]) * rendered[i];
+
+                    // At gain g the error is T - 2gC + g^2 R, least at g = C / R; a
+                    // negative C would want the polarity flipped, which alignment has settled
+                    fits[k].esr = std::numeric_limits<double>::infinity();
+                    for (int lag = firstLag; lag <= lastLag; ++lag)
+                    {
+                        const float* target = segment.target.data() + lag;
+                        double& c = cross[k][lag - firstLag];
+                        for (int i = 0; i < segment.length; ++i)
+                            c += static_cast<double> (rendered[i]) * target[i];
+
+                        const double level = renderEnergy[k] > 0.0 ? juce::jmax (0.0, c) / renderEnergy[k] : 0.0;
+                        const double esr = (segmentTarget[lag - firstLag] - level * c) / targetEnergies[static_cast<size_t> (lag)];
+
+                        if (esr < fits[k].esr)
+                            fits[k] = { esr, level, lag - lagRange, true };
+                    }
+
+                    if (fits[k].esr > abandonAbove)
+                    {
+                        fits[k].finished = false;
+                        --running;
+                    }
+                }
+            }
+        }
+
+        int getNumSegments() const { return static_cast<int> (segments.size()); }
+
+    private:
+        const WoolyMammothDSP& prototype;
+        const std::vector<Segment>& segments;
+        int lagRange, numLags;
+        size_t maxInput = 0;
+        std::vector<double> segmentEnergies;  // by segment, then lag
+        std::vector<double> targetEnergies;   // all segments, by lag
+    };
+
+    //==========================================================================
+    // Separable CMA-ES (Ros & Hansen): the covariance is kept diagonal, which
+    // makes every update linear in the number of dimensions. Samples stay
+    // within [-1, 1] in every coordinate.
+    class SeparableCmaEs
+    {
+    public:
+        SeparableCmaEs (const std::vector<double>& start, int populationSize, double initialSigma, unsigned seed)
+            : n (static_cast<int> (start.size())), lambda (populationSize), mu (populationSize / 2), sigma (initialSigma), rng (seed),
+              mean (start), variances (static_cast<size_t> (n), 1.0),
+              pathSigma (static_cast<size_t> (n), 0.0), pathCovariance (static_cast<size_t> (n), 0.0),
+              samples (static_cast<size_t> (lambda), std::vector<double> (static_cast<size_t> (n))),
+              normals (samples)
+        {
+            double sum = 0.0, sumSquares = 0.0;
+            for (int i = 0; i < mu; ++i)
+            {
+                weights.push_back (std::log (mu + 0.5) - std::log (i + 1.0));
+                sum += weights.back();
+            }
+
+            for (auto& weight : weights)
+            {
+                weight /= sum;
+                sumSquares += weight * weight;
+            }
+
+            muEffective = 1.0 / sumSquares;
+            cSigma = (muEffective + 2.0) / (n + muEffective + 5.0);
+            dSigma = 1.0 + 2.0 * std::max (0.0, std::sqrt ((muEffective - 1.0) / (n + 1.0)) - 1.0) + cSigma;
+            cCovariance = (4.0 + muEffective / n) / (n + 4.0 + 2.0 * muEffective / n);
+
+            // Rank-one and rank-mu learning rates, sped up by (n + 2) / 3 for the diagonal model
+            const double speedUp = (n + 2.0) / 3.0;
+            cOne = std::min (1.0, speedUp * 2.0 / ((n + 1.3) * (n + 1.3) + muEffective));
+            cMu = std::min (1.0 - cOne, speedUp * 2.0 * (muEffective - 2.0 + 1.0 / muEffective) / ((n + 2.0) * (n + 2.0) + muEffective));
+            expectedNorm = std::sqrt (static_cast<double> (n)) * (1.0 - 1.0 / (4.0 * n) + 1.0 / (21.0 * n * n));
+        }
+
+        const std::vector<std::vector<double>>& sample()
+        {
+            std::normal_distribution<double> normal;
+
+            for (int k = 0; k < lambda; ++k)
+                for (int i = 0; i < n; ++i)
+                {
+                    auto& z = normals[static_cast<size_t> (k)][static_cast<size_t> (i)];
+                    auto& x = samples[static_cast<size_t> (k)][static_cast<size_t> (i)];
+                    const double centre = mean[static_cast<size_t> (i)];
+                    const double scale = sigma * std::sqrt (variances[static_cast<size_t> (i)]);
+
+                    // Out of bounds is drawn again; the rare coordinate still out
+                    // after that is put on the bound, with the normal that lands there
+                    for (int attempt = 0; attempt < 10; ++attempt)
+                    {
+                        z = normal (rng);
+                        x = centre + scale * z;
+
+                        if (std::abs (x) <= 1.0)
+                            break;
+                    }
+
+                    if (std::abs (x) > 1.0)
+                    {
+                        x = juce::jlimit (-1.0, 1.0, x);
+                        z = (x - centre) / scale;
+                    }
+                }
+
+            return samples;
+        }
+
+        void update (const std::vector<double>& scores)
+        {
+            std::vector<int> order (static_cast<size_t> (lambda));
+            std::iota (order.begin(), order.end(), 0);
+            std::sort (order.begin(), order.end(), [&scores] (int a, int b) { return scores[static_cast<size_t> (a)] < scores[static_cast<size_t> (b)]; });
+
+            ++generation;
+            std::vector<double> meanStep (static_cast<size_t> (n), 0.0), normalStep (static_cast<size_t> (n), 0.0);
+
+            for (int j = 0; j < mu; ++j)
+                for (int i = 0; i < n; ++i)
+                {
+                    const auto k = static_cast<size_t> (order[static_cast<size_t> (j)]);
+                    meanStep[static_cast<size_t> (i)] += weights[static_cast<size_t> (j)] * (samples[k][static_cast<size_t> (i)] - mean[static_cast<size_t> (i)]);
+                    normalStep[static_cast<size_t> (i)] += weights[static_cast<size_t> (j)] * normals[k][static_cast<size_t> (i)];
+                }
+
+            // Evolution paths; with a diagonal covariance C^-1/2 (m' - m) / sigma is the weighted normal
+            double pathNorm = 0.0;
+            for (int i = 0; i < n; ++i)
+            {
+                auto& p = pathSigma[static_cast<size_t> (i)];
+                p = (1.0 - cSigma) * p + std::sqrt (cSigma * (2.0 - cSigma) * muEffective) * normalStep[static_cast<size_t> (i)];
+                pathNorm += p * p;
+            }
+
+            pathNorm = std::sqrt (pathNorm);
+            const bool stalled = pathNorm / std::sqrt (1.0 - std::pow (1.0 - cSigma, 2.0 * generation)) / expectedNorm
+                                 >= 1.4 + 2.0 / (n + 1.0);
+            const double hSigma = stalled ? 0.0 : 1.0;
+
+            for (int i = 0; i < n; ++i)
+            {
+                const auto index = static_cast<size_t> (i);
+                auto& p = pathCovariance[index];
+                p = (1.0 - cCovariance) * p + hSigma * std::sqrt (cCovariance * (2.0 - cCovariance) * muEffective) * meanStep[index] / sigma;
+
+                double rankMu = 0.0;
+                for (int j = 0; j < mu; ++j)
+                {
+                    const double y = (samples[static_cast<size_t> (order[static_cast<size_t> (j)])][index] - mean[index]) / sigma;
+                    rankMu += weights[static_cast<size_t> (j)] * y * y;
+                }
+
+                auto& variance = variances[index];
+                variance = (1.0 - cOne - cMu) * variance
+                           + cOne * (p * p + (1.0 - hSigma) * cCovariance * (2.0 - cCovariance) * variance)
+                           + cMu * rankMu;
+
+                mean[index] += meanStep[index];
+            }
+
+            sigma *= std::exp ((cSigma / dSigma) * (pathNorm / expectedNorm - 1.0));
+        }
+
+        double getSigma() const { return sigma * std::sqrt (*std::max_element (variances.begin(), variances.end())); }
+        int getMu() const { return mu; }
+
+    private:
+        int n, lambda, mu;
+        double sigma;
+        std::mt19937 rng;
+        std::vector<double> mean, variances, pathSigma, pathCovariance, weights;
+        std::vector<std::vector<double>> samples, normals;
+        double muEffective = 1.0, cSigma = 0.0, dSigma = 1.0, cCovariance = 0.0, cOne = 0.0, cMu = 0.0, expectedNorm = 1.0;
+        int generation = 0;
+    };
+
+    //==========================================================================
+    bool readMono (juce::AudioFormatManager& formatManager, const juce::File& file, std::vector<float>& samples, double& sampleRate)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (file));
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->lengthInSamples > std::numeric_limits<int>::max())
+            return false;
+
+        juce::AudioBuffer<float> buffer (static_cast<int> (reader->numChannels), static_cast<int> (reader->lengthInSamples));
+        if (! reader->read (&buffer, 0, buffer.getNumSamples(), 0, true, true))
+            return false;
+
+        samples.assign (buffer.getReadPointer (0), buffer.getReadPointer (0) + buffer.getNumSamples());
+        sampleRate = reader->sampleRate;
+        return true;
+    }
+
+    struct Alignment
+    {
+        int lag = 0;            // samples the pedal take runs late
+        bool inverted = false;  // the take's polarity was flipped
+    };
+
+    // Shifts and if need be inverts the pedal take so it lines up with the
+    // circuit's render of the DI
+    Alignment alignToCircuit (const WoolyMammothDSP& circuit, const std::vector<float>& di, std::vector<float>& pedal, int maxLag)
+    {
+        const int length = static_cast<int> (juce::jmin (di.size(), pedal.size(), static_cast<size_t> (10 * maxLag + 96000)));
+        std::vector<float> rendered (di.begin(), di.begin() + length);
+        auto dsp = circuit;
+        dsp.processBlock (rendered.data(), length);
+
+        int bestLag = 0;
+        double bestCorrelation = 0.0;
+
+        for (int lag = -maxLag; lag <= maxLag; ++lag)
+        {
+            double correlation = 0.0;
+            for (int i = juce::jmax (0, -lag); i < length && i + lag < length; ++i)
+                correlation += static_cast<double> (rendered[static_cast<size_t> (i)]) * pedal[static_cast<size_t> (i + lag)];
+
+            if (std::abs (correlation) > std::abs (bestCorrelation))
+            {
+                bestCorrelation = correlation;
+                bestLag = lag;
+            }
+        }
+
+        // pedal[i + lag] lines up with rendered[i]
+        std::vector<float> aligned (pedal.size(), 0.0f);
+        const float polarity = bestCorrelation < 0.0 ? -1.0f : 1.0f;
+        for (int i = 0; i < static_cast<int> (pedal.size()); ++i)
+            if (i + bestLag >= 0 && i + bestLag < static_cast<int> (pedal.size()))
+                aligned[static_cast<size_t> (i)] = polarity * pedal[static_cast<size_t> (i + bestLag)];
+
+        pedal = std::move (aligned);
+        return { bestLag, polarity < 0.0f };
+    }
+
+    // Cuts a take into segments, each with its mean square DI level
+    void collectSegments (const WoolyMammothDSP& circuit, const std::vector<float>& di, const std::vector<float>& pedal,
+                          int preRoll, int length, int lagRange, std::vector<std::pair<double, Segment>>& candidates)
+    {
+        const int end = static_cast<int> (juce::jmin (di.size(), pedal.size()));
+        auto dsp = circuit;
+        std::vector<float> scratch;
+        int position = 0;
+
+        for (int start = juce::jmax (preRoll, lagRange); start + length + lagRange <= end; start += length)
+        {
+            // Runs the render at the defaults up to where this segment's pre-roll begins
+            scratch.assign (di.begin() + position, di.begin() + (start - preRoll));
+            dsp.processBlock (scratch.data(), static_cast<int> (scratch.size()));
+            position = start - preRoll;
+
+            double energy = 0.0;
+            for (int i = start; i < start + length; ++i)
+                energy += static_cast<double> (di[static_cast<size_t> (i)]) * di[static_cast<size_t> (i)];
+
+            Segment segment;
+            segment.start = dsp.snapshot();
+            segment.input.assign (di.begin() + (start - preRoll), di.begin() + (start + length));
+            segment.target.assign (pedal.begin() + (start - lagRange), pedal.begin() + (start + length + lagRange));
+            segment.length = length;
+            candidates.emplace_back (energy / length, std::move (segment));
+        }
+    }
+
+    // Segments where the DI is within 30 dB of the loudest one, evenly spaced
+    // so every part of every take gets its say
+    std::vector<Segment> pickSegments (std::vector<std::pair<double, Segment>>& candidates, int maxSegments)
+    {
+        double loudest = 0.0;
+        for (const auto& candidate : candidates)
+            loudest = juce::jmax (loudest, candidate.first);
+
+        std::vector<Segment> playing;
+        for (auto& candidate : candidates)
+            if (candidate.first >= loudest * 0.001)
+                playing.push_back (std::move (candidate.second));
+
+        std::vector<Segment> segments;
+        const size_t numSegments = juce::jmin (playing.size(), static_cast<size_t> (maxSegments));
+        for (size_t i = 0; i < numSegments; ++i)
+            segments.push_back (std::move (playing[i * playing.size() / numSegments]));
+
+        return segments;
+    }
+
+    //==========================================================================
+    struct FitResult
+    {
+        std::vector<double> best;
+        Fit fit, atDefaults;
+        int evaluations = 0, abandoned = 0, restarts = 0;
+        double seconds = 0.0;
+    };
+
+    // IPOP separable CMA-ES from the defaults until the evaluations or the
+    // time run out, or the ESR gets down to targetEsr
+    FitResult runFit (const Scorer& scorer, const FitOptions& options, double targetEsr)
+    {
+        FitResult result;
+        result.best.assign (static_cast<size_t> (numConstants), 0.0);
+
+        std::vector<float> mainScratch;
+        const std::vector<double>* defaults[] { &result.best };
+        scorer.score (defaults, 1, 0, std::numeric_limits<double>::infinity(), mainScratch, &result.atDefaults);
+        result.fit = result.atDefaults;
+
+        // Whole batches of lanes, and enough of them for every thread
+        const auto minimumPopulation = juce::jmax (4 + static_cast<int> (3.0 * std::log (numConstants)),
+                                                   static_cast<int> (candidateLanes) * options.numThreads);
+        const int basePopulation = static_cast<int> (candidateLanes) * ((minimumPopulation + static_cast<int> (candidateLanes) - 1) / static_cast<int> (candidateLanes));
+
+        std::printf ("Fitting %d constants on %d segment(s) of %.0f ms: %d candidates per generation at first, %d thread(s)\n",
+                     numConstants, scorer.getNumSegments(), options.segmentMs, basePopulation, options.numThreads);
+        std::printf ("Defaults: ESR %.2f dB\n", toDb (result.atDefaults.esr));
+
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        auto elapsedSeconds = [startTicks] { return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks); };
+        auto withinBudget = [&]
+        {
+            return result.evaluations < options.maxEvaluations && elapsedSeconds() < options.maxMinutes * 60.0
+                && result.fit.esr > targetEsr;
+        };
+
+        int generation = 0;
+        double lastReport = 0.0;
+
+        for (int populationSize = basePopulation, run = 0; withinBudget(); populationSize *= 2, ++run)
+        {
+            result.restarts = run;
+            SeparableCmaEs optimiser (result.best, populationSize, 0.3, static_cast<unsigned> (result.restarts + 1));
+
+            // A run ends once its step has collapsed, or after this many
+            // generations without bettering its own best ESR by 1%
+            const int patience = 10 + (30 * numConstants + populationSize - 1) / populationSize;
+            double abandonAbove = std::numeric_limits<double>::infinity();
+            double runBest = std::numeric_limits<double>::infinity();
+            int runGeneration = 0, lastImprovement = 0;
+
+            if (run > 0)
+                std::printf ("  restart %d from the best so far with %d candidates per generation\n", run, populationSize);
+
+            while (withinBudget() && optimiser.getSigma() > 1.0e-3 && runGeneration - lastImprovement < patience)
+            {
+                const auto& population = optimiser.sample();
+                const size_t numBatches = (population.size() + candidateLanes - 1) / candidateLanes;
+                const int centreLag = result.fit.lag;
+                std::vector<Fit> fits (population.size());
+                std::atomic<size_t> next { 0 };
+                std::vector<std::thread> workers;
+
+                for (int worker = 0; worker < options.numThreads; ++worker)
+                {
+                    workers.emplace_back ([&]
+                    {
+                        std::vector<float> scratch;
+                        for (size_t batch = next++; batch < numBatches; batch = next++)
+                        {
+                            const size_t first = batch * candidateLanes;
+                            const size_t count = juce::jmin (candidateLanes, population.size() - first);
+                            const std::vector<double>* candidates[candidateLanes] {};
+
+                            for (size_t k = 0; k < count; ++k)
+                                candidates[k] = &population[first + k];
+
+                            scorer.score (candidates, count, centreLag, abandonAbove, scratch, fits.data() + first);
+                        }
+                    });
+                }
+
+                for (auto& worker : workers)
+                    worker.join();
+
+                std::vector<double> scores (population.size());
+                for (size_t k = 0; k < population.size(); ++k)
+                {
+                    scores[k] = fits[k].esr;
+
+                    if (! fits[k].finished)
+                    {
+                        ++result.abandoned;
+                        continue;
+                    }
+
+                    if (fits[k].esr < result.fit.esr)
+                    {
+                        result.fit = fits[k];
+                        result.best = population[k];
+                    }
+
+                    if (fits[k].esr < runBest * 0.99)
+                    {
+                        runBest = fits[k].esr;
+                        lastImprovement = runGeneration;
+                    }
+                }
+
+                result.evaluations += static_cast<int> (population.size());
+                ++runGeneration;
+                ++generation;
+
+                // The next generation abandons anything worse than the worst candidate selected in this one
+                auto sorted = scores;
+                std::nth_element (sorted.begin(), sorted.begin() + (optimiser.getMu() - 1), sorted.end());
+                abandonAbove = sorted[static_cast<size_t> (optimiser.getMu() - 1)];
+
+                optimiser.update (scores);
+
+                if (elapsedSeconds() - lastReport >= 2.0)
+                {
+                    lastReport = elapsedSeconds();
+                    std::printf ("  generation %5d  %7d renders (%6.0f/s, %2.0f%% abandoned)  best ESR %7.2f dB  step %.4f\n",
+                                 generation, result.evaluations, result.evaluations / lastReport,
+                                 100.0 * result.abandoned / result.evaluations, toDb (result.fit.esr), optimiser.getSigma());
+                }
+            }
+        }
+
+        result.seconds = elapsedSeconds();
+        return result;
+    }
+
+    //==========================================================================
+    // The pair --self-test fits: a bass line of plucked notes with their
+    // second and third harmonics, with gaps and a little noise, and the
+    // circuit's render of it with three constants moved, selfTestLag samples
+    // late at selfTestLevel
+    constexpr int selfTestLag = 6;
+    constexpr double selfTestLevel = 0.7;
+
+    std::vector<float> syntheticDi (double sampleRate, double seconds)
+    {
+        const double notes[] { 41.2, 55.0, 73.4, 82.4, 110.0, 146.8, 164.8, 220.0 };
+        std::vector<float> di (static_cast<size_t> (sampleRate * seconds), 0.0f);
+        std::mt19937 rng (3);
+        std::uniform_real_distribution<double> uniform;
+        size_t position = 0;
+
+        while (position < di.size())
+        {
+            const auto length = static_cast<size_t> (sampleRate * (0.15 + 0.5 * uniform (rng)));
+            const double frequency = notes[static_cast<size_t> (uniform (rng) * std::size (notes)) % std::size (notes)];
+            const double amplitude = 0.05 + 0.6 * uniform (rng);
+
+            for (size_t i = 0; i < length && position + i < di.size(); ++i)
+            {
+                const double t = static_cast<double> (i) / sampleRate;
+                const double phase = juce::MathConstants<double>::twoPi * frequency * t;
+                const double envelope = amplitude * std::exp (-3.0 * t) * juce::jmin (1.0, 500.0 * t);
+                di[position + i] = static_cast<float> (envelope * (std::sin (phase) + 0.3 * std::sin (2.0 * phase + 0.5) + 0.1 * std::sin (3.0 * phase)));
+            }
+
+            position += length + static_cast<size_t> (sampleRate * 0.05 * uniform (rng));
+        }
+
+        for (auto& sample : di)
+            sample += static_cast<float> (0.001 * (uniform (rng) - 0.5));
+
+        return di;
+    }
+
+    std::vector<float> syntheticPedal (const WoolyMammothDSP& circuit, const std::vector<float>& di)
+    {
+        Constants pedalConstants;
+        pedalConstants.q1_bias_voltage *= 1.15;
+        pedalConstants.q2_gain *= 1.3;
+        pedalConstants.fuzz_drive *= 0.75;
+
+        auto dsp = circuit;
+        dsp.setCircuitConstants (pedalConstants);
+        auto rendered = di;
+        dsp.processBlock (rendered.data(), static_cast<int> (rendered.size()));
+
+        std::vector<float> pedal (di.size(), 0.0f);
+        for (size_t i = 0; i + selfTestLag < di.size(); ++i)
+            pedal[i + selfTestLag] = static_cast<float> (selfTestLevel * rendered[i]);
+
+        return pedal;
+    }
+
+    // ESR of the fitted render of a whole take against the aligned pedal take
+    double wholeTakeEsr (const WoolyMammothDSP& circuit, const std::vector<double>& fitted, const Fit& fit,
+                         const std::vector<float>& di, const std::vector<float>& pedal)
+    {
+        auto dsp = circuit;
+        dsp.setCircuitConstants (toConstants (fitted));
+        auto rendered = di;
+        dsp.processBlock (rendered.data(), static_cast<int> (rendered.size()));
+
+        double error = 0.0, energy = 0.0;
+        for (int i = juce::jmax (0, -fit.lag); i < static_cast<int> (rendered.size()) && i + fit.lag < static_cast<int> (pedal.size()); ++i)
+        {
+            const double target = pedal[static_cast<size_t> (i + fit.lag)];
+            const double difference = fit.level * rendered[static_cast<size_t> (i)] - target;
+            error += difference * difference;
+            energy += target * target;
+        }
+
+        return energy > 0.0 ? error / energy : 1.0;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    FitOptions options;
+    if (! parseOptions (args, options))
+    {
+        std::printf ("usage: HarmonsterConstantFit <di.wav> <pedal.wav> [<di.wav> <pedal.wav> ...] [--preset=N]\n"
+                     "                             [--wool=] [--pinch=] [--eq=] [--output=] [--no-sag] [--no-texture] [--passive-eq]\n"
+                     "                             [--segments=16] [--segment-ms=60] [--preroll-ms=40] [--evaluations=20000]\n"
+                     "                             [--minutes=10] [--threads=N] [--save=constants.txt]\n"
+                     "       HarmonsterConstantFit --self-test [options as above]\n");
+        return 1;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    WoolyMammothDSP circuit;
+    double sampleRate = 0.0;
+    int lagRange = 0;
+    std::vector<std::pair<double, Segment>> candidates;
+
+    auto setUpCircuit = [&] (double rate)
+    {
+        sampleRate = rate;
+        lagRange = juce::roundToInt (sampleRate * lagRangeMs / 1000.0);
+        circuit.setSampleRate (sampleRate);
+        circuit.setWool (options.wool);
+        circuit.setPinch (options.pinch);
+        circuit.setEQ (options.eq);
+        circuit.setOutput (options.output);
+        circuit.setFeatures (options.features);
+    };
+
+    auto addTake = [&] (const juce::String& name, const std::vector<float>& di, std::vector<float>& pedal)
+    {
+        const auto alignment = alignToCircuit (circuit, di, pedal, static_cast<int> (sampleRate * 0.02));
+        std::printf ("%s: %d samples late%s\n", name.toRawUTF8(), alignment.lag, alignment.inverted ? ", polarity inverted" : "");
+
+        collectSegments (circuit, di, pedal, static_cast<int> (sampleRate * options.preRollMs / 1000.0),
+                         juce::jmax (1, static_cast<int> (sampleRate * options.segmentMs / 1000.0)), lagRange, candidates);
+        return alignment;
+    };
+
+    // --self-test keeps its pair for the whole-take check
+    std::vector<float> selfTestDi, selfTestPedal;
+    Alignment selfTestAlignment;
+
+    if (options.selfTest)
+    {
+        options.features &= ~static_cast<unsigned> (WoolyMammothDSP::bitReduction);
+        setUpCircuit (48000.0);
+
+        selfTestDi = syntheticDi (sampleRate, 8.0);
+        selfTestPedal = syntheticPedal (circuit, selfTestDi);
+        selfTestAlignment = addTake ("Synthetic pedal", selfTestDi, selfTestPedal);
+    }
+
+    for (int pair = 0; pair < options.diFiles.size(); ++pair)
+    {
+        std::vector<float> di, pedal;
+        double diRate = 0.0, pedalRate = 0.0;
+
+        if (! readMono (formatManager, options.diFiles[pair], di, diRate) || ! readMono (formatManager, options.pedalFiles[pair], pedal, pedalRate))
+        {
+            std::printf ("Cannot read %s or %s\n", options.diFiles[pair].getFullPathName().toRawUTF8(),
+                         options.pedalFiles[pair].getFullPathName().toRawUTF8());
+            return 1;
+        }
+
+        if (diRate < pedalRate || diRate > pedalRate || (sampleRate > 0.0 && (diRate < sampleRate || diRate > sampleRate)))
+        {
+            std::printf ("All recordings must share one sample rate\n");
+            return 1;
+        }
+
+        if (sampleRate <= 0.0)
+            setUpCircuit (diRate);
+
+        addTake (options.pedalFiles[pair].getFileName(), di, pedal);
+    }
+
+    const auto segments = pickSegments (candidates, options.numSegments);
+    if (segments.empty())
+    {
+        std::printf ("The DI recordings are silent\n");
+        return 1;
+    }
+
+    // The self-test stops with a margin over what it needs to pass, which
+    // pins the level down too; a real fit uses all its budget
+    const double segmentTargetDb = -40.0, wholeTakeTargetDb = -30.0, selfTestStopDb = -50.0;
+    const Scorer scorer (circuit, segments, lagRange);
+    const auto result = runFit (scorer, options, options.selfTest ? std::pow (10.0, selfTestStopDb / 10.0) : 0.0);
+
+    std::printf ("Done after %d renders in %.1f s (%.0f/s, %.0f%% abandoned early, %d restart(s))\n", result.evaluations, result.seconds,
+                 result.evaluations / juce::jmax (result.seconds, 1.0e-9), 100.0 * result.abandoned / juce::jmax (1, result.evaluations),
+                 result.restarts);
+    std::printf ("ESR %.2f dB at the defaults, %.2f dB fitted; recording level %+.2f dB and lag %+d samples against the initial estimate\n\n",
+                 toDb (result.atDefaults.esr), toDb (result.fit.esr), 20.0 * std::log10 (juce::jmax (result.fit.level, 1.0e-9)), result.fit.lag);
+
+    // As lines for the defaults in WoolyMammothDSP::CircuitConstants
+    const Constants defaults, fitted = toConstants (result.best);
+    juce::String lines;
+
+    for (const auto& constant : fittedConstants)
+    {
+        const double value = fitted.*(constant.member);
+        const double defaultValue = defaults.*(constant.member);
+        lines << "double " << constant.name << " = " << juce::String (value, 6) << ";";
+        if (value < defaultValue || value > defaultValue)
+            lines << "  // was " << juce::String (defaultValue, 6);
+        lines << "\n";
+    }
+
+    std::printf ("%s", lines.toRawUTF8());
+
+    if (options.saveFile != juce::File() && ! options.saveFile.replaceWithText (lines))
+    {
+        std::printf ("Cannot write %s\n", options.saveFile.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    if (options.selfTest)
+    {
+        // The constants themselves aren't checked: several sets render the same pedal
+        const double wholeTakeDb = toDb (wholeTakeEsr (circuit, result.best, result.fit, selfTestDi, selfTestPedal));
+        const int lag = selfTestAlignment.lag + result.fit.lag;
+        const double levelErrorDb = 20.0 * std::log10 (juce::jmax (result.fit.level, 1.0e-9) / selfTestLevel);
+
+        const bool passed = toDb (result.fit.esr) <= segmentTargetDb && wholeTakeDb <= wholeTakeTargetDb
+                            && lag == selfTestLag && ! selfTestAlignment.inverted && std::abs (levelErrorDb) <= 0.1;
+
+        std::printf ("\nSelf-test: segments %.2f dB (needs %.0f), whole take %.2f dB (needs %.0f), lag %d (needs %d), level off by %.3f dB\n",
+                     toDb (result.fit.esr), segmentTargetDb, wholeTakeDb, wholeTakeTargetDb, lag, selfTestLag, levelErrorDb);
+        std::printf ("Self-test: %s\n", passed ? "passed" : "FAILED");
+        return passed ? 0 : 1;
+    }
+
+    return 0;
+}
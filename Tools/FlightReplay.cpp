@@ -0,0 +1,258 @@
+//==============================================================================
+// Flight recorder replay, HarmonsterOfflineRender --replay
+//
+// Feeds a dump back through a fresh processor with the recorded block sizes
+// and per-block parameter values, twice, and checks that the two renders
+// agree bit for bit. The live plugin had been running before the recorded
+// window began, whereas the replay starts from a quiescent circuit, so the
+// replay is compared against the recorded output to show from which point on
+// it follows the live session.
+//
+// A recorded cabinet IR is loaded first and the processor runs on silence
+// until the convolution has picked it up and settled, so the asynchronous
+// load never lands inside the replay. Every block runs at the CPU governor
+// tier it was recorded at rather than one chosen from the replay's own timing.
+//==============================================================================
+
+#include "FlightReplay.h"
+#include "PluginProcessor.h"
+
+#include <cstdio>
+#include <limits>
+
+namespace
+{
+    using Recording = FlightRecorder::Recording;
+
+    constexpr double settleSeconds = 2.0;
+    constexpr int cabinetTimeoutMs = 10000;
+
+    bool render (const Recording& recording, juce::AudioBuffer<float>& output, juce::String& error)
+    {
+        WoolyMammothAudioProcessor processor;
+        const int numChannels = juce::jmax (recording.numInputChannels, recording.numOutputChannels);
+
+        // Recorded values are matched to parameters by ID, not position
+        std::vector<juce::AudioProcessorParameter*> targets;
+        for (const auto& id : recording.parameterIds)
+            targets.push_back (processor.parameters.getParameter (id));
+
+        auto applyParameters = [&targets] (const FlightRecorder::BlockRecord& block)
+        {
+            for (size_t i = 0; i < targets.size() && i < static_cast<size_t> (FlightRecorder::maxParameters); ++i)
+                if (targets[i] != nullptr && targets[i]->getValue() != block.parameters[i])
+                    targets[i]->setValueNotifyingHost (block.parameters[i]);
+        };
+
+        applyParameters (recording.blocks.front());
+        processor.pinQualityTier (recording.blocks.front().qualityTier);
+
+        const bool withCabinet = recording.cabinetFile.existsAsFile();
+        if (withCabinet)
+            processor.loadCabinetImpulseResponse (recording.cabinetFile);
+
+        processor.setPlayConfigDetails (recording.numInputChannels, recording.numOutputChannels,
+                                        recording.sampleRate, recording.maxBlockSize);
+        processor.prepareToPlay (recording.sampleRate, recording.maxBlockSize);
+
+        juce::AudioBuffer<float> buffer (numChannels, recording.maxBlockSize);
+        juce::MidiBuffer midi;
+
+        if (withCabinet)
+        {
+            const auto timeout = juce::Time::getMillisecondCounter() + static_cast<juce::uint32> (cabinetTimeoutMs);
+
+            while (processor.getTailLengthSeconds() <= 0.0)
+            {
+                if (juce::Time::getMillisecondCounter() > timeout)
+                {
+                    error = "Cannot load the cabinet IR " + recording.cabinetFile.getFullPathName();
+                    return false;
+                }
+
+                buffer.clear();
+                processor.processBlock (buffer, midi);
+                juce::Thread::sleep (1);
+            }
+
+            for (int settled = 0; settled < static_cast<int> (settleSeconds * recording.sampleRate); settled += recording.maxBlockSize)
+            {
+                buffer.clear();
+                processor.processBlock (buffer, midi);
+            }
+        }
+
+        output.setSize (recording.numOutputChannels, recording.input.getNumSamples());
+        int position = 0;
+
+        for (const auto& block : recording.blocks)
+        {
+            applyParameters (block);
+            processor.pinQualityTier (block.qualityTier);
+
+            buffer.setSize (numChannels, block.numSamples, false, false, true);
+            buffer.clear();
+
+            for (int channel = 0; channel < juce::jmin (recording.numInputChannels, recording.input.getNumChannels()); ++channel)
+                buffer.copyFrom (channel, 0, recording.input, channel, position, block.numSamples);
+
+            processor.processBlock (buffer, midi);
+
+            for (int channel = 0; channel < output.getNumChannels(); ++channel)
+                output.copyFrom (channel, position, buffer, channel, 0, block.numSamples);
+
+            position += block.numSamples;
+        }
+
+        processor.releaseResources();
+        return true;
+    }
+
+    //==========================================================================
+    struct Agreement
+    {
+        int firstMismatch = -1;    // -1: identical throughout
+        int matchesFrom = 0;       // first sample after which every deviation is within tolerance
+        float worstBefore = 0.0f;  // largest deviation before that
+    };
+
+    Agreement compare (const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b, float tolerance)
+    {
+        Agreement agreement;
+        const int numChannels = juce::jmin (a.getNumChannels(), b.getNumChannels());
+        const int numSamples = juce::jmin (a.getNumSamples(), b.getNumSamples());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const float* x = a.getReadPointer (channel);
+            const float* y = b.getReadPointer (channel);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const float deviation = std::abs (x[i] - y[i]);
+
+                if (x[i] != y[i] && (agreement.firstMismatch < 0 || i < agreement.firstMismatch))
+                    agreement.firstMismatch = i;
+
+                if (! (deviation <= tolerance))
+                {
+                    agreement.matchesFrom = juce::jmax (agreement.matchesFrom, i + 1);
+                    agreement.worstBefore = std::isfinite (deviation) ? juce::jmax (agreement.worstBefore, deviation)
+                                                                      : std::numeric_limits<float>::infinity();
+                }
+            }
+        }
+
+        return agreement;
+    }
+
+    void printSummary (const Recording& recording)
+    {
+        const double seconds = recording.input.getNumSamples() / recording.sampleRate;
+        int smallest = recording.maxBlockSize, largest = 0;
+
+        for (const auto& block : recording.blocks)
+        {
+            smallest = juce::jmin (smallest, block.numSamples);
+            largest = juce::jmax (largest, block.numSamples);
+        }
+
+        std::printf ("Flight recording: %.2f s at %.0f Hz, %d in / %d out, %d blocks of %d-%d samples\n",
+                     seconds, recording.sampleRate, recording.numInputChannels, recording.numOutputChannels,
+                     static_cast<int> (recording.blocks.size()), smallest, largest);
+
+        if (recording.triggerSample >= 0)
+            std::printf ("Dumped for: %s at %.3f s\n", FlightRecorder::describeTriggers (recording.triggers).toRawUTF8(),
+                         static_cast<double> (recording.triggerSample) / recording.sampleRate);
+
+        // Every block that raised an anomaly, and the slowest one against its budget
+        int position = 0, listed = 0;
+        size_t slowest = 0;
+
+        for (size_t i = 0; i < recording.blocks.size(); ++i)
+        {
+            const auto& block = recording.blocks[i];
+
+            if (block.triggers != 0 && listed++ < 20)
+                std::printf ("  %8.3f s  %-22s %5d samples %9.1f us  supply %.2f V  gate %.3f  %dx  tier %d\n",
+                             position / recording.sampleRate, FlightRecorder::describeTriggers (block.triggers).toRawUTF8(),
+                             block.numSamples, static_cast<double> (block.processMicros),
+                             static_cast<double> (block.supplyVoltage), static_cast<double> (block.gateActivity),
+                             block.oversamplingFactor, block.qualityTier);
+
+            if (block.processMicros * recording.blocks[slowest].numSamples > recording.blocks[slowest].processMicros * block.numSamples)
+                slowest = i;
+
+            position += block.numSamples;
+        }
+
+        const auto& worst = recording.blocks[slowest];
+        std::printf ("Slowest block: %.1f us for %d samples (%.0f%% of its real-time budget)\n",
+                     static_cast<double> (worst.processMicros), worst.numSamples,
+                     worst.processMicros * 1.0e-4 * recording.sampleRate / worst.numSamples);
+    }
+
+    bool writeOutput (const juce::File& file, const juce::AudioBuffer<float>& audio, double sampleRate)
+    {
+        file.deleteFile();
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+
+        if (auto stream = file.createOutputStream())
+            writer.reset (juce::WavAudioFormat().createWriterFor (stream.release(), sampleRate,
+                                                                  static_cast<unsigned> (audio.getNumChannels()), 32, {}, 0));
+
+        return writer != nullptr && writer->writeFromAudioSampleBuffer (audio, 0, audio.getNumSamples());
+    }
+}
+
+//==============================================================================
+int replayFlightRecording (const juce::File& recordingFile, const juce::File& outputFile, double toleranceDb)
+{
+    Recording recording;
+    juce::String error;
+
+    if (! Recording::load (recordingFile, recording, error) || recording.blocks.empty())
+    {
+        std::printf ("%s\n", error.isEmpty() ? "The recording is empty" : error.toRawUTF8());
+        return 1;
+    }
+
+    printSummary (recording);
+
+    juce::AudioBuffer<float> first, second;
+    if (! render (recording, first, error) || ! render (recording, second, error))
+    {
+        std::printf ("%s\n", error.toRawUTF8());
+        return 1;
+    }
+
+    const auto repeat = compare (first, second, 0.0f);
+    const bool deterministic = repeat.firstMismatch < 0;
+
+    if (deterministic)
+        std::printf ("Replay: deterministic, two renders agree bit for bit\n");
+    else
+        std::printf ("Replay: NOT deterministic, renders differ from %.3f s\n", repeat.firstMismatch / recording.sampleRate);
+
+    const float tolerance = juce::Decibels::decibelsToGain (static_cast<float> (toleranceDb), -1000.0f);
+    const auto live = compare (first, recording.output, tolerance);
+
+    if (live.matchesFrom == 0)
+        std::printf ("Against the live output: within %.0f dB throughout\n", toleranceDb);
+    else if (live.matchesFrom < first.getNumSamples())
+        std::printf ("Against the live output: within %.0f dB from %.3f s (%.1f dB before, while the circuit caught up)\n",
+                     toleranceDb, live.matchesFrom / recording.sampleRate,
+                     static_cast<double> (juce::Decibels::gainToDecibels (live.worstBefore)));
+    else
+        std::printf ("Against the live output: never within %.0f dB (worst %.1f dB)\n",
+                     toleranceDb, static_cast<double> (juce::Decibels::gainToDecibels (live.worstBefore)));
+
+    if (! writeOutput (outputFile, first, recording.sampleRate))
+    {
+        std::printf ("Cannot write %s\n", outputFile.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    std::printf ("Wrote %s\n", outputFile.getFullPathName().toRawUTF8());
+    return deterministic ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+// Replays a flight recorder dump through the processor and writes the result
+// to outputFile; returns the process exit code
+int replayFlightRecording (const juce::File& recordingFile, const juce::File& outputFile, double toleranceDb);
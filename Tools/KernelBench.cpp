@@ -0,0 +1,440 @@
+//==============================================================================
+// HarmonsterKernelBench - timing and output equivalence of the memoryless kernels
+//
+// Runs the input overdrive, the output stage (gain and soft limiter) and the
+// Q1 saturation over a block of random samples three ways:
+//   reference - the original per-sample code with its if/else branches
+//   precise   - the branch-free kernels with PreciseMath
+//   fast      - the branch-free kernels with FastMath (vectorised)
+// and reports ns/sample for each. Precise must match the reference bit for
+// bit (builds that contract to FMA may differ in the last bit); fast must
+// stay within --tolerance. Then runs the two linear runs of the circuit that
+// LinearCascade fuses (WOOL high-pass, boost and C2 before Q2; C6, classic EQ
+// and anti-aliasing after it) stage by stage as originally written and as the
+// compiled cascades, which must agree to rounding. Exits with 1 if anything
+// fails, so it doubles as the equivalence test. Finally times the whole
+// circuit with the math this build uses, and the dual circuit mode against
+// two separate circuits, whose outputs it must reproduce.
+//
+// Usage:
+//   HarmonsterKernelBench [--samples=1048576] [--tolerance=1e-6]
+//==============================================================================
+
+#include <juce_core/juce_core.h>
+#include "WoolyMammothDSP.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace
+{
+    //==========================================================================
+    // The stages as they were written before the kernels, for comparison
+    struct Reference
+    {
+        static double inputOverdrive(double input)
+        {
+            double boosted = input * 3.5;
+            double clipped;
+            if (boosted > 0.0) {
+                clipped = 0.9 * std::tanh(boosted * 1.5);
+            } else {
+                clipped = 0.8 * std::tanh(boosted * 1.8);
+            }
+            double squared = clipped * clipped;
+            clipped += squared * 0.15;
+            return std::tanh(clipped * 1.2) * 0.85;
+        }
+
+        static double softLimit(double input)
+        {
+            double compressed = input / (1.0 + std::abs(input) * 0.5);
+            double limited;
+            if (compressed > 0.0) {
+                limited = 0.9 * std::tanh(compressed * 1.8);
+            } else {
+                limited = 0.85 * std::tanh(compressed * 2.0);
+            }
+            limited += limited * limited * 0.04;
+            return limited;
+        }
+
+        static double q1Saturation(double ic_linear, double supply_factor)
+        {
+            double saturation_level = 0.9 * supply_factor;
+            double compression_factor = 0.6 + (1.0 - supply_factor) * 0.2;
+            double ic_compressed;
+            if (std::abs(ic_linear) > saturation_level * 0.3) {
+                double stage1 = saturation_level * std::tanh(ic_linear / (saturation_level * compression_factor));
+                ic_compressed = stage1 / (1.0 + std::abs(stage1) * 0.5);
+            } else {
+                ic_compressed = ic_linear;
+            }
+            double asymmetry_factor = 1.2 + (1.0 - supply_factor) * 0.3;
+            if (ic_compressed > 0.0) {
+                ic_compressed *= (0.9 + (1.0 - supply_factor) * 0.2);
+            } else {
+                ic_compressed *= (1.2 * asymmetry_factor);
+                ic_compressed = std::max(ic_compressed, -0.8 * supply_factor);
+            }
+            double harmonic_strength = 0.08 * supply_factor;
+            double harmonic_content = ic_compressed * ic_compressed * harmonic_strength;
+            double third_harmonic = ic_compressed * ic_compressed * ic_compressed * harmonic_strength * 0.3;
+            ic_compressed += harmonic_content + third_harmonic;
+            if (std::abs(ic_compressed) > 0.6 * supply_factor) {
+                double vce_sat = 0.25 + (1.0 - supply_factor) * 0.2;
+                double sat_factor = 1.0 - (std::abs(ic_compressed) - 0.6 * supply_factor) * 3.0;
+                ic_compressed *= std::max(sat_factor, vce_sat);
+            }
+            return ic_compressed;
+        }
+
+        // WOOL high-pass, inter-stage boost and C2, one stage at a time
+        struct InterStage
+        {
+            double wool_cutoff, sampleRate, c2;
+            double wool_z1 = 0.0, c2_voltage = 0.0;
+
+            double process(double input)
+            {
+                double alpha = 1.0 / (1.0 + (2.0 * M_PI * wool_cutoff / sampleRate));
+                wool_z1 = wool_z1 * alpha + input * (1.0 - alpha);
+                double boosted = (input - wool_z1) * 1.3;
+                c2_voltage = c2_voltage * c2 + boosted * (1.0 - c2);
+                return boosted - c2_voltage;
+            }
+        };
+
+        // C6, the classic EQ blend and the direct form I anti-aliasing biquad
+        struct Output
+        {
+            double c6, eq, eq_alpha;
+            double b0, b1, b2, a1, a2;
+            double c6_voltage = 0.0, eq_z1 = 0.0, eq_z2 = 0.0;
+            double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+
+            double process(double input)
+            {
+                c6_voltage = c6_voltage * c6 + input * (1.0 - c6);
+                double coupled = input - c6_voltage;
+
+                eq_z1 = eq_z1 * eq_alpha + coupled * (1.0 - eq_alpha);
+                eq_z2 = eq_z2 * eq_alpha + eq_z1 * (1.0 - eq_alpha);
+                double shaped = eq_z2 * (1.0 - eq) + (coupled - eq_z1) * eq * 0.7;
+
+                double result = b0 * shaped + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+                x2 = x1;
+                x1 = shaped;
+                y2 = y1;
+                y1 = result;
+                return result;
+            }
+        };
+    };
+
+    //==========================================================================
+    struct Comparison
+    {
+        double nanoseconds[3] {};
+        juce::int64 preciseMismatches = 0;
+        double fastError = 0.0;
+    };
+
+    template <typename Function>
+    double nanosecondsPerSample (int numSamples, Function&& function)
+    {
+        // Best of five, so a context switch does not count
+        double best = 1.0e30;
+        for (int run = 0; run < 5; ++run)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            function();
+            best = juce::jmin (best, juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start));
+        }
+        return best * 1.0e9 / numSamples;
+    }
+
+    void compare (const std::vector<double>& reference, const std::vector<double>& precise,
+                  const std::vector<double>& fast, Comparison& result)
+    {
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            if (std::memcmp (&reference[i], &precise[i], sizeof (double)) != 0)
+                ++result.preciseMismatches;
+
+            result.fastError = juce::jmax (result.fastError, std::abs (fast[i] - reference[i]));
+        }
+    }
+
+    void print (const char* name, const Comparison& result)
+    {
+        std::printf ("%-18s %9.2f %9.2f %9.2f %12lld %12.2e\n", name,
+                     result.nanoseconds[0], result.nanoseconds[1], result.nanoseconds[2],
+                     static_cast<long long> (result.preciseMismatches), result.fastError);
+    }
+
+    //==========================================================================
+    // Stage-by-stage reference against the compiled cascade, per sample as the
+    // circuit runs the inter-stage run and block-wise as it runs the output run
+    struct SegmentComparison
+    {
+        double nanoseconds[3] {};
+        int numSections = 0;
+        double error = 0.0;
+    };
+
+    template <std::size_t MaxSections, typename ReferenceStages>
+    SegmentComparison compareSegment (const LinearCascade<MaxSections>& cascade, const ReferenceStages& stages,
+                                      const std::vector<double>& input)
+    {
+        const int numSamples = static_cast<int> (input.size());
+        std::vector<double> reference (input.size()), perSample (input.size()), block (input.size());
+        SegmentComparison result;
+        result.numSections = cascade.getNumSections();
+
+        // Each timed run starts from rest, so every run computes the same output
+        result.nanoseconds[0] = nanosecondsPerSample (numSamples, [&]
+        {
+            auto running = stages;
+            for (size_t i = 0; i < input.size(); ++i)
+                reference[i] = running.process (input[i]);
+        });
+        result.nanoseconds[1] = nanosecondsPerSample (numSamples, [&]
+        {
+            typename LinearCascade<MaxSections>::State state;
+            for (size_t i = 0; i < input.size(); ++i)
+                perSample[i] = cascade.processSample (input[i], state);
+        });
+        result.nanoseconds[2] = nanosecondsPerSample (numSamples, [&]
+        {
+            typename LinearCascade<MaxSections>::State state;
+            for (int start = 0; start < numSamples; start += 64)
+                cascade.process (input.data() + start, block.data() + start, juce::jmin (64, numSamples - start), state);
+        });
+
+        for (size_t i = 0; i < input.size(); ++i)
+            result.error = juce::jmax (result.error, std::abs (perSample[i] - reference[i]), std::abs (block[i] - reference[i]));
+
+        return result;
+    }
+
+    void print (const char* name, const SegmentComparison& result)
+    {
+        std::printf ("%-18s %9.2f %9.2f %9.2f %12d %12.2e\n", name,
+                     result.nanoseconds[0], result.nanoseconds[1], result.nanoseconds[2],
+                     result.numSections, result.error);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ArgumentList args (argc, argv);
+    const int numSamples = args.containsOption ("--samples")
+                               ? juce::jmax (64, args.getValueForOption ("--samples").getIntValue())
+                               : 1 << 20;
+    const double tolerance = args.containsOption ("--tolerance")
+                                 ? args.getValueForOption ("--tolerance").getDoubleValue()
+                                 : 1.0e-6;
+
+    using Precise = MemorylessKernels<PreciseMath>;
+    using Fast = MemorylessKernels<FastMath>;
+
+    // Inputs that spend time on both sides of every threshold
+    std::mt19937 rng (7);
+    std::uniform_real_distribution<float> audio (-1.5f, 1.5f);
+    std::uniform_real_distribution<double> current (-3.0, 3.0), supply (6.0 / 9.0, 1.0);
+
+    std::vector<float> input (static_cast<size_t> (numSamples));
+    std::vector<double> wide (input.size()), supplyFactor (input.size());
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        input[i] = audio (rng);
+        wide[i] = current (rng);
+        supplyFactor[i] = supply (rng);
+    }
+
+    std::vector<double> reference (input.size()), precise (input.size()), fast (input.size());
+    std::vector<float> referenceOut (input.size()), preciseOut (input.size()), fastOut (input.size());
+    const double outputGain = 2.3;
+
+    std::printf ("%d samples, ns/sample\n", numSamples);
+    std::printf ("%-18s %9s %9s %9s %12s %12s\n", "kernel", "reference", "precise", "fast", "precise diff", "fast error");
+
+    // Input overdrive, block
+    Comparison overdrive;
+    overdrive.nanoseconds[0] = nanosecondsPerSample (numSamples, [&]
+    {
+        for (size_t i = 0; i < input.size(); ++i)
+            reference[i] = Reference::inputOverdrive (input[i]);
+    });
+    overdrive.nanoseconds[1] = nanosecondsPerSample (numSamples, [&] { Precise::inputOverdrive (input.data(), precise.data(), numSamples); });
+    overdrive.nanoseconds[2] = nanosecondsPerSample (numSamples, [&] { Fast::inputOverdrive (input.data(), fast.data(), numSamples); });
+    compare (reference, precise, fast, overdrive);
+    print ("input overdrive", overdrive);
+
+    // Output gain, supply gain and soft limiter, block
+    Comparison output;
+    output.nanoseconds[0] = nanosecondsPerSample (numSamples, [&]
+    {
+        for (size_t i = 0; i < input.size(); ++i)
+            referenceOut[i] = static_cast<float> (Reference::softLimit (wide[i] * outputGain * supplyFactor[i]));
+    });
+    output.nanoseconds[1] = nanosecondsPerSample (numSamples, [&] { Precise::outputStage (wide.data(), supplyFactor.data(), outputGain, preciseOut.data(), numSamples); });
+    output.nanoseconds[2] = nanosecondsPerSample (numSamples, [&] { Fast::outputStage (wide.data(), supplyFactor.data(), outputGain, fastOut.data(), numSamples); });
+
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        reference[i] = referenceOut[i];
+        precise[i] = preciseOut[i];
+        fast[i] = fastOut[i];
+    }
+    compare (reference, precise, fast, output);
+    print ("output stage", output);
+
+    // Q1 saturation, per sample as the circuit calls it
+    Comparison q1;
+    q1.nanoseconds[0] = nanosecondsPerSample (numSamples, [&]
+    {
+        for (size_t i = 0; i < input.size(); ++i)
+            reference[i] = Reference::q1Saturation (wide[i], supplyFactor[i]);
+    });
+    q1.nanoseconds[1] = nanosecondsPerSample (numSamples, [&]
+    {
+        for (size_t i = 0; i < input.size(); ++i)
+            precise[i] = Precise::q1Saturation (wide[i], supplyFactor[i]);
+    });
+    q1.nanoseconds[2] = nanosecondsPerSample (numSamples, [&]
+    {
+        for (size_t i = 0; i < input.size(); ++i)
+            fast[i] = Fast::q1Saturation (wide[i], supplyFactor[i]);
+    });
+    compare (reference, precise, fast, q1);
+    print ("Q1 saturation", q1);
+
+    // The linear runs around Q2, at the circuit's default settings
+    const double sampleRate = 48000.0, wool = 0.5, eq = 0.5, pole = 0.995;
+    const double woolCutoff = 50.0 + (wool * 300.0);
+    const double woolAlpha = 1.0 / (1.0 + (2.0 * M_PI * woolCutoff / sampleRate));
+    const double eqCutoff = 800.0 + (eq * 2200.0);
+    const auto antiAliasing = WoolyMammothDSP::antiAliasingStage (sampleRate);
+
+    const auto interStage = LinearCascade<1>::compile ({ LinearStage::capacitorHighPass (woolAlpha),
+                                                         LinearStage::gain (1.3),
+                                                         LinearStage::capacitorHighPass (pole) });
+    const auto outputRun = LinearCascade<3>::compile ({ LinearStage::capacitorHighPass (pole),
+                                                        WoolyMammothDSP::classicEqStage (eq, sampleRate),
+                                                        antiAliasing });
+
+    const Reference::InterStage interStageStages { woolCutoff, sampleRate, pole };
+    const Reference::Output outputStages { pole, eq, 1.0 / (1.0 + (2.0 * M_PI * eqCutoff / sampleRate)),
+                                           antiAliasing.b0, antiAliasing.b1, antiAliasing.b2, antiAliasing.a1, antiAliasing.a2 };
+
+    std::printf ("\n%-18s %9s %9s %9s %12s %12s\n", "linear run", "stages", "fused", "block", "sections", "error");
+    const auto interStageResult = compareSegment (interStage, interStageStages, wide);
+    print ("WOOL, boost, C2", interStageResult);
+    const auto outputResult = compareSegment (outputRun, outputStages, wide);
+    print ("C6, EQ, AA", outputResult);
+
+    // The whole circuit, all features, as built
+    WoolyMammothDSP dsp;
+    dsp.setSampleRate (48000.0);
+    auto block = input;
+    const double circuit = nanosecondsPerSample (numSamples, [&]
+    {
+        for (int start = 0; start < numSamples; start += 256)
+            dsp.processBlock (block.data() + start, juce::jmin (256, numSamples - start));
+    });
+    std::printf ("\nWhole circuit (%s math): %.2f ns/sample\n", HARMONSTER_PRECISE_MATH != 0 ? "precise" : "fast", circuit);
+
+    // Dual circuit mode against two separate circuits. Its Q2 lanes always
+    // use economy math, so with the blend all on one circuit it must match
+    // that circuit with economy math exactly; blended half and half it must
+    // match the blend of the two up to float rounding. The blend ramps in
+    // over the first block.
+    auto makeCircuit = [] (const WoolyMammothPresets::Preset& settings, unsigned features)
+    {
+        WoolyMammothDSP circuit;
+        circuit.setSampleRate (48000.0);
+        circuit.setFeatures (features);
+        circuit.setWool (settings.wool);
+        circuit.setPinch (settings.pinch);
+        circuit.setEQ (settings.eq);
+        circuit.setOutput (settings.output);
+        return circuit;
+    };
+
+    // Every timed run processes the input afresh, carrying on from the state
+    // the last one left, the same for the dual and the separate circuits
+    auto runBlocks = [&input, numSamples] (std::vector<float>& samples, auto&& processBlock)
+    {
+        samples.resize (input.size());
+        return nanosecondsPerSample (numSamples, [&]
+        {
+            for (int start = 0; start < numSamples; start += 256)
+            {
+                const int count = juce::jmin (256, numSamples - start);
+                std::copy_n (input.data() + start, count, samples.data() + start);
+                processBlock (samples.data() + start, count);
+            }
+        });
+    };
+
+    const auto& settingsA = WoolyMammothPresets::defaultPreset;
+    const auto& settingsB = WoolyMammothPresets::factoryPresets[4];  // Smooth Fuzz
+    const unsigned economyFeatures = WoolyMammothDSP::allFeatures | WoolyMammothDSP::economyMath;
+
+    std::vector<float> dualOut[3], separateOut[2];
+    double dualTime = 0.0;
+
+    for (int blend = 0; blend < 3; ++blend)
+    {
+        auto dual = makeCircuit (settingsA, WoolyMammothDSP::allFeatures);
+        dual.setSecondCircuit (true, settingsB.wool, settingsB.pinch, settingsB.eq, settingsB.output);
+        dual.setBlend (1.0 - 0.5 * blend, 0.5 * blend);
+
+        const double time = runBlocks (dualOut[blend], [&] (float* samples, int count) { dual.processBlock (samples, count); });
+        dualTime = blend == 1 ? time : dualTime;
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        auto circuit = makeCircuit (i == 0 ? settingsA : settingsB, economyFeatures);
+        runBlocks (separateOut[i], [&] (float* samples, int count) { circuit.processBlock (samples, count); });
+    }
+
+    auto circuitA = makeCircuit (settingsA, WoolyMammothDSP::allFeatures);
+    auto circuitB = makeCircuit (settingsB, WoolyMammothDSP::allFeatures);
+    std::vector<float> twoOut, secondInput (256);
+    const double twoTime = runBlocks (twoOut, [&] (float* samples, int count)
+    {
+        std::copy_n (samples, count, secondInput.data());
+        circuitA.processBlock (samples, count);
+        circuitB.processBlock (secondInput.data(), count);
+    });
+
+    int dualMismatches = 0;
+    double blendError = 0.0;
+    for (size_t i = 256; i < input.size(); ++i)
+    {
+        dualMismatches += (dualOut[0][i] != separateOut[0][i] ? 1 : 0) + (dualOut[2][i] != separateOut[1][i] ? 1 : 0);
+        blendError = juce::jmax (blendError, static_cast<double> (std::abs (dualOut[1][i] - 0.5f * (separateOut[0][i] + separateOut[1][i]))));
+    }
+
+    std::printf ("Dual circuit: %.2f ns/sample, two circuits %.2f ns/sample; %d samples differ from a single circuit, blend error %.2e\n",
+                 dualTime, twoTime, dualMismatches, blendError);
+
+    bool passed = true;
+    for (auto* result : { &overdrive, &output, &q1 })
+        passed = passed && result->preciseMismatches == 0 && result->fastError <= tolerance;
+
+    // Fusing only reorders the arithmetic, so anything beyond rounding is a bug
+    for (auto* result : { &interStageResult, &outputResult })
+        passed = passed && result->error <= 1.0e-9;
+
+    passed = passed && dualMismatches == 0 && blendError <= 1.0e-6;
+
+    std::printf ("Equivalence: %s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,394 @@
+//==============================================================================
+// HarmonsterLoadBench - headless host measuring plugin-level CPU load
+//
+// Instantiates WoolyMammothAudioProcessor directly and drives N instances
+// through processBlock() for every combination of buffer size and sample
+// rate, optionally with random parameter automation between blocks. The
+// timed region is exactly what a host pays for: processBlock() including
+// parameter atomics, per-block DSP setters and ScopedNoDenormals.
+//
+// Before that, a startup run creates a batch of instances the way a host
+// scanning or loading a big session does and times each step per instance:
+// construction, prepareToPlay() and the first processBlock().
+//
+// After it, an automation sweep run sweeps PINCH like a tremolo, one
+// automation point per block, and times one instance with the knobs held,
+// with the sweep stepped once per block and with it followed in sub-blocks,
+// reporting the cost of the split and how far each is from the same sweep
+// rendered in one-sample blocks.
+//
+// Usage:
+//   HarmonsterLoadBench [--instances=8] [--seconds=5]
+//                       [--rates=44100,48000,96000]
+//                       [--buffers=16,32,64,128,256,512,1024,2048]
+//                       [--no-automation] [--startup-instances=100]
+//                       [--sweep-seconds=2]
+//==============================================================================
+
+#include "PluginProcessor.h"
+
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    struct BenchOptions
+    {
+        int numInstances = 8;
+        double secondsPerRun = 5.0;
+        juce::Array<double> sampleRates { 44100.0, 48000.0, 96000.0 };
+        juce::Array<int> bufferSizes { 16, 32, 64, 128, 256, 512, 1024, 2048 };
+        bool automation = true;
+        int numStartupInstances = 100;
+        double sweepSeconds = 2.0;
+    };
+
+    struct StartupStep
+    {
+        double totalSeconds = 0.0;
+        double worstSeconds = 0.0;
+
+        void add (double seconds)
+        {
+            totalSeconds += seconds;
+            worstSeconds = juce::jmax (worstSeconds, seconds);
+        }
+    };
+
+    struct RunResult
+    {
+        double realtimeCpuPercent = 0.0;
+        double meanBlockMicros = 0.0;
+        double worstBlockMicros = 0.0;
+        double deadlineMicros = 0.0;
+        float averageOversampling = 1.0f;
+        int qualityTier = 0;  // CPU governor tier the first instance ended on
+    };
+
+    //==========================================================================
+    // Plucked low-E style test signal: decaying harmonics re-struck every half second
+    class GuitarSignal
+    {
+    public:
+        explicit GuitarSignal (double rate) : sampleRate (rate) {}
+
+        void fill (juce::AudioBuffer<float>& buffer)
+        {
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                if (samplesUntilPluck-- <= 0)
+                {
+                    envelope = 0.8;
+                    samplesUntilPluck = static_cast<int> (sampleRate * 0.5);
+                }
+
+                double value = 0.0;
+                for (int harmonic = 1; harmonic <= 6; ++harmonic)
+                    value += std::sin (phase * harmonic) / harmonic;
+
+                phase += juce::MathConstants<double>::twoPi * 82.41 / sampleRate;
+                if (phase > juce::MathConstants<double>::twoPi)
+                    phase -= juce::MathConstants<double>::twoPi;
+
+                envelope *= decay;
+
+                auto sample = static_cast<float> (value * envelope * 0.5 + noise (rng) * 0.001);
+                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                    buffer.setSample (channel, i, sample);
+            }
+        }
+
+    private:
+        double sampleRate;
+        double phase = 0.0;
+        double envelope = 0.0;
+        double decay = std::pow (0.001, 1.0 / (sampleRate * 2.0));
+        int samplesUntilPluck = 0;
+        std::mt19937 rng { 1234 };
+        std::normal_distribution<float> noise { 0.0f, 1.0f };
+    };
+
+    //==========================================================================
+    BenchOptions parseOptions (const juce::ArgumentList& args)
+    {
+        BenchOptions options;
+
+        if (args.containsOption ("--instances"))
+            options.numInstances = juce::jmax (1, args.getValueForOption ("--instances").getIntValue());
+
+        if (args.containsOption ("--seconds"))
+            options.secondsPerRun = juce::jmax (0.1, args.getValueForOption ("--seconds").getDoubleValue());
+
+        if (args.containsOption ("--rates"))
+        {
+            options.sampleRates.clear();
+            for (auto& token : juce::StringArray::fromTokens (args.getValueForOption ("--rates"), ",", {}))
+                options.sampleRates.add (token.getDoubleValue());
+        }
+
+        if (args.containsOption ("--buffers"))
+        {
+            options.bufferSizes.clear();
+            for (auto& token : juce::StringArray::fromTokens (args.getValueForOption ("--buffers"), ",", {}))
+                options.bufferSizes.add (token.getIntValue());
+        }
+
+        options.automation = ! args.containsOption ("--no-automation");
+
+        if (args.containsOption ("--startup-instances"))
+            options.numStartupInstances = juce::jmax (0, args.getValueForOption ("--startup-instances").getIntValue());
+
+        if (args.containsOption ("--sweep-seconds"))
+            options.sweepSeconds = juce::jmax (0.0, args.getValueForOption ("--sweep-seconds").getDoubleValue());
+
+        return options;
+    }
+
+    void automateRandomParameter (juce::AudioProcessor& processor, std::mt19937& rng)
+    {
+        // Mimics a host writing an automation point before the block, as the
+        // VST3 wrapper does; bypass is left alone so every block is processed
+        auto& params = processor.getParameters();
+        auto* param = params[static_cast<int> (rng() % static_cast<unsigned> (params.size()))];
+
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (param))
+            if (ranged->getParameterID() == "bypass")
+                return;
+
+        param->setValueNotifyingHost (std::uniform_real_distribution<float> (0.0f, 1.0f) (rng));
+    }
+
+    // Times construction, prepareToPlay() and the first block of each new
+    // instance, with every earlier instance still alive as in a real session
+    void runStartup (const BenchOptions& options, double sampleRate, int blockSize)
+    {
+        std::vector<std::unique_ptr<WoolyMammothAudioProcessor>> instances;
+        StartupStep construction, preparation, firstBlock;
+
+        GuitarSignal signal (sampleRate);
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+
+        auto secondsSince = [] (juce::int64 start)
+        {
+            return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        };
+
+        for (int i = 0; i < options.numStartupInstances; ++i)
+        {
+            signal.fill (buffer);
+
+            auto start = juce::Time::getHighResolutionTicks();
+            auto processor = std::make_unique<WoolyMammothAudioProcessor>();
+            construction.add (secondsSince (start));
+
+            start = juce::Time::getHighResolutionTicks();
+            processor->setPlayConfigDetails (2, 2, sampleRate, blockSize);
+            processor->prepareToPlay (sampleRate, blockSize);
+            preparation.add (secondsSince (start));
+
+            start = juce::Time::getHighResolutionTicks();
+            processor->processBlock (buffer, midi);
+            firstBlock.add (secondsSince (start));
+
+            instances.push_back (std::move (processor));
+        }
+
+        auto print = [&options] (const char* name, const StartupStep& step)
+        {
+            std::printf ("  %-14s mean %9.1f us   worst %9.1f us\n", name,
+                         1.0e6 * step.totalSeconds / options.numStartupInstances, 1.0e6 * step.worstSeconds);
+        };
+
+        std::printf ("Startup: %d instance(s) at %.0f Hz, %d-sample blocks\n",
+                     options.numStartupInstances, sampleRate, blockSize);
+        print ("construct", construction);
+        print ("prepareToPlay", preparation);
+        print ("first block", firstBlock);
+        std::printf ("  %-14s %9.1f ms\n\n", "total",
+                     1.0e3 * (construction.totalSeconds + preparation.totalSeconds + firstBlock.totalSeconds));
+
+        for (auto& processor : instances)
+            processor->releaseResources();
+    }
+
+    // One instance with PINCH under a 4 Hz sine, its value at the end of each
+    // block written before the block as the VST3 wrapper does. step is the
+    // automation sub-block length (the block size steps once per block, 0 is
+    // the processor's default); returns ns per sample and the left output.
+    double runSweep (double sampleRate, int blockSize, int step, bool sweep, double seconds, std::vector<float>& output)
+    {
+        WoolyMammothAudioProcessor processor;
+        processor.setAutomationStep (step);
+        processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+        processor.prepareToPlay (sampleRate, blockSize);
+        processor.pinQualityTier (0);
+
+        auto* pinch = processor.parameters.getParameter ("pinch");
+        GuitarSignal signal (sampleRate);
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+
+        const auto numBlocks = juce::jmax (1, static_cast<int> (seconds * sampleRate / blockSize));
+        output.resize (static_cast<size_t> (numBlocks * blockSize));
+        double totalSeconds = 0.0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            signal.fill (buffer);
+
+            if (sweep)
+            {
+                const double blockEnd = (block + 1) * blockSize / sampleRate;
+                pinch->setValueNotifyingHost (static_cast<float> (0.5 + 0.4 * std::sin (juce::MathConstants<double>::twoPi * 4.0 * blockEnd)));
+            }
+
+            auto start = juce::Time::getHighResolutionTicks();
+            processor.processBlock (buffer, midi);
+            totalSeconds += juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+            std::copy_n (buffer.getReadPointer (0), blockSize, output.begin() + block * blockSize);
+        }
+
+        processor.releaseResources();
+        return 1.0e9 * totalSeconds / (numBlocks * blockSize);
+    }
+
+    // Error of output against reference, in dB below the reference
+    double errorDb (const std::vector<float>& output, const std::vector<float>& reference)
+    {
+        double error = 0.0, energy = 0.0;
+        for (size_t i = 0; i < juce::jmin (output.size(), reference.size()); ++i)
+        {
+            error += juce::square (static_cast<double> (output[i]) - reference[i]);
+            energy += juce::square (static_cast<double> (reference[i]));
+        }
+
+        return 10.0 * std::log10 (juce::jmax (error, 1.0e-30) / juce::jmax (energy, 1.0e-30));
+    }
+
+    void runAutomationSweep (const BenchOptions& options, double sampleRate)
+    {
+        // One-sample blocks follow the sine as closely as the host's points allow
+        std::vector<float> reference, output;
+        runSweep (sampleRate, 1, 1, true, options.sweepSeconds, reference);
+
+        std::printf ("Automation sweep at %.0f Hz: PINCH under a 4 Hz sine, one point per block\n", sampleRate);
+        std::printf ("%7s %12s %12s %12s %10s %13s %13s\n",
+                     "buffer", "held ns", "stepped ns", "split ns", "split %", "stepped dB", "split dB");
+
+        for (auto blockSize : options.bufferSizes)
+        {
+            const double held = runSweep (sampleRate, blockSize, 0, false, options.sweepSeconds, output);
+            const double stepped = runSweep (sampleRate, blockSize, blockSize, true, options.sweepSeconds, output);
+            const double steppedError = errorDb (output, reference);
+            const double split = runSweep (sampleRate, blockSize, 0, true, options.sweepSeconds, output);
+            const double splitError = errorDb (output, reference);
+
+            std::printf ("%7d %12.1f %12.1f %12.1f %+10.1f %13.1f %13.1f\n",
+                         blockSize, held, stepped, split, 100.0 * (split - stepped) / stepped, steppedError, splitError);
+        }
+
+        std::printf ("\n");
+    }
+
+    RunResult runConfiguration (const BenchOptions& options, double sampleRate, int blockSize)
+    {
+        std::vector<std::unique_ptr<WoolyMammothAudioProcessor>> instances;
+        std::vector<juce::AudioBuffer<float>> buffers;
+
+        for (int i = 0; i < options.numInstances; ++i)
+        {
+            auto processor = std::make_unique<WoolyMammothAudioProcessor>();
+            processor->setPlayConfigDetails (2, 2, sampleRate, blockSize);
+            processor->prepareToPlay (sampleRate, blockSize);
+            instances.push_back (std::move (processor));
+            buffers.emplace_back (2, blockSize);
+        }
+
+        GuitarSignal signal (sampleRate);
+        juce::AudioBuffer<float> input (2, blockSize);
+        juce::MidiBuffer midi;
+        std::mt19937 rng (42);
+
+        const auto numBlocks = juce::jmax (1, static_cast<int> (options.secondsPerRun * sampleRate / blockSize));
+        double totalSeconds = 0.0;
+        double worstSeconds = 0.0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            signal.fill (input);
+
+            for (size_t i = 0; i < instances.size(); ++i)
+            {
+                buffers[i].makeCopyOf (input, true);
+
+                if (options.automation && (rng() & 3u) == 0)
+                    automateRandomParameter (*instances[i], rng);
+            }
+
+            // One block of the whole rig, all instances on this thread
+            auto start = juce::Time::getHighResolutionTicks();
+
+            for (size_t i = 0; i < instances.size(); ++i)
+                instances[i]->processBlock (buffers[i], midi);
+
+            auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+            totalSeconds += elapsed;
+            worstSeconds = juce::jmax (worstSeconds, elapsed);
+        }
+
+        RunResult result;
+        const auto stats = instances.front()->getProcessingStats();
+        result.averageOversampling = stats.averageOversampling;
+        result.qualityTier = stats.qualityTier;
+
+        for (auto& processor : instances)
+            processor->releaseResources();
+
+        auto audioSeconds = numBlocks * blockSize / sampleRate;
+        result.realtimeCpuPercent = 100.0 * totalSeconds / audioSeconds;
+        result.meanBlockMicros = 1.0e6 * totalSeconds / numBlocks;
+        result.worstBlockMicros = 1.0e6 * worstSeconds;
+        result.deadlineMicros = 1.0e6 * blockSize / sampleRate;
+        return result;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    auto options = parseOptions (juce::ArgumentList (argc, argv));
+
+    std::printf ("Harmonster load bench: %d instance(s), %.1f s per run, automation %s\n\n",
+                 options.numInstances, options.secondsPerRun, options.automation ? "on" : "off");
+
+    if (options.numStartupInstances > 0)
+        for (auto sampleRate : options.sampleRates)
+            runStartup (options, sampleRate, 512);
+
+    if (options.sweepSeconds > 0.0)
+        for (auto sampleRate : options.sampleRates)
+            runAutomationSweep (options, sampleRate);
+
+    std::printf ("%8s %7s %9s %11s %11s %11s %9s %7s %5s\n",
+                 "rate", "buffer", "cpu %", "mean us", "worst us", "deadline us", "worst %", "os avg", "tier");
+
+    for (auto sampleRate : options.sampleRates)
+    {
+        for (auto blockSize : options.bufferSizes)
+        {
+            auto result = runConfiguration (options, sampleRate, blockSize);
+
+            std::printf ("%8.0f %7d %9.2f %11.2f %11.2f %11.2f %9.1f %7.2f %5d\n",
+                         sampleRate, blockSize, result.realtimeCpuPercent,
+                         result.meanBlockMicros, result.worstBlockMicros, result.deadlineMicros,
+                         100.0 * result.worstBlockMicros / result.deadlineMicros,
+                         static_cast<double> (result.averageOversampling), result.qualityTier);
+        }
+    }
+
+    return 0;
+}
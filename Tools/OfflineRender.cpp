@@ -0,0 +1,343 @@
+//==============================================================================
+// HarmonsterOfflineRender - chunk-parallel offline reamp of a long recording
+//
+// Splits the input file into chunks and renders them on all cores at once.
+// Each chunk (apart from the first) warms its circuit with a pre-roll of the
+// audio just before it, so it starts close to the state a straight-through
+// render would have reached there.
+//
+// Every splice is then verified: the circuit state at the end of the previous
+// chunk is restored into a fresh circuit, which re-renders the head of the
+// next chunk beside a second circuit restored to the state that chunk's
+// render started from after its pre-roll. Once the two circuit states have
+// agreed to within the tolerance for 10 ms, the rest of the parallel render
+// is the exact continuation; until then its samples are replaced by the
+// exact ones, so the output matches a single-threaded render within the
+// tolerance. A chunk whose state never meets the exact one is re-rendered
+// whole.
+//
+// Renders the circuit at the host rate (the plugin's 1x setting), without
+// the cabinet stage.
+//
+// --replay instead plays a flight recorder dump back through the whole
+// processor, block by block (see FlightReplay.cpp).
+//
+// Usage:
+//   HarmonsterOfflineRender <input> <output.wav> [--preset=0]
+//                           [--wool=] [--pinch=] [--eq=] [--output=]
+//                           [--no-sag] [--no-texture] [--passive-eq] [--threads=N]
+//                           [--chunk-seconds=10] [--preroll-seconds=0.5]
+//                           [--tolerance-db=-120]
+//   HarmonsterOfflineRender --replay=<recording.xml> <output.wav> [--tolerance-db=-120]
+//==============================================================================
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "WoolyMammothDSP.h"
+#include "FlightReplay.h"
+
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    struct RenderOptions
+    {
+        juce::File inputFile, outputFile;
+        double wool = 0.5, pinch = 0.5, eq = 0.5, output = 0.5;
+        unsigned features = WoolyMammothDSP::allFeatures & ~static_cast<unsigned> (WoolyMammothDSP::passiveEq);
+        int numThreads = 1;
+        double chunkSeconds = 10.0;
+        double preRollSeconds = 0.5;
+        double toleranceDb = -120.0;
+    };
+
+    struct SpliceReport
+    {
+        int numSplices = 0;
+        juce::int64 repairedSamples = 0;
+        float worstDeviation = 0.0f;    // parallel output vs. exact continuation, before repair
+    };
+
+    //==========================================================================
+    bool parseOptions (const juce::ArgumentList& args, RenderOptions& options)
+    {
+        if (args.size() < 2)
+            return false;
+
+        const auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+        options.inputFile = workingDirectory.getChildFile (args[0].text);
+        options.outputFile = workingDirectory.getChildFile (args[1].text);
+
+        const int presetIndex = args.containsOption ("--preset") ? args.getValueForOption ("--preset").getIntValue() : 0;
+        const auto& preset = WoolyMammothPresets::factoryPresets[static_cast<size_t> (juce::jlimit (0, WoolyMammothPresets::numFactoryPresets - 1, presetIndex))];
+
+        options.wool = preset.wool;
+        options.pinch = preset.pinch;
+        options.eq = preset.eq;
+        options.output = preset.output;
+
+        auto readKnob = [&args] (const char* option, double& value)
+        {
+            if (args.containsOption (option))
+                value = juce::jlimit (0.0, 1.0, args.getValueForOption (option).getDoubleValue());
+        };
+
+        readKnob ("--wool", options.wool);
+        readKnob ("--pinch", options.pinch);
+        readKnob ("--eq", options.eq);
+        readKnob ("--output", options.output);
+
+        if (args.containsOption ("--no-sag"))
+            options.features &= ~static_cast<unsigned> (WoolyMammothDSP::supplySag);
+        if (args.containsOption ("--no-texture"))
+            options.features &= ~WoolyMammothDSP::textureFeatures;
+        if (args.containsOption ("--passive-eq"))
+            options.features |= WoolyMammothDSP::passiveEq;
+
+        options.numThreads = juce::SystemStats::getNumCpus();
+        if (args.containsOption ("--threads"))
+            options.numThreads = juce::jmax (1, args.getValueForOption ("--threads").getIntValue());
+
+        if (args.containsOption ("--chunk-seconds"))
+            options.chunkSeconds = juce::jmax (0.1, args.getValueForOption ("--chunk-seconds").getDoubleValue());
+
+        if (args.containsOption ("--preroll-seconds"))
+            options.preRollSeconds = juce::jmax (0.0, args.getValueForOption ("--preroll-seconds").getDoubleValue());
+
+        if (args.containsOption ("--tolerance-db"))
+            options.toleranceDb = args.getValueForOption ("--tolerance-db").getDoubleValue();
+
+        return true;
+    }
+
+    //==========================================================================
+    // Renders one chunk of one wave. source holds the wave's input preceded by
+    // preRoll samples of history; the chunk is rendered in place into target.
+    // The states the chunk starts from after the pre-roll and ends in are kept.
+    void renderChunk (const WoolyMammothDSP& prototype, const juce::AudioBuffer<float>& source,
+                      juce::AudioBuffer<float>& target, int sourceOffset, int targetOffset,
+                      int numSamples, int preRollSamples, std::vector<WoolyMammothDSP::State>& startStates,
+                      std::vector<WoolyMammothDSP::State>& endStates)
+    {
+        std::vector<float> preRoll (static_cast<size_t> (preRollSamples));
+
+        for (int channel = 0; channel < source.getNumChannels(); ++channel)
+        {
+            auto dsp = prototype;
+
+            if (preRollSamples > 0)
+            {
+                // Warm up on the audio leading into the chunk and discard the result
+                auto* history = source.getReadPointer (channel, sourceOffset - preRollSamples);
+                std::copy (history, history + preRollSamples, preRoll.begin());
+                dsp.processBlock (preRoll.data(), preRollSamples);
+            }
+
+            startStates[static_cast<size_t> (channel)] = dsp.snapshot();
+
+            auto* samples = target.getWritePointer (channel, targetOffset);
+            std::copy_n (source.getReadPointer (channel, sourceOffset), numSamples, samples);
+            dsp.processBlock (samples, numSamples);
+
+            endStates[static_cast<size_t> (channel)] = dsp.snapshot();
+        }
+    }
+
+    // Re-renders the head of a chunk from the exact state the previous chunk
+    // ended in, beside the chunk's own circuit from the state its parallel
+    // render started in, until the two states agree for settleSamples
+    void verifySplice (const WoolyMammothDSP& prototype, const juce::AudioBuffer<float>& source,
+                       juce::AudioBuffer<float>& target, int sourceOffset, int targetOffset, int numSamples,
+                       float tolerance, int settleSamples, const std::vector<WoolyMammothDSP::State>& exactStates,
+                       const std::vector<WoolyMammothDSP::State>& chunkStartStates,
+                       std::vector<WoolyMammothDSP::State>& endStates, SpliceReport& report)
+    {
+        ++report.numSplices;
+
+        for (int channel = 0; channel < source.getNumChannels(); ++channel)
+        {
+            auto exact = prototype;
+            exact.restore (exactStates[static_cast<size_t> (channel)]);
+
+            auto parallel = prototype;
+            parallel.restore (chunkStartStates[static_cast<size_t> (channel)]);
+
+            auto* input = source.getReadPointer (channel, sourceOffset);
+            auto* rendered = target.getWritePointer (channel, targetOffset);
+            int agreeing = 0;
+            int i = 0;
+
+            for (; i < numSamples && agreeing < settleSamples; ++i)
+            {
+                float sample = input[i];
+                exact.processBlock (&sample, 1);
+
+                float parallelSample = input[i];
+                parallel.processBlock (&parallelSample, 1);
+
+                const float deviation = std::abs (sample - rendered[i]);
+                report.worstDeviation = juce::jmax (report.worstDeviation, deviation);
+
+                // The output can agree while the circuits still differ, e.g.
+                // in the slow supply sag or during a gated silence
+                const bool statesAgree = exact.snapshot().distanceTo (parallel.snapshot()) <= tolerance;
+                agreeing = statesAgree ? agreeing + 1 : 0;
+
+                if (sample != rendered[i])
+                {
+                    rendered[i] = sample;
+                    ++report.repairedSamples;
+                }
+            }
+
+            // Never converged: the whole chunk was re-rendered, and the exact
+            // circuit carries on into the next splice
+            if (agreeing < settleSamples)
+                endStates[static_cast<size_t> (channel)] = exact.snapshot();
+        }
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption ("--replay"))
+    {
+        const auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+        juce::File outputFile;
+
+        for (const auto& argument : args.arguments)
+            if (! argument.isOption())
+                outputFile = workingDirectory.getChildFile (argument.text);
+
+        if (outputFile != juce::File())
+            return replayFlightRecording (workingDirectory.getChildFile (args.getValueForOption ("--replay")), outputFile,
+                                          args.containsOption ("--tolerance-db") ? args.getValueForOption ("--tolerance-db").getDoubleValue() : -120.0);
+    }
+
+    RenderOptions options;
+    if (args.containsOption ("--replay") || ! parseOptions (args, options))
+    {
+        std::printf ("usage: HarmonsterOfflineRender <input> <output.wav> [--preset=N] [--wool=] [--pinch=] [--eq=] [--output=]\n"
+                     "                              [--no-sag] [--no-texture] [--passive-eq] [--threads=N] [--chunk-seconds=10]\n"
+                     "                              [--preroll-seconds=0.5] [--tolerance-db=-120]\n"
+                     "       HarmonsterOfflineRender --replay=<recording.xml> <output.wav> [--tolerance-db=-120]\n");
+        return 1;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (options.inputFile));
+    if (reader == nullptr)
+    {
+        std::printf ("Cannot read %s\n", options.inputFile.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    const double sampleRate = reader->sampleRate;
+    const int numChannels = static_cast<int> (reader->numChannels);
+    const juce::int64 totalSamples = reader->lengthInSamples;
+
+    options.outputFile.deleteFile();
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    if (auto stream = options.outputFile.createOutputStream())
+        writer.reset (juce::WavAudioFormat().createWriterFor (stream.release(), sampleRate, static_cast<unsigned> (numChannels), 24, {}, 0));
+
+    if (writer == nullptr)
+    {
+        std::printf ("Cannot write %s\n", options.outputFile.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    WoolyMammothDSP prototype;
+    prototype.setSampleRate (sampleRate);
+    prototype.setWool (options.wool);
+    prototype.setPinch (options.pinch);
+    prototype.setEQ (options.eq);
+    prototype.setOutput (options.output);
+    prototype.setFeatures (options.features);
+
+    const int chunkSamples = juce::jmax (1, static_cast<int> (options.chunkSeconds * sampleRate));
+    const int preRollSamples = static_cast<int> (options.preRollSeconds * sampleRate);
+    const int settleSamples = juce::jmax (1, static_cast<int> (sampleRate * 0.01));
+    const float tolerance = juce::Decibels::decibelsToGain (static_cast<float> (options.toleranceDb), -1000.0f);
+
+    std::printf ("Rendering %.1f s of %d-channel audio at %.0f Hz: %d thread(s), %.1f s chunks, %.2f s pre-roll\n",
+                 static_cast<double> (totalSamples) / sampleRate, numChannels, sampleRate,
+                 options.numThreads, options.chunkSeconds, options.preRollSeconds);
+
+    // Work proceeds in waves of one chunk per thread, so memory stays bounded
+    // however long the recording is
+    const juce::int64 waveSamples = static_cast<juce::int64> (chunkSamples) * options.numThreads;
+    juce::AudioBuffer<float> source, rendered;
+    std::vector<std::vector<WoolyMammothDSP::State>> startStates (static_cast<size_t> (options.numThreads),
+                                                                  std::vector<WoolyMammothDSP::State> (static_cast<size_t> (numChannels)));
+    auto endStates = startStates;
+    std::vector<WoolyMammothDSP::State> carriedStates (static_cast<size_t> (numChannels));
+    SpliceReport report;
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    for (juce::int64 waveStart = 0; waveStart < totalSamples; waveStart += waveSamples)
+    {
+        const int waveLength = static_cast<int> (juce::jmin (waveSamples, totalSamples - waveStart));
+        const int history = static_cast<int> (juce::jmin (static_cast<juce::int64> (preRollSamples), waveStart));
+
+        source.setSize (numChannels, history + waveLength, false, false, true);
+        rendered.setSize (numChannels, waveLength, false, false, true);
+        reader->read (&source, 0, history + waveLength, waveStart - history, true, true);
+
+        std::vector<std::thread> workers;
+        const int numChunks = (waveLength + chunkSamples - 1) / chunkSamples;
+
+        for (int chunk = 0; chunk < numChunks; ++chunk)
+        {
+            const int offset = chunk * chunkSamples;
+            const int length = juce::jmin (chunkSamples, waveLength - offset);
+
+            // The very first chunk starts from the quiescent circuit, just like the plugin
+            const int chunkPreRoll = waveStart + offset == 0 ? 0 : juce::jmin (preRollSamples, history + offset);
+
+            workers.emplace_back ([&, offset, length, chunkPreRoll, chunk]
+            {
+                renderChunk (prototype, source, rendered, history + offset, offset, length, chunkPreRoll,
+                             startStates[static_cast<size_t> (chunk)], endStates[static_cast<size_t> (chunk)]);
+            });
+        }
+
+        for (auto& worker : workers)
+            worker.join();
+
+        // Splices are verified in order, each from the exact state the one before it ended in
+        for (int chunk = 0; chunk < numChunks; ++chunk)
+        {
+            const int offset = chunk * chunkSamples;
+
+            if (waveStart + offset > 0)
+                verifySplice (prototype, source, rendered, history + offset, offset,
+                              juce::jmin (chunkSamples, waveLength - offset), tolerance, settleSamples,
+                              carriedStates, startStates[static_cast<size_t> (chunk)],
+                              endStates[static_cast<size_t> (chunk)], report);
+
+            carriedStates = endStates[static_cast<size_t> (chunk)];
+        }
+
+        writer->writeFromAudioSampleBuffer (rendered, 0, waveLength);
+    }
+
+    writer.reset();
+
+    const auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+    const auto audioSeconds = static_cast<double> (totalSamples) / sampleRate;
+
+    std::printf ("Rendered in %.2f s (%.0fx realtime)\n", seconds, audioSeconds / juce::jmax (seconds, 1.0e-9));
+    std::printf ("Splices: %d, worst deviation before repair %.1f dBFS, %lld sample(s) repaired\n",
+                 report.numSplices, static_cast<double> (juce::Decibels::gainToDecibels (report.worstDeviation, -200.0f)),
+                 static_cast<long long> (report.repairedSamples));
+
+    return 0;
+}
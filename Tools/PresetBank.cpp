@@ -0,0 +1,445 @@
+//==============================================================================
+// HarmonsterPresetBank - user preset bank import, export, search and checks
+//
+//   --import=<file.csv>   adds the presets in a CSV file to the bank; the
+//                         first row names the columns: name, tags (separated
+//                         by ';') and any of UserPresetBank::parameterIds
+//   --export=<file.csv>   writes every preset in the bank, same columns
+//   --search=<query>      lists the presets the editor's search would show
+//   --bench[=10000]       builds a bank of that many generated presets in a
+//                         temporary folder and times opening it, searching it
+//                         and saving to it, then checks search results against
+//                         a linear scan, the log replay after a crash before
+//                         the merge and the repair of a torn log entry;
+//                         exits non-zero on a mismatch
+//
+// Usage:
+//   HarmonsterPresetBank [--bank=<file>] [--import=...] [--export=...] [--search=...] [--bench[=N]]
+//==============================================================================
+
+#include <juce_core/juce_core.h>
+#include "UserPresetBank.h"
+
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <random>
+#include <utility>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsSince (Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli> (Clock::now() - start).count();
+    }
+
+    juce::String parameterId (int index)
+    {
+        const auto id = UserPresetBank::parameterIds[static_cast<size_t> (index)];
+        return juce::String (id.data(), id.size());
+    }
+
+    //==========================================================================
+    // Quoted fields may hold commas, quotes ("") and line breaks
+    std::vector<juce::StringArray> parseCsv (const juce::String& text)
+    {
+        std::vector<juce::StringArray> rows (1);
+        juce::String field;
+        bool quoted = false;
+
+        for (auto p = text.getCharPointer(); ! p.isEmpty(); ++p)
+        {
+            const auto c = *p;
+
+            if (quoted)
+            {
+                if (c == '"' && p[1] == '"')
+                {
+                    field += '"';
+                    ++p;
+                }
+                else if (c == '"')
+                    quoted = false;
+                else
+                    field += c;
+            }
+            else if (c == '"')
+                quoted = true;
+            else if (c == ',')
+                rows.back().add (std::exchange (field, {}));
+            else if (c == '\n')
+            {
+                rows.back().add (std::exchange (field, {}).trimCharactersAtEnd ("\r"));
+                rows.emplace_back();
+            }
+            else
+                field += c;
+        }
+
+        if (field.isNotEmpty() || ! rows.back().isEmpty())
+            rows.back().add (field.trimCharactersAtEnd ("\r"));
+        else
+            rows.pop_back();
+
+        return rows;
+    }
+
+    juce::String csvField (const juce::String& text)
+    {
+        if (! text.containsAnyOf (",\"\n\r"))
+            return text;
+
+        return "\"" + text.replace ("\"", "\"\"") + "\"";
+    }
+
+    std::vector<UserPresetBank::Preset> readPresets (const UserPresetBank& bank)
+    {
+        std::vector<UserPresetBank::Preset> presets (static_cast<size_t> (bank.getNumPresets()));
+
+        for (int i = 0; i < bank.getNumPresets(); ++i)
+            bank.getPreset (i, presets[static_cast<size_t> (i)]);
+
+        return presets;
+    }
+
+    //==========================================================================
+    bool importCsv (const juce::File& bankFile, const juce::File& csvFile)
+    {
+        const auto rows = parseCsv (csvFile.loadFileAsString());
+        if (rows.empty())
+        {
+            std::printf ("%s: empty\n", csvFile.getFullPathName().toRawUTF8());
+            return false;
+        }
+
+        const auto& header = rows.front();
+        const int nameColumn = header.indexOf ("name", true);
+        const int tagsColumn = header.indexOf ("tags", true);
+
+        if (nameColumn < 0)
+        {
+            std::printf ("%s: no \"name\" column\n", csvFile.getFullPathName().toRawUTF8());
+            return false;
+        }
+
+        std::vector<int> parameterColumns;
+        for (auto& column : header)
+            parameterColumns.push_back (UserPresetBank::getParameterIndex (column.trim().toLowerCase()));
+
+        // Everything in one new bank file rather than through the log
+        std::vector<UserPresetBank::Preset> presets;
+        {
+            UserPresetBank bank (bankFile);
+            bank.mergeNow();
+            presets = readPresets (bank);
+        }
+
+        const auto numExisting = presets.size();
+
+        for (size_t row = 1; row < rows.size(); ++row)
+        {
+            UserPresetBank::Preset preset;
+            preset.name = rows[row][nameColumn].trim();
+
+            if (preset.name.isEmpty())
+                continue;
+
+            if (tagsColumn >= 0)
+            {
+                preset.tags.addTokens (rows[row][tagsColumn], ";", {});
+                preset.tags.trim();
+                preset.tags.removeEmptyStrings();
+            }
+
+            for (int column = 0; column < rows[row].size(); ++column)
+            {
+                const int index = parameterColumns[static_cast<size_t> (column)];
+                if (index >= 0 && rows[row][column].trim().isNotEmpty())
+                    preset.values[static_cast<size_t> (index)] = rows[row][column].getFloatValue();
+            }
+
+            presets.push_back (preset);
+        }
+
+        if (! UserPresetBank::writeBank (bankFile, presets))
+        {
+            std::printf ("Couldn't write %s\n", bankFile.getFullPathName().toRawUTF8());
+            return false;
+        }
+
+        std::printf ("Imported %d presets into %s\n", static_cast<int> (presets.size() - numExisting),
+                     bankFile.getFullPathName().toRawUTF8());
+        return true;
+    }
+
+    bool exportCsv (const juce::File& bankFile, const juce::File& csvFile)
+    {
+        const UserPresetBank bank (bankFile);
+
+        juce::StringArray header { "name", "tags" };
+        for (int i = 0; i < UserPresetBank::numParameters; ++i)
+            header.add (parameterId (i));
+
+        juce::String csv = header.joinIntoString (",") + "\n";
+
+        for (auto& preset : readPresets (bank))
+        {
+            juce::StringArray row { csvField (preset.name), csvField (preset.tags.joinIntoString (";")) };
+
+            for (auto value : preset.values)
+                row.add (std::isnan (value) ? juce::String() : juce::String (value));
+
+            csv << row.joinIntoString (",") << "\n";
+        }
+
+        if (! csvFile.replaceWithText (csv))
+        {
+            std::printf ("Couldn't write %s\n", csvFile.getFullPathName().toRawUTF8());
+            return false;
+        }
+
+        std::printf ("Exported %d presets to %s\n", bank.getNumPresets(), csvFile.getFullPathName().toRawUTF8());
+        return true;
+    }
+
+    void search (const juce::File& bankFile, const juce::String& query)
+    {
+        const UserPresetBank bank (bankFile);
+
+        const auto start = Clock::now();
+        const auto results = bank.search (query);
+        const double elapsed = millisecondsSince (start);
+
+        for (auto index : results)
+        {
+            UserPresetBank::Preset preset;
+            bank.getPreset (index, preset);
+            std::printf ("  %-32s %s\n", preset.name.toRawUTF8(), preset.tags.joinIntoString (", ").toRawUTF8());
+        }
+
+        std::printf ("%d of %d presets in %.3f ms\n", static_cast<int> (results.size()), bank.getNumPresets(), elapsed);
+    }
+
+    //==========================================================================
+    // Generated presets: names and tags from small word lists, so searches
+    // have hits of every size from one preset to most of the bank
+    std::vector<UserPresetBank::Preset> generatePresets (int count, std::mt19937& random)
+    {
+        const juce::StringArray adjectives { "Wooly", "Gated", "Velcro", "Sputter", "Doom", "Sludge", "Glass", "Fizzy",
+                                             "Broken", "Warm", "Ripping", "Spitty", "Thick", "Octave", "Hollow", "Stoner" };
+        const juce::StringArray nouns { "Bass", "Lead", "Rhythm", "Wall", "Drone", "Synth", "Riff", "Swell", "Chug", "Fuzz" };
+        const juce::StringArray tags { "bass", "guitar", "doom", "gated", "clean", "octave", "live", "studio", "synth", "velcro" };
+
+        std::uniform_real_distribution<float> knob (0.0f, 1.0f);
+        std::vector<UserPresetBank::Preset> presets (static_cast<size_t> (count));
+
+        for (int i = 0; i < count; ++i)
+        {
+            auto& preset = presets[static_cast<size_t> (i)];
+            preset.name = adjectives[static_cast<int> (random() % 16)] + " " + nouns[static_cast<int> (random() % 10)] + " " + juce::String (i + 1);
+
+            for (int t = 0; t < 1 + static_cast<int> (random() % 3); ++t)
+                preset.tags.addIfNotAlreadyThere (tags[static_cast<int> (random() % 10)]);
+
+            for (int v = 0; v < 4; ++v)
+                preset.values[static_cast<size_t> (v)] = knob (random);
+        }
+
+        return presets;
+    }
+
+    // What search() should find, by brute force over the names and tags
+    std::vector<juce::String> linearSearch (const std::vector<UserPresetBank::Preset>& presets, const juce::String& query)
+    {
+        juce::StringArray queryWords;
+        queryWords.addTokens (query.toLowerCase(), " ", {});
+        queryWords.removeEmptyStrings();
+
+        std::vector<juce::String> names;
+        for (auto& preset : presets)
+        {
+            juce::StringArray words;
+            words.addTokens ((preset.name + " " + preset.tags.joinIntoString (" ")).toLowerCase(), " ", {});
+
+            bool matches = true;
+            for (auto& queryWord : queryWords)
+            {
+                bool found = false;
+                for (auto& word : words)
+                    found = found || word.startsWith (queryWord);
+
+                matches = matches && found;
+            }
+
+            if (matches)
+                names.push_back (preset.name);
+        }
+
+        std::sort (names.begin(), names.end(), [] (const juce::String& a, const juce::String& b) { return a.toLowerCase() < b.toLowerCase(); });
+        return names;
+    }
+
+    bool checkSearch (const UserPresetBank& bank, const std::vector<UserPresetBank::Preset>& presets, const juce::String& query)
+    {
+        const auto expected = linearSearch (presets, query);
+        const auto results = bank.search (query);
+
+        bool matches = results.size() == expected.size();
+        for (size_t i = 0; matches && i < results.size(); ++i)
+            matches = bank.getName (results[i]) == expected[i];
+
+        if (! matches)
+            std::printf ("  MISMATCH: \"%s\" found %d presets, expected %d\n", query.toRawUTF8(),
+                         static_cast<int> (results.size()), static_cast<int> (expected.size()));
+
+        return matches;
+    }
+
+    bool bench (int count)
+    {
+        juce::TemporaryFile folder;
+        const auto directory = folder.getFile();
+        directory.createDirectory();
+        const auto bankFile = directory.getChildFile ("Bench.harmonsterbank");
+
+        std::mt19937 random (47);
+        auto presets = generatePresets (count, random);
+        const juce::StringArray queries { "", "wooly", "wo", "doom bass", "b", "gated lead 1", "velcro", "synth 99", "nothing here" };
+        bool ok = true;
+
+        auto start = Clock::now();
+        UserPresetBank::writeBank (bankFile, presets);
+        std::printf ("Bank of %d presets, %.1f kB, written in %.2f ms\n", count,
+                     static_cast<double> (bankFile.getSize()) / 1024.0, millisecondsSince (start));
+
+        {
+            start = Clock::now();
+            UserPresetBank bank (bankFile);
+            const double openTime = millisecondsSince (start);
+
+            start = Clock::now();
+            const auto firstPage = bank.search ({}, 20);
+            const double firstPageTime = millisecondsSince (start);
+
+            std::printf ("  open %.3f ms, first page of the browser %.3f ms\n", openTime, firstPageTime);
+            ok = firstPage.size() == static_cast<size_t> (juce::jmin (20, count)) && ok;
+
+            for (auto& query : queries)
+            {
+                start = Clock::now();
+                const auto results = bank.search (query);
+                std::printf ("  search %-16s %6d hits %8.3f ms\n", ("\"" + query + "\"").toRawUTF8(),
+                             static_cast<int> (results.size()), millisecondsSince (start));
+                ok = checkSearch (bank, presets, query) && ok;
+            }
+
+            // Values round trip through the records
+            for (auto index : bank.search (presets.front().name))
+            {
+                UserPresetBank::Preset stored;
+                bank.getPreset (index, stored);
+
+                if (stored.name == presets.front().name && std::memcmp (&stored.values, &presets.front().values, sizeof (stored.values)) != 0)
+                    ok = (std::printf ("  MISMATCH: stored values\n"), false);
+            }
+
+            // Saves are searchable before the merge, and a name saved again replaces the old preset
+            auto added = generatePresets (50, random);
+            for (auto& preset : added)
+                preset.name << " New";
+            added.back().name = presets[10].name;
+
+            start = Clock::now();
+            for (auto& preset : added)
+                ok = bank.addPreset (preset) && ok;
+            std::printf ("  50 saves %.3f ms\n", millisecondsSince (start));
+
+            presets.erase (presets.begin() + 10);
+            presets.insert (presets.end(), added.begin(), added.end());
+
+            for (auto& query : queries)
+                ok = checkSearch (bank, presets, query) && ok;
+
+            start = Clock::now();
+            for (auto& query : queries)
+                bank.search (query);
+            std::printf ("  all searches with 50 unmerged saves %.3f ms\n", millisecondsSince (start));
+
+            // Destroyed before the background merge: the saves stay in the log
+        }
+
+        {
+            UserPresetBank bank (bankFile);
+            ok = (bank.getNumPresets() == static_cast<int> (presets.size())
+                  || (std::printf ("  MISMATCH: %d presets after log replay\n", bank.getNumPresets()), false)) && ok;
+
+            start = Clock::now();
+            ok = bank.mergeNow() && ok;
+            std::printf ("  merge %.2f ms\n", millisecondsSince (start));
+
+            for (auto& query : queries)
+                ok = checkSearch (bank, presets, query) && ok;
+
+            ok = ! bankFile.getSiblingFile (bankFile.getFileName() + ".log").exists() && ok;
+
+            UserPresetBank::Preset survivor, torn;
+            survivor.name = "Survivor";
+            torn.name = "Torn";
+            ok = bank.addPreset (survivor) && bank.addPreset (torn) && ok;
+        }
+
+        UserPresetBank::Preset afterRepair;
+        afterRepair.name = "After Repair";
+
+        {
+            // A crash in the middle of the second save: the first must survive, the torn one go,
+            // and the next save must land where the torn one began
+            const auto logFile = bankFile.getSiblingFile (bankFile.getFileName() + ".log");
+            juce::MemoryBlock log;
+            logFile.loadFileAsData (log);
+            logFile.replaceWithData (log.getData(), log.getSize() - 7);
+
+            UserPresetBank bank (bankFile);
+            ok = (bank.getNumPresets() == static_cast<int> (presets.size()) + 1
+                  || (std::printf ("  MISMATCH: %d presets after a torn save\n", bank.getNumPresets()), false)) && ok;
+            ok = bank.search ("survivor").size() == 1 && bank.search ("torn").empty() && ok;
+            ok = bank.addPreset (afterRepair) && ok;
+        }
+
+        {
+            UserPresetBank bank (bankFile);
+            ok = (bank.search ("survivor").size() == 1 && bank.search ("after repair").size() == 1)
+                 || (std::printf ("  MISMATCH: save after a torn entry lost\n"), false);
+        }
+
+        directory.deleteRecursively();
+        std::printf (ok ? "All checks passed\n" : "FAILED\n");
+        return ok;
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    const juce::ArgumentList args (argc, argv);
+    const auto bankFile = args.containsOption ("--bank") ? args.getFileForOption ("--bank") : UserPresetBank::getDefaultBankFile();
+    bool ok = true;
+
+    if (args.containsOption ("--import"))
+        ok = importCsv (bankFile, args.getFileForOption ("--import")) && ok;
+
+    if (args.containsOption ("--export"))
+        ok = exportCsv (bankFile, args.getFileForOption ("--export")) && ok;
+
+    if (args.containsOption ("--search"))
+        search (bankFile, args.getValueForOption ("--search"));
+
+    if (args.containsOption ("--bench"))
+    {
+        const auto count = args.getValueForOption ("--bench").getIntValue();
+        ok = bench (count > 0 ? count : 10000) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,480 @@
+//==============================================================================
+// HarmonsterRealtimeCheck - audio-thread realtime-safety checker
+//
+// Replaces operator new/delete, malloc/calloc/realloc/free and
+// pthread_mutex_lock for the whole process and flags every call made from
+// inside processBlock() on the thread driving the processor. Everything a
+// host does between blocks (automation, program changes, prepareToPlay())
+// runs on the same thread but unchecked; only processBlock() is watched.
+//
+// The session it plays: every sample rate, each with a range of maximum
+// block sizes and random shorter blocks below them; random automation of
+// every parameter, factory program switches, bypass toggles, mono and
+// stereo input, a cabinet IR loaded in the background and swapped in, and
+// the flight recorder armed with one dump requested mid-run. A listener is
+// registered on the processor as a host's would be, since the processor only
+// locks its listener list while it has listeners.
+//
+// Each new call site prints the call and a backtrace (link with -rdynamic
+// for symbol names). The exit code is 1 if anything was flagged, so the
+// tool can gate a CI run.
+//
+// Linux (glibc) interposes all of the calls above; other platforms only
+// operator new/delete.
+//
+// Usage:
+//   HarmonsterRealtimeCheck [--seconds=2] [--rates=44100,48000,88200,96000]
+//                           [--buffers=32,64,441,512,2048] [--max-reports=20]
+//==============================================================================
+
+#include "PluginProcessor.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <execinfo.h>
+ #include <unistd.h>
+#endif
+
+#if JUCE_LINUX
+ #include <dlfcn.h>
+ #include <pthread.h>
+
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void __libc_free (void*);
+}
+#endif
+
+//==============================================================================
+namespace
+{
+    // Above zero while this thread is inside a checked processBlock()
+    thread_local int checkDepth = 0;
+
+    // Set while a violation is being reported, so the report can't report itself
+    thread_local bool reporting = false;
+
+    std::atomic<int> numViolations { 0 };
+    std::atomic<int> maxReports { 20 };
+
+    // Call sites already reported, by a hash of their return addresses
+    constexpr int maxCallSites = 256;
+    juce::uint64 callSites[maxCallSites] {};
+    int numCallSites = 0;
+
+    void writeMessage (const char* text)
+    {
+       #if JUCE_LINUX || JUCE_MAC
+        // Not stdio, which may allocate or lock
+        const auto length = std::strlen (text);
+        juce::ignoreUnused (::write (STDERR_FILENO, text, length));
+       #else
+        std::fputs (text, stderr);
+       #endif
+    }
+
+    void reportViolation (const char* call)
+    {
+        if (checkDepth == 0 || reporting)
+            return;
+
+        reporting = true;
+        ++numViolations;
+
+       #if JUCE_LINUX || JUCE_MAC
+        void* frames[48];
+        const int numFrames = backtrace (frames, 48);
+
+        juce::uint64 site = 14695981039346656037ull;
+        for (int i = 0; i < numFrames; ++i)
+            site = (site ^ static_cast<juce::uint64> (reinterpret_cast<std::uintptr_t> (frames[i]))) * 1099511628211ull;
+
+        bool seen = false;
+        for (int i = 0; i < numCallSites; ++i)
+            seen = seen || callSites[i] == site;
+
+        if (! seen && numCallSites < juce::jmin (maxReports.load(), maxCallSites))
+        {
+            callSites[numCallSites++] = site;
+
+            writeMessage ("\nrealtime violation: ");
+            writeMessage (call);
+            writeMessage (" inside processBlock()\n");
+            backtrace_symbols_fd (frames, numFrames, STDERR_FILENO);
+        }
+       #else
+        if (numViolations.load() <= maxReports.load())
+        {
+            writeMessage ("\nrealtime violation: ");
+            writeMessage (call);
+            writeMessage (" inside processBlock()\n");
+        }
+       #endif
+
+        reporting = false;
+    }
+
+    // The untracked allocator underneath the replacements
+    void* rawAllocate (size_t size)
+    {
+       #if JUCE_LINUX
+        return __libc_malloc (size);
+       #else
+        return std::malloc (size);
+       #endif
+    }
+
+    void* rawAllocateAligned (size_t size, size_t alignment)
+    {
+       #if JUCE_LINUX
+        return __libc_memalign (alignment, size);
+       #elif JUCE_WINDOWS
+        return _aligned_malloc (size, alignment);
+       #else
+        void* memory = nullptr;
+        return posix_memalign (&memory, alignment, size) == 0 ? memory : nullptr;
+       #endif
+    }
+
+    void rawFree (void* memory)
+    {
+       #if JUCE_LINUX
+        __libc_free (memory);
+       #else
+        std::free (memory);
+       #endif
+    }
+
+    void rawFreeAligned (void* memory)
+    {
+       #if JUCE_WINDOWS
+        _aligned_free (memory);
+       #else
+        rawFree (memory);
+       #endif
+    }
+
+    void* checkedNew (size_t size, const char* call)
+    {
+        reportViolation (call);
+
+        if (auto* memory = rawAllocate (size == 0 ? 1 : size))
+            return memory;
+
+        throw std::bad_alloc();
+    }
+
+    void* checkedAlignedNew (size_t size, std::align_val_t alignment, const char* call)
+    {
+        reportViolation (call);
+
+        if (auto* memory = rawAllocateAligned (size == 0 ? 1 : size, static_cast<size_t> (alignment)))
+            return memory;
+
+        throw std::bad_alloc();
+    }
+
+    // Deleting null is a no-op, not a trip into the allocator
+    void checkedDelete (void* memory, const char* call)
+    {
+        if (memory == nullptr)
+            return;
+
+        reportViolation (call);
+        rawFree (memory);
+    }
+
+    void checkedAlignedDelete (void* memory, const char* call)
+    {
+        if (memory == nullptr)
+            return;
+
+        reportViolation (call);
+        rawFreeAligned (memory);
+    }
+
+    struct CheckedScope
+    {
+        CheckedScope() { ++checkDepth; }
+        ~CheckedScope() { --checkDepth; }
+    };
+}
+
+//==============================================================================
+// Global replacements, picked up by every library in the process
+void* operator new (size_t size) { return checkedNew (size, "operator new"); }
+void* operator new[] (size_t size) { return checkedNew (size, "operator new[]"); }
+void* operator new (size_t size, const std::nothrow_t&) noexcept { reportViolation ("operator new"); return rawAllocate (size == 0 ? 1 : size); }
+void* operator new[] (size_t size, const std::nothrow_t&) noexcept { reportViolation ("operator new[]"); return rawAllocate (size == 0 ? 1 : size); }
+void* operator new (size_t size, std::align_val_t alignment) { return checkedAlignedNew (size, alignment, "aligned operator new"); }
+void* operator new[] (size_t size, std::align_val_t alignment) { return checkedAlignedNew (size, alignment, "aligned operator new[]"); }
+
+void operator delete (void* memory) noexcept { checkedDelete (memory, "operator delete"); }
+void operator delete[] (void* memory) noexcept { checkedDelete (memory, "operator delete[]"); }
+void operator delete (void* memory, size_t) noexcept { checkedDelete (memory, "operator delete"); }
+void operator delete[] (void* memory, size_t) noexcept { checkedDelete (memory, "operator delete[]"); }
+void operator delete (void* memory, const std::nothrow_t&) noexcept { checkedDelete (memory, "operator delete"); }
+void operator delete[] (void* memory, const std::nothrow_t&) noexcept { checkedDelete (memory, "operator delete[]"); }
+void operator delete (void* memory, std::align_val_t) noexcept { checkedAlignedDelete (memory, "aligned operator delete"); }
+void operator delete[] (void* memory, std::align_val_t) noexcept { checkedAlignedDelete (memory, "aligned operator delete[]"); }
+void operator delete (void* memory, size_t, std::align_val_t) noexcept { checkedAlignedDelete (memory, "aligned operator delete"); }
+void operator delete[] (void* memory, size_t, std::align_val_t) noexcept { checkedAlignedDelete (memory, "aligned operator delete[]"); }
+
+#if JUCE_LINUX
+// glibc looks these up through the dynamic linker, so the definitions in the
+// executable win for every library, libstdc++ included
+extern "C"
+{
+    void* malloc (size_t size) noexcept { reportViolation ("malloc"); return __libc_malloc (size); }
+    void* calloc (size_t count, size_t size) noexcept { reportViolation ("calloc"); return __libc_calloc (count, size); }
+    void* realloc (void* memory, size_t size) noexcept { reportViolation ("realloc"); return __libc_realloc (memory, size); }
+    void* memalign (size_t alignment, size_t size) noexcept { reportViolation ("memalign"); return __libc_memalign (alignment, size); }
+    void* aligned_alloc (size_t alignment, size_t size) noexcept { reportViolation ("aligned_alloc"); return __libc_memalign (alignment, size); }
+
+    int posix_memalign (void** memory, size_t alignment, size_t size) noexcept
+    {
+        reportViolation ("posix_memalign");
+        *memory = __libc_memalign (alignment, size);
+        return *memory != nullptr ? 0 : ENOMEM;
+    }
+
+    void free (void* memory) noexcept
+    {
+        if (memory != nullptr)
+            reportViolation ("free");
+
+        __libc_free (memory);
+    }
+
+    int pthread_mutex_lock (pthread_mutex_t* mutex) noexcept
+    {
+        // Looked up on first use without a guarded static, whose guard could lock
+        using LockFunction = int (*) (pthread_mutex_t*);
+        static std::atomic<LockFunction> next { nullptr };
+
+        auto lock = next.load (std::memory_order_acquire);
+        if (lock == nullptr)
+        {
+            lock = reinterpret_cast<LockFunction> (dlsym (RTLD_NEXT, "pthread_mutex_lock"));
+            next.store (lock, std::memory_order_release);
+        }
+
+        reportViolation ("pthread_mutex_lock");
+        return lock (mutex);
+    }
+}
+#endif
+
+//==============================================================================
+namespace
+{
+    struct CheckOptions
+    {
+        double secondsPerRun = 2.0;
+        juce::Array<double> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0 };
+        juce::Array<int> bufferSizes { 32, 64, 441, 512, 2048 };
+    };
+
+    CheckOptions parseOptions (const juce::ArgumentList& args)
+    {
+        CheckOptions options;
+
+        if (args.containsOption ("--seconds"))
+            options.secondsPerRun = juce::jmax (0.1, args.getValueForOption ("--seconds").getDoubleValue());
+
+        if (args.containsOption ("--rates"))
+        {
+            options.sampleRates.clear();
+            for (auto& token : juce::StringArray::fromTokens (args.getValueForOption ("--rates"), ",", {}))
+                options.sampleRates.add (token.getDoubleValue());
+        }
+
+        if (args.containsOption ("--buffers"))
+        {
+            options.bufferSizes.clear();
+            for (auto& token : juce::StringArray::fromTokens (args.getValueForOption ("--buffers"), ",", {}))
+                options.bufferSizes.add (juce::jmax (1, token.getIntValue()));
+        }
+
+        if (args.containsOption ("--max-reports"))
+            maxReports = juce::jmax (0, args.getValueForOption ("--max-reports").getIntValue());
+
+        return options;
+    }
+
+    // Decaying noise burst, so the cabinet has an IR to load and swap in
+    juce::File writeImpulseResponse (const juce::File& directory)
+    {
+        auto file = directory.getChildFile ("cabinet.wav");
+        juce::AudioBuffer<float> impulse (1, 4096);
+        juce::Random random (7);
+
+        for (int i = 0; i < impulse.getNumSamples(); ++i)
+            impulse.setSample (0, i, (random.nextFloat() * 2.0f - 1.0f) * std::exp (-i / 600.0f));
+
+        file.deleteFile();
+        juce::WavAudioFormat wav;
+
+        if (auto stream = std::unique_ptr<juce::OutputStream> (file.createOutputStream()))
+            if (auto writer = std::unique_ptr<juce::AudioFormatWriter> (wav.createWriterFor (stream.get(), 48000.0, 1, 24, {}, 0)))
+            {
+                stream.release();
+                writer->writeFromAudioSampleBuffer (impulse, 0, impulse.getNumSamples());
+            }
+
+        return file;
+    }
+
+    void fillInput (juce::AudioBuffer<float>& buffer, int numSamples, double sampleRate, double& phase, bool stereo, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> noise (-0.01f, 0.01f);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto sample = static_cast<float> (0.5 * std::sin (phase)) + noise (rng);
+            phase = std::fmod (phase + juce::MathConstants<double>::twoPi * 110.0 / sampleRate, juce::MathConstants<double>::twoPi);
+
+            buffer.setSample (0, i, sample);
+            buffer.setSample (1, i, stereo ? sample * 0.7f + noise (rng) : sample);
+        }
+    }
+
+    // Stands in for the host's own listener on the processor
+    struct HostListener : public juce::AudioProcessorListener
+    {
+        void audioProcessorParameterChanged (juce::AudioProcessor*, int, float) override {}
+        void audioProcessorChanged (juce::AudioProcessor*, const ChangeDetails&) override {}
+    };
+
+    // What a host does between two blocks, none of it checked
+    void betweenBlocks (WoolyMammothAudioProcessor& processor, int block, std::mt19937& rng)
+    {
+        auto& params = processor.getParameters();
+
+        // Automation, a few points per block, every parameter including the switches
+        for (int i = static_cast<int> (rng() % 3u); i > 0; --i)
+        {
+            auto* param = params[static_cast<int> (rng() % static_cast<unsigned> (params.size()))];
+            param->setValueNotifyingHost (std::uniform_real_distribution<float> (0.0f, 1.0f) (rng));
+        }
+
+        if (block % 97 == 0)
+            processor.setCurrentProgram (static_cast<int> (rng() % static_cast<unsigned> (processor.getNumPrograms())));
+
+        if (block % 41 == 0)
+            if (auto* bypass = processor.parameters.getParameter ("bypass"))
+                bypass->setValueNotifyingHost (bypass->getValue() > 0.5f ? 0.0f : 1.0f);
+
+        if (block == 100)
+            processor.getFlightRecorder().requestDump();
+    }
+
+    int runConfiguration (WoolyMammothAudioProcessor& processor, const CheckOptions& options, double sampleRate, int maxBlockSize)
+    {
+        processor.releaseResources();
+        processor.setPlayConfigDetails (2, 2, sampleRate, maxBlockSize);
+        processor.prepareToPlay (sampleRate, maxBlockSize);
+
+        juce::AudioBuffer<float> buffer (2, maxBlockSize);
+        juce::MidiBuffer midi;
+        std::mt19937 rng (static_cast<unsigned> (sampleRate) + static_cast<unsigned> (maxBlockSize));
+        double phase = 0.0;
+
+        const int violationsBefore = numViolations.load();
+        const auto totalSamples = static_cast<juce::int64> (options.secondsPerRun * sampleRate);
+        juce::int64 samplesDone = 0;
+        int block = 0;
+
+        while (samplesDone < totalSamples)
+        {
+            // Hosts may hand over anything up to the prepared size
+            const int numSamples = (rng() & 3u) == 0 ? 1 + static_cast<int> (rng() % static_cast<unsigned> (maxBlockSize)) : maxBlockSize;
+            const bool stereo = (block / 50) % 2 == 1;
+
+            betweenBlocks (processor, block, rng);
+            buffer.setSize (2, numSamples, false, false, true);
+            fillInput (buffer, numSamples, sampleRate, phase, stereo, rng);
+
+            {
+                const CheckedScope scope;
+                processor.processBlock (buffer, midi);
+            }
+
+            samplesDone += numSamples;
+            ++block;
+        }
+
+        const int violations = numViolations.load() - violationsBefore;
+        std::printf ("%8.0f %7d %8d %11d\n", sampleRate, maxBlockSize, block, violations);
+        std::fflush (stdout);
+        return violations;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    auto options = parseOptions (juce::ArgumentList (argc, argv));
+
+   #if JUCE_LINUX || JUCE_MAC
+    // The first backtrace() loads the unwinder, which allocates
+    void* frames[4];
+    juce::ignoreUnused (backtrace (frames, 4));
+   #endif
+
+   #if ! JUCE_LINUX
+    std::printf ("Note: only operator new/delete are checked on this platform\n");
+   #endif
+
+    auto workDirectory = juce::File::createTempFile ("harmonster-rt-check");
+    workDirectory.createDirectory();
+
+    int failures = 0;
+
+    {
+        WoolyMammothAudioProcessor processor;
+        HostListener hostListener;
+        processor.addListener (&hostListener);
+
+        processor.setPlayConfigDetails (2, 2, options.sampleRates.getFirst(), options.bufferSizes.getFirst());
+        processor.prepareToPlay (options.sampleRates.getFirst(), options.bufferSizes.getFirst());
+
+        processor.getFlightRecorder().setDumpDirectory (workDirectory);
+        processor.getFlightRecorder().setEnabled (true);
+        processor.loadCabinetImpulseResponse (writeImpulseResponse (workDirectory));
+
+        std::printf ("Harmonster realtime check: %.1f s per run\n\n", options.secondsPerRun);
+        std::printf ("%8s %7s %8s %11s\n", "rate", "buffer", "blocks", "violations");
+
+        for (auto sampleRate : options.sampleRates)
+            for (auto blockSize : options.bufferSizes)
+                failures += runConfiguration (processor, options, sampleRate, blockSize);
+
+        processor.releaseResources();
+        processor.removeListener (&hostListener);
+    }
+
+    workDirectory.deleteRecursively();
+
+    if (failures > 0)
+    {
+        std::printf ("\nFAILED: %d allocation or lock call(s) inside processBlock()\n", failures);
+        return 1;
+    }
+
+    std::printf ("\nOK: processBlock() made no allocation or lock calls\n");
+    return 0;
+}
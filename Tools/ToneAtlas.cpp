@@ -0,0 +1,493 @@
+//==============================================================================
+// HarmonsterToneAtlas - renders a DI phrase across the whole knob space
+//
+// Renders the phrase at every point of a wool x pinch x eq x output grid
+// (--steps positions per knob, so 5 steps give 625 renders), each with a
+// WoolyMammothDSP of its own, and writes one file per point plus atlas.csv
+// summarising each render:
+//   rms        - output level, dBFS
+//   crest      - peak over RMS, dB
+//   centroid   - spectral centroid, energy-weighted over the whole render, Hz
+//   gate duty  - fraction of the 10 ms windows in which the phrase is playing
+//                that the output is open, i.e. within 40 dB of its loudest
+//
+// The input is memory-mapped once and each worker copies the phrase straight
+// out of the mapping. The grid is split into one contiguous shard per worker;
+// a worker that runs out steals from the far end of another's shard, so
+// settings that render slowly don't leave the other threads idle. Finished
+// renders go to a single writer thread through a bounded queue, so disk I/O
+// stays off the compute threads; they only wait when the queue is full, and
+// the time they spent waiting is reported.
+//
+// The phrase must be a WAV or AIFF file, which can be mapped; only its first
+// channel is rendered.
+//
+// Usage:
+//   HarmonsterToneAtlas <phrase.wav> <atlas-directory> [--steps=5] [--threads=N]
+//                       [--queue=32] [--no-sag] [--no-texture] [--passive-eq]
+//==============================================================================
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_dsp/juce_dsp.h>
+#include "WoolyMammothDSP.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    struct AtlasOptions
+    {
+        juce::File inputFile, atlasDirectory;
+        int steps = 5;
+        int numThreads = 1;
+        int queueCapacity = 32;
+        unsigned features = WoolyMammothDSP::allFeatures & ~static_cast<unsigned> (WoolyMammothDSP::passiveEq);
+    };
+
+    struct GridPoint
+    {
+        double wool = 0.0, pinch = 0.0, eq = 0.0, output = 0.0;
+
+        juce::String getFileName() const
+        {
+            auto knob = [] (const char* name, double value) { return name + juce::String (juce::roundToInt (value * 100.0)).paddedLeft ('0', 3); };
+            return knob ("w", wool) + "_" + knob ("p", pinch) + "_" + knob ("e", eq) + "_" + knob ("o", output) + ".wav";
+        }
+    };
+
+    struct Summary
+    {
+        double rmsDb = 0.0, crestDb = 0.0, centroid = 0.0, gateDuty = 0.0;
+    };
+
+    //==========================================================================
+    bool parseOptions (const juce::ArgumentList& args, AtlasOptions& options)
+    {
+        if (args.size() < 2)
+            return false;
+
+        const auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+        options.inputFile = workingDirectory.getChildFile (args[0].text);
+        options.atlasDirectory = workingDirectory.getChildFile (args[1].text);
+
+        if (args.containsOption ("--steps"))
+            options.steps = juce::jlimit (2, 101, args.getValueForOption ("--steps").getIntValue());
+
+        options.numThreads = juce::SystemStats::getNumCpus();
+        if (args.containsOption ("--threads"))
+            options.numThreads = juce::jmax (1, args.getValueForOption ("--threads").getIntValue());
+
+        if (args.containsOption ("--queue"))
+            options.queueCapacity = juce::jmax (1, args.getValueForOption ("--queue").getIntValue());
+
+        if (args.containsOption ("--no-sag"))
+            options.features &= ~static_cast<unsigned> (WoolyMammothDSP::supplySag);
+        if (args.containsOption ("--no-texture"))
+            options.features &= ~WoolyMammothDSP::textureFeatures;
+        if (args.containsOption ("--passive-eq"))
+            options.features |= WoolyMammothDSP::passiveEq;
+
+        return true;
+    }
+
+    std::vector<GridPoint> makeGrid (int steps)
+    {
+        std::vector<GridPoint> grid;
+        auto position = [steps] (int step) { return static_cast<double> (step) / (steps - 1); };
+
+        for (int wool = 0; wool < steps; ++wool)
+            for (int pinch = 0; pinch < steps; ++pinch)
+                for (int eq = 0; eq < steps; ++eq)
+                    for (int output = 0; output < steps; ++output)
+                        grid.push_back ({ position (wool), position (pinch), position (eq), position (output) });
+
+        return grid;
+    }
+
+    //==========================================================================
+    // One deque of task indices per worker, each behind its own lock. The
+    // owner takes from the back; thieves take from the front, furthest from
+    // where the owner is working. Nothing is added once work has started, so
+    // all deques empty means the grid is done.
+    class WorkStealingQueues
+    {
+    public:
+        WorkStealingQueues (int numTasks, int numWorkers) : shards (static_cast<size_t> (numWorkers))
+        {
+            for (int task = 0; task < numTasks; ++task)
+                shards[static_cast<size_t> (static_cast<juce::int64> (task) * numWorkers / numTasks)].tasks.push_back (task);
+        }
+
+        bool next (int worker, int& task)
+        {
+            if (take (shards[static_cast<size_t> (worker)], task, false))
+                return true;
+
+            for (size_t i = 1; i < shards.size(); ++i)
+            {
+                if (take (shards[(static_cast<size_t> (worker) + i) % shards.size()], task, true))
+                {
+                    ++steals;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        int getNumSteals() const { return steals.load(); }
+
+    private:
+        struct Shard
+        {
+            std::mutex lock;
+            std::deque<int> tasks;
+        };
+
+        std::vector<Shard> shards;
+        std::atomic<int> steals { 0 };
+
+        static bool take (Shard& shard, int& task, bool fromFront)
+        {
+            const std::lock_guard<std::mutex> guard (shard.lock);
+            if (shard.tasks.empty())
+                return false;
+
+            task = fromFront ? shard.tasks.front() : shard.tasks.back();
+            fromFront ? shard.tasks.pop_front() : shard.tasks.pop_back();
+            return true;
+        }
+    };
+
+    //==========================================================================
+    // Writes finished renders on a thread of its own. push() only blocks when
+    // capacity renders are already waiting, which bounds the memory they hold.
+    class AsyncWriter
+    {
+    public:
+        AsyncWriter (double rate, size_t maxQueued)
+            : sampleRate (rate), capacity (maxQueued), thread ([this] { run(); })
+        {
+        }
+
+        ~AsyncWriter() { finish(); }
+
+        void push (const juce::File& file, std::vector<float>&& samples)
+        {
+            std::unique_lock<std::mutex> guard (lock);
+
+            if (queue.size() >= capacity)
+            {
+                const auto start = juce::Time::getHighResolutionTicks();
+                spaceAvailable.wait (guard, [this] { return queue.size() < capacity; });
+                waitedTicks += juce::Time::getHighResolutionTicks() - start;
+            }
+
+            queue.push_back ({ file, std::move (samples) });
+            workAvailable.notify_one();
+        }
+
+        // Writes whatever is still queued and stops the thread; returns the
+        // number of files that could not be written
+        int finish()
+        {
+            {
+                const std::lock_guard<std::mutex> guard (lock);
+                finished = true;
+            }
+
+            workAvailable.notify_one();
+            if (thread.joinable())
+                thread.join();
+
+            return failures;
+        }
+
+        double getSecondsWaited() const { return juce::Time::highResolutionTicksToSeconds (waitedTicks.load()); }
+
+    private:
+        struct Job
+        {
+            juce::File file;
+            std::vector<float> samples;
+        };
+
+        double sampleRate;
+        size_t capacity;
+        std::mutex lock;
+        std::condition_variable workAvailable, spaceAvailable;
+        std::deque<Job> queue;
+        bool finished = false;
+        int failures = 0;
+        std::atomic<juce::int64> waitedTicks { 0 };
+        std::thread thread;
+
+        void run()
+        {
+            for (;;)
+            {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> guard (lock);
+                    workAvailable.wait (guard, [this] { return finished || ! queue.empty(); });
+
+                    if (queue.empty())
+                        return;
+
+                    job = std::move (queue.front());
+                    queue.pop_front();
+                }
+
+                spaceAvailable.notify_one();
+
+                if (! write (job))
+                    ++failures;
+            }
+        }
+
+        bool write (const Job& job) const
+        {
+            job.file.deleteFile();
+            std::unique_ptr<juce::AudioFormatWriter> writer;
+
+            if (auto stream = job.file.createOutputStream())
+                writer.reset (juce::WavAudioFormat().createWriterFor (stream.release(), sampleRate, 1, 24, {}, 0));
+
+            const float* channels[] { job.samples.data() };
+            return writer != nullptr && writer->writeFromFloatArrays (channels, 1, static_cast<int> (job.samples.size()));
+        }
+    };
+
+    //==========================================================================
+    class FeatureAnalysis
+    {
+    public:
+        explicit FeatureAnalysis (double rate)
+            : sampleRate (rate), fft (fftOrder),
+              window (static_cast<size_t> (fftSize)), frame (static_cast<size_t> (2 * fftSize))
+        {
+            for (int i = 0; i < fftSize; ++i)
+                window[static_cast<size_t> (i)] = static_cast<float> (0.5 - 0.5 * std::cos (2.0 * M_PI * i / fftSize));
+        }
+
+        Summary analyse (const float* input, const float* output, int numSamples)
+        {
+            Summary summary;
+            double sumSquares = 0.0;
+            float peak = 0.0f;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                sumSquares += static_cast<double> (output[i]) * output[i];
+                peak = juce::jmax (peak, std::abs (output[i]));
+            }
+
+            const double rms = std::sqrt (sumSquares / juce::jmax (1, numSamples));
+            summary.rmsDb = juce::Decibels::gainToDecibels (rms, -200.0);
+            summary.crestDb = juce::Decibels::gainToDecibels (peak / juce::jmax (rms, 1.0e-12), -200.0);
+            summary.centroid = spectralCentroid (output, numSamples);
+            summary.gateDuty = gateDuty (input, output, numSamples);
+            return summary;
+        }
+
+    private:
+        static constexpr int fftOrder = 11;
+        static constexpr int fftSize = 1 << fftOrder;
+
+        double sampleRate;
+        juce::dsp::FFT fft;
+        std::vector<float> window, frame;
+
+        double spectralCentroid (const float* samples, int numSamples)
+        {
+            double weighted = 0.0, total = 0.0;
+
+            for (int start = 0; start + fftSize <= numSamples; start += fftSize / 2)
+            {
+                std::fill (frame.begin(), frame.end(), 0.0f);
+                for (int i = 0; i < fftSize; ++i)
+                    frame[static_cast<size_t> (i)] = samples[start + i] * window[static_cast<size_t> (i)];
+
+                fft.performFrequencyOnlyForwardTransform (frame.data());
+
+                for (int bin = 1; bin <= fftSize / 2; ++bin)
+                {
+                    const double energy = static_cast<double> (frame[static_cast<size_t> (bin)]) * frame[static_cast<size_t> (bin)];
+                    weighted += energy * bin * sampleRate / fftSize;
+                    total += energy;
+                }
+            }
+
+            return total > 0.0 ? weighted / total : 0.0;
+        }
+
+        double gateDuty (const float* input, const float* output, int numSamples) const
+        {
+            const int windowSamples = juce::jmax (1, static_cast<int> (sampleRate * 0.01));
+            const float playingLevel = juce::Decibels::decibelsToGain (-60.0f);
+            std::vector<std::pair<double, double>> windows;  // input RMS, output RMS
+            double loudest = 0.0;
+
+            for (int start = 0; start + windowSamples <= numSamples; start += windowSamples)
+            {
+                double in = 0.0, out = 0.0;
+                for (int i = start; i < start + windowSamples; ++i)
+                {
+                    in += static_cast<double> (input[i]) * input[i];
+                    out += static_cast<double> (output[i]) * output[i];
+                }
+
+                windows.emplace_back (std::sqrt (in / windowSamples), std::sqrt (out / windowSamples));
+                loudest = juce::jmax (loudest, windows.back().second);
+            }
+
+            const double openLevel = loudest * juce::Decibels::decibelsToGain (-40.0);
+            int playing = 0, open = 0;
+
+            for (const auto& [in, out] : windows)
+            {
+                if (in < playingLevel)
+                    continue;
+
+                ++playing;
+                if (out >= openLevel)
+                    ++open;
+            }
+
+            return playing > 0 ? static_cast<double> (open) / playing : 0.0;
+        }
+    };
+
+    bool writeSummaries (const juce::File& file, const std::vector<GridPoint>& grid, const std::vector<Summary>& summaries)
+    {
+        juce::String csv ("file,wool,pinch,eq,output,rms_db,crest_db,centroid_hz,gate_duty\n");
+
+        for (size_t i = 0; i < grid.size(); ++i)
+        {
+            const auto& point = grid[i];
+            const auto& summary = summaries[i];
+            csv << point.getFileName() << ',' << point.wool << ',' << point.pinch << ',' << point.eq << ',' << point.output << ','
+                << juce::String (summary.rmsDb, 2) << ',' << juce::String (summary.crestDb, 2) << ','
+                << juce::String (summary.centroid, 1) << ',' << juce::String (summary.gateDuty, 3) << '\n';
+        }
+
+        return file.replaceWithText (csv);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    const juce::ArgumentList args (argc, argv);
+
+    AtlasOptions options;
+    if (! parseOptions (args, options))
+    {
+        std::printf ("usage: HarmonsterToneAtlas <phrase.wav> <atlas-directory> [--steps=5] [--threads=N]\n"
+                     "                           [--queue=32] [--no-sag] [--no-texture] [--passive-eq]\n");
+        return 1;
+    }
+
+    // Mapped once; every worker reads from the same pages
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader;
+    if (options.inputFile.hasFileExtension ("aif;aiff"))
+        reader.reset (juce::AiffAudioFormat().createMemoryMappedReader (options.inputFile));
+    else
+        reader.reset (juce::WavAudioFormat().createMemoryMappedReader (options.inputFile));
+
+    if (reader == nullptr || ! reader->mapEntireFile() || reader->lengthInSamples <= 0
+        || reader->lengthInSamples > std::numeric_limits<int>::max())
+    {
+        std::printf ("Cannot map %s\n", options.inputFile.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    if (! options.atlasDirectory.createDirectory())
+    {
+        std::printf ("Cannot create %s\n", options.atlasDirectory.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    const double sampleRate = reader->sampleRate;
+    const int numSamples = static_cast<int> (reader->lengthInSamples);
+    const auto grid = makeGrid (options.steps);
+    const int numTasks = static_cast<int> (grid.size());
+    const int numWorkers = juce::jmin (options.numThreads, numTasks);
+
+    WoolyMammothDSP prototype;
+    prototype.setSampleRate (sampleRate);
+    prototype.setFeatures (options.features);
+
+    std::printf ("Rendering %.1f s at %.0f Hz over %d points (%d steps per knob): %d thread(s), queue of %d\n",
+                 numSamples / sampleRate, sampleRate, numTasks, options.steps, numWorkers, options.queueCapacity);
+
+    WorkStealingQueues queues (numTasks, numWorkers);
+    AsyncWriter writer (sampleRate, static_cast<size_t> (options.queueCapacity));
+    std::vector<Summary> summaries (grid.size());
+    std::atomic<int> numRendered { 0 };
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    std::vector<std::thread> workers;
+
+    for (int worker = 0; worker < numWorkers; ++worker)
+    {
+        workers.emplace_back ([&, worker]
+        {
+            // The mapped reader only copies out of the mapping, so workers can share it
+            juce::AudioBuffer<float> input (1, numSamples);
+            if (! reader->read (&input, 0, numSamples, 0, true, false))
+                return;
+
+            FeatureAnalysis analysis (sampleRate);
+            int task = 0;
+
+            while (queues.next (worker, task))
+            {
+                const auto& point = grid[static_cast<size_t> (task)];
+                auto dsp = prototype;
+                dsp.setWool (point.wool);
+                dsp.setPinch (point.pinch);
+                dsp.setEQ (point.eq);
+                dsp.setOutput (point.output);
+
+                std::vector<float> output (input.getReadPointer (0), input.getReadPointer (0) + numSamples);
+                dsp.processBlock (output.data(), numSamples);
+
+                summaries[static_cast<size_t> (task)] = analysis.analyse (input.getReadPointer (0), output.data(), numSamples);
+                writer.push (options.atlasDirectory.getChildFile (point.getFileName()), std::move (output));
+                ++numRendered;
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    const auto computeSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+    const int writeFailures = writer.finish();
+    const auto totalSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+
+    const auto summaryFile = options.atlasDirectory.getChildFile ("atlas.csv");
+    const bool summariesWritten = writeSummaries (summaryFile, grid, summaries);
+
+    std::printf ("Rendered in %.2f s (%.1f renders/s), all written after %.2f s; %d steal(s)\n",
+                 computeSeconds, numTasks / juce::jmax (computeSeconds, 1.0e-9), totalSeconds, queues.getNumSteals());
+    std::printf ("Compute threads waited %.3f s on the writer\n", writer.getSecondsWaited());
+
+    if (numRendered < numTasks || writeFailures > 0 || ! summariesWritten)
+    {
+        std::printf ("%d of %d point(s) rendered, %d file(s) could not be written%s\n", numRendered.load(), numTasks,
+                     writeFailures, summariesWritten ? "" : ", atlas.csv could not be written");
+        return 1;
+    }
+
+    std::printf ("Wrote %d files and %s\n", numTasks, summaryFile.getFullPathName().toRawUTF8());
+    return 0;
+}
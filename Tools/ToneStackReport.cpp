@@ -0,0 +1,233 @@
+//==============================================================================
+// HarmonsterToneStackReport - accuracy and CPU of the passive EQ model
+//
+// Accuracy, per sample rate:
+//   grid   - interpolated coefficients against an exact design at every knob
+//            position, worst magnitude error over 20 Hz .. 20 kHz
+//   model  - exact digital design against the analogue circuit, worst error
+//            up to 16 kHz (bilinear warping above the prewarp frequency)
+// then the response of the classic EQ blend and of the passive model side by
+// side at a few knob positions.
+//
+// CPU: the filter alone per sample, the cost of a knob change (the classic
+// filter's coefficient, a grid lookup, a full design), and the whole circuit
+// with either EQ model.
+//
+// Usage:
+//   HarmonsterToneStackReport [--seconds=2]
+//==============================================================================
+
+#include <juce_core/juce_core.h>
+#include "WoolyMammothDSP.h"
+
+#include <complex>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    using Coefficients = PassiveToneStack::Coefficients;
+
+    double magnitude (const Coefficients& c, double frequency, double sampleRate)
+    {
+        const auto z = std::polar (1.0, -2.0 * M_PI * frequency / sampleRate);
+        return std::abs ((c.b0 + c.b1 * z + c.b2 * z * z) / (1.0 + c.a1 * z + c.a2 * z * z));
+    }
+
+    double toDb (double gain) { return 20.0 * std::log10 (std::max (gain, 1.0e-12)); }
+
+    //==========================================================================
+    // The classic EQ blend, as WoolyMammothDSP::classicEqStage() designs it
+    struct ClassicEq
+    {
+        double alpha = 0.0, eq = 0.5;
+        double z1 = 0.0, z2 = 0.0;
+
+        void setEQ (double newEq, double sampleRate)
+        {
+            eq = newEq;
+            const double cutoff = 800.0 + eq * 2200.0;
+            alpha = 1.0 / (1.0 + (2.0 * M_PI * cutoff / sampleRate));
+        }
+
+        double process (double input)
+        {
+            z1 = z1 * alpha + input * (1.0 - alpha);
+            z2 = z2 * alpha + z1 * (1.0 - alpha);
+            return z2 * (1.0 - eq) + (input - z1) * eq * 0.7;
+        }
+
+        double magnitude (double frequency, double sampleRate) const
+        {
+            const auto zInv = std::polar (1.0, -2.0 * M_PI * frequency / sampleRate);
+            const auto onePole = (1.0 - alpha) / (1.0 - alpha * zInv);
+            return std::abs (onePole * onePole * (1.0 - eq) + (1.0 - onePole) * eq * 0.7);
+        }
+    };
+
+    //==========================================================================
+    void reportAccuracy (double sampleRate)
+    {
+        const auto table = PassiveToneStack::getTable (sampleRate);
+        const double topFrequency = std::min (20000.0, 0.45 * sampleRate);
+        double worstGrid = 0.0, worstModel = 0.0;
+
+        for (int i = 0; i <= 1000; ++i)
+        {
+            const double eq = i / 1000.0;
+            const auto exact = PassiveToneStack::design (eq, sampleRate);
+            const auto interpolated = PassiveToneStack::lookup (*table, eq);
+
+            for (double frequency = 20.0; frequency <= topFrequency; frequency *= 1.05)
+            {
+                const double exactDb = toDb (magnitude (exact, frequency, sampleRate));
+                worstGrid = std::max (worstGrid, std::abs (toDb (magnitude (interpolated, frequency, sampleRate)) - exactDb));
+
+                if (frequency <= 16000.0)
+                    worstModel = std::max (worstModel, std::abs (exactDb - toDb (PassiveToneStack::analogMagnitude (eq, frequency))));
+            }
+        }
+
+        std::printf ("%8.0f Hz   grid %.4f dB   model %.2f dB\n", sampleRate, worstGrid, worstModel);
+    }
+
+    void reportResponses (double sampleRate)
+    {
+        const auto table = PassiveToneStack::getTable (sampleRate);
+        const double frequencies[] = { 50.0, 200.0, 500.0, 1000.0, 2000.0, 5000.0, 10000.0 };
+
+        std::printf ("\nResponse at %.0f Hz (dB)    ", sampleRate);
+        for (auto frequency : frequencies)
+            std::printf ("%8.0f", frequency);
+        std::printf ("\n");
+
+        for (double eq : { 0.0, 0.25, 0.5, 0.75, 1.0 })
+        {
+            ClassicEq classic;
+            classic.setEQ (eq, sampleRate);
+            const auto passive = PassiveToneStack::lookup (*table, eq);
+
+            std::printf ("  eq %.2f   classic        ", eq);
+            for (auto frequency : frequencies)
+                std::printf ("%8.1f", toDb (classic.magnitude (frequency, sampleRate)));
+
+            std::printf ("\n            passive RC     ");
+            for (auto frequency : frequencies)
+                std::printf ("%8.1f", toDb (magnitude (passive, frequency, sampleRate)));
+            std::printf ("\n");
+        }
+    }
+
+    //==========================================================================
+    template <typename Function>
+    double nanosecondsPer (int count, Function&& function)
+    {
+        const auto start = juce::Time::getHighResolutionTicks();
+        function();
+        const auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        return seconds * 1.0e9 / count;
+    }
+
+    void reportCpu (double sampleRate, double seconds)
+    {
+        const int numSamples = static_cast<int> (sampleRate * seconds);
+        const int numKnobChanges = 1000000;
+
+        std::vector<float> input (static_cast<size_t> (numSamples));
+        std::mt19937 rng (1);
+        std::normal_distribution<float> noise (0.0f, 0.3f);
+        for (auto& sample : input)
+            sample = noise (rng);
+
+        const auto table = PassiveToneStack::getTable (sampleRate);
+        volatile double sink = 0.0;
+
+        // The filters on their own
+        ClassicEq classic;
+        classic.setEQ (0.4, sampleRate);
+        const double classicFilter = nanosecondsPer (numSamples, [&]
+        {
+            double sum = 0.0;
+            for (auto sample : input)
+                sum += classic.process (sample);
+            sink = sum;
+        });
+
+        const auto passive = PassiveToneStack::lookup (*table, 0.4);
+        const double passiveFilter = nanosecondsPer (numSamples, [&]
+        {
+            double sum = 0.0, z1 = 0.0, z2 = 0.0;
+            for (auto sample : input)
+                sum += PassiveToneStack::process (passive, sample, z1, z2);
+            sink = sum;
+        });
+
+        // A knob change
+        const double classicChange = nanosecondsPer (numKnobChanges, [&]
+        {
+            double sum = 0.0;
+            for (int i = 0; i < numKnobChanges; ++i)
+            {
+                classic.setEQ ((i & 1023) / 1023.0, sampleRate);
+                sum += classic.alpha;
+            }
+            sink = sum;
+        });
+
+        const double lookupChange = nanosecondsPer (numKnobChanges, [&]
+        {
+            double sum = 0.0;
+            for (int i = 0; i < numKnobChanges; ++i)
+                sum += PassiveToneStack::lookup (*table, (i & 1023) / 1023.0).b0;
+            sink = sum;
+        });
+
+        const double designChange = nanosecondsPer (numKnobChanges, [&]
+        {
+            double sum = 0.0;
+            for (int i = 0; i < numKnobChanges; ++i)
+                sum += PassiveToneStack::design ((i & 1023) / 1023.0, sampleRate).b0;
+            sink = sum;
+        });
+
+        // The whole circuit with each EQ model
+        auto circuitCost = [&] (unsigned features)
+        {
+            WoolyMammothDSP dsp;
+            dsp.setSampleRate (sampleRate);
+            dsp.setEQ (0.4);
+            dsp.setFeatures (features);
+
+            auto block = input;
+            return nanosecondsPer (numSamples, [&] { dsp.processBlock (block.data(), numSamples); });
+        };
+
+        const unsigned passiveFeatures = WoolyMammothDSP::allFeatures;
+        const unsigned classicFeatures = passiveFeatures & ~static_cast<unsigned> (WoolyMammothDSP::passiveEq);
+        const double classicCircuit = circuitCost (classicFeatures);
+        const double passiveCircuit = circuitCost (passiveFeatures);
+
+        std::printf ("\nCPU at %.0f Hz\n", sampleRate);
+        std::printf ("  filter per sample     classic %6.2f ns   passive RC %6.2f ns\n", classicFilter, passiveFilter);
+        std::printf ("  knob change           classic %6.2f ns   grid lookup %6.2f ns   full design %6.2f ns\n",
+                     classicChange, lookupChange, designChange);
+        std::printf ("  circuit per sample    classic %6.2f ns   passive RC %6.2f ns\n", classicCircuit, passiveCircuit);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::ArgumentList args (argc, argv);
+    const double seconds = args.containsOption ("--seconds")
+                               ? juce::jmax (0.1, args.getValueForOption ("--seconds").getDoubleValue())
+                               : 2.0;
+
+    std::printf ("Interpolated grid and digital model, worst magnitude error\n");
+    for (double sampleRate : { 44100.0, 48000.0, 88200.0, 96000.0, 192000.0, 384000.0 })
+        reportAccuracy (sampleRate);
+
+    reportResponses (48000.0);
+    reportCpu (48000.0, seconds);
+    return 0;
+}